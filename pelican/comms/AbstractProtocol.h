@@ -7,8 +7,8 @@
 
 #include <boost/shared_ptr.hpp>
 #include <QtCore/QMap>
+#include <QtCore/QString>
 
-class QString;
 class QIODevice;
 class QTcpSocket;
 
@@ -19,6 +19,7 @@ class StreamData;
 class DataChunk;
 class DataBlob;
 class DataSupportResponse;
+class MetricsResponse;
 
 /**
  * @ingroup c_comms
@@ -47,6 +48,10 @@ class AbstractProtocol
         /// Processes an incoming request.
         virtual boost::shared_ptr<ServerRequest> request(QTcpSocket& socket) = 0;
 
+        /// Returns true if a whole request has arrived on the socket, so
+        /// that request() will not wait for more (the default assumes so).
+        virtual bool requestComplete(QTcpSocket& /*socket*/) { return true; }
+
         /// Write stream data to an I/O device.
         virtual void send(QIODevice& device, const StreamData_t&) = 0;
 
@@ -65,6 +70,27 @@ class AbstractProtocol
         /// Send an error to an I/O device.
         virtual void sendError(QIODevice& device, const QString&) = 0;
 
+        /// Write the server metrics to an I/O device.
+        /// (the default reports that metrics are not supported)
+        virtual void send(QIODevice& device, const MetricsResponse&)
+        { sendError(device, "Metrics not supported"); }
+
+        /// Agree the protocol version to use with the client.
+        /// (the default only supports the original version)
+        virtual void sendVersion(QIODevice& device, quint16 /*version*/)
+        { sendError(device, "Protocol version negotiation not supported"); }
+
+        /// Name of the device property that, when true, asks the protocol
+        /// to leave its writes queued on the device instead of waiting for
+        /// them to be sent (the caller flushes the device).
+        static const char* deferredWritesProperty()
+        { return "pelicanDeferredWrites"; }
+
+        /// Returns true if stream data is sent by reference, in which case
+        /// it must stay locked until the client releases it
+        /// (see ReleaseRequest).
+        virtual bool sendsReferences() const { return false; }
+
 };
 
 } // namespace pelican
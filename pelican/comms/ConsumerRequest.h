@@ -0,0 +1,54 @@
+#ifndef CONSUMERREQUEST_H
+#define CONSUMERREQUEST_H
+
+/**
+ * @file ConsumerRequest.h
+ */
+
+#include "ServerRequest.h"
+#include <QtCore/QString>
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class ConsumerRequest
+ *
+ * @brief
+ * Names the consumer of the stream data requested on a connection.
+ *
+ * @details
+ * Stream data buffers in broadcast mode keep a read cursor for each named
+ * consumer, so that every consumer sees every chunk. The name applies to
+ * all later requests on the connection, which the server keeps alive.
+ * Connections that do not name a consumer share the unnamed consumer.
+ * The server does not reply.
+ */
+class ConsumerRequest : public ServerRequest
+{
+    public:
+        /// Creates the ConsumerRequest object.
+        ConsumerRequest(const QString& name = QString())
+        : ServerRequest(ServerRequest::Consumer), _name(name) {}
+
+        /// Destroys the ConsumerRequest object.
+        ~ConsumerRequest() {}
+
+        /// Returns the name of the consumer.
+        const QString& name() const { return _name; }
+
+        /// Test for equality between ConsumerRequest objects.
+        virtual bool operator==(const ServerRequest& req) const
+        {
+            return ServerRequest::operator==(req) &&
+                    _name == static_cast<const ConsumerRequest&>(req)._name;
+        }
+
+    private:
+        QString _name;
+};
+
+} // namespace pelican
+
+#endif // CONSUMERREQUEST_H
@@ -0,0 +1,49 @@
+#ifndef CREDITREQUEST_H
+#define CREDITREQUEST_H
+
+/**
+ * @file CreditRequest.h
+ */
+
+#include "ServerRequest.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class CreditRequest
+ *
+ * @brief
+ * Grants the server credits to push more data on a subscription.
+ *
+ * @details
+ * See StreamSubscriptionRequest. The server does not reply.
+ */
+class CreditRequest : public ServerRequest
+{
+    public:
+        /// Creates the CreditRequest object.
+        CreditRequest(quint32 credits = 1)
+        : ServerRequest(ServerRequest::Credit), _credits(credits) {}
+
+        /// Destroys the CreditRequest object.
+        ~CreditRequest() {}
+
+        /// Returns the number of credits granted.
+        quint32 credits() const { return _credits; }
+
+        /// Test for equality between CreditRequest objects.
+        virtual bool operator==(const ServerRequest& req) const
+        {
+            return ServerRequest::operator==(req) &&
+                    _credits == static_cast<const CreditRequest&>(req)._credits;
+        }
+
+    private:
+        quint32 _credits;
+};
+
+} // namespace pelican
+
+#endif // CREDITREQUEST_H
@@ -0,0 +1,35 @@
+#ifndef METRICSREQUEST_H
+#define METRICSREQUEST_H
+
+/**
+ * @file MetricsRequest.h
+ */
+
+#include "ServerRequest.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class MetricsRequest
+ *
+ * @brief
+ * Asks the server for its current metrics.
+ *
+ * @details
+ * The server replies with a MetricsResponse.
+ */
+class MetricsRequest : public ServerRequest
+{
+    public:
+        /// Creates the MetricsRequest object.
+        MetricsRequest() : ServerRequest(ServerRequest::Metrics) {}
+
+        /// Destroys the MetricsRequest object.
+        ~MetricsRequest() {}
+};
+
+} // namespace pelican
+
+#endif // METRICSREQUEST_H
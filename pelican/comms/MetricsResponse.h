@@ -0,0 +1,57 @@
+#ifndef METRICSRESPONSE_H
+#define METRICSRESPONSE_H
+
+/**
+ * @file MetricsResponse.h
+ */
+
+#include "ServerResponse.h"
+#include <QtCore/QMap>
+#include <QtCore/QString>
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class MetricsResponse
+ *
+ * @brief
+ * The metrics of a server.
+ *
+ * @details
+ * Each metric is a value keyed by its name in the Prometheus style, with
+ * any labels in braces, e.g.
+ * \verbatim pelican_stream_chunks_written_total{stream="VisibilityData"} \endverbatim
+ * text() returns the metrics in the Prometheus text exposition format.
+ */
+class MetricsResponse : public ServerResponse
+{
+    public:
+        /// Constructs the MetricsResponse object.
+        MetricsResponse(const QMap<QString, double>& values = QMap<QString, double>())
+        : ServerResponse(ServerResponse::Metrics), _values(values) {}
+
+        /// Destroys the MetricsResponse object.
+        ~MetricsResponse() {}
+
+        /// Returns the metrics.
+        const QMap<QString, double>& values() const { return _values; }
+
+        /// Returns the value of the named metric (0 if there is none).
+        double value(const QString& name) const { return _values.value(name); }
+
+        /// Returns the metrics in the Prometheus text format.
+        QString text() const;
+
+        /// Returns the name of a metric with a label.
+        static QString name(const QString& metric, const QString& label,
+                const QString& value);
+
+    private:
+        QMap<QString, double> _values;
+};
+
+} // namespace pelican
+
+#endif // METRICSRESPONSE_H
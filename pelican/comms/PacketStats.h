@@ -0,0 +1,84 @@
+#ifndef PACKETSTATS_H
+#define PACKETSTATS_H
+
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QtGlobal>
+
+/**
+ * @file PacketStats.h
+ */
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class PacketStats
+ *
+ * @brief
+ *    How completely a chunk of stream data was assembled from its packets.
+ *
+ * @details
+ *    Set by a chunker that assembles its chunks from sequence numbered
+ *    packets (see PacketReassembler): the sequence number and timestamp of
+ *    the first packet of the chunk, the number of packets it should hold,
+ *    and how many were lost or arrived out of order. If the gaps left by
+ *    lost packets are not zero-filled, gaps() lists them as the index of
+ *    the first packet missing and the number missing.
+ *
+ *    Chunks from other chunkers have no packets().
+ */
+class PacketStats
+{
+    public:
+        /// A run of missing packets: the index of the first, and the count.
+        typedef QPair<quint32, quint32> Gap;
+
+    public:
+        /// Constructs empty statistics.
+        PacketStats() { clear(); }
+
+        /// Clears the statistics.
+        void clear() {
+            _sequence = _timestamp = 0;
+            _packets = _lost = _reordered = 0;
+            _gaps.clear();
+        }
+
+        /// Returns the sequence number of the first packet of the chunk.
+        quint64 sequence() const { return _sequence; }
+        void setSequence(quint64 sequence) { _sequence = sequence; }
+
+        /// Returns the timestamp of the earliest packet received.
+        quint64 timestamp() const { return _timestamp; }
+        void setTimestamp(quint64 timestamp) { _timestamp = timestamp; }
+
+        /// Returns the number of packets the chunk should hold.
+        quint32 packets() const { return _packets; }
+        void setPackets(quint32 packets) { _packets = packets; }
+
+        /// Returns the number of packets missing from the chunk.
+        quint32 lost() const { return _lost; }
+        void setLost(quint32 lost) { _lost = lost; }
+
+        /// Returns the number of packets that arrived out of order.
+        quint32 reordered() const { return _reordered; }
+        void setReordered(quint32 reordered) { _reordered = reordered; }
+
+        /// Returns the runs of missing packets that were not zero-filled.
+        const QList<Gap>& gaps() const { return _gaps; }
+        void addGap(quint32 first, quint32 count) { _gaps.append(Gap(first, count)); }
+
+    private:
+        quint64 _sequence;
+        quint64 _timestamp;
+        quint32 _packets;
+        quint32 _lost;
+        quint32 _reordered;
+        QList<Gap> _gaps;
+};
+
+} // namespace pelican
+
+#endif // PACKETSTATS_H
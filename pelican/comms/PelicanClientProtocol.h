@@ -6,12 +6,16 @@
  */
 
 #include "AbstractClientProtocol.h"
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
 
 class QDataStream;
 
 namespace pelican {
 
 class DataSpec;
+class WireReader;
+class WireWriter;
 
 /**
  * @ingroup c_comms
@@ -22,6 +26,10 @@ class DataSpec;
  * Implementation of the PelicanProtocol for the client side of communications.
  *
  * @details
+ * Messages are in version 1 format unless a later version has been agreed
+ * with the server on the connection with negotiate() (see WireFormat).
+ * As the version is a property of the connection, a protocol object
+ * should only be used for one connection at a time.
  */
 
 class PelicanClientProtocol : public AbstractClientProtocol
@@ -32,9 +40,27 @@ class PelicanClientProtocol : public AbstractClientProtocol
         virtual QByteArray serialise(const ServerRequest&);
         virtual boost::shared_ptr<ServerResponse> receive(QAbstractSocket&);
 
+        /// Agrees the protocol version to use on a new connection.
+        quint16 negotiate(QAbstractSocket& socket, quint16 version);
+
+        /// Sets the protocol version used.
+        void setVersion(quint16 version) { _version = version; }
+
+        /// Returns the protocol version used.
+        quint16 version() const { return _version; }
+
     private:
         void _serializeDataRequirements(QDataStream& stream,
                 const DataSpec& req) const;
+        QByteArray _serialiseV2(const ServerRequest&);
+        boost::shared_ptr<ServerResponse> _receiveV2(QAbstractSocket&);
+        void _putName(WireWriter& out, const QString& name) const;
+        QString _readName(WireReader& in) const;
+
+    private:
+        quint16 _version;
+        QStringList _names;           ///< Names by id, from the server.
+        QHash<QString, quint16> _ids;
 };
 
 } // namespace pelican
@@ -6,10 +6,18 @@
  */
 
 #include "AbstractProtocol.h"
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QReadWriteLock>
+
+class QDataStream;
 
 namespace pelican {
 
 class DataBlob;
+class StreamDataRequest;
+class WireReader;
+class WireWriter;
 
 /**
  * @ingroup c_comms
@@ -20,6 +28,19 @@ class DataBlob;
  * The primary protocol for communication between pipelines and the server.
  *
  * @details
+ * When stream data is sent to a socket, the header and chunks are passed
+ * to the kernel in a single sendmsg() call straight from the chunk memory,
+ * rather than being copied through the socket's write buffer. With
+ * setZeroCopy(true) large chunks are sent with MSG_ZEROCOPY where the
+ * kernel supports it, and send() returns only once the kernel has released
+ * the chunk memory (so it remains locked until then). On a device with
+ * the deferredWritesProperty() set, stream data is instead copied to the
+ * device's write buffer, and left for the caller to flush.
+ *
+ * A client may ask for version 2 or 3 of the protocol on a connection (see
+ * WireFormat), in which case the agreed version is stored as a property of
+ * the socket and used for all later messages on it, as is the sequence
+ * number of the stream data sent on it.
  */
 
 class PelicanProtocol : public AbstractProtocol
@@ -32,6 +53,9 @@ class PelicanProtocol : public AbstractProtocol
         /// Construct a server request object from reading the specified socket
         virtual boost::shared_ptr<ServerRequest> request(QTcpSocket& socket);
 
+        /// Returns true if a whole request has arrived on the socket.
+        virtual bool requestComplete(QTcpSocket& socket);
+
         /// Sends a list of supported stream and service data.
         virtual void send(QIODevice& device, const DataSupportResponse&);
 
@@ -50,6 +74,53 @@ class PelicanProtocol : public AbstractProtocol
 
         /// Send a error.
         virtual void sendError(QIODevice& stream, const QString&);
+
+        /// Send the server metrics.
+        virtual void send(QIODevice& device, const MetricsResponse&);
+
+        /// Agree the protocol version to use on the connection.
+        virtual void sendVersion(QIODevice& device, quint16 version);
+
+        /// Send large stream data chunks without copying them (default false).
+        void setZeroCopy(bool zeroCopy) { _zeroCopy = zeroCopy; }
+
+        /// Returns the number of sends made with MSG_ZEROCOPY.
+        quint64 zeroCopySends() const { return _zeroCopySends; }
+
+    private:
+        /// Reads a version 1 request.
+        boost::shared_ptr<ServerRequest> _requestV1(QDataStream& in);
+
+        /// Reads a version 2 request.
+        boost::shared_ptr<ServerRequest> _requestV2(QTcpSocket& socket);
+
+        /// Reads the data options of a version 2 stream data request.
+        void _readDataOptions(WireReader& in, int count, StreamDataRequest& req);
+
+        /// Starts a version 2 response.
+        void _startResponse(WireWriter& out, quint16 type, quint16 count,
+                quint64 sequence = 0);
+
+        /// Writes the name, by id if the client knows it.
+        void _putName(WireWriter& out, const QString& name, int knownIds);
+
+        /// Reads a name sent by id or in full.
+        QString _readName(WireReader& in);
+
+        /// Writes the header and stream data directly to a socket.
+        bool _sendDirect(QIODevice& device, const QByteArray& header,
+                const AbstractProtocol::StreamData_t& data);
+
+    private:
+        /// Smallest send (bytes) made with MSG_ZEROCOPY.
+        static const size_t zeroCopyThreshold = 65536;
+
+    private:
+        bool _zeroCopy;
+        quint64 _zeroCopySends;
+        QReadWriteLock _idLock;
+        QHash<QString, quint16> _ids;  ///< Ids of names sent to clients.
+        QStringList _names;            ///< Names by id.
 };
 
 } // namespace pelican
@@ -0,0 +1,51 @@
+#ifndef PROTOCOLVERSIONREQUEST_H
+#define PROTOCOLVERSIONREQUEST_H
+
+/**
+ * @file ProtocolVersionRequest.h
+ */
+
+#include "ServerRequest.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class ProtocolVersionRequest
+ *
+ * @brief
+ * Asks the server to use a later version of the protocol on the connection.
+ *
+ * @details
+ * The server replies with a ProtocolVersionResponse giving the version it
+ * will use, which is no later than the version requested. A server that
+ * does not support negotiation replies with an error.
+ */
+class ProtocolVersionRequest : public ServerRequest
+{
+    public:
+        /// Creates the ProtocolVersionRequest object.
+        ProtocolVersionRequest(quint16 version = 1)
+        : ServerRequest(ServerRequest::ProtocolVersion), _version(version) {}
+
+        /// Destroys the ProtocolVersionRequest object.
+        ~ProtocolVersionRequest() {}
+
+        /// Returns the highest version the client supports.
+        quint16 version() const { return _version; }
+
+        /// Test for equality between ProtocolVersionRequest objects.
+        virtual bool operator==(const ServerRequest& req) const
+        {
+            return ServerRequest::operator==(req) &&
+                    _version == static_cast<const ProtocolVersionRequest&>(req)._version;
+        }
+
+    private:
+        quint16 _version;
+};
+
+} // namespace pelican
+
+#endif // PROTOCOLVERSIONREQUEST_H
@@ -0,0 +1,39 @@
+#ifndef PROTOCOLVERSIONRESPONSE_H
+#define PROTOCOLVERSIONRESPONSE_H
+
+/**
+ * @file ProtocolVersionResponse.h
+ */
+
+#include "ServerResponse.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class ProtocolVersionResponse
+ *
+ * @brief
+ * The protocol version the server will use on the connection.
+ */
+class ProtocolVersionResponse : public ServerResponse
+{
+    public:
+        /// Constructs the ProtocolVersionResponse object.
+        ProtocolVersionResponse(quint16 version)
+        : ServerResponse(ServerResponse::ProtocolVersion), _version(version) {}
+
+        /// Destroys the ProtocolVersionResponse object.
+        ~ProtocolVersionResponse() {}
+
+        /// Returns the agreed protocol version.
+        quint16 version() const { return _version; }
+
+    private:
+        quint16 _version;
+};
+
+} // namespace pelican
+
+#endif // PROTOCOLVERSIONRESPONSE_H
@@ -0,0 +1,52 @@
+#ifndef RELEASEREQUEST_H
+#define RELEASEREQUEST_H
+
+/**
+ * @file ReleaseRequest.h
+ */
+
+#include "ServerRequest.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class ReleaseRequest
+ *
+ * @brief
+ * Releases stream data sent by reference.
+ *
+ * @details
+ * Stream data sent by a protocol that sends references (e.g. the
+ * SharedMemoryProtocol) stays locked in the server until the client has
+ * finished with it. The request releases the given number of chunks, oldest
+ * first. The server does not reply.
+ */
+class ReleaseRequest : public ServerRequest
+{
+    public:
+        /// Creates the ReleaseRequest object.
+        ReleaseRequest(quint32 count = 1)
+        : ServerRequest(ServerRequest::Release), _count(count) {}
+
+        /// Destroys the ReleaseRequest object.
+        ~ReleaseRequest() {}
+
+        /// Returns the number of chunks released.
+        quint32 count() const { return _count; }
+
+        /// Test for equality between ReleaseRequest objects.
+        virtual bool operator==(const ServerRequest& req) const
+        {
+            return ServerRequest::operator==(req) &&
+                    _count == static_cast<const ReleaseRequest&>(req)._count;
+        }
+
+    private:
+        quint32 _count;
+};
+
+} // namespace pelican
+
+#endif // RELEASEREQUEST_H
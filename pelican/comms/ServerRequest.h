@@ -25,7 +25,9 @@ class ServerRequest
 {
     public:
         typedef enum {
-            Error, Acknowledge, StreamData, ServiceData, DataSupport
+            Error, Acknowledge, StreamData, ServiceData, DataSupport,
+            StreamSubscription, Credit, ProtocolVersion, Release, Consumer,
+            Metrics
         } Request;
 
     private:
@@ -23,7 +23,8 @@ class ServerResponse
 {
     public:
         typedef enum {
-            Error, Acknowledge, StreamData, ServiceData, Blob, DataSupport
+            Error, Acknowledge, StreamData, ServiceData, Blob, DataSupport,
+            ProtocolVersion, SharedStreamData, Metrics
         } Response;
 
     private:
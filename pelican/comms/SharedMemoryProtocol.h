@@ -0,0 +1,51 @@
+#ifndef SHAREDMEMORYPROTOCOL_H
+#define SHAREDMEMORYPROTOCOL_H
+
+/**
+ * @file SharedMemoryProtocol.h
+ */
+
+#include "pelican/comms/PelicanProtocol.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class SharedMemoryProtocol
+ *
+ * @brief
+ * Version of the PelicanProtocol for clients on the same host.
+ *
+ * @details
+ * Stream data held in a shared memory segment (see StreamDataBuffer's
+ * Shared allocation) is not copied to the client. The client is sent a
+ * SharedStreamData response describing the data and its location in the
+ * segment, and reads it in place. Other stream data is sent as usual.
+ *
+ * Stream data stays locked in the server until the client sends a
+ * ReleaseRequest for it, so the protocol should only be used on
+ * connections that are kept alive (e.g. with
+ * PelicanServer::addLocalProtocol()). Only version 1 of the protocol is
+ * supported.
+ */
+class SharedMemoryProtocol : public PelicanProtocol
+{
+    public:
+        SharedMemoryProtocol() {}
+        ~SharedMemoryProtocol() {}
+
+    public:
+        /// Sends a description of stream data held in shared memory.
+        virtual void send(QIODevice& stream, const AbstractProtocol::StreamData_t&);
+        using PelicanProtocol::send;
+
+        /// Agrees version 1 of the protocol.
+        virtual void sendVersion(QIODevice& device, quint16 version);
+
+        /// Stream data is sent by reference.
+        virtual bool sendsReferences() const { return true; }
+};
+
+} // namespace pelican
+#endif // SHAREDMEMORYPROTOCOL_H
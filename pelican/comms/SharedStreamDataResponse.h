@@ -0,0 +1,45 @@
+#ifndef SHAREDSTREAMDATARESPONSE_H
+#define SHAREDSTREAMDATARESPONSE_H
+
+/**
+ * @file SharedStreamDataResponse.h
+ */
+
+#include "pelican/comms/StreamDataResponse.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class SharedStreamDataResponse
+ *
+ * @brief
+ * Stream data left in the server's shared memory.
+ *
+ * @details
+ * The data itself is not sent; it is found at offset() in the shared
+ * memory segment named by segment(), until the client sends a
+ * ReleaseRequest for it.
+ */
+class SharedStreamDataResponse : public StreamDataResponse
+{
+    public:
+        /// Constructs a SharedStreamDataResponse object.
+        SharedStreamDataResponse(const QString& segment, quint64 offset)
+        : StreamDataResponse(ServerResponse::SharedStreamData),
+          _segment(segment), _offset(offset) {}
+
+        /// Returns the name of the shared memory segment holding the data.
+        const QString& segment() const { return _segment; }
+
+        /// Returns the offset of the data in the segment.
+        quint64 offset() const { return _offset; }
+
+    private:
+        QString _segment;
+        quint64 _offset;
+};
+
+} // namespace pelican
+#endif // SHAREDSTREAMDATARESPONSE_H
@@ -6,6 +6,8 @@
  */
 
 #include "pelican/comms/DataChunk.h"
+#include "pelican/comms/PacketStats.h"
+#include "pelican/utility/LatencyTrace.h"
 
 #include <QtCore/QSet>
 #include <QtCore/QString>
@@ -24,7 +26,10 @@ class LockedData;
  *     Contains Pointers to Chunked Stream and a manifest of associated data
  * @details
  *     As well as a pointer to and the size of the data this class
- *     also contains linking information to the service data
+ *     also contains linking information to the service data, the
+ *     times the data passed each stage of the server (see LatencyTrace)
+ *     and, for chunks assembled from numbered packets, the packets lost
+ *     and reordered (see PacketStats).
  */
 
 class StreamData : public DataChunk
@@ -45,12 +50,22 @@ class StreamData : public DataChunk
         bool operator==(const StreamData& sd) const;
         void reset( size_t );
 
+        /// Returns the times the data passed each stage.
+        LatencyTrace& latencyTrace() { return _trace; }
+        const LatencyTrace& latencyTrace() const { return _trace; }
+
+        /// Returns the statistics of the packets the chunk was assembled from.
+        PacketStats& packetStats() { return _packetStats; }
+        const PacketStats& packetStats() const { return _packetStats; }
+
     private:
         StreamData(const StreamData&);
 
     private:
         DataList_t _associateData;
         QSet<QString> _associateDataTypes;
+        LatencyTrace _trace;
+        PacketStats _packetStats;
 };
 
 } // namespace pelican
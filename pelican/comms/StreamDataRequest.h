@@ -56,6 +56,10 @@ class StreamDataRequest : public ServerRequest
 
         /// Test for equality between ServiceData objects.
         virtual bool operator==(const ServerRequest&) const;
+
+    protected:
+        /// Constructor for derived request types.
+        StreamDataRequest(ServerRequest::Request type);
 };
 
 typedef StreamDataRequest::DataSpecIterator DataSpecIterator;
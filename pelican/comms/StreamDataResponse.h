@@ -25,6 +25,7 @@ class StreamDataResponse : public ServerResponse
 {
     private:
         pelican::StreamData* _data;
+        quint64 _sequence;
 
     public:
         /// Constructs a StreamDataResponse object.
@@ -38,6 +39,17 @@ class StreamDataResponse : public ServerResponse
 
         /// Returns the pointer to the StreamData object.
         pelican::StreamData* streamData() {return _data;}
+
+        /// Sets the server's sequence number for the data.
+        void setSequence(quint64 sequence) { _sequence = sequence; }
+
+        /// Returns the server's sequence number for the data
+        /// (protocol version 2 and later, otherwise 0).
+        quint64 sequence() const { return _sequence; }
+
+    protected:
+        /// Constructs a response of a derived type.
+        StreamDataResponse(ServerResponse::Response type);
 };
 
 } // namespace pelican
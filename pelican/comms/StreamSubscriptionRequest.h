@@ -0,0 +1,53 @@
+#ifndef STREAMSUBSCRIPTIONREQUEST_H
+#define STREAMSUBSCRIPTIONREQUEST_H
+
+/**
+ * @file StreamSubscriptionRequest.h
+ */
+
+#include "pelican/comms/StreamDataRequest.h"
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class StreamSubscriptionRequest
+ *
+ * @brief
+ * Subscribes a connection to a set of DataSpec options.
+ *
+ * @details
+ * Instead of answering a single request, the server pushes stream data
+ * matching the options (as for a StreamDataRequest) down the connection as
+ * it becomes available, preceded by any associated service data that has
+ * not already been sent on the connection.
+ *
+ * Flow control is credit based: each chunk pushed uses one credit, and the
+ * server stops pushing when the credits run out. The subscription carries
+ * the initial number of credits, and the client grants more with a
+ * CreditRequest as it consumes the data.
+ */
+
+class StreamSubscriptionRequest : public StreamDataRequest
+{
+    public:
+        /// Constructs a subscription with the given initial credits.
+        StreamSubscriptionRequest(quint32 credits = 1);
+        ~StreamSubscriptionRequest();
+
+        /// Returns the initial number of credits.
+        quint32 credits() const { return _credits; }
+
+        /// Sets the initial number of credits.
+        void setCredits(quint32 credits) { _credits = credits; }
+
+        /// Test for equality between StreamSubscriptionRequest objects.
+        virtual bool operator==(const ServerRequest&) const;
+
+    private:
+        quint32 _credits;
+};
+
+} // namespace pelican
+#endif // STREAMSUBSCRIPTIONREQUEST_H
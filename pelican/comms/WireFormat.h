@@ -0,0 +1,213 @@
+#ifndef WIREFORMAT_H
+#define WIREFORMAT_H
+
+/**
+ * @file WireFormat.h
+ */
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QtEndian>
+#include <cstring>
+
+namespace pelican {
+
+/**
+ * @ingroup c_comms
+ *
+ * @class WireFormat
+ *
+ * @brief
+ * Constants describing versions 2 and 3 of the Pelican protocol.
+ *
+ * @details
+ * Version 1 messages are written with QDataStream (big-endian, with names
+ * and versions as UTF-16 strings). Version 2 messages are little-endian
+ * and start with a fixed size header:
+ *
+ * - requests: type (16 bits), count (16), body length (32).
+ * - responses: type (16 bits), count (16), body length (32),
+ *   sequence number (64, counting the stream data sent on the connection).
+ *
+ * Stream and service data names are sent as 16-bit ids from the table sent
+ * with the DataSupport response, or as the id noId followed by the name.
+ * Version ids that are decimal numbers (as the server generates) are sent
+ * as 64-bit integers, other versions as the value stringVersion followed
+ * by the string. Strings are a 16-bit length followed by UTF-8.
+ *
+ * Version 3 is version 2 with the times the server ingested and served
+ * each chunk of stream data (64-bit nanoseconds, see LatencyTrace) after
+ * its size.
+ *
+ * Version 2 or 3 is agreed with a ProtocolVersion request and response,
+ * which are always written in version 1 format.
+ */
+class WireFormat
+{
+    public:
+        /// The highest protocol version supported.
+        static const quint16 version = 3;
+
+        /// Size of the version 2 request header (bytes).
+        static const int requestHeaderSize = 8;
+
+        /// Size of the version 2 response header (bytes).
+        static const int responseHeaderSize = 16;
+
+        /// Id used for names sent in full.
+        static const quint16 noId = 0xFFFF;
+
+        /// Version value for an empty version id.
+        static const quint64 emptyVersion = Q_UINT64_C(0xFFFFFFFFFFFFFFFE);
+
+        /// Version value for a version id sent as a string.
+        static const quint64 stringVersion = Q_UINT64_C(0xFFFFFFFFFFFFFFFF);
+};
+
+
+/**
+ * @ingroup c_comms
+ *
+ * @class WireWriter
+ *
+ * @brief
+ * Appends little-endian fields to a version 2 protocol message.
+ */
+class WireWriter
+{
+    public:
+        /// Appends to the given buffer.
+        WireWriter(QByteArray& buffer) : _buffer(buffer) {}
+
+        void putU16(quint16 v) { _put(v); }
+        void putU32(quint32 v) { _put(v); }
+        void putU64(quint64 v) { _put(v); }
+
+        /// Appends a double as its 64-bit IEEE 754 representation.
+        void putF64(double v) {
+            quint64 bits;
+            memcpy(&bits, &v, sizeof(bits));
+            putU64(bits);
+        }
+
+        /// Appends a string as a length and UTF-8 bytes.
+        void putString(const QString& s) {
+            QByteArray utf8 = s.toUtf8();
+            putU16(utf8.size());
+            _buffer.append(utf8);
+        }
+
+        /// Appends a name by id, or in full if id is WireFormat::noId.
+        void putName(quint16 id, const QString& name) {
+            putU16(id);
+            if (id == WireFormat::noId) putString(name);
+        }
+
+        /// Appends a version id.
+        void putVersion(const QString& version) {
+            if (version.isEmpty()) {
+                putU64(WireFormat::emptyVersion);
+                return;
+            }
+            // Send decimal numbers (without leading zeros) as integers.
+            bool number = version.size() < 20
+                    && (version[0] != '0' || version.size() == 1);
+            for (int i = 0; number && i < version.size(); ++i)
+                number = version[i] >= '0' && version[i] <= '9';
+            if (number) {
+                putU64(version.toULongLong());
+            }
+            else {
+                putU64(WireFormat::stringVersion);
+                putString(version);
+            }
+        }
+
+        /// Overwrites a 32-bit field written earlier (e.g. a length).
+        void setU32(int offset, quint32 v) {
+            qToLittleEndian(v, reinterpret_cast<uchar*>(_buffer.data() + offset));
+        }
+
+        /// Returns the size of the message so far.
+        int size() const { return _buffer.size(); }
+
+    private:
+        template<typename T> void _put(T v) {
+            uchar b[sizeof(T)];
+            qToLittleEndian(v, b);
+            _buffer.append(reinterpret_cast<const char*>(b), sizeof(T));
+        }
+
+    private:
+        QByteArray& _buffer;
+};
+
+
+/**
+ * @ingroup c_comms
+ *
+ * @class WireReader
+ *
+ * @brief
+ * Reads little-endian fields from a version 2 protocol message.
+ *
+ * @details
+ * Throws a QString if the message is shorter than the fields read.
+ */
+class WireReader
+{
+    public:
+        /// Reads from the given buffer (which must outlive the reader).
+        WireReader(const QByteArray& buffer)
+            : _data(buffer.constData()), _size(buffer.size()), _pos(0) {}
+
+        quint16 u16() { return _get<quint16>(); }
+        quint32 u32() { return _get<quint32>(); }
+        quint64 u64() { return _get<quint64>(); }
+
+        /// Reads a double written with WireWriter::putF64().
+        double f64() {
+            quint64 bits = u64();
+            double v;
+            memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+
+        /// Reads a string written with WireWriter::putString().
+        QString string() {
+            int n = u16();
+            _need(n);
+            QString s = QString::fromUtf8(_data + _pos, n);
+            _pos += n;
+            return s;
+        }
+
+        /// Reads a version id written with WireWriter::putVersion().
+        QString version() {
+            quint64 v = u64();
+            if (v == WireFormat::emptyVersion) return QString();
+            if (v == WireFormat::stringVersion) return string();
+            return QString::number(v);
+        }
+
+    private:
+        template<typename T> T _get() {
+            _need(sizeof(T));
+            T v = qFromLittleEndian<T>(reinterpret_cast<const uchar*>(_data + _pos));
+            _pos += sizeof(T);
+            return v;
+        }
+        void _need(int n) {
+            if (_pos + n > _size)
+                throw QString("WireReader: Message is truncated");
+        }
+
+    private:
+        const char* _data;
+        int _size;
+        int _pos;
+};
+
+} // namespace pelican
+
+#endif // WIREFORMAT_H
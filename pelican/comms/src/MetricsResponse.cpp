@@ -0,0 +1,36 @@
+#include "MetricsResponse.h"
+
+
+namespace pelican {
+
+
+/**
+ * @details
+ * Returns a line for each metric, giving its name (with labels) and value.
+ */
+QString MetricsResponse::text() const
+{
+    QString text;
+    QMapIterator<QString, double> it(_values);
+    while (it.hasNext()) {
+        it.next();
+        text += it.key() + ' ' + QString::number(it.value(), 'g', 17) + '\n';
+    }
+    return text;
+}
+
+
+/**
+ * @details
+ * Returns the metric name with the label, e.g. name("x", "stream", "a")
+ * gives \c x{stream="a"}. Quotes and backslashes in the value are escaped.
+ */
+QString MetricsResponse::name(const QString& metric, const QString& label,
+        const QString& value)
+{
+    QString v = value;
+    v.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return QString("%1{%2=\"%3\"}").arg(metric).arg(label).arg(v);
+}
+
+} // namespace pelican
@@ -6,9 +6,19 @@
 #include "pelican/comms/ServiceDataResponse.h"
 #include "pelican/comms/DataBlobResponse.h"
 #include "pelican/comms/StreamDataResponse.h"
+#include "pelican/comms/SharedStreamDataResponse.h"
 #include "pelican/comms/DataSupportResponse.h"
+#include "pelican/comms/MetricsResponse.h"
 #include "pelican/comms/ServiceDataRequest.h"
 #include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/comms/ConsumerRequest.h"
+#include "pelican/comms/DataSupportRequest.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/ProtocolVersionResponse.h"
+#include "pelican/comms/WireFormat.h"
 #include "pelican/data/DataSpec.h"
 #include "pelican/data/DataBlob.h"
 
@@ -22,7 +32,7 @@
 namespace pelican {
 
 PelicanClientProtocol::PelicanClientProtocol()
-    : AbstractClientProtocol()
+    : AbstractClientProtocol(), _version(1)
 {
 }
 
@@ -32,6 +42,9 @@ PelicanClientProtocol::~PelicanClientProtocol()
 
 QByteArray PelicanClientProtocol::serialise(const ServerRequest& req)
 {
+    if (_version >= 2 && req.type() != ServerRequest::ProtocolVersion)
+        return _serialiseV2(req);
+
     QByteArray data;
     QDataStream ds(&data, QIODevice::WriteOnly);
     ds.setVersion(QDataStream::Qt_4_0);
@@ -44,6 +57,7 @@ QByteArray PelicanClientProtocol::serialise(const ServerRequest& req)
         case ServerRequest::DataSupport:
             break;
         case ServerRequest::StreamData:
+        case ServerRequest::StreamSubscription:
         {
             const StreamDataRequest& r = static_cast<const StreamDataRequest&>(req);
             ds << (quint16)r.size();
@@ -53,6 +67,28 @@ QByteArray PelicanClientProtocol::serialise(const ServerRequest& req)
                 _serializeDataRequirements(ds, *it);
                 ++it;
             }
+            if( req.type() == ServerRequest::StreamSubscription )
+                ds << static_cast<const StreamSubscriptionRequest&>(req).credits();
+            break;
+        }
+        case ServerRequest::Credit:
+        {
+            ds << static_cast<const CreditRequest&>(req).credits();
+            break;
+        }
+        case ServerRequest::Release:
+        {
+            ds << static_cast<const ReleaseRequest&>(req).count();
+            break;
+        }
+        case ServerRequest::Consumer:
+        {
+            ds << static_cast<const ConsumerRequest&>(req).name();
+            break;
+        }
+        case ServerRequest::ProtocolVersion:
+        {
+            ds << static_cast<const ProtocolVersionRequest&>(req).version();
             break;
         }
         case ServerRequest::ServiceData:
@@ -73,6 +109,9 @@ QByteArray PelicanClientProtocol::serialise(const ServerRequest& req)
 
 boost::shared_ptr<ServerResponse> PelicanClientProtocol::receive(QAbstractSocket& socket)
 {
+    if (_version >= 2)
+        return _receiveV2(socket);
+
     int timeout = 2000;
     ServerResponse::Response type = ServerResponse::Error;
     while (socket.bytesAvailable() < (int)sizeof(quint16)) {
@@ -143,6 +182,35 @@ boost::shared_ptr<ServerResponse> PelicanClientProtocol::receive(QAbstractSocket
             break;
         }
 
+        case ServerResponse::SharedStreamData:
+        {
+            // As StreamData, with the location of the data in shared memory.
+            boost::shared_ptr<SharedStreamDataResponse> s;
+            quint16 streams;
+            in >> streams;
+            for (int i=0; i < streams; ++i)
+            {
+                QString name, id, segment;
+                quint64 size, offset;
+                in >> name >> id >> size >> segment >> offset;
+
+                s.reset(new SharedStreamDataResponse(segment, offset));
+                StreamData* sd = new StreamData(name, 0, (unsigned long)size);
+                s->setStreamData(sd);
+                sd->setId(id);
+
+                quint16 associates;
+                in >> associates;
+                for (unsigned j = 0; j < associates; ++j) {
+                    in >> name >> id >> size;
+                    sd->addAssociatedData( boost::shared_ptr<DataChunk>(
+                            new DataChunk(name, id, size)));
+                }
+            }
+            if (s) return s;
+            break;
+        }
+
         case ServerResponse::ServiceData:
         {
             boost::shared_ptr<ServiceDataResponse> s(new ServiceDataResponse);
@@ -161,6 +229,24 @@ boost::shared_ptr<ServerResponse> PelicanClientProtocol::receive(QAbstractSocket
             break;
         }
 
+        case ServerResponse::ProtocolVersion:
+        {
+            while (socket.bytesAvailable() < (int)sizeof(quint16)) {
+                if (!socket.waitForReadyRead(timeout)) break;
+            }
+            quint16 version;
+            in >> version;
+            return boost::shared_ptr<ProtocolVersionResponse>(
+                    new ProtocolVersionResponse(version));
+        }
+
+        case ServerResponse::Metrics:
+        {
+            QMap<QString, double> values;
+            in >> values;
+            return boost::shared_ptr<MetricsResponse>(new MetricsResponse(values));
+        }
+
         case ServerResponse::Blob:
         {
             QString type;
@@ -187,6 +273,282 @@ boost::shared_ptr<ServerResponse> PelicanClientProtocol::receive(QAbstractSocket
 }
 
 
+/**
+ * @details
+ * Asks the server to use the given protocol version (or the latest
+ * version it supports before that) on a newly opened connection and, for
+ * version 2, fetches the table of name ids.
+ *
+ * Returns the version agreed, or 0 if the server did not understand the
+ * request. The connection must then be reopened, and version 1 used.
+ */
+quint16 PelicanClientProtocol::negotiate(QAbstractSocket& socket,
+        quint16 version)
+{
+    _version = 1;
+    _names.clear();
+    _ids.clear();
+    if (version < 2)
+        return _version;
+
+    socket.write(serialise(ProtocolVersionRequest(version)));
+    socket.flush();
+    boost::shared_ptr<ServerResponse> r = receive(socket);
+    if (r->type() != ServerResponse::ProtocolVersion)
+        return 0;
+    _version = static_cast<ProtocolVersionResponse*>(r.get())->version();
+
+    if (_version >= 2) {
+        socket.write(serialise(DataSupportRequest()));
+        socket.flush();
+        r = receive(socket);
+        if (r->type() != ServerResponse::DataSupport) {
+            _version = 1;
+            return 0;
+        }
+    }
+    return _version;
+}
+
+
+/**
+ * @details
+ * Writes the request in version 2 format.
+ */
+QByteArray PelicanClientProtocol::_serialiseV2(const ServerRequest& req)
+{
+    QByteArray data;
+    WireWriter out(data);
+    out.putU16(req.type());
+    out.putU16(0);
+    out.putU32(0);
+    quint16 count = 0;
+
+    switch(req.type())
+    {
+        case ServerRequest::StreamData:
+        case ServerRequest::StreamSubscription:
+        {
+            const StreamDataRequest& r = static_cast<const StreamDataRequest&>(req);
+            count = r.size();
+            DataSpecIterator it = r.begin();
+            while( it != r.end() )
+            {
+                out.putU16(it->streamData().size());
+                out.putU16(it->serviceData().size());
+                foreach (const QString& name, it->streamData())
+                    _putName(out, name);
+                foreach (const QString& name, it->serviceData())
+                    _putName(out, name);
+                ++it;
+            }
+            if( req.type() == ServerRequest::StreamSubscription )
+                out.putU32(static_cast<const StreamSubscriptionRequest&>(req).credits());
+            break;
+        }
+        case ServerRequest::Credit:
+            out.putU32(static_cast<const CreditRequest&>(req).credits());
+            break;
+        case ServerRequest::Release:
+            out.putU32(static_cast<const ReleaseRequest&>(req).count());
+            break;
+        case ServerRequest::Consumer:
+            out.putString(static_cast<const ConsumerRequest&>(req).name());
+            break;
+        case ServerRequest::ProtocolVersion:
+            out.putU16(static_cast<const ProtocolVersionRequest&>(req).version());
+            break;
+        case ServerRequest::ServiceData:
+        {
+            const ServiceDataRequest& r = static_cast<const ServiceDataRequest&>(req);
+            count = r.types().size();
+            foreach( QString type, r.types() ) {
+                _putName(out, type);
+                out.putVersion(r.version(type));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    out.setU32(4, out.size() - WireFormat::requestHeaderSize);
+    qToLittleEndian(count, reinterpret_cast<uchar*>(data.data() + 2));
+    return data;
+}
+
+
+/**
+ * @details
+ * Reads a response in version 2 format: the fixed size header and then
+ * the body, whose length is given in the header. Any data following the
+ * body (e.g. stream data) is left to be read from the socket.
+ */
+boost::shared_ptr<ServerResponse> PelicanClientProtocol::_receiveV2(
+        QAbstractSocket& socket)
+{
+    int timeout = 2000;
+    while (socket.bytesAvailable() < WireFormat::responseHeaderSize) {
+        if ( !socket.waitForReadyRead(timeout) ) {
+            std::cerr << "PelicanClientProtocol: Receive error: "
+                      << socket.errorString().toStdString() << std::endl;
+            return boost::shared_ptr<ServerResponse>(new ServerResponse(
+                    ServerResponse::Error, socket.errorString()));
+        }
+    }
+    QByteArray header = socket.read(WireFormat::responseHeaderSize);
+    WireReader h(header);
+    quint16 type = h.u16();
+    quint16 count = h.u16();
+    quint32 length = h.u32();
+    quint64 sequence = h.u64();
+    while (socket.bytesAvailable() < (qint64)length) {
+        if ( !socket.waitForReadyRead(timeout) ) {
+            return boost::shared_ptr<ServerResponse>(new ServerResponse(
+                    ServerResponse::Error, socket.errorString()));
+        }
+    }
+    QByteArray body = socket.read(length);
+    WireReader in(body);
+
+    try {
+        switch (type)
+        {
+            case ServerResponse::Acknowledge:
+            case ServerResponse::Error:
+                return boost::shared_ptr<ServerResponse>(new ServerResponse(
+                        (ServerResponse::Response)type, QString::fromUtf8(body)));
+
+            case ServerResponse::DataSupport:
+            {
+                _names.clear();
+                _ids.clear();
+                int ids = in.u16();
+                for (int i = 0; i < ids; ++i) {
+                    _names.append(in.string());
+                    _ids.insert(_names.last(), i);
+                }
+                DataSpec spec;
+                int n = in.u16();
+                for (int i = 0; i < n; ++i)
+                    spec.addStreamData(_readName(in));
+                n = in.u16();
+                for (int i = 0; i < n; ++i)
+                    spec.addServiceData(_readName(in));
+                n = in.u16();
+                QHash<QString, QString> adapters;
+                for (int i = 0; i < n; ++i) {
+                    QString name = _readName(in);
+                    adapters.insert(name, in.string());
+                }
+                spec.addAdapterTypes(adapters);
+                return boost::shared_ptr<DataSupportResponse>(
+                        new DataSupportResponse(spec));
+            }
+
+            case ServerResponse::StreamData:
+            {
+                boost::shared_ptr<StreamDataResponse> s(new StreamDataResponse);
+                s->setSequence(sequence);
+                for (int i = 0; i < count; ++i) {
+                    QString name = _readName(in);
+                    QString id = in.version();
+                    quint64 size = in.u64();
+                    StreamData* sd = new StreamData(name, 0, (unsigned long)size);
+                    s->setStreamData(sd);
+                    sd->setId(id);
+                    LatencyTrace& trace = sd->latencyTrace();
+                    trace.setStream(name);
+                    if (_version >= 3) {
+                        trace.setTime(LatencyTrace::Ingest, in.u64());
+                        trace.setTime(LatencyTrace::Serve, in.u64());
+                    }
+                    trace.stamp(LatencyTrace::Receive);
+                    int associates = in.u16();
+                    for (int j = 0; j < associates; ++j) {
+                        name = _readName(in);
+                        id = in.version();
+                        size = in.u64();
+                        sd->addAssociatedData( boost::shared_ptr<DataChunk>(
+                                new DataChunk(name, id, size)));
+                    }
+                }
+                return s;
+            }
+
+            case ServerResponse::ServiceData:
+            {
+                boost::shared_ptr<ServiceDataResponse> s(new ServiceDataResponse);
+                for (int i = 0; i < count; ++i) {
+                    QString name = _readName(in);
+                    QString version = in.version();
+                    quint64 size = in.u64();
+                    s->addData(new DataChunk(name, version, size));
+                }
+                return s;
+            }
+
+            case ServerResponse::Metrics:
+            {
+                QMap<QString, double> values;
+                quint32 n = in.u32();
+                for (quint32 i = 0; i < n; ++i) {
+                    QString name = in.string();
+                    values.insert(name, in.f64());
+                }
+                return boost::shared_ptr<MetricsResponse>(new MetricsResponse(values));
+            }
+
+            case ServerResponse::Blob:
+            {
+                QString blobType = in.string();
+                QString name = _readName(in);
+                quint64 dataSize = in.u64();
+                QSysInfo::Endian endian = (QSysInfo::Endian)in.u16();
+                return boost::shared_ptr<DataBlobResponse>(
+                        new DataBlobResponse(blobType, name, dataSize, endian));
+            }
+
+            default:
+                break;
+        }
+    }
+    catch (const QString& e) {
+        return boost::shared_ptr<ServerResponse>(new ServerResponse(
+                ServerResponse::Error, "PelicanClientProtocol: " + e));
+    }
+
+    return boost::shared_ptr<ServerResponse>(
+            new ServerResponse(ServerResponse::Error,
+                    QString("PelicanClientProtocol: Unknown type passed: %1")
+                    .arg(type)));
+}
+
+
+/**
+ * @details
+ * Writes the name by the id the server gave it, or in full.
+ */
+void PelicanClientProtocol::_putName(WireWriter& out, const QString& name) const
+{
+    out.putName(_ids.value(name, (quint16)WireFormat::noId), name);
+}
+
+
+/**
+ * @details
+ * Reads a name sent by its id, or in full.
+ */
+QString PelicanClientProtocol::_readName(WireReader& in) const
+{
+    quint16 id = in.u16();
+    if (id == WireFormat::noId)
+        return in.string();
+    if (id >= _names.size())
+        throw QString("Unknown id %1").arg(id);
+    return _names[id];
+}
+
+
 void PelicanClientProtocol::_serializeDataRequirements(QDataStream& stream,
         const DataSpec& req) const
 {
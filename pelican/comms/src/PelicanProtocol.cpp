@@ -7,7 +7,15 @@
 #include "pelican/comms/DataSupportRequest.h"
 #include "pelican/comms/ServiceDataRequest.h"
 #include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/comms/ConsumerRequest.h"
+#include "pelican/comms/MetricsRequest.h"
+#include "pelican/comms/MetricsResponse.h"
 #include "pelican/comms/StreamData.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/WireFormat.h"
 #include "pelican/data/DataSpec.h"
 #include "pelican/data/DataBlob.h"
 #include "pelican/data/DataBlobVerify.h"
@@ -17,16 +25,51 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QString>
 #include <QtCore/QMapIterator>
-
+#include <QtCore/QVariant>
+#include <QtCore/QtAlgorithms>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define PELICAN_ZEROCOPY
+#include <linux/errqueue.h>
+#else
+#define MSG_ZEROCOPY 0
+#endif
+#include <vector>
 #include <iostream>
 using std::cout;
 using std::endl;
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 namespace pelican {
 
+// Socket properties holding the state of a connection.
+static const char* versionProperty = "pelicanProtocolVersion";
+static const char* knownIdsProperty = "pelicanKnownIds";
+static const char* sequenceProperty = "pelicanSequence";
+
+/**
+ * @details
+ * Returns the protocol version agreed on the connection.
+ */
+static int protocolVersion(const QIODevice& device)
+{
+    return device.property(versionProperty).toInt();
+}
+
 
 PelicanProtocol::PelicanProtocol()
-    : AbstractProtocol()
+    : AbstractProtocol(), _zeroCopy(false), _zeroCopySends(0)
 {
 }
 
@@ -44,12 +87,14 @@ PelicanProtocol::~PelicanProtocol()
  */
 boost::shared_ptr<ServerRequest> PelicanProtocol::request(QTcpSocket& socket)
 {
+    if (protocolVersion(socket) >= 2)
+        return _requestV2(socket);
+
     int timeout = 1000;
     ServerRequest::Request type = ServerRequest::Error;
 
-    // If there are not enough bytes in the socket to hold the request type
-    // return a error (bad) request.
-    while (socket.bytesAvailable() < (int)sizeof(quint16))
+    // If the whole request does not arrive return a error (bad) request.
+    while (!requestComplete(socket))
     {
         if ( !socket.waitForReadyRead(timeout)) {
             return boost::shared_ptr<ServerRequest>(new ServerRequest(type,
@@ -59,10 +104,67 @@ boost::shared_ptr<ServerRequest> PelicanProtocol::request(QTcpSocket& socket)
 
     // Read the request type and return an appropriate server request object.
     QDataStream in(&socket);
-    quint16 tmp;
     in.setVersion(QDataStream::Qt_4_0);
+    return _requestV1(in);
+}
+
+
+/**
+ * @details
+ * Returns true if a whole request is waiting on the socket, without taking
+ * anything from it. Version 1 requests carry no length, so the request is
+ * parsed from a copy of the data, and is complete if the parse did not run
+ * past the end.
+ */
+bool PelicanProtocol::requestComplete(QTcpSocket& socket)
+{
+    qint64 available = socket.bytesAvailable();
+    if (protocolVersion(socket) >= 2) {
+        if (available < WireFormat::requestHeaderSize)
+            return false;
+        QByteArray header = socket.peek(WireFormat::requestHeaderSize);
+        WireReader h(header);
+        h.u16();
+        h.u16();
+        return available >= WireFormat::requestHeaderSize + (qint64)h.u32();
+    }
+    if (available < (qint64)sizeof(quint16))
+        return false;
+    QByteArray data = socket.peek(available);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_4_0);
+    _requestV1(in);
+    return in.status() == QDataStream::Ok;
+}
+
+
+/**
+ * @details
+ * Reads the elements of a set written by QDataStream. Unlike the QDataStream
+ * operator, this does not stop early at the end of the data, so that a
+ * truncated set shows as a read past the end.
+ */
+static void readSet(QDataStream& in, QSet<QString>& set)
+{
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString s;
+        in >> s;
+        set.insert(s);
+    }
+}
+
+
+/**
+ * @details
+ * Reads a version 1 request from the data stream.
+ */
+boost::shared_ptr<ServerRequest> PelicanProtocol::_requestV1(QDataStream& in)
+{
+    quint16 tmp;
     in >> tmp;
-    type=(ServerRequest::Request)tmp;
+    ServerRequest::Request type = (ServerRequest::Request)tmp;
 
     switch(type)
     {
@@ -97,8 +199,8 @@ boost::shared_ptr<ServerRequest> PelicanProtocol::request(QTcpSocket& socket)
             {
                 QSet<QString> serviceData;
                 QSet<QString> streamData;
-                in >> serviceData;
-                in >> streamData;
+                readSet(in, serviceData);
+                readSet(in, streamData);
                 DataSpec dr;
                 dr.addServiceData(serviceData);
                 dr.addStreamData(streamData);
@@ -113,6 +215,62 @@ boost::shared_ptr<ServerRequest> PelicanProtocol::request(QTcpSocket& socket)
             return s;
         }
 
+        case ServerRequest::StreamSubscription:
+        {
+            boost::shared_ptr<StreamSubscriptionRequest> s(new StreamSubscriptionRequest);
+            quint16 num;
+            in >> num;
+            for(int i = 0; i < num; ++i )
+            {
+                QSet<QString> serviceData;
+                QSet<QString> streamData;
+                readSet(in, serviceData);
+                readSet(in, streamData);
+                DataSpec dr;
+                dr.addServiceData(serviceData);
+                dr.addStreamData(streamData);
+                s->addDataOption(dr);
+            }
+            quint32 credits;
+            in >> credits;
+            s->setCredits(credits);
+            return s;
+        }
+
+        case ServerRequest::Credit:
+        {
+            quint32 credits;
+            in >> credits;
+            return boost::shared_ptr<CreditRequest>(new CreditRequest(credits));
+        }
+
+        case ServerRequest::Release:
+        {
+            quint32 count;
+            in >> count;
+            return boost::shared_ptr<ReleaseRequest>(new ReleaseRequest(count));
+        }
+
+        case ServerRequest::Consumer:
+        {
+            QString name;
+            in >> name;
+            return boost::shared_ptr<ConsumerRequest>(new ConsumerRequest(name));
+        }
+
+        case ServerRequest::Metrics:
+        {
+            return boost::shared_ptr<MetricsRequest>(new MetricsRequest);
+        }
+
+        case ServerRequest::ProtocolVersion:
+        {
+            quint16 version;
+            in >> version;
+            return boost::shared_ptr<ProtocolVersionRequest>(
+                    new ProtocolVersionRequest(version));
+        }
+
         default:
             break;
     }
@@ -120,11 +278,239 @@ boost::shared_ptr<ServerRequest> PelicanProtocol::request(QTcpSocket& socket)
 }
 
 
+/**
+ * @details
+ * Reads a version 2 request: the fixed size header and then the body,
+ * whose length is given in the header.
+ */
+boost::shared_ptr<ServerRequest> PelicanProtocol::_requestV2(QTcpSocket& socket)
+{
+    // Nothing is taken from the socket until the whole request is there,
+    // so that a timeout leaves the connection in step.
+    int timeout = 1000;
+    while (!requestComplete(socket)) {
+        if (!socket.waitForReadyRead(timeout)) {
+            return boost::shared_ptr<ServerRequest>(new ServerRequest(
+                    ServerRequest::Error, socket.errorString()));
+        }
+    }
+    QByteArray header = socket.read(WireFormat::requestHeaderSize);
+    WireReader h(header);
+    quint16 type = h.u16();
+    quint16 count = h.u16();
+    quint32 length = h.u32();
+    QByteArray body = socket.read(length);
+    WireReader in(body);
+
+    try {
+        switch (type)
+        {
+            case ServerRequest::Acknowledge:
+                return boost::shared_ptr<AcknowledgementRequest>(
+                        new AcknowledgementRequest());
+
+            case ServerRequest::DataSupport:
+                return boost::shared_ptr<DataSupportRequest>(
+                        new DataSupportRequest);
+
+            case ServerRequest::ServiceData:
+            {
+                boost::shared_ptr<ServiceDataRequest> s(new ServiceDataRequest);
+                for (int i = 0; i < count; ++i) {
+                    QString name = _readName(in);
+                    s->request(name, in.version());
+                }
+                return s;
+            }
+
+            case ServerRequest::StreamData:
+            {
+                boost::shared_ptr<StreamDataRequest> s(new StreamDataRequest);
+                _readDataOptions(in, count, *s);
+                return s;
+            }
+
+            case ServerRequest::StreamSubscription:
+            {
+                boost::shared_ptr<StreamSubscriptionRequest> s(
+                        new StreamSubscriptionRequest);
+                _readDataOptions(in, count, *s);
+                s->setCredits(in.u32());
+                return s;
+            }
+
+            case ServerRequest::Credit:
+                return boost::shared_ptr<CreditRequest>(
+                        new CreditRequest(in.u32()));
+
+            case ServerRequest::Release:
+                return boost::shared_ptr<ReleaseRequest>(
+                        new ReleaseRequest(in.u32()));
+
+            case ServerRequest::Consumer:
+                return boost::shared_ptr<ConsumerRequest>(
+                        new ConsumerRequest(in.string()));
+
+            case ServerRequest::Metrics:
+                return boost::shared_ptr<MetricsRequest>(new MetricsRequest);
+
+            case ServerRequest::ProtocolVersion:
+                return boost::shared_ptr<ProtocolVersionRequest>(
+                        new ProtocolVersionRequest(in.u16()));
+
+            default:
+                break;
+        }
+    }
+    catch (const QString& e) {
+        return boost::shared_ptr<ServerRequest>(new ServerRequest(
+                ServerRequest::Error, "PelicanProtocol: " + e));
+    }
+    return boost::shared_ptr<ServerRequest>(new ServerRequest(
+            ServerRequest::Error, "PelicanProtocol: Unknown type passed"));
+}
+
+
+/**
+ * @details
+ * Reads the data options of a version 2 stream data request. Each option
+ * is the number of stream and service data names, followed by the names.
+ */
+void PelicanProtocol::_readDataOptions(WireReader& in, int count,
+        StreamDataRequest& req)
+{
+    for (int i = 0; i < count; ++i) {
+        int streams = in.u16();
+        int services = in.u16();
+        DataSpec dr;
+        for (int j = 0; j < streams; ++j)
+            dr.addStreamData(_readName(in));
+        for (int j = 0; j < services; ++j)
+            dr.addServiceData(_readName(in));
+        req.addDataOption(dr);
+    }
+}
+
+
+/**
+ * @details
+ * Reads a name sent by its id, or in full.
+ */
+QString PelicanProtocol::_readName(WireReader& in)
+{
+    quint16 id = in.u16();
+    if (id == WireFormat::noId)
+        return in.string();
+    QReadLocker locker(&_idLock);
+    if (id >= _names.size())
+        throw QString("Unknown id %1").arg(id);
+    return _names[id];
+}
+
+
+/**
+ * @details
+ * Writes the name by its id if the client has been sent the id (the ids
+ * below knownIds), otherwise in full.
+ */
+void PelicanProtocol::_putName(WireWriter& out, const QString& name,
+        int knownIds)
+{
+    quint16 id = WireFormat::noId;
+    if (knownIds > 0) {
+        QReadLocker locker(&_idLock);
+        id = _ids.value(name, (quint16)WireFormat::noId);
+        if (id >= knownIds) id = WireFormat::noId;
+    }
+    out.putName(id, name);
+}
+
+
+/**
+ * @details
+ * Starts a version 2 response. The body length is filled in with
+ * WireWriter::setU32(4, ...) once the body has been written.
+ */
+void PelicanProtocol::_startResponse(WireWriter& out, quint16 type,
+        quint16 count, quint64 sequence)
+{
+    out.putU16(type);
+    out.putU16(count);
+    out.putU32(0);
+    out.putU64(sequence);
+}
+
+
+/**
+ * @details
+ * Replies (in version 1 format) with the latest version of the protocol
+ * supported, no later than that requested by the client, and uses it for
+ * the rest of the connection.
+ */
+void PelicanProtocol::sendVersion(QIODevice& device, quint16 version)
+{
+    quint16 agreed = version;
+    if (agreed > WireFormat::version) agreed = WireFormat::version;
+    if (agreed < 1) agreed = 1;
+    QByteArray array;
+    QDataStream out(&array, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << (quint16)ServerResponse::ProtocolVersion;
+    out << agreed;
+    device.write(array);
+    device.setProperty(versionProperty, (int)agreed);
+    device.setProperty(knownIdsProperty, 0);
+    device.setProperty(sequenceProperty, (qulonglong)0);
+}
+
+
 /**
  * @details
  */
 void PelicanProtocol::send(QIODevice& device, const DataSupportResponse& supported)
 {
+    if (protocolVersion(device) >= 2) {
+        // Give each name an id, and send the client the table of ids.
+        QList<QString> names = (supported.streamData()
+                + supported.serviceData()).toList();
+        names += supported.defaultAdapters().keys();
+        qSort(names);
+        QByteArray array;
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::DataSupport, 0);
+        int knownIds;
+        {
+            QWriteLocker locker(&_idLock);
+            foreach (const QString& name, names) {
+                if (!_ids.contains(name) && _names.size() < WireFormat::noId) {
+                    _ids.insert(name, _names.size());
+                    _names.append(name);
+                }
+            }
+            knownIds = _names.size();
+            out.putU16(knownIds);
+            foreach (const QString& name, _names)
+                out.putString(name);
+        }
+        out.putU16(supported.streamData().size());
+        foreach (const QString& name, supported.streamData())
+            _putName(out, name, knownIds);
+        out.putU16(supported.serviceData().size());
+        foreach (const QString& name, supported.serviceData())
+            _putName(out, name, knownIds);
+        out.putU16(supported.defaultAdapters().size());
+        QHashIterator<QString, QString> a(supported.defaultAdapters());
+        while (a.hasNext()) {
+            a.next();
+            _putName(out, a.key(), knownIds);
+            out.putString(a.value());
+        }
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+        device.write(array);
+        device.setProperty(knownIdsProperty, knownIds);
+        return;
+    }
+
     QByteArray array;
     QDataStream out(&array, QIODevice::WriteOnly);
     out.setVersion(QDataStream::Qt_4_0);
@@ -153,26 +539,64 @@ void PelicanProtocol::send(QIODevice& stream, const AbstractProtocol::StreamData
 
     // General header for the stream data set.
     QByteArray array;
-    QDataStream out(&array, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_4_0);
-    out << (quint16)ServerResponse::StreamData;
-    out << (quint16)data.size();
     QListIterator<StreamData*> i(data);
-
-    // Header per stream data object.
-    while (i.hasNext())
-    {
-        StreamData* sd = i.next();
-        out << sd->name() << sd->id() << (quint64)(sd->size());
-
-        // service data info
-        out << (quint16) sd->associateData().size();
-        foreach(const boost::shared_ptr<DataChunk>& dat, sd->associateData())
+    int version = protocolVersion(stream);
+    if (version >= 2) {
+        // The same header in version 2 format, with a sequence number
+        // (and in version 3 the ingest and serve times).
+        // Responses on a connection are sent by one thread at a time.
+        int knownIds = stream.property(knownIdsProperty).toInt();
+        quint64 sequence = stream.property(sequenceProperty).toULongLong() + 1;
+        stream.setProperty(sequenceProperty, (qulonglong)sequence);
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::StreamData, data.size(), sequence);
+        while (i.hasNext())
         {
-            out << dat->name() << dat->id() << (quint64)(dat->size());
+            StreamData* sd = i.next();
+            _putName(out, sd->name(), knownIds);
+            out.putVersion(sd->id());
+            out.putU64(sd->size());
+            if (version >= 3) {
+                out.putU64(sd->latencyTrace().time(LatencyTrace::Ingest));
+                out.putU64(LatencyTrace::now());
+            }
+            out.putU16(sd->associateData().size());
+            foreach(const boost::shared_ptr<DataChunk>& dat, sd->associateData())
+            {
+                _putName(out, dat->name(), knownIds);
+                out.putVersion(dat->id());
+                out.putU64(dat->size());
+            }
+        }
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+    }
+    else {
+        QDataStream out(&array, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_0);
+        out << (quint16)ServerResponse::StreamData;
+        out << (quint16)data.size();
+
+        // Header per stream data object.
+        while (i.hasNext())
+        {
+            StreamData* sd = i.next();
+            out << sd->name() << sd->id() << (quint64)(sd->size());
+
+            // service data info
+            out << (quint16) sd->associateData().size();
+            foreach(const boost::shared_ptr<DataChunk>& dat, sd->associateData())
+            {
+                out << dat->name() << dat->id() << (quint64)(dat->size());
+            }
         }
     }
 
+    // Write the header and data straight to the socket if possible, unless
+    // the caller does not want to wait for it to be sent.
+    bool deferred = stream.property(deferredWritesProperty()).toBool();
+    if (!deferred && _sendDirect(stream, array, data))
+        return;
+
     stream.write(array);
 
     // Write the actual stream data.
@@ -181,7 +605,8 @@ void PelicanProtocol::send(QIODevice& stream, const AbstractProtocol::StreamData
     {
         StreamData* sd = i.next();
         stream.write((const char*)sd->ptr(), sd->size());
-        stream.waitForBytesWritten(-1);
+        if (!deferred)
+            stream.waitForBytesWritten(-1);
     }
 }
 
@@ -196,17 +621,31 @@ void PelicanProtocol::send(QIODevice& stream, const AbstractProtocol::ServiceDat
     // for each set there is a name tag, a version tag and size of data
     // followed by the binary data itself
     QByteArray array;
-    QDataStream out(&array, QIODevice::WriteOnly);
+    QListIterator<DataChunk*> i(data);
+    if (protocolVersion(stream) >= 2) {
+        int knownIds = stream.property(knownIdsProperty).toInt();
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::ServiceData, data.size());
+        while (i.hasNext()) {
+            DataChunk* d = i.next();
+            _putName(out, d->name(), knownIds);
+            out.putVersion(d->id());
+            out.putU64(d->size());
+        }
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+    }
+    else {
+        QDataStream out(&array, QIODevice::WriteOnly);
 
-    // Write (send) the header.
-    out.setVersion(QDataStream::Qt_4_0);
-    out << (quint16)ServerResponse::ServiceData;
-    out << (quint16)data.size();
+        // Write (send) the header.
+        out.setVersion(QDataStream::Qt_4_0);
+        out << (quint16)ServerResponse::ServiceData;
+        out << (quint16)data.size();
 
-    QListIterator<DataChunk*> i(data);
-    while (i.hasNext()) {
-        DataChunk* d = i.next();
-        out << d->name() << d->id() << (quint64)d->size();
+        while (i.hasNext()) {
+            DataChunk* d = i.next();
+            out << d->name() << d->id() << (quint64)d->size();
+        }
     }
     stream.write(array);
 
@@ -226,12 +665,23 @@ void PelicanProtocol::send(QIODevice& stream, const AbstractProtocol::ServiceDat
 void PelicanProtocol::send(QIODevice& device, const QString& name, const DataBlob& data)
 {
     QByteArray array;
-    QDataStream out(&array, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_4_0);
-    out << (quint16)ServerResponse::Blob;
-    out << data.type();
-    out << name;
-    out << data.serialisedBytes();
+    if (protocolVersion(device) >= 2) {
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::Blob, 1);
+        out.putString(data.type());
+        _putName(out, name, device.property(knownIdsProperty).toInt());
+        out.putU64(data.serialisedBytes());
+        out.putU16(QSysInfo::ByteOrder);
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+    }
+    else {
+        QDataStream out(&array, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_0);
+        out << (quint16)ServerResponse::Blob;
+        out << data.type();
+        out << name;
+        out << data.serialisedBytes();
+    }
     if (device.write(array) < 0)
         throw QString("PelicanProtocol::send: Unable to write.");
     data.serialise(device);
@@ -254,6 +704,16 @@ void PelicanProtocol::send(QIODevice& device, const QString& name, const DataBlo
  */
 void PelicanProtocol::send(QIODevice& device, const QString& msg)
 {
+    if (protocolVersion(device) >= 2) {
+        QByteArray array;
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::Acknowledge, 0);
+        array.append(msg.toUtf8());
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+        device.write(array);
+        return;
+    }
+
     QByteArray array;
     QDataStream out(&array, QIODevice::WriteOnly);
     out.setVersion(QDataStream::Qt_4_0);
@@ -265,11 +725,51 @@ void PelicanProtocol::send(QIODevice& device, const QString& msg)
 }
 
 
+/**
+ * @details
+ * Sends the metrics as the number of values followed by the name and value
+ * of each.
+ */
+void PelicanProtocol::send(QIODevice& device, const MetricsResponse& metrics)
+{
+    QByteArray array;
+    QMapIterator<QString, double> it(metrics.values());
+    if (protocolVersion(device) >= 2) {
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::Metrics, 0);
+        out.putU32(metrics.values().size());
+        while (it.hasNext()) {
+            it.next();
+            out.putString(it.key());
+            out.putF64(it.value());
+        }
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+    }
+    else {
+        QDataStream out(&array, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_0);
+        out << (quint16)ServerResponse::Metrics;
+        out << metrics.values();
+    }
+    device.write(array);
+}
+
+
 /**
  * @Details
  */
 void PelicanProtocol::sendError(QIODevice& stream, const QString& msg)
 {
+    if (protocolVersion(stream) >= 2) {
+        QByteArray array;
+        WireWriter out(array);
+        _startResponse(out, ServerResponse::Error, 0);
+        array.append(msg.toUtf8());
+        out.setU32(4, out.size() - WireFormat::responseHeaderSize);
+        stream.write(array);
+        return;
+    }
+
     QByteArray array;
     QDataStream out(&array, QIODevice::WriteOnly);
     out.setVersion(QDataStream::Qt_4_0);
@@ -280,4 +780,134 @@ void PelicanProtocol::sendError(QIODevice& stream, const QString& msg)
     stream.write(array);
 }
 
+/**
+ * @details
+ * Waits for the socket descriptor to be ready for the given events.
+ */
+static void waitForDescriptor(int fd, short events)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = events;
+    p.revents = 0;
+    ::poll(&p, 1, 1000);
+}
+
+
+#ifdef PELICAN_ZEROCOPY
+/**
+ * @details
+ * Waits for the kernel to report that the given number of MSG_ZEROCOPY
+ * sends have completed, i.e. that their pages are no longer referenced.
+ */
+static void waitForZeroCopy(int fd, unsigned sends)
+{
+    unsigned completed = 0;
+    while (completed < sends) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                waitForDescriptor(fd, 0); // POLLERR is always reported.
+                continue;
+            }
+            return;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                completed += err->ee_data - err->ee_info + 1;
+        }
+    }
+}
+#endif
+
+
+/**
+ * @details
+ * Sends the header and stream data chunks to the socket descriptor with
+ * sendmsg(), straight from the chunk memory, blocking until all of it has
+ * been accepted by the kernel. Anything already buffered by the socket is
+ * flushed first to keep the order of the responses.
+ *
+ * Returns false, having sent nothing, if the device is not a connected
+ * socket.
+ */
+bool PelicanProtocol::_sendDirect(QIODevice& device, const QByteArray& header,
+        const AbstractProtocol::StreamData_t& data)
+{
+    QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(&device);
+    if (!socket || socket->socketDescriptor() == -1
+            || socket->state() != QAbstractSocket::ConnectedState)
+        return false;
+    while (socket->bytesToWrite() > 0) {
+        if (!socket->waitForBytesWritten(-1))
+            return false;
+    }
+    int fd = socket->socketDescriptor();
+
+    std::vector<struct iovec> iov(1 + data.size());
+    iov[0].iov_base = const_cast<char*>(header.constData());
+    iov[0].iov_len = header.size();
+    size_t total = header.size();
+    for (int i = 0; i < data.size(); ++i) {
+        iov[i + 1].iov_base = data[i]->ptr();
+        iov[i + 1].iov_len = data[i]->size();
+        total += data[i]->size();
+    }
+
+    int flags = MSG_NOSIGNAL;
+    unsigned zeroCopySends = 0;
+#ifdef PELICAN_ZEROCOPY
+    int one = 1;
+    if (_zeroCopy && total >= zeroCopyThreshold
+            && ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+        flags |= MSG_ZEROCOPY;
+#endif
+
+    size_t first = 0;
+    while (first < iov.size()) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[first];
+        msg.msg_iovlen = qMin(iov.size() - first, (size_t)IOV_MAX);
+        ssize_t n = ::sendmsg(fd, &msg, flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitForDescriptor(fd, POLLOUT);
+                continue;
+            }
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                flags &= ~MSG_ZEROCOPY; // Out of locked memory.
+                continue;
+            }
+            throw QString("PelicanProtocol: Unable to send stream data: %1")
+                    .arg(strerror(errno));
+        }
+        if (flags & MSG_ZEROCOPY) ++zeroCopySends;
+
+        // Skip over the data sent.
+        while (first < iov.size() && (size_t)n >= iov[first].iov_len) {
+            n -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = (char*)iov[first].iov_base + n;
+            iov[first].iov_len -= n;
+        }
+    }
+
+#ifdef PELICAN_ZEROCOPY
+    if (zeroCopySends > 0) {
+        __sync_add_and_fetch(&_zeroCopySends, (quint64)zeroCopySends);
+        waitForZeroCopy(fd, zeroCopySends);
+    }
+#endif
+    return true;
+}
+
 } // namespace pelican
@@ -0,0 +1,65 @@
+#include "pelican/comms/SharedMemoryProtocol.h"
+#include "pelican/comms/ServerResponse.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataChunk.h"
+#include "pelican/utility/SharedMemorySegment.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QByteArray>
+
+namespace pelican {
+
+/**
+ * @details
+ * Sends a SharedStreamData response if all of the stream data is in shared
+ * memory, consisting of:
+ *
+ * - Response type and the number of streams.
+ * - For each stream, its name, version id and size, the name of the
+ *   segment and the offset of the data in it, followed by the name,
+ *   version id and size of each of its associated service data.
+ *
+ * Otherwise the stream data is sent as by the PelicanProtocol.
+ */
+void SharedMemoryProtocol::send(QIODevice& stream,
+        const AbstractProtocol::StreamData_t& data)
+{
+    QList<SharedMemorySegment*> segments;
+    foreach (StreamData* sd, data) {
+        SharedMemorySegment* segment = SharedMemorySegment::find(sd->ptr());
+        if (!segment) {
+            PelicanProtocol::send(stream, data);
+            return;
+        }
+        segments.append(segment);
+    }
+
+    QByteArray array;
+    QDataStream out(&array, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << (quint16)ServerResponse::SharedStreamData;
+    out << (quint16)data.size();
+    for (int i = 0; i < data.size(); ++i) {
+        StreamData* sd = data[i];
+        out << sd->name() << sd->id() << (quint64)(sd->size());
+        out << segments[i]->name()
+            << (quint64)((const char*)sd->ptr() - segments[i]->data());
+        out << (quint16) sd->associateData().size();
+        foreach(const boost::shared_ptr<DataChunk>& dat, sd->associateData()) {
+            out << dat->name() << dat->id() << (quint64)(dat->size());
+        }
+    }
+    stream.write(array);
+}
+
+
+/**
+ * @details
+ * Stream data descriptions are only written in version 1 format.
+ */
+void SharedMemoryProtocol::sendVersion(QIODevice& device, quint16)
+{
+    PelicanProtocol::sendVersion(device, 1);
+}
+
+} // namespace pelican
@@ -68,6 +68,7 @@ bool StreamData::operator==(const StreamData& sd) const
 void StreamData::reset( size_t size )
 {
     _associateData.clear();
+    _packetStats.clear();
     setSize(size);
 }
 
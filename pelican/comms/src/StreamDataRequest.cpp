@@ -13,6 +13,11 @@ StreamDataRequest::StreamDataRequest()
     _dataOptions.end();
 }
 
+StreamDataRequest::StreamDataRequest(ServerRequest::Request type)
+    : ServerRequest(type)
+{
+}
+
 StreamDataRequest::~StreamDataRequest()
 {
 }
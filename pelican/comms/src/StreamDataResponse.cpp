@@ -7,7 +7,16 @@ namespace pelican {
  * Creates a new StreamDataResponse object.
  */
 StreamDataResponse::StreamDataResponse()
-    : ServerResponse( ServerResponse::StreamData ), _data(0)
+    : ServerResponse( ServerResponse::StreamData ), _data(0), _sequence(0)
+{
+}
+
+/**
+ * @details
+ * Creates a new StreamDataResponse object of the given type.
+ */
+StreamDataResponse::StreamDataResponse(ServerResponse::Response type)
+    : ServerResponse( type ), _data(0), _sequence(0)
 {
 }
 
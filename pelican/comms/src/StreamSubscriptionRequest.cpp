@@ -0,0 +1,27 @@
+#include "pelican/comms/StreamSubscriptionRequest.h"
+
+namespace pelican {
+
+
+// class StreamSubscriptionRequest
+StreamSubscriptionRequest::StreamSubscriptionRequest(quint32 credits)
+    : StreamDataRequest(ServerRequest::StreamSubscription), _credits(credits)
+{
+}
+
+StreamSubscriptionRequest::~StreamSubscriptionRequest()
+{
+}
+
+bool StreamSubscriptionRequest::operator==(const ServerRequest& req) const
+{
+    bool r = StreamDataRequest::operator==(req);
+    if( r ) {
+        const StreamSubscriptionRequest& sr =
+                static_cast<const StreamSubscriptionRequest&>(req);
+        return _credits == sr._credits;
+    }
+    return r;
+}
+
+} // namespace pelican
@@ -40,10 +40,14 @@ class PelicanProtocolTest : public CppUnit::TestFixture
         CPPUNIT_TEST_SUITE( PelicanProtocolTest );
         CPPUNIT_TEST( test_request );
         CPPUNIT_TEST( test_sendStreamData );
+        CPPUNIT_TEST( test_sendStreamDataSocket );
+        CPPUNIT_TEST( test_sendStreamDataZeroCopy );
         CPPUNIT_TEST( test_sendServiceData );
         CPPUNIT_TEST( test_sendDataBlob );
         CPPUNIT_TEST( test_sendDataSupport );
         CPPUNIT_TEST( test_sendChunk );
+        CPPUNIT_TEST( test_sendMetrics );
+        CPPUNIT_TEST( test_version2 );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -53,10 +57,14 @@ class PelicanProtocolTest : public CppUnit::TestFixture
         // Test Methods
         void test_request();
         void test_sendStreamData();
+        void test_sendStreamDataSocket();
+        void test_sendStreamDataZeroCopy();
         void test_sendServiceData();
         void test_sendDataBlob();
         void test_sendDataSupport();
         void test_sendChunk();
+        void test_sendMetrics();
+        void test_version2();
 
     public:
         PelicanProtocolTest();
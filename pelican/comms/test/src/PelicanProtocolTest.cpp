@@ -11,14 +11,27 @@
 #include "StreamData.h"
 
 #include "pelican/comms/DataSupportRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ConsumerRequest.h"
+#include "pelican/comms/MetricsRequest.h"
+#include "pelican/comms/MetricsResponse.h"
 #include "pelican/comms/DataSupportResponse.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/ProtocolVersionResponse.h"
+#include "pelican/comms/DataChunk.h"
 #include "pelican/data/DataRequirements.h"
 #include "pelican/utility/test/SocketTester.h"
 #include "pelican/data/test/TestDataBlob.h"
 #include "pelican/server/WritableData.h"
 
 #include <QtCore/QBuffer>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QHostAddress>
 #include <QtCore/QDataStream>
+#include <QtCore/QThread>
+
+#include <sys/socket.h>
 
 #include <iostream>
 using std::endl;
@@ -31,6 +44,27 @@ using test::TestDataBlob;
 using test::SocketTester;
 
 CPPUNIT_TEST_SUITE_REGISTRATION( PelicanProtocolTest );
+
+// Sends stream data from another thread, so that the test can read it
+// while the send blocks.
+class StreamDataSender : public QThread
+{
+    public:
+        StreamDataSender(PelicanProtocol* proto, QTcpSocket* socket,
+                const AbstractProtocol::StreamData_t* data)
+            : _proto(proto), _socket(socket), _data(data) {}
+        QString error;
+    protected:
+        void run() {
+            try { _proto->send(*_socket, *_data); }
+            catch (const QString& e) { error = e; }
+        }
+    private:
+        PelicanProtocol* _proto;
+        QTcpSocket* _socket;
+        const AbstractProtocol::StreamData_t* _data;
+};
+
 // class PelicanProtocolTest
 PelicanProtocolTest::PelicanProtocolTest()
     : CppUnit::TestFixture()
@@ -256,6 +290,291 @@ void PelicanProtocolTest::test_sendStreamData()
     }
 }
 
+void PelicanProtocolTest::test_sendStreamDataSocket()
+{
+    // Use Case
+    // Two Stream Data chunks sent directly to a connected socket
+    // Expect the header and both chunks in order
+    QTcpServer server;
+    CPPUNIT_ASSERT( server.listen(QHostAddress::LocalHost) );
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    CPPUNIT_ASSERT( client.waitForConnected(5000) );
+    CPPUNIT_ASSERT( server.waitForNewConnection(5000) );
+    QTcpSocket* socket = server.nextPendingConnection();
+
+    QByteArray data1(8192, 'a');
+    QByteArray data2(4096, 'b');
+    StreamData sd1("d1", data1.data(), data1.size());
+    sd1.setId("id1");
+    StreamData sd2("d2", data2.data(), data2.size());
+    sd2.setId("id2");
+    AbstractProtocol::StreamData_t data;
+    data.append(&sd1);
+    data.append(&sd2);
+
+    PelicanProtocol proto;
+    proto.setZeroCopy(true);
+    socket->write("x"); // Buffered data must be sent first.
+    proto.send(*socket, data);
+    CPPUNIT_ASSERT_EQUAL( (qint64)0, socket->bytesToWrite() );
+
+    while (client.bytesAvailable() < 1) client.waitForReadyRead(5000);
+    char x;
+    client.getChar(&x);
+    CPPUNIT_ASSERT_EQUAL( 'x', x );
+    boost::shared_ptr<ServerResponse> resp = _protocol.receive(client);
+    CPPUNIT_ASSERT( resp->type() == ServerResponse::StreamData );
+    QByteArray buf;
+    while (buf.size() < data1.size() + data2.size()) {
+        if (client.bytesAvailable() == 0) client.waitForReadyRead(5000);
+        buf.append(client.readAll());
+    }
+    CPPUNIT_ASSERT( buf == data1 + data2 );
+    delete socket;
+}
+
+void PelicanProtocolTest::test_sendStreamDataZeroCopy()
+{
+    // Use Case
+    // A Stream Data chunk above the zero copy threshold sent to a socket
+    // with zero copy enabled
+    // Expect the chunk intact, sent with MSG_ZEROCOPY where the kernel
+    // supports it
+    QTcpServer server;
+    CPPUNIT_ASSERT( server.listen(QHostAddress::LocalHost) );
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    CPPUNIT_ASSERT( client.waitForConnected(5000) );
+    CPPUNIT_ASSERT( server.waitForNewConnection(5000) );
+    QTcpSocket* socket = server.nextPendingConnection();
+
+    QByteArray data1(256 * 1024, 0);
+    for (int i = 0; i < data1.size(); ++i) data1[i] = (char)(i % 251);
+    StreamData sd1("d1", data1.data(), data1.size());
+    sd1.setId("id1");
+    AbstractProtocol::StreamData_t data;
+    data.append(&sd1);
+
+    PelicanProtocol proto;
+    proto.setZeroCopy(true);
+    StreamDataSender sender(&proto, socket, &data);
+    sender.start();
+
+    while (client.bytesAvailable() == 0) client.waitForReadyRead(5000);
+    boost::shared_ptr<ServerResponse> resp = _protocol.receive(client);
+    CPPUNIT_ASSERT( resp->type() == ServerResponse::StreamData );
+    QByteArray buf;
+    while (buf.size() < data1.size()) {
+        if (client.bytesAvailable() == 0)
+            CPPUNIT_ASSERT( client.waitForReadyRead(5000) );
+        buf.append(client.readAll());
+    }
+    CPPUNIT_ASSERT( sender.wait(5000) );
+    CPPUNIT_ASSERT_EQUAL( std::string(), sender.error.toStdString() );
+    CPPUNIT_ASSERT( buf == data1 );
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+    int one = 1;
+    if (::setsockopt(client.socketDescriptor(), SOL_SOCKET, SO_ZEROCOPY,
+            &one, sizeof(one)) == 0)
+        CPPUNIT_ASSERT( proto.zeroCopySends() > 0 );
+#endif
+    delete socket;
+}
+
+void PelicanProtocolTest::test_sendMetrics()
+{
+    // Use Case:
+    // Metrics with labels
+    // Expect the same values to be received and listed in text()
+    QMap<QString, double> values;
+    QString written = MetricsResponse::name("pelican_stream_chunks_written_total",
+            "stream", "stream1");
+    values.insert(written, 12);
+    values.insert("pelican_request_seconds_max", 0.25);
+    PelicanProtocol proto;
+    QByteArray block;
+    QBuffer stream(&block);
+    stream.open(QIODevice::WriteOnly);
+    proto.send(stream, MetricsResponse(values));
+
+    QTcpSocket& socket = _st->send(block);
+    boost::shared_ptr<ServerResponse> resp = _protocol.receive(socket);
+    CPPUNIT_ASSERT( resp->type() == ServerResponse::Metrics );
+    MetricsResponse* r = static_cast<MetricsResponse*>(resp.get());
+    CPPUNIT_ASSERT( r->values() == values );
+    CPPUNIT_ASSERT_EQUAL(
+            std::string("pelican_stream_chunks_written_total{stream=\"stream1\"}"),
+            written.toStdString() );
+    CPPUNIT_ASSERT( r->text().contains(written + " 12\n") );
+    CPPUNIT_ASSERT( r->text().contains("pelican_request_seconds_max 0.25\n") );
+}
+
+void PelicanProtocolTest::test_version2()
+{
+    QTcpServer server;
+    CPPUNIT_ASSERT( server.listen(QHostAddress::LocalHost) );
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    CPPUNIT_ASSERT( client.waitForConnected(5000) );
+    CPPUNIT_ASSERT( server.waitForNewConnection(5000) );
+    QTcpSocket* socket = server.nextPendingConnection();
+    PelicanProtocol proto;
+    PelicanClientProtocol clientProto;
+    {
+        // Use Case:
+        // Client asks for a later version than the server supports
+        // Expect version 3 to be agreed
+        client.write(clientProto.serialise(ProtocolVersionRequest(4)));
+        client.flush();
+        boost::shared_ptr<ServerRequest> req = proto.request(*socket);
+        CPPUNIT_ASSERT( req->type() == ServerRequest::ProtocolVersion );
+        proto.sendVersion(*socket,
+                static_cast<ProtocolVersionRequest*>(req.get())->version());
+        socket->flush();
+        boost::shared_ptr<ServerResponse> resp = clientProto.receive(client);
+        CPPUNIT_ASSERT( resp->type() == ServerResponse::ProtocolVersion );
+        CPPUNIT_ASSERT_EQUAL( (quint16)3,
+                static_cast<ProtocolVersionResponse*>(resp.get())->version() );
+        clientProto.setVersion(3);
+    }
+    {
+        // Use Case:
+        // DataSupport request and response in version 2
+        // Expect the names to be received
+        client.write(clientProto.serialise(DataSupportRequest()));
+        client.flush();
+        boost::shared_ptr<ServerRequest> req = proto.request(*socket);
+        CPPUNIT_ASSERT( req->type() == ServerRequest::DataSupport );
+        DataSpec spec;
+        spec.addStreamData("stream1");
+        spec.addServiceData("service1");
+        proto.send(*socket, DataSupportResponse(spec));
+        socket->flush();
+        boost::shared_ptr<ServerResponse> resp = clientProto.receive(client);
+        CPPUNIT_ASSERT( resp->type() == ServerResponse::DataSupport );
+        DataSupportResponse* r = static_cast<DataSupportResponse*>(resp.get());
+        CPPUNIT_ASSERT( r->streamData().contains("stream1") );
+        CPPUNIT_ASSERT( r->serviceData().contains("service1") );
+    }
+    {
+        // Use Case:
+        // Metrics request and response in version 2
+        // Expect the values to be received
+        client.write(clientProto.serialise(MetricsRequest()));
+        client.flush();
+        boost::shared_ptr<ServerRequest> req = proto.request(*socket);
+        CPPUNIT_ASSERT( req->type() == ServerRequest::Metrics );
+        QMap<QString, double> values;
+        values.insert("pelican_requests_total{type=\"Metrics\"}", 1);
+        values.insert("pelican_request_seconds_total", 1.5e-6);
+        proto.send(*socket, MetricsResponse(values));
+        socket->flush();
+        boost::shared_ptr<ServerResponse> resp = clientProto.receive(client);
+        CPPUNIT_ASSERT( resp->type() == ServerResponse::Metrics );
+        CPPUNIT_ASSERT( static_cast<MetricsResponse*>(resp.get())->values() == values );
+    }
+    {
+        // Use Case:
+        // StreamData request with known and unknown names
+        // Expect the same request to be received
+        StreamDataRequest req;
+        DataSpec require;
+        require.addStreamData("stream1");
+        require.addServiceData("service1");
+        require.addServiceData("unknown");
+        req.addDataOption(require);
+        client.write(clientProto.serialise(req));
+        client.flush();
+        CPPUNIT_ASSERT( req == *(proto.request(*socket)) );
+    }
+    {
+        // Use Case:
+        // Two chunks of stream data with associated service data
+        // Expect the descriptions to be received, numbered in sequence,
+        // with the ingest time and the serve and receive times stamped
+        QByteArray data(16, 'a');
+        QString id1("1");
+        QString id2("version2");
+        StreamData sd1("stream1", id1, data);
+        sd1.latencyTrace().setTime(LatencyTrace::Ingest, 1000);
+        sd1.addAssociatedData(boost::shared_ptr<DataChunk>(
+                new DataChunk("service1", "7", 12)));
+        StreamData sd2("stream1", id2, data);
+        for (int i = 1; i <= 2; ++i) {
+            AbstractProtocol::StreamData_t d;
+            d.append(i == 1 ? &sd1 : &sd2);
+            proto.send(*socket, d);
+            boost::shared_ptr<ServerResponse> resp = clientProto.receive(client);
+            CPPUNIT_ASSERT( resp->type() == ServerResponse::StreamData );
+            StreamDataResponse* r = static_cast<StreamDataResponse*>(resp.get());
+            CPPUNIT_ASSERT_EQUAL( (quint64)i, r->sequence() );
+            StreamData* sd = r->streamData();
+            CPPUNIT_ASSERT_EQUAL( std::string("stream1"), sd->name().toStdString() );
+            CPPUNIT_ASSERT_EQUAL( (i == 1 ? id1 : id2).toStdString(),
+                    sd->id().toStdString() );
+            CPPUNIT_ASSERT_EQUAL( (size_t)data.size(), sd->size() );
+            CPPUNIT_ASSERT_EQUAL( i == 1 ? 1 : 0, sd->associateData().size() );
+            const LatencyTrace& trace = sd->latencyTrace();
+            CPPUNIT_ASSERT_EQUAL( std::string("stream1"), trace.stream().toStdString() );
+            CPPUNIT_ASSERT_EQUAL( (quint64)(i == 1 ? 1000 : 0),
+                    trace.time(LatencyTrace::Ingest) );
+            CPPUNIT_ASSERT( trace.time(LatencyTrace::Serve) > 1000 );
+            CPPUNIT_ASSERT( trace.time(LatencyTrace::Receive) != 0 );
+            QByteArray buf;
+            while (buf.size() < data.size()) {
+                if (client.bytesAvailable() == 0) client.waitForReadyRead(5000);
+                buf.append(client.read(data.size() - buf.size()));
+            }
+            CPPUNIT_ASSERT( buf == data );
+        }
+    }
+    {
+        // Use Case:
+        // Stream data sent on a second connection, between sends on the
+        // first
+        // Expect each connection to be numbered from 1 without gaps
+        QTcpSocket client2;
+        client2.connectToHost(QHostAddress::LocalHost, server.serverPort());
+        CPPUNIT_ASSERT( client2.waitForConnected(5000) );
+        CPPUNIT_ASSERT( server.waitForNewConnection(5000) );
+        QTcpSocket* socket2 = server.nextPendingConnection();
+        proto.sendVersion(*socket2, 2);
+        socket2->flush();
+        PelicanClientProtocol clientProto2;
+        CPPUNIT_ASSERT( clientProto2.receive(client2)->type()
+                == ServerResponse::ProtocolVersion );
+        clientProto2.setVersion(2);
+
+        QByteArray data(16, 'b');
+        StreamData sd("stream1", QString("3"), data);
+        AbstractProtocol::StreamData_t d;
+        d.append(&sd);
+        for (int i = 1; i <= 2; ++i) {
+            proto.send(*socket2, d);
+            boost::shared_ptr<ServerResponse> resp = clientProto2.receive(client2);
+            CPPUNIT_ASSERT( resp->type() == ServerResponse::StreamData );
+            CPPUNIT_ASSERT_EQUAL( (quint64)i,
+                    static_cast<StreamDataResponse*>(resp.get())->sequence() );
+            while (client2.bytesAvailable() < data.size())
+                client2.waitForReadyRead(5000);
+            client2.read(data.size());
+
+            proto.send(*socket, d);
+            resp = clientProto.receive(client);
+            CPPUNIT_ASSERT( resp->type() == ServerResponse::StreamData );
+            CPPUNIT_ASSERT_EQUAL( (quint64)(i + 2),
+                    static_cast<StreamDataResponse*>(resp.get())->sequence() );
+            while (client.bytesAvailable() < data.size())
+                client.waitForReadyRead(5000);
+            client.read(data.size());
+        }
+        delete socket2;
+    }
+    delete socket;
+}
+
 void PelicanProtocolTest::test_request()
 {
     // Request Processing tests
@@ -318,6 +637,45 @@ void PelicanProtocolTest::test_request()
         Socket_t& socket = _send(&req);
         CPPUNIT_ASSERT( req == *(proto.request(socket)) );
     }
+    {
+        // Use Case:
+        // A StreamSubscription Request
+        StreamSubscriptionRequest req(3);
+        DataSpec require;
+        require.addStreamData("teststream");
+        require.addServiceData("testservice");
+        req.addDataOption(require);
+        PelicanProtocol proto;
+        Socket_t& socket = _send(&req);
+        boost::shared_ptr<ServerRequest> req2 = proto.request(socket);
+        CPPUNIT_ASSERT( req == *req2 );
+        CPPUNIT_ASSERT_EQUAL( (quint32)3,
+                static_cast<StreamSubscriptionRequest*>(req2.get())->credits() );
+    }
+    {
+        // Use Case:
+        // A Credit Request
+        CreditRequest req(5);
+        PelicanProtocol proto;
+        Socket_t& socket = _send(&req);
+        CPPUNIT_ASSERT( req == *(proto.request(socket)) );
+    }
+    {
+        // Use Case:
+        // A Consumer Request
+        ConsumerRequest req("monitoring");
+        PelicanProtocol proto;
+        Socket_t& socket = _send(&req);
+        CPPUNIT_ASSERT( req == *(proto.request(socket)) );
+    }
+    {
+        // Use Case:
+        // A Metrics Request
+        MetricsRequest req;
+        PelicanProtocol proto;
+        Socket_t& socket = _send(&req);
+        CPPUNIT_ASSERT( req == *(proto.request(socket)) );
+    }
 }
 
 void PelicanProtocolTest::test_sendDataSupport()
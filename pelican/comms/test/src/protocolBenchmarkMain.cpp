@@ -0,0 +1,141 @@
+#include "pelican/comms/PelicanProtocol.h"
+#include "pelican/comms/PelicanClientProtocol.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/DataSupportRequest.h"
+#include "pelican/comms/DataSupportResponse.h"
+#include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataChunk.h"
+#include "pelican/comms/ServerRequest.h"
+#include "pelican/comms/ServerResponse.h"
+#include "pelican/data/DataSpec.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QBuffer>
+#include <QtCore/QTime>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QHostAddress>
+#include <iostream>
+#include <cstdlib>
+
+using namespace pelican;
+
+/*
+ * Serialisation benchmark for versions 1 and 2 of the Pelican protocol.
+ *
+ * For each version, times:
+ * - writing stream data response headers (one stream, with service data);
+ * - serialising the client's stream data request;
+ * - sending stream data headers over a loopback connection and parsing
+ *   them on the client side.
+ */
+
+static void report(const char* what, int version, int count, int elapsed)
+{
+    std::cout << "v" << version << " " << what << ": " << count << " in "
+              << elapsed << " ms ("
+              << (elapsed ? (qint64)count * 1000 / elapsed : 0)
+              << " /s)" << std::endl;
+}
+
+static void run(int version, int count)
+{
+    QString id("1234567");
+    StreamData sd("VisibilityData", id, 0);
+    sd.addAssociatedData(boost::shared_ptr<DataChunk>(
+            new DataChunk("AntennaPositions", "42", 4096)));
+    sd.addAssociatedData(boost::shared_ptr<DataChunk>(
+            new DataChunk("CalibrationTable", "17", 65536)));
+    AbstractProtocol::StreamData_t data;
+    data.append(&sd);
+
+    DataSpec spec;
+    spec.addStreamData("VisibilityData");
+    spec.addServiceData("AntennaPositions");
+    spec.addServiceData("CalibrationTable");
+
+    // Connect a client and server, and agree the protocol version.
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost))
+        throw QString("Unable to listen: ") + server.errorString();
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    if (!client.waitForConnected(5000) || !server.waitForNewConnection(5000))
+        throw QString("Unable to connect: ") + client.errorString();
+    QTcpSocket* socket = server.nextPendingConnection();
+    PelicanProtocol proto;
+    PelicanClientProtocol clientProto;
+    if (version >= 2) {
+        client.write(clientProto.serialise(ProtocolVersionRequest(version)));
+        client.flush();
+        proto.request(*socket);
+        proto.sendVersion(*socket, version);
+        socket->flush();
+        clientProto.receive(client);
+        clientProto.setVersion(version);
+        client.write(clientProto.serialise(DataSupportRequest()));
+        client.flush();
+        proto.request(*socket);
+        proto.send(*socket, DataSupportResponse(spec));
+        socket->flush();
+        clientProto.receive(client);
+    }
+
+    // Write stream data headers to memory.
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    buffer.setProperty("pelicanProtocolVersion", socket->property("pelicanProtocolVersion"));
+    buffer.setProperty("pelicanKnownIds", socket->property("pelicanKnownIds"));
+    QTime timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        buffer.seek(0);
+        proto.send(buffer, data);
+    }
+    report("response headers written", version, count, timer.elapsed());
+
+    // Serialise stream data requests.
+    StreamDataRequest request;
+    request.addDataOption(spec);
+    timer.start();
+    qint64 bytes = 0;
+    for (int i = 0; i < count; ++i)
+        bytes += clientProto.serialise(request).size();
+    report("requests serialised", version, count, timer.elapsed());
+    std::cout << "    request size " << bytes / count << " bytes" << std::endl;
+
+    // Send headers over the connection and parse them.
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        proto.send(*socket, data);
+        socket->flush();
+        boost::shared_ptr<ServerResponse> r = clientProto.receive(client);
+        if (r->type() != ServerResponse::StreamData)
+            throw QString("Unexpected response: ") + r->message();
+    }
+    report("responses sent and parsed", version, count, timer.elapsed());
+    std::cout << "    response header size " << buffer.pos() << " bytes" << std::endl;
+    delete socket;
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        QCoreApplication app(argc, argv);
+
+        if (argc != 2) {
+            std::cerr << "Usage: protocolBenchmark <iterations>" << std::endl;
+            return 1;
+        }
+        int count = atoi(argv[1]);
+
+        run(1, count);
+        run(2, count);
+    }
+    catch (const QString& err) {
+        std::cerr << "Error: " << err.toStdString() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -7,7 +7,9 @@
 
 #include "pelican/utility/ConfigNode.h"
 #include "pelican/utility/FactoryRegistrar.h"
+#include "pelican/utility/TaskScheduler.h"
 #include "pelican/data/DataBlob.h"
+#include <QtCore/QList>
 #include <QtCore/QString>
 #include <algorithm>
 #include <iostream>
@@ -32,6 +34,12 @@ class AbstractPipeline;
  * This is the base class for all Pelican pipeline modules, which provide
  * functionality to Pelican pipelines. Inherit this class to create a new
  * module type.
+ *
+ * Modules can split their loops over the threads of the task scheduler
+ * shared by the pipelines with parallelFor() and parallelReduce() (see
+ * TaskScheduler), rather than starting threads of their own. The loops
+ * are run serially on the calling thread when the module is not in a
+ * pipeline run by a driver.
  */
 class AbstractModule
 {
@@ -65,11 +73,34 @@ class AbstractModule
          */
         void dataOutput( const DataBlob*, const QString& stream = "" ) const;
 
+        /// Runs the module on the blobs named when it was created with
+        /// AbstractPipeline::createModule(type, name, inputs, outputs), in
+        /// the same order. Override this to let the pipeline schedule the
+        /// module.
+        virtual void execute(const QList<DataBlob*>& inputs,
+                const QList<DataBlob*>& outputs);
+
+        /// Returns the task scheduler shared by the pipelines (0 if the
+        /// module is not in a pipeline run by a driver).
+        TaskScheduler* taskScheduler() const;
+
     protected:
         /// Returns the index of the first occurrence of value in the data.
         template <typename T>
         unsigned findIndex(T value, vector<T> const& data) const;
 
+        /// Calls body(begin, end) on pieces of the range [begin, end) on the
+        /// threads of the task scheduler.
+        template <class Body>
+        void parallelFor(int begin, int end, const Body& body,
+                int grain = 0) const;
+
+        /// Calls body(begin, end) on pieces of the range [begin, end) on the
+        /// threads of the task scheduler, joining the results in order.
+        template <class T, class Body, class Join>
+        T parallelReduce(int begin, int end, const T& identity,
+                const Body& body, const Join& join, int grain = 0) const;
+
 };
 
 
@@ -93,6 +124,31 @@ unsigned AbstractModule::findIndex(T value, vector<T> const& data) const
     return i;
 }
 
+template <class Body>
+inline
+void AbstractModule::parallelFor(int begin, int end, const Body& body,
+        int grain) const
+{
+    TaskScheduler* scheduler = taskScheduler();
+    if (scheduler)
+        scheduler->parallelFor(begin, end, body, grain);
+    else if (begin < end)
+        body(begin, end);
+}
+
+template <class T, class Body, class Join>
+inline
+T AbstractModule::parallelReduce(int begin, int end, const T& identity,
+        const Body& body, const Join& join, int grain) const
+{
+    TaskScheduler* scheduler = taskScheduler();
+    if (scheduler)
+        return scheduler->parallelReduce(begin, end, identity, body, join, grain);
+    if (begin >= end)
+        return identity;
+    return join(identity, body(begin, end));
+}
+
 
 } // namespace pelican
 
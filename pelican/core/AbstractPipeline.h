@@ -9,8 +9,10 @@
 #include "pelican/modules/AbstractModule.h"
 #include "pelican/utility/FactoryConfig.h"
 #include "pelican/utility/FactoryGeneric.h"
+#include "pelican/utility/LatencyTrace.h"
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QList>
 
 namespace pelican {
@@ -24,6 +26,8 @@ class DataBlob;
 class PipelineDriver;
 class OutputStreamManager;
 class DataBlobBuffer;
+class TaskScheduler;
+class SequenceGate;
 
 /**
  * @ingroup c_core
@@ -90,6 +94,38 @@ class DataBlobBuffer;
  *
  * The run() method is called each time a new hash of data is obtained from
  * the data client, and the data hash is passed as a function argument.
+ *
+ * Alternatively, modules that implement AbstractModule::execute() can be
+ * created with the names of the data blobs they read and write, and run
+ * by runModules(). Inputs are remote data types or blobs created with
+ * createBlob(type, name), and outputs are named blobs. Each module is run
+ * once the modules writing its inputs have finished, so that independent
+ * modules run at the same time on the task scheduler of the pipeline
+ * driver. The module graph is checked when the pipeline is initialised.
+ *
+ * \code
+ * void init()
+ * {
+ *     createBlob("ImageData", "image");
+ *     createBlob("SpectrumData", "spectrum");
+ *     createModule("ZenithImagerDft", "", QStringList() << "VisibilityData",
+ *             QStringList() << "image");
+ *     createModule("SpectrumModule", "", QStringList() << "VisibilityData",
+ *             QStringList() << "spectrum");
+ *     createModule("ImageWriterFits", "", QStringList() << "image",
+ *             QStringList());
+ *     requestRemoteData("VisibilityData");
+ * }
+ *
+ * void run(QHash<QString, DataBlob*>& remoteData)
+ * {
+ *     runModules(remoteData); // the imager and spectrum run together
+ * }
+ * \endcode
+ *
+ * The latency of each run, and of each data blob output during it, is
+ * measured from the time the server ingested the newest data in the hash
+ * (see LatencyMonitor).
  */
 class AbstractPipeline
 {
@@ -160,6 +196,21 @@ class AbstractPipeline
         /// return the history for the specifed data stream
         const QList<DataBlob*>& streamHistory(const QString& stream) const;
 
+        /// Returns the task scheduler of the pipeline driver (0 if there
+        /// is no driver).
+        TaskScheduler* taskScheduler() const;
+
+        /// Checks and orders the modules created with inputs and outputs
+        /// (called by the pipeline driver after init()).
+        void buildModuleGraph();
+
+        /// Holds back the output of the next run until the gate has passed
+        /// the given sequence number (used by the driver for replicas).
+        void setOutputOrder(SequenceGate* gate, quint64 sequence);
+
+        /// Returns the sequence number of the output of the current run.
+        quint64 outputSequence() const { return _outputSequence; }
+
     protected:
         /// get the specified Configuration Node from the pipeline configuration
         ConfigNode config( const QString& tag, const QString& name = "" );
@@ -182,6 +233,18 @@ class AbstractPipeline
         AbstractModule* createModule(const QString& type,
                 const QString& name = QString());
 
+        /// Create a pipeline module to be run by runModules() on the
+        /// named input and output blobs.
+        AbstractModule* createModule(const QString& type, const QString& name,
+                const QStringList& inputs, const QStringList& outputs);
+
+        /// Create a data blob that modules can read and write by name.
+        DataBlob* createBlob(const QString& type, const QString& name);
+
+        /// Runs the modules created with inputs and outputs, each once
+        /// its inputs have been written.
+        void runModules(QHash<QString, DataBlob*>& data);
+
 
         /// Stops the pipeline driver.
         void stop();
@@ -215,6 +278,23 @@ class AbstractPipeline
         //  in reverse order (latest at the front)
         QHash<QString, QList<DataBlob*>* > _streamHistory;
 
+        /// Latency trace of the newest data in the current run.
+        LatencyTrace _trace;
+
+        /// Modules run by runModules(), in the order created and in an
+        /// order that respects their dependencies.
+        class ModuleTask;
+        QList<ModuleTask*> _moduleGraph;
+        QList<ModuleTask*> _moduleOrder;
+        bool _moduleGraphBuilt;
+
+        /// Blobs created with a name, for the modules.
+        QHash<QString, DataBlob*> _namedBlobs;
+
+        /// Orders the output of replicas of the pipeline (0 if none).
+        SequenceGate* _outputGate;
+        quint64 _outputSequence;
+
 
     private:
         /// \todo fix me (horrible use of friend class)!
@@ -8,18 +8,24 @@
 #include "AbstractAdaptingDataClient.h"
 #include <boost/shared_ptr.hpp>
 #include "pelican/data/DataSpec.h"
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QByteArray>
 
 using boost::shared_ptr;
 class QTcpSocket;
 
 namespace pelican {
 
-class AbstractClientProtocol;
+class PelicanClientProtocol;
 class ConfigNode;
 class ServerRequest;
 class ServerResponse;
 class StreamData;
 class ServiceDataRequest;
+class StreamSubscriptionRequest;
+class StreamDataRequest;
+class PelicanServerPrefetcher;
 
 /**
  * @ingroup c_core
@@ -30,6 +36,33 @@ class ServiceDataRequest;
  * Implements the data client interface for attaching to a Pelican Server.
  *
  * @details
+ * By default a new connection is made for each request. Setting
+ * \verbatim <server host="127.0.0.1" port="2000" keepAlive="true"/> \endverbatim
+ * keeps a single connection open and reuses it for all requests
+ * (the server must also be configured for keep-alive sessions).
+ *
+ * Setting
+ * \verbatim <server host="127.0.0.1" port="2000" subscribe="true" credits="2"/> \endverbatim
+ * subscribes to the stream data on the first call to getData(), after
+ * which the server pushes each chunk (and any new service data) as it
+ * becomes available, with up to \c credits chunks in flight. Each call to
+ * getData() adapts the next chunk received and grants the server a
+ * further credit.
+ *
+ * Setting \c prefetch="N" on the \c server tag instead fetches up to N
+ * chunks of stream data (and their service data) into memory from a
+ * background thread, so that getData() only has to adapt them.
+ *
+ * Kept-alive connections use version 3 of the Pelican protocol (or the
+ * latest the server supports), which carries the times the server
+ * ingested and served each chunk, so that the latency of each stage can be
+ * traced (see LatencyMonitor). Setting \c protocol="1" on the \c server
+ * tag disables the version negotiation.
+ *
+ * Setting \c consumer="name" on the \c server tag names the client to the
+ * server, so that it is served every chunk of broadcast streams through
+ * its own read cursor (see StreamDataBuffer). Pipelines with different
+ * consumer names each see every chunk. Implies keep-alive.
  */
 
 class PelicanServerClient : public AbstractAdaptingDataClient
@@ -61,6 +94,15 @@ class PelicanServerClient : public AbstractAdaptingDataClient
         /// mechanics of sending a request and waiting for a response
         boost::shared_ptr<ServerResponse> _sendRequest( QTcpSocket& sock, const ServerRequest& request ) const;
 
+        /// connect the socket to the server
+        void _connect( QTcpSocket& sock ) const;
+
+        /// (re)connect the socket and agree the protocol version to use
+        void _open( QTcpSocket& sock ) const;
+
+        /// the connection reused in keep-alive mode
+        QTcpSocket& _connection() const;
+
         /// Process the response from the server.
         DataBlobHash _response(QIODevice&, shared_ptr<ServerResponse> r,
                 DataBlobHash&);
@@ -69,16 +111,47 @@ class PelicanServerClient : public AbstractAdaptingDataClient
         DataBlobHash _getServiceData(const ServiceDataRequest& requirements,
                 DataBlobHash& dataHash);
 
+        /// Receives the next chunk pushed on the stream subscription.
+        DataBlobHash _nextPushed(const StreamSubscriptionRequest& request,
+                DataBlobHash& dataHash);
+
+        /// (Re)connects and sends the subscription.
+        void _sendSubscription(QTcpSocket& sock,
+                const StreamSubscriptionRequest& request);
+
+        /// Takes the next chunk fetched by the prefetch thread.
+        DataBlobHash _nextPrefetched(const StreamDataRequest& request,
+                DataBlobHash& dataHash);
+
+        /// Adapts stream and service data already read into memory.
+        DataBlobHash _adaptFetched(const StreamData* sd, QByteArray& data,
+                const QHash<QString, QPair<QString, QByteArray> >& serviceData,
+                DataBlobHash& dataHash);
+
+        /// Reads size bytes from the device, waiting if necessary.
+        bool _read(QIODevice& device, char* buffer, qint64 size);
+
         /// Calls adaptStream on the data client base class.
         DataBlobHash _adaptStream(QIODevice& device, const StreamData*,
                 DataBlobHash& dataHash);
 
     private:
-        AbstractClientProtocol* _protocol;
+        PelicanClientProtocol* _protocol;
         QString _server;
         unsigned _port;
         mutable bool _specRecieved;
         mutable DataSpec _dataSpec;
+        bool _keepAlive;
+        quint16 _protocolVersion;
+        QString _consumer;
+        bool _subscribe;
+        bool _subscribed;
+        unsigned _credits;
+        mutable QTcpSocket* _socket;
+        int _prefetch;
+        PelicanServerPrefetcher* _prefetcher;
+        /// Service data pushed by the server, by name (version, data).
+        QHash<QString, QPair<QString, QByteArray> > _serviceCache;
 
     private:
         /// Unit testing class.
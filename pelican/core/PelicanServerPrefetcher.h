@@ -0,0 +1,114 @@
+#ifndef PELICANSERVERPREFETCHER_H
+#define PELICANSERVERPREFETCHER_H
+
+/**
+ * @file PelicanServerPrefetcher.h
+ */
+
+#include "pelican/comms/StreamDataRequest.h"
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QQueue>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <boost/shared_ptr.hpp>
+
+class QTcpSocket;
+
+namespace pelican {
+
+class PelicanClientProtocol;
+class ServerRequest;
+class ServerResponse;
+class StreamData;
+
+/**
+ * @ingroup c_core
+ *
+ * @class PelicanServerPrefetcher
+ *
+ * @brief
+ * Fetches stream data from a Pelican server ahead of it being required.
+ *
+ * @details
+ * Used by the PelicanServerClient in prefetch mode. The thread repeatedly
+ * sends the stream data request to the server, reading each chunk and the
+ * service data associated with it into memory, and keeps up to the given
+ * number of chunks queued for next() to collect. Service data is only
+ * requested from the server when its version changes.
+ *
+ * If the server reports an error it is returned by next() in place of the
+ * data, and the thread stops.
+ */
+class PelicanServerPrefetcher : public QThread
+{
+    public:
+        /// Service data by name (version, contents).
+        typedef QHash<QString, QPair<QString, QByteArray> > ServiceData_t;
+
+        /// A fetched stream data chunk.
+        struct Chunk {
+            boost::shared_ptr<ServerResponse> response; ///< Owns the StreamData.
+            QByteArray data;
+            ServiceData_t serviceData;
+            QString error;
+
+            /// Returns the stream data description.
+            StreamData* streamData() const;
+        };
+
+    public:
+        /// Constructs the prefetcher (call start() to begin fetching).
+        PelicanServerPrefetcher(const QString& host, quint16 port,
+                const StreamDataRequest& request, int depth,
+                bool keepAlive = false, quint16 protocolVersion = 1,
+                QObject* parent = 0);
+
+        /// Stops fetching.
+        ~PelicanServerPrefetcher();
+
+        /// Waits for and returns the next chunk fetched.
+        Chunk next();
+
+        /// Returns the number of chunks waiting to be collected.
+        int available();
+
+        /// Names the prefetcher as a broadcast consumer (call before start()).
+        void setConsumer(const QString& name) { _consumer = name; }
+
+    protected:
+        /// Runs the fetch loop.
+        void run();
+
+    private:
+        bool _fetch(QTcpSocket& sock, Chunk& chunk);
+        boost::shared_ptr<ServerResponse> _send(QTcpSocket& sock,
+                const ServerRequest& request);
+        bool _connect(QTcpSocket& sock);
+        bool _read(QTcpSocket& sock, char* buffer, qint64 size);
+
+    private:
+        QString _host;
+        quint16 _port;
+        StreamDataRequest _request;
+        int _depth;
+        bool _keepAlive;
+        quint16 _version;
+        QString _consumer;
+        PelicanClientProtocol* _protocol;
+        ServiceData_t _serviceCache;
+
+        QMutex _mutex;
+        QWaitCondition _notFull;
+        QWaitCondition _notEmpty;
+        QQueue<Chunk> _queue;
+        volatile bool _stopping;
+};
+
+} // namespace pelican
+
+#endif // PELICANSERVERPREFETCHER_H
@@ -24,6 +24,8 @@ class DataClientFactory;
 class AbstractAdapterFactory;
 class OutputStreamManager;
 class PipelineSwitcher;
+class PipelineReplicas;
+class TaskScheduler;
 
 /**
  * @ingroup c_core
@@ -38,6 +40,7 @@ class PipelineSwitcher;
  * command-line arguments and creates the objects, including:
  * - the configuration object;
  * - the various factories;
+ * - the task scheduler shared by the pipelines and their modules;
  * - the pipeline driver.
  *
  * It also provides public methods to register pipelines and start them running.
@@ -74,6 +77,11 @@ class PipelineSwitcher;
  *     return 0;
  * }
  * \endcode
+ *
+ * The threads of the task scheduler (one per core by default) are set
+ * in the \c pipelineConfig section with e.g.
+ * \verbatim <scheduler threads="8" cpus="0-7"/> \endverbatim
+ * where the optional \c cpus list binds each thread to a CPU in turn.
  */
 
 class PipelineApplication
@@ -110,12 +118,18 @@ class PipelineApplication
         /// Return a pointer to the module factory.
         FactoryConfig<AbstractModule>* moduleFactory() const;
 
+        /// Return a pointer to the task scheduler.
+        TaskScheduler* taskScheduler() const { return _taskScheduler; }
+
         /// Register a pipeline with the pipeline driver.
         void registerPipeline(AbstractPipeline *pipeline);
 
         /// add a PipelineSwitcher to the driver
         void addPipelineSwitcher(const PipelineSwitcher& switcher);
 
+        /// add replicas of a pipeline to the driver
+        void addPipelineReplicas(const PipelineReplicas& replicas);
+
         /// Sets the data client.
         void setDataClient(const QString& name);
         void setDataClient(AbstractDataClient* client);
@@ -154,6 +168,7 @@ class PipelineApplication
         AbstractAdapterFactory* _adapterFactory;
         DataClientFactory* _clientFactory;
         FactoryConfig<AbstractModule>* _moduleFactory;
+        TaskScheduler* _taskScheduler;
 
         // signal handling function
         static void exit(int sig);
@@ -14,7 +14,13 @@
 #include "pelican/utility/TypeCounter.h"
 #include "pelican/utility/FactoryGeneric.h"
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QSet>
 #include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+class QThreadPool;
 
 namespace pelican {
 
@@ -26,6 +32,8 @@ class OutputStreamManager;
 class PipelineSwitcher;
 class DataBlobBuffer;
 class Config;
+class TaskScheduler;
+class PipelineReplicas;
 
 /**
  * @ingroup c_core
@@ -38,11 +46,50 @@ class Config;
  * This class controls the data flow through the pipelines.
  * The pipeline driver also takes ownership of the pipelines and is
  * responsible for deleting them.
+ *
+ * By default each pipeline is run in turn by the thread that calls start().
+ * With
+ * \verbatim <driver threads="4"/> \endverbatim
+ * in the pipeline configuration, the pipelines are run on a pool of that
+ * many threads instead, so that pipelines that use different data run at
+ * the same time, while the driver fetches the next data. A pipeline
+ * is never run again before its last run has finished, and is not
+ * given data that a running pipeline is still using.
+ *
+ * With
+ * \verbatim <driver acquireQueue="2"/> \endverbatim
+ * the data client fetches the data on a separate thread, filling the next
+ * sets of data blobs (up to the given number) while the pipelines run on
+ * the current set.
+ *
+ * Replicas of a pipeline (see PipelineReplicas) are run in turn on
+ * successive data, so that with the thread pool they run at the same time.
+ *
+ * Modules run by AbstractPipeline::runModules(), and their parallel loops,
+ * are run on a task scheduler shared by the pipelines. This is the
+ * scheduler of the PipelineApplication, set with setTaskScheduler(), or
+ * else one with a thread per core created by the driver.
+ *
+ * The data blobs of each type allocate their data as set in the
+ * \c buffers tag of the pipeline configuration (see BufferMemory), e.g.
+ * \verbatim <buffers><SignalData pages="2M" lock="true" numaNode="0"/></buffers> \endverbatim
  */
 class PipelineDriver
 {
     private:
         friend class PipelineDriverTest;
+        class PipelineTask;
+        friend class PipelineTask;
+        class Acquirer;
+        friend class Acquirer;
+        struct ReplicaSet;
+
+        /// A set of data fetched by the acquisition thread.
+        struct Acquired {
+            QHash<QString, DataBlob*> data;
+            QHash<QString, DataBlob*> valid;
+            QString error;
+        };
 
     private:
         OutputStreamManager* _osmanager;
@@ -99,6 +146,46 @@ class PipelineDriver
         /// The name of the data client.
         QString _dataClientName;
 
+        /// Pool of threads running the pipelines (0 to run them in turn).
+        QThreadPool* _pool;
+
+        /// Seconds between latency reports (0 for none).
+        int _latencyReport;
+
+        /// Guards the state shared with the pipeline threads.
+        QMutex _mutex;
+        QWaitCondition _pipelineFinished;
+
+        /// Pipelines running in the pool.
+        QSet<AbstractPipeline*> _running;
+
+        /// Number of running pipelines using each data blob.
+        QHash<DataBlob*, int> _busy;
+
+        /// The first error thrown by a pipeline running in the pool.
+        QString _pipelineError;
+
+        /// Thread fetching data ahead of the pipelines (0 if none).
+        Acquirer* _acquirer;
+
+        /// Number of sets of data the acquisition thread may fetch ahead.
+        int _acquireQueue;
+
+        /// Data fetched by the acquisition thread, waiting to be run.
+        QQueue<Acquired> _acquired;
+        QWaitCondition _dataAcquired;
+        QWaitCondition _acquiredTaken;
+        bool _acquiring;
+
+        /// Sets of replicated pipelines, and the set of each replica.
+        QList<ReplicaSet*> _replicaSets;
+        QHash<AbstractPipeline*, ReplicaSet*> _replicaMap;
+
+        /// Scheduler of the module tasks (created when first needed,
+        /// unless set).
+        TaskScheduler* _taskScheduler;
+        bool _ownsTaskScheduler;
+
         /// All the adapters created for each data type.
         QHash<QString, AbstractAdapter*> _adapters;
 
@@ -125,6 +212,10 @@ class PipelineDriver
         //  time the current pipeline is deactivated
         void addPipelineSwitcher(const PipelineSwitcher& switcher);
 
+        /// Registers replicas of a pipeline, each run in turn on the next
+        //  data, with their output kept in order
+        void addPipelineReplicas(const PipelineReplicas& replicas);
+
         /// Sets the data client.
         void setDataClient(QString name);
         void setDataClient(AbstractDataClient* client);
@@ -144,6 +235,12 @@ class PipelineDriver
         // return the named configuration node, relative to the base adress
         ConfigNode config( const QString& pipeline, const QString& name="") const;
 
+        /// Returns the scheduler for the tasks of the pipelines.
+        TaskScheduler* taskScheduler();
+
+        /// Sets the scheduler for the tasks of the pipelines (not owned).
+        void setTaskScheduler(TaskScheduler* scheduler);
+
     private:
         /// deactivate a registered pipeline
         void _deactivatePipeline(AbstractPipeline*);
@@ -160,6 +257,49 @@ class PipelineDriver
         /// set up the DataBlob buffers for the pipeline
         void _activatePipelineBuffers(AbstractPipeline *pipeline);
 
+        /// runs the pipeline on the thread pool
+        void _dispatchPipeline(AbstractPipeline*);
+
+        /// called by the pool when a pipeline has finished
+        void _pipelineDone(AbstractPipeline*, const QList<DataBlob*>& blobs,
+                const QString& error);
+
+        /// returns the data blobs the pipeline may use when run with _dataHash
+        QList<DataBlob*> _pipelineBlobs(AbstractPipeline*) const;
+
+        /// waits (with _mutex locked) until none of the blobs are in use
+        void _waitForBlobs(const QList<DataBlob*>& blobs);
+
+        /// waits for all the pipelines running in the pool to finish
+        void _waitForPipelines();
+
+        /// returns the replica to run on the next data (or the pipeline)
+        AbstractPipeline* _nextReplica(AbstractPipeline*);
+
+        /// returns the pipeline that stands for the replicas of a pipeline
+        AbstractPipeline* _lead(AbstractPipeline*) const;
+
+        /// returns the history the driver keeps for a pipeline and its replicas
+        unsigned int _historySize(AbstractPipeline*, const QString& type) const;
+
+        /// numbers the output of a replica before it runs
+        void _beginRun(AbstractPipeline*);
+
+        /// lets the output of the replicas on later data through
+        void _endRun(AbstractPipeline*);
+
+        /// starts fetching data on the acquisition thread
+        void _startAcquisition();
+
+        /// stops fetching data on the acquisition thread
+        void _stopAcquisition();
+
+        /// fetches the next set of data (on the acquisition thread)
+        bool _acquire();
+
+        /// returns the next set of data fetched by the acquisition thread
+        QHash<QString, DataBlob*> _takeData();
+
         /// adjust internals to a new history size
         void _updateHistoryBuffers();
 
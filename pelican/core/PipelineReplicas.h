@@ -0,0 +1,59 @@
+#ifndef PIPELINEREPLICAS_H
+#define PIPELINEREPLICAS_H
+
+#include <QtCore/QList>
+
+/**
+ * @file PipelineReplicas.h
+ */
+
+namespace pelican {
+
+class AbstractPipeline;
+
+/**
+ * @class PipelineReplicas
+ *
+ * @brief
+ *     Runs several copies of a pipeline on successive data
+ * @details
+ *     This is a container class of identical pipelines (instances of the
+ *     same class, with the same data requirements). The pipeline driver
+ *     gives each new set of data to the next replica in turn, so that with
+ *     the driver's thread pool the replicas process successive data at the
+ *     same time. The output of each replica (see
+ *     AbstractPipeline::dataOutput()) is held back until the replicas
+ *     running on earlier data have finished, so that the output streams
+ *     still see the data in order.
+ *
+ * @code
+ * PipelineReplicas replicas;
+ * for( int i = 0; i < 4; ++i )
+ *     replicas.addPipeline(new MyPipeline);
+ * pipelineApp.addPipelineReplicas(replicas);
+ * @endcode
+ *
+ *     Each replica keeps the history of the data it was given.
+ */
+class PipelineReplicas
+{
+    public:
+        /// PipelineReplicas constructor.
+        PipelineReplicas();
+
+        /// PipelineReplicas destructor.
+        ~PipelineReplicas();
+
+        /// add a replica of the pipeline
+        void addPipeline(AbstractPipeline*);
+
+        /// return the list of all the replicas
+        const QList<AbstractPipeline*>& pipelines() const { return _pipelines; }
+
+    private:
+        QList<AbstractPipeline*> _pipelines;
+};
+
+} // namespace pelican
+
+#endif // PIPELINEREPLICAS_H
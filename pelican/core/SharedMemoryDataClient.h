@@ -0,0 +1,91 @@
+#ifndef SHAREDMEMORYDATACLIENT_H
+#define SHAREDMEMORYDATACLIENT_H
+
+/**
+ * @file SharedMemoryDataClient.h
+ */
+
+#include "pelican/core/AbstractAdaptingDataClient.h"
+#include "pelican/data/DataSpec.h"
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <boost/shared_ptr.hpp>
+
+class QTcpSocket;
+class QIODevice;
+
+namespace pelican {
+
+class ConfigNode;
+class PelicanClientProtocol;
+class ServerRequest;
+class ServerResponse;
+class SharedMemorySegment;
+class StreamData;
+
+/**
+ * @ingroup c_core
+ *
+ * @class SharedMemoryDataClient
+ *
+ * @brief
+ * Data client for a Pelican server on the same host, reading stream data
+ * in place from the server's shared memory.
+ *
+ * @details
+ * Connects to a Unix domain socket served with a SharedMemoryProtocol
+ * (see PelicanServer::addLocalProtocol()), e.g.
+ * \verbatim <server socket="/tmp/pelican.socket"/> \endverbatim
+ *
+ * For stream buffers with shared allocation only a description of each
+ * chunk is sent; the chunk is adapted straight from the mapped segment,
+ * and released back to the server once it has been adapted. Service data
+ * (and stream data from other buffers) is copied through the socket.
+ */
+class SharedMemoryDataClient : public AbstractAdaptingDataClient
+{
+    public:
+        /// Constructs the shared memory data client.
+        SharedMemoryDataClient(const ConfigNode& configNode,
+                const DataTypes& types, const Config* config);
+
+        /// Destroys the client, unmapping any segments.
+        virtual ~SharedMemoryDataClient();
+
+    public:
+        /// Retrieves and adapts the data required by the pipelines.
+        virtual DataBlobHash getData(DataBlobHash& dataHash);
+        virtual const DataSpec& dataSpec() const;
+
+    private:
+        /// Returns the connection to the server, connecting if necessary.
+        QTcpSocket& _connection() const;
+
+        /// Sends a request and waits for the response.
+        boost::shared_ptr<ServerResponse> _send(const ServerRequest& request) const;
+
+        /// Fetches and adapts the changed service data for the stream data.
+        DataBlobHash _serviceData(const StreamData* sd, DataBlobHash& dataHash);
+
+        /// Releases the oldest chunk held by the server.
+        void _release();
+
+        /// Returns the named segment, mapping it if necessary.
+        SharedMemorySegment* _segment(const QString& name);
+
+        /// Reads size bytes from the device.
+        void _read(QIODevice& device, char* buffer, qint64 size);
+
+    private:
+        QString _path;
+        PelicanClientProtocol* _protocol;
+        mutable QTcpSocket* _socket;
+        mutable DataSpec _dataSpec;
+        mutable bool _specReceived;
+        QHash<QString, SharedMemorySegment*> _segments;
+};
+
+PELICAN_DECLARE_CLIENT(SharedMemoryDataClient)
+
+} // namespace pelican
+#endif // SHAREDMEMORYDATACLIENT_H
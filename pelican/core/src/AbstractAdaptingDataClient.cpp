@@ -3,6 +3,7 @@
 #include "pelican/core/AbstractServiceAdapter.h"
 #include "pelican/comms/StreamData.h"
 #include "pelican/data/DataBlob.h"
+#include "pelican/utility/LatencyMonitor.h"
 
 
 namespace pelican {
@@ -46,6 +47,9 @@ void AbstractAdaptingDataClient::reset( const QList<DataSpec>& requirements  ) {
  * @details
  * Adapts (de-serialises) stream data into data blobs.
  *
+ * The blob takes the latency trace of the stream data, with the adapt
+ * time stamped, and the receive and adapt latencies are recorded.
+ *
  * @param device
  * @param sd
  * @param dataHash
@@ -65,6 +69,12 @@ AbstractDataClient::DataBlobHash AbstractAdaptingDataClient::adaptStream(
     adapter->deserialise(&device);
     validData.insert(type, dataHash.value(type));
 
+    LatencyTrace& trace = dataHash[type]->latencyTrace();
+    trace = sd->latencyTrace();
+    trace.stamp(LatencyTrace::Adapt);
+    LatencyMonitor::instance()->record(trace, LatencyTrace::Receive);
+    LatencyMonitor::instance()->record(trace, LatencyTrace::Adapt);
+
     return validData;
 }
 
@@ -9,7 +9,7 @@ namespace pelican {
  *@details AbstractModule 
  */
 AbstractModule::AbstractModule( const ConfigNode& config )
-    : _config(config)
+    : _config(config), _pipeline(0)
 {
 }
 
@@ -24,6 +24,27 @@ DataBlob* AbstractModule::createBlob(const QString& type) const {
     return _pipeline->createBlob(type);
 }
 
+/**
+ * @details
+ * The default implementation throws, as the module can only be run by
+ * calling its own methods.
+ */
+void AbstractModule::execute(const QList<DataBlob*>&, const QList<DataBlob*>&)
+{
+    throw QString("AbstractModule: %1 can not be run by the pipeline "
+            "(execute() is not implemented)").arg(_config.getDomElement().tagName());
+}
+
+/**
+ * @details
+ * Returns the task scheduler of the pipeline driver running the module's
+ * pipeline, or 0 if there is none.
+ */
+TaskScheduler* AbstractModule::taskScheduler() const
+{
+    return _pipeline ? _pipeline->taskScheduler() : 0;
+}
+
 void AbstractModule::dataOutput( const DataBlob* d,
                                  const QString& stream ) const
 {
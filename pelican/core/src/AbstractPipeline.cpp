@@ -5,9 +5,50 @@
 #include "pelican/core/PipelineDriver.h"
 #include "pelican/data/DataBlobBuffer.h"
 #include "pelican/output/OutputStreamManager.h"
+#include "pelican/utility/LatencyMonitor.h"
+#include "pelican/utility/SequenceGate.h"
+#include "pelican/utility/TaskScheduler.h"
+
+#include <QtCore/QSet>
 
 namespace pelican {
 
+/**
+ * @details
+ * A module in the module graph of the pipeline, run as a task once the
+ * modules writing its inputs have finished.
+ */
+class AbstractPipeline::ModuleTask : public TaskScheduler::Task
+{
+    public:
+        ModuleTask(AbstractModule* m, const QString& t, const QStringList& in,
+                const QStringList& out)
+            : module(m), type(t), inputs(in), outputs(out), dependencies(0),
+              scheduler(0), group(0) {}
+
+        void run()
+        {
+            module->execute(inputBlobs, outputBlobs);
+            foreach( ModuleTask* task, next ) {
+                if( task->remaining.sub() == 0 )
+                    scheduler->submit(task, *group);
+            }
+        }
+
+    public:
+        AbstractModule* module;
+        QString type;
+        QStringList inputs;
+        QStringList outputs;
+        QList<ModuleTask*> next;    ///< Modules reading the outputs.
+        int dependencies;           ///< Modules writing the inputs.
+        QList<DataBlob*> inputBlobs;
+        QList<DataBlob*> outputBlobs;
+        AtomicCounter remaining;
+        TaskScheduler* scheduler;
+        TaskScheduler::Group* group;
+};
+
 /**
  * @details
  * AbstractPipeline constructor.
@@ -18,6 +59,9 @@ AbstractPipeline::AbstractPipeline()
     _blobFactory = NULL;
     _moduleFactory = NULL;
     _pipelineDriver = NULL;
+    _moduleGraphBuilt = false;
+    _outputGate = NULL;
+    _outputSequence = 0;
 }
 
 /**
@@ -31,6 +75,7 @@ AbstractPipeline::~AbstractPipeline()
     for (it = _streamHistory.begin(); it != _streamHistory.end(); ++it) {
         delete it.value();
     }
+    qDeleteAll(_moduleGraph);
 }
 
 /**
@@ -81,11 +126,176 @@ AbstractModule* AbstractPipeline::createModule(const QString& type,
     return module;
 }
 
+/**
+ * @details
+ * Creates a new data blob, as createBlob(type), that can be named as an
+ * input or output of the modules run by runModules().
+ */
+DataBlob* AbstractPipeline::createBlob(const QString& type, const QString& name)
+{
+    if (_namedBlobs.contains(name))
+        throw QString("AbstractPipeline::createBlob(): Blob \"%1\" already exists.").arg(name);
+    DataBlob* blob = createBlob(type);
+    _namedBlobs.insert(name, blob);
+    return blob;
+}
+
+/**
+ * @details
+ * Creates a new module, as createModule(type, name), to be run by
+ * runModules(). Each time, the module's AbstractModule::execute() method is
+ * called with the blobs named by \p inputs and \p outputs, once the
+ * modules writing the inputs have run.
+ *
+ * @param[in] inputs  Remote data types, or names given to createBlob().
+ * @param[in] outputs Names given to createBlob().
+ */
+AbstractModule* AbstractPipeline::createModule(const QString& type,
+        const QString& name, const QStringList& inputs,
+        const QStringList& outputs)
+{
+    AbstractModule* module = createModule(type, name);
+    _moduleGraph.append(new ModuleTask(module, type, inputs, outputs));
+    _moduleGraphBuilt = false;
+    return module;
+}
+
+/**
+ * @details
+ * Links each module created with inputs and outputs to the modules that
+ * write its inputs, and orders them so that each comes after those it
+ * depends on.
+ *
+ * Throws if an output is not a named blob or is written by more than one
+ * module, if an input is neither remote data nor a named blob, or if the
+ * modules depend on each other in a cycle.
+ */
+void AbstractPipeline::buildModuleGraph()
+{
+    _moduleOrder.clear();
+    _moduleGraphBuilt = true;
+    if( _moduleGraph.isEmpty() ) return;
+
+    QHash<QString, ModuleTask*> writers;
+    foreach( ModuleTask* task, _moduleGraph ) {
+        task->next.clear();
+        foreach( const QString& output, task->outputs ) {
+            if( ! _namedBlobs.contains(output) )
+                throw QString("AbstractPipeline: output \"%1\" of module %2 is not "
+                        "a named blob").arg(output).arg(task->type);
+            if( writers.contains(output) )
+                throw QString("AbstractPipeline: blob \"%1\" is written by modules "
+                        "%2 and %3").arg(output).arg(writers[output]->type)
+                        .arg(task->type);
+            writers.insert(output, task);
+        }
+    }
+    foreach( ModuleTask* task, _moduleGraph ) {
+        QSet<ModuleTask*> dependencies;
+        foreach( const QString& input, task->inputs ) {
+            if( writers.contains(input) )
+                dependencies.insert(writers[input]);
+            else if( ! _namedBlobs.contains(input)
+                    && ! _requiredDataRemote.contains(input) )
+                throw QString("AbstractPipeline: input \"%1\" of module %2 is "
+                        "neither remote data nor a named blob")
+                        .arg(input).arg(task->type);
+        }
+        task->dependencies = dependencies.size();
+        foreach( ModuleTask* d, dependencies ) {
+            d->next.append(task);
+        }
+    }
+
+    // Order the modules, each after all the modules it depends on.
+    QHash<ModuleTask*, int> remaining;
+    foreach( ModuleTask* task, _moduleGraph ) {
+        remaining.insert(task, task->dependencies);
+        if( task->dependencies == 0 )
+            _moduleOrder.append(task);
+    }
+    for( int i = 0; i < _moduleOrder.size(); ++i ) {
+        foreach( ModuleTask* task, _moduleOrder[i]->next ) {
+            if( --remaining[task] == 0 )
+                _moduleOrder.append(task);
+        }
+    }
+    if( _moduleOrder.size() != _moduleGraph.size() ) {
+        QStringList cycle;
+        foreach( ModuleTask* task, _moduleGraph ) {
+            if( remaining[task] > 0 ) cycle << task->type;
+        }
+        _moduleOrder.clear();
+        _moduleGraphBuilt = false;
+        throw QString("AbstractPipeline: the modules %1 depend on each other "
+                "in a cycle").arg(cycle.join(", "));
+    }
+}
+
+/**
+ * @details
+ * Runs the modules created with inputs and outputs on the remote \p data
+ * and the named blobs. Modules are run as tasks on the pipeline driver's
+ * task scheduler, each as soon as the modules writing its inputs have
+ * finished, or in order if the pipeline has no driver. Missing optional
+ * data is passed as a null pointer.
+ *
+ * If a module throws, the modules depending on it are not run, and the
+ * error is thrown once the others have finished.
+ */
+void AbstractPipeline::runModules(QHash<QString, DataBlob*>& data)
+{
+    if( ! _moduleGraphBuilt )
+        buildModuleGraph();
+
+    foreach( ModuleTask* task, _moduleOrder ) {
+        task->inputBlobs.clear();
+        foreach( const QString& input, task->inputs ) {
+            task->inputBlobs.append( _namedBlobs.contains(input) ?
+                    _namedBlobs[input] : data.value(input) );
+        }
+        task->outputBlobs.clear();
+        foreach( const QString& output, task->outputs ) {
+            task->outputBlobs.append( _namedBlobs[output] );
+        }
+    }
+
+    TaskScheduler* scheduler = taskScheduler();
+    if( ! scheduler ) {
+        foreach( ModuleTask* task, _moduleOrder ) {
+            task->module->execute(task->inputBlobs, task->outputBlobs);
+        }
+        return;
+    }
+
+    TaskScheduler::Group group;
+    foreach( ModuleTask* task, _moduleOrder ) {
+        task->remaining.set(task->dependencies);
+        task->scheduler = scheduler;
+        task->group = &group;
+    }
+    foreach( ModuleTask* task, _moduleOrder ) {
+        if( task->dependencies == 0 )
+            scheduler->submit(task, group);
+    }
+    scheduler->wait(group);
+}
+
 const QList<DataBlob*>& AbstractPipeline::streamHistory(const QString& stream) const
 {
       return *(_streamHistory[stream]);
 }
 
+/**
+ * @details
+ * Returns the task scheduler shared by the pipelines of the driver, used
+ * to run the modules and by the modules for their own parallel loops.
+ */
+TaskScheduler* AbstractPipeline::taskScheduler() const
+{
+    return _pipelineDriver ? _pipelineDriver->taskScheduler() : 0;
+}
+
 ConfigNode AbstractPipeline::config( const QString& tag, const QString& name )
 {
      return _pipelineDriver->config( tag, name );
@@ -113,9 +323,25 @@ void AbstractPipeline::exec( QHash<QString,DataBlob*>& data )
               h.removeAll(blob); 
 #endif
               h.push_front(blob);
+              // forget blobs beyond the history asked for, as the driver
+              // may already be reusing them
+              while( (unsigned int)h.size() > qMax(1u, historySize(stream)) )
+                  h.pop_back();
           }
       }
+
+      // Trace the run from the newest data ingested by the server.
+      _trace.clear();
+      foreach( DataBlob* blob, data ) {
+          if( blob && blob->latencyTrace().time(LatencyTrace::Ingest)
+                  > _trace.time(LatencyTrace::Ingest) )
+              _trace = blob->latencyTrace();
+      }
+      _trace.stamp(LatencyTrace::ExecStart);
+      LatencyMonitor::instance()->record(_trace, LatencyTrace::ExecStart);
       run(data);
+      _trace.stamp(LatencyTrace::ExecEnd);
+      LatencyMonitor::instance()->record(_trace, LatencyTrace::ExecEnd);
 }
 
 /**
@@ -192,12 +418,28 @@ void AbstractPipeline::deactivate()
  * @details
  * Sends data to the output streams managed by the OutputStreamManger
  *
+ * For a replica (see PipelineReplicas), waits first until the replicas
+ * running on earlier data have finished.
+ *
  * @param[in] DataBlob to be sent.
  * @param[in] name of the output stream (defaults to DataBlob->type()).
  */
 void AbstractPipeline::dataOutput( const DataBlob* data, const QString& stream ) const
 {
-     _osmanager->send(data, stream);
+     if( _outputGate )
+         _outputGate->wait(_outputSequence);
+     _osmanager->send(data, stream, &_trace);
+}
+
+/**
+ * @details
+ * Sets the sequence number of the next run's output. Its calls to
+ * dataOutput() wait until \p gate has completed all the earlier numbers.
+ */
+void AbstractPipeline::setOutputOrder(SequenceGate* gate, quint64 sequence)
+{
+    _outputGate = gate;
+    _outputSequence = sequence;
 }
 
 /**
@@ -1,4 +1,5 @@
 #include "PelicanServerClient.h"
+#include "PelicanServerPrefetcher.h"
 #include "pelican/core/AbstractServiceAdapter.h"
 #include "pelican/core/AbstractStreamAdapter.h"
 #include "pelican/data/DataSpec.h"
@@ -7,6 +8,10 @@
 #include "pelican/comms/DataBlobResponse.h"
 #include "pelican/comms/StreamData.h"
 #include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ConsumerRequest.h"
+#include "pelican/comms/DataChunk.h"
 #include "pelican/comms/ServiceDataRequest.h"
 #include "pelican/comms/StreamDataResponse.h"
 #include "pelican/comms/ServiceDataResponse.h"
@@ -20,6 +25,7 @@
 #include <QtCore/QBuffer>
 #include <QtCore/QByteArray>
 #include <QtCore/QDebug>
+#include <QtCore/QThread>
 
 #include <vector>
 #include <iostream>
@@ -41,12 +47,20 @@ PelicanServerClient::PelicanServerClient(const ConfigNode& configNode,
         const DataTypes& types, const Config* config
         )
     : AbstractAdaptingDataClient(configNode, types, config)
-        , _protocol(0), _specRecieved(false)
+        , _protocol(0), _specRecieved(false), _subscribed(false), _socket(0), _prefetcher(0)
 {
     _protocol = new PelicanClientProtocol;
 
     setIP_Address(configNode.getOption("server", "host"));
     setPort(configNode.getOption("server", "port").toUInt());
+    _keepAlive = configNode.getOption("server", "keepAlive", "false").toLower() == "true";
+    _subscribe = configNode.getOption("server", "subscribe", "false").toLower() == "true";
+    _credits = configNode.getOption("server", "credits", "2").toUInt();
+    if (_credits == 0) _credits = 1;
+    _consumer = configNode.getOption("server", "consumer");
+    if (_subscribe || !_consumer.isEmpty()) _keepAlive = true;
+    _protocolVersion = configNode.getOption("server", "protocol", "3").toUShort();
+    _prefetch = configNode.getOption("server", "prefetch", "0").toInt();
 }
 
 
@@ -55,6 +69,8 @@ PelicanServerClient::PelicanServerClient(const ConfigNode& configNode,
  */
 PelicanServerClient::~PelicanServerClient()
 {
+    delete _prefetcher;
+    delete _socket;
     delete _protocol;
 }
 
@@ -84,12 +100,26 @@ AbstractDataClient::DataBlobHash PelicanServerClient::getData(DataBlobHash& data
         throw(QString("PelicanServerClient::getData() data hash does not "
                 "contain objects for all possible requests"));
 
+    // Subscriptions are served as the data is pushed by the server.
+    if (_subscribe) {
+        StreamSubscriptionRequest sub(_credits);
+        foreach(const DataSpec& d, dataRequirements())
+        {
+            sub.addDataOption( d );
+        }
+        if (sub.isEmpty())
+            throw QString("PelicanServerClient::getData(): Request for non-stream data");
+        return _nextPushed(sub, dataHash);
+    }
+
     // Construct the request
     StreamDataRequest sr;
     foreach(const DataSpec& d, dataRequirements())
     {
         sr.addDataOption( d );
     }
+    if (_prefetch > 0 && !sr.isEmpty())
+        return _nextPrefetched(sr, dataHash);
 
     DataBlobHash validData;
 
@@ -115,15 +145,65 @@ AbstractDataClient::DataBlobHash PelicanServerClient::getData(DataBlobHash& data
 AbstractDataClient::DataBlobHash PelicanServerClient::_sendRequest(
         const ServerRequest& request, DataBlobHash& dataHash)
 {
-    // Connect to the server.
+    // Connect to the server (or reuse the connection in keep-alive mode).
     DataBlobHash validData;
-    QTcpSocket sock;
+    QTcpSocket localSock;
+    QTcpSocket& sock = _keepAlive ? _connection() : localSock;
     validData = _response(sock, _sendRequest( sock, request ), dataHash);
 
     return validData;
 }
 
+/**
+ * @details
+ * Returns the socket kept open between requests in keep-alive mode.
+ */
+QTcpSocket& PelicanServerClient::_connection() const
+{
+    // A socket can only be used by the thread that created it, so open a
+    // new connection when data is fetched on another thread (e.g. by the
+    // acquisition thread of the PipelineDriver).
+    if (_socket && _socket->thread() != QThread::currentThread()) {
+        delete _socket;
+        _socket = 0;
+    }
+    if (!_socket)
+        _socket = new QTcpSocket;
+    return *_socket;
+}
+
+/**
+ * @details
+ * Sends the request, connecting first if the socket is not already
+ * connected. In keep-alive mode, if the server has closed the connection
+ * since the last request, reconnects and sends the request again.
+ */
 boost::shared_ptr<ServerResponse> PelicanServerClient::_sendRequest( QTcpSocket& sock, const ServerRequest& request ) const {
+    if (sock.state() != QAbstractSocket::ConnectedState)
+        _open(sock);
+
+    // Write the request to the open TCP socket with the PelicanClientProtocol.
+    QByteArray data = _protocol->serialise(request);
+    sock.write(data);
+    sock.flush();
+
+    // Receive the response from the server and process it.
+    // Need to supply -1 so this doesn't time out.
+    if (!sock.waitForReadyRead(-1) && _keepAlive) {
+        _open(sock);
+        sock.write(_protocol->serialise(request));
+        sock.flush();
+        sock.waitForReadyRead(-1);
+    }
+    return _protocol->receive(sock);
+}
+
+/**
+ * @details
+ * Connects the socket to the server, retrying while the server is not
+ * available.
+ */
+void PelicanServerClient::_connect( QTcpSocket& sock ) const {
     Q_ASSERT(_server != "");
     sock.connectToHost(_server, _port , QIODevice::ReadWrite);
     while(! sock.waitForConnected(-1))
@@ -138,14 +218,26 @@ boost::shared_ptr<ServerResponse> PelicanServerClient::_sendRequest( QTcpSocket&
         sleep(4); // wait before trying again
         sock.connectToHost(_server, _port , QIODevice::ReadWrite);
     }
+}
 
-    // Write the request to the open TCP socket with the PelicanClientProtocol.
-    sock.write(_protocol->serialise(request));
-    sock.flush();
-
-    // Receive the response from the server and process it.
-    sock.waitForReadyRead(-1); // Need to supply -1 so this doesn't time out.
-    return _protocol->receive(sock);
+/**
+ * @details
+ * Connects the socket to the server and, in keep-alive mode, agrees the
+ * protocol version to use on the connection. A server that does not
+ * support version negotiation is reconnected to and spoken to with
+ * version 1. The consumer name, if any, is then sent on the connection.
+ */
+void PelicanServerClient::_open( QTcpSocket& sock ) const {
+    sock.abort();
+    _connect(sock);
+    if (!_keepAlive)
+        return;
+    if (_protocol->negotiate(sock, _protocolVersion) == 0) {
+        sock.abort();
+        _connect(sock);
+    }
+    if (!_consumer.isEmpty())
+        sock.write(_protocol->serialise(ConsumerRequest(_consumer)));
 }
 
 /**
@@ -215,7 +307,10 @@ PelicanServerClient::_response(QIODevice& device, shared_ptr<ServerResponse> r,
             }
 
             // Retrieve the stream data.
-            if(req.isEmpty()) {
+            // On a kept-alive connection the data is always read out in
+            // full first, so that an adapter that stops short can not
+            // leave bytes in the socket for the next response.
+            if(req.isEmpty() && !_keepAlive) {
                 // If there is no service data to fetch so we can adapt the
                 // stream data immediately.
                 validData.unite(_adaptStream(device, sd, dataHash));
@@ -228,31 +323,12 @@ PelicanServerClient::_response(QIODevice& device, shared_ptr<ServerResponse> r,
 
                 // Read the stream data out of the QIOdevice into a temporary buffer.
                 std::vector<char> tmp(sd->size());
-                int timeout = 2000;
-                int bytesRead = 0;
-                unsigned long bytesReadTotal = 0;
-
-                while(bytesReadTotal != sd->size())
-                {
-                    while (device.bytesAvailable() < 1) {
-                        if (!device.waitForReadyRead(timeout)) {
-                            log(QString("PelicanServerClient: Timed out"
-                                    " from server.") + device.errorString());
-                            return validData;
-                        }
-                    }
-                    bytesRead = device.read(&tmp[0 + bytesReadTotal], sd->size());
-                    if(bytesRead == -1) {
-                        log(QString("PelicanServerClient: Problem reading "
-                                "from server.") + device.errorString());
-                        return validData;
-                    }
-                    bytesReadTotal += bytesRead;
-                }
-                Q_ASSERT(tmp.size() == sd->size());
+                if (!_read(device, &tmp[0], sd->size()))
+                    return validData;
 
                 // Fetch the service data.
-                validData.unite(_getServiceData(req, dataHash));
+                if (!req.isEmpty())
+                    validData.unite(_getServiceData(req, dataHash));
 
                 // Now we can adapt the stream data.
                 QByteArray tmp_array = QByteArray::fromRawData(&tmp[0], tmp.size());
@@ -309,6 +385,188 @@ PelicanServerClient::_response(QIODevice& device, shared_ptr<ServerResponse> r,
 }
 
 
+/**
+ * @details
+ * Takes the next chunk from the prefetch thread (starting it on the first
+ * call). If the server reported an error the prefetcher is discarded, so
+ * that the next call starts again, and the error is thrown.
+ */
+AbstractDataClient::DataBlobHash PelicanServerClient::_nextPrefetched(
+        const StreamDataRequest& request, DataBlobHash& dataHash)
+{
+    if (!_prefetcher) {
+        _prefetcher = new PelicanServerPrefetcher(_server, _port, request,
+                _prefetch, _keepAlive, _protocolVersion);
+        _prefetcher->setConsumer(_consumer);
+        _prefetcher->start();
+    }
+    PelicanServerPrefetcher::Chunk chunk = _prefetcher->next();
+    if (!chunk.error.isEmpty()) {
+        delete _prefetcher;
+        _prefetcher = 0;
+        std::cerr << chunk.error.toStdString() << std::endl;
+        throw chunk.error;
+    }
+    return _adaptFetched(chunk.streamData(), chunk.data, chunk.serviceData,
+            dataHash);
+}
+
+
+/**
+ * @details
+ * Adapts stream data that has already been read into memory, first
+ * adapting any of its service data that has changed version from the
+ * contents given.
+ */
+AbstractDataClient::DataBlobHash PelicanServerClient::_adaptFetched(
+        const StreamData* sd, QByteArray& data,
+        const QHash<QString, QPair<QString, QByteArray> >& serviceData,
+        DataBlobHash& dataHash)
+{
+    DataBlobHash validData;
+    foreach (const shared_ptr<DataChunk>& d, sd->associateData())
+    {
+        if( dataHash[d->name()]->version() != d->id()) {
+            QPair<QString, QByteArray> service = serviceData.value(d->name());
+            if (service.first != d->id())
+                throw QString("PelicanServerClient: Service data %1 %2"
+                        " not received from the server").arg(d->name()).arg(d->id());
+            DataChunk chunk(d->name(), service.second.data(),
+                    service.second.size());
+            chunk.setId(d->id());
+            QBuffer buf(&service.second);
+            buf.open(QIODevice::ReadOnly);
+            validData.unite(adaptService(buf, &chunk, dataHash));
+        }
+        validData[d->name()] = dataHash[d->name()];
+    }
+
+    QBuffer buf(&data);
+    buf.open(QIODevice::ReadOnly);
+    validData.unite(_adaptStream(buf, sd, dataHash));
+    return validData;
+}
+
+
+/**
+ * @details
+ * Reads the given number of bytes from the device, waiting up to 2 seconds
+ * at a time for them to arrive. Returns false (after logging the problem)
+ * if they do not.
+ */
+bool PelicanServerClient::_read(QIODevice& device, char* buffer, qint64 size)
+{
+    int timeout = 2000;
+    qint64 bytesReadTotal = 0;
+    while (bytesReadTotal != size)
+    {
+        while (device.bytesAvailable() < 1) {
+            if (!device.waitForReadyRead(timeout)) {
+                log(QString("PelicanServerClient: Timed out"
+                        " from server.") + device.errorString());
+                return false;
+            }
+        }
+        qint64 bytesRead = device.read(buffer + bytesReadTotal,
+                size - bytesReadTotal);
+        if (bytesRead == -1) {
+            log(QString("PelicanServerClient: Problem reading "
+                    "from server.") + device.errorString());
+            return false;
+        }
+        bytesReadTotal += bytesRead;
+    }
+    return true;
+}
+
+
+/**
+ * @details
+ * Connects (if necessary) and sends the subscription. Service data
+ * pushed on an earlier connection will be sent again, so is forgotten.
+ */
+void PelicanServerClient::_sendSubscription(QTcpSocket& sock,
+        const StreamSubscriptionRequest& request)
+{
+    if (sock.state() != QAbstractSocket::ConnectedState)
+        _open(sock);
+    _serviceCache.clear();
+    sock.write(_protocol->serialise(request));
+    sock.flush();
+    _subscribed = true;
+}
+
+
+/**
+ * @details
+ * Subscribes on the first call, then waits for the next chunk pushed by
+ * the server. Service data pushed ahead of it is kept until a chunk
+ * refers to it. Once the chunk has been read from the socket the server is
+ * granted another credit, so that it can send the next one while this one
+ * is adapted. If the connection is lost the subscription is renewed.
+ */
+AbstractDataClient::DataBlobHash PelicanServerClient::_nextPushed(
+        const StreamSubscriptionRequest& request, DataBlobHash& dataHash)
+{
+    QTcpSocket& sock = _connection();
+    if (!_subscribed || sock.state() != QAbstractSocket::ConnectedState)
+        _sendSubscription(sock, request);
+
+    forever {
+        while (sock.bytesAvailable() < (qint64)sizeof(quint16)) {
+            if (!sock.waitForReadyRead(-1)
+                    && sock.state() != QAbstractSocket::ConnectedState)
+                _sendSubscription(sock, request);
+        }
+        boost::shared_ptr<ServerResponse> r = _protocol->receive(sock);
+        switch (r->type())
+        {
+            case ServerResponse::ServiceData:
+            {
+                ServiceDataResponse* res = static_cast<ServiceDataResponse*>(r.get());
+                foreach (const DataChunk* d, res->data())
+                {
+                    QByteArray bytes(d->size(), 0);
+                    if (d->size() > 0 && !_read(sock, bytes.data(), d->size())) {
+                        sock.abort(); // Resubscribe.
+                        break;
+                    }
+                    _serviceCache.insert(d->name(), qMakePair(d->id(), bytes));
+                }
+                break;
+            }
+
+            case ServerResponse::StreamData:
+            {
+                StreamDataResponse* resp = static_cast<StreamDataResponse*>(r.get());
+                StreamData* sd = resp->streamData();
+                Q_ASSERT(sd != 0);
+                QByteArray data(sd->size(), 0);
+                if (sd->size() > 0 && !_read(sock, data.data(), sd->size())) {
+                    sock.abort(); // Resubscribe.
+                    break;
+                }
+                sock.write(_protocol->serialise(CreditRequest(1)));
+                sock.flush();
+                return _adaptFetched(sd, data, _serviceCache, dataHash);
+            }
+
+            case ServerResponse::Error:
+            {
+                QString msg = "PelicanServerClient: Server Error: " + r->message();
+                std::cerr << msg.toStdString() << std::endl;
+                _subscribed = false;
+                throw( msg );
+            }
+
+            default:
+                std::cerr << "PelicanServerClient: Unknown Response" << std::endl;
+                break;
+        }
+    }
+}
+
+
 AbstractDataClient::DataBlobHash PelicanServerClient::_getServiceData(
         const ServiceDataRequest& request, DataBlobHash& dataHash)
 {
@@ -325,9 +583,22 @@ AbstractDataClient::DataBlobHash PelicanServerClient::_adaptStream(
 const DataSpec& PelicanServerClient::dataSpec() const {
     if( ! _specRecieved ) {
         // send a request to the server for the types of data
+        // A subscribed connection carries pushed data, so is not used.
         DataSupportRequest request;
-        QTcpSocket sock;
-        boost::shared_ptr<ServerResponse> r = _sendRequest( sock, request );
+        boost::shared_ptr<ServerResponse> r;
+        if (_keepAlive && !_subscribe) {
+            r = _sendRequest( _connection(), request );
+        }
+        else {
+            // Use version 1 on the short-lived connection.
+            PelicanClientProtocol protocol;
+            QTcpSocket sock;
+            _connect(sock);
+            sock.write(protocol.serialise(request));
+            sock.flush();
+            sock.waitForReadyRead(-1);
+            r = protocol.receive(sock);
+        }
         Q_ASSERT( r->type() == ServerResponse::DataSupport);
         DataSupportResponse* res = static_cast<DataSupportResponse*>(r.get());
         _dataSpec.clear();
@@ -0,0 +1,256 @@
+#include "PelicanServerPrefetcher.h"
+#include "pelican/comms/PelicanClientProtocol.h"
+#include "pelican/comms/ServerResponse.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/StreamDataResponse.h"
+#include "pelican/comms/ServiceDataRequest.h"
+#include "pelican/comms/ServiceDataResponse.h"
+#include "pelican/comms/DataChunk.h"
+#include "pelican/comms/ConsumerRequest.h"
+
+#include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QAbstractSocket>
+#include <QtCore/QMutexLocker>
+
+namespace pelican {
+
+/**
+ * @details
+ * Returns the description of the stream data held in the chunk.
+ */
+StreamData* PelicanServerPrefetcher::Chunk::streamData() const
+{
+    return static_cast<StreamDataResponse*>(response.get())->streamData();
+}
+
+
+/**
+ * @details
+ * Constructs the prefetcher for the given server and request.
+ *
+ * @param host      The Pelican server host.
+ * @param port      The Pelican server port.
+ * @param request   The stream data request to send to the server.
+ * @param depth     The maximum number of chunks to hold.
+ * @param keepAlive Reuse a single connection (requires a keep-alive server).
+ * @param protocolVersion The protocol version to ask for on a kept-alive
+ *                  connection.
+ */
+PelicanServerPrefetcher::PelicanServerPrefetcher(const QString& host,
+        quint16 port, const StreamDataRequest& request, int depth,
+        bool keepAlive, quint16 protocolVersion, QObject* parent)
+    : QThread(parent), _host(host), _port(port), _request(request),
+      _depth(depth), _keepAlive(keepAlive), _version(protocolVersion),
+      _stopping(false)
+{
+    if (_depth < 1) _depth = 1;
+    _protocol = new PelicanClientProtocol;
+}
+
+
+/**
+ * @details
+ * Stops the fetch thread, discarding any data fetched.
+ */
+PelicanServerPrefetcher::~PelicanServerPrefetcher()
+{
+    _stopping = true;
+    {
+        QMutexLocker locker(&_mutex);
+        _notFull.wakeAll();
+    }
+    wait();
+    delete _protocol;
+}
+
+
+/**
+ * @details
+ * Blocks until a chunk is available. A chunk with an error message set
+ * reports a server error in place of the data.
+ */
+PelicanServerPrefetcher::Chunk PelicanServerPrefetcher::next()
+{
+    QMutexLocker locker(&_mutex);
+    while (_queue.isEmpty())
+        _notEmpty.wait(&_mutex);
+    Chunk chunk = _queue.dequeue();
+    _notFull.wakeOne();
+    return chunk;
+}
+
+
+int PelicanServerPrefetcher::available()
+{
+    QMutexLocker locker(&_mutex);
+    return _queue.size();
+}
+
+
+/**
+ * @details
+ * Fetches chunks while there is room for them in the queue.
+ */
+void PelicanServerPrefetcher::run()
+{
+    QTcpSocket sock;
+    while (!_stopping) {
+        Chunk chunk;
+        try {
+            if (!_fetch(sock, chunk))
+                continue;
+        }
+        catch (const QString& e) {
+            chunk.error = e;
+        }
+
+        QMutexLocker locker(&_mutex);
+        while (_queue.size() >= _depth && !_stopping)
+            _notFull.wait(&_mutex);
+        if (_stopping) break;
+        _queue.enqueue(chunk);
+        _notEmpty.wakeOne();
+        if (!chunk.error.isEmpty()) break;
+    }
+    sock.abort();
+}
+
+
+/**
+ * @details
+ * Fetches the next chunk of stream data and its service data, requesting
+ * only the service data that has changed version since it was last
+ * fetched. Returns false if the fetch was interrupted (by the connection
+ * closing or the prefetcher stopping) and should be tried again.
+ */
+bool PelicanServerPrefetcher::_fetch(QTcpSocket& sock, Chunk& chunk)
+{
+    boost::shared_ptr<ServerResponse> r = _send(sock, _request);
+    if (!r) return false;
+    if (r->type() == ServerResponse::Error)
+        throw QString("PelicanServerClient: Server Error: ") + r->message();
+    if (r->type() != ServerResponse::StreamData)
+        throw QString("PelicanServerClient: Unexpected response to a StreamData request");
+
+    StreamData* sd = static_cast<StreamDataResponse*>(r.get())->streamData();
+    Q_ASSERT(sd != 0);
+    chunk.data.resize(sd->size());
+    if (!_read(sock, chunk.data.data(), sd->size()))
+        return false;
+
+    // Fetch any service data that has changed.
+    ServiceDataRequest req;
+    foreach (const boost::shared_ptr<DataChunk>& d, sd->associateData()) {
+        if (_serviceCache.value(d->name()).first != d->id())
+            req.request(d->name(), d->id());
+    }
+    if (!req.isEmpty()) {
+        boost::shared_ptr<ServerResponse> s = _send(sock, req);
+        if (!s) return false;
+        if (s->type() == ServerResponse::Error)
+            throw QString("PelicanServerClient: Server Error: ") + s->message();
+        if (s->type() != ServerResponse::ServiceData)
+            throw QString("PelicanServerClient: Unexpected response to a ServiceData request");
+        foreach (const DataChunk* d, static_cast<ServiceDataResponse*>(s.get())->data()) {
+            QByteArray bytes(d->size(), 0);
+            if (!_read(sock, bytes.data(), d->size()))
+                return false;
+            _serviceCache.insert(d->name(), qMakePair(d->id(), bytes));
+        }
+    }
+
+    foreach (const boost::shared_ptr<DataChunk>& d, sd->associateData()) {
+        chunk.serviceData.insert(d->name(), _serviceCache.value(d->name()));
+    }
+    chunk.response = r;
+    return true;
+}
+
+
+/**
+ * @details
+ * Sends the request and waits for the response header. Returns a null
+ * pointer if the connection is lost or the prefetcher is stopped first.
+ */
+boost::shared_ptr<ServerResponse> PelicanServerPrefetcher::_send(
+        QTcpSocket& sock, const ServerRequest& request)
+{
+    boost::shared_ptr<ServerResponse> r;
+    if (!_keepAlive || sock.state() != QAbstractSocket::ConnectedState) {
+        sock.abort();
+        if (!_connect(sock)) return r;
+    }
+    sock.write(_protocol->serialise(request));
+    sock.flush();
+    while (sock.bytesAvailable() == 0) {
+        if (_stopping) return r;
+        if (!sock.waitForReadyRead(100)
+                && sock.state() != QAbstractSocket::ConnectedState)
+            return r;
+    }
+    return _protocol->receive(sock);
+}
+
+
+/**
+ * @details
+ * Connects to the server, retrying while it is not available, and agrees
+ * the protocol version to use on a kept-alive connection. If the server
+ * does not support version negotiation, reconnects and uses version 1.
+ * The consumer name, if any, is then sent on the new connection.
+ * Returns false if the prefetcher is stopped first.
+ */
+bool PelicanServerPrefetcher::_connect(QTcpSocket& sock)
+{
+    forever {
+        sock.connectToHost(_host, _port, QIODevice::ReadWrite);
+        if (sock.waitForConnected(2000)) {
+            if (_keepAlive && _protocol->negotiate(sock, _version) == 0) {
+                _version = 1;
+                sock.abort();
+                continue;
+            }
+            if (!_consumer.isEmpty())
+                sock.write(_protocol->serialise(ConsumerRequest(_consumer)));
+            return true;
+        }
+        QAbstractSocket::SocketError e = sock.error();
+        if( e != QAbstractSocket::ConnectionRefusedError
+         && e != QAbstractSocket::RemoteHostClosedError
+         && e != QAbstractSocket::NetworkError
+         && e != QAbstractSocket::SocketTimeoutError ) {
+            throw(QString("PelicanServerClient: unable to connect to host ") + _host
+                + QString(" port %1").arg(_port) + " : " + sock.errorString() );
+        }
+        sock.abort();
+        // Wait before trying again.
+        for (int i = 0; i < 40 && !_stopping; ++i) msleep(100);
+        if (_stopping) return false;
+    }
+}
+
+
+/**
+ * @details
+ * Reads the given number of bytes from the socket. Returns false if the
+ * connection is lost or the prefetcher is stopped first.
+ */
+bool PelicanServerPrefetcher::_read(QTcpSocket& sock, char* buffer, qint64 size)
+{
+    qint64 total = 0;
+    while (total < size) {
+        if (sock.bytesAvailable() == 0) {
+            if (_stopping) return false;
+            if (!sock.waitForReadyRead(100)
+                    && sock.state() != QAbstractSocket::ConnectedState)
+                return false;
+            continue;
+        }
+        qint64 n = sock.read(buffer + total, size - total);
+        if (n < 0) return false;
+        total += n;
+    }
+    return true;
+}
+
+} // namespace pelican
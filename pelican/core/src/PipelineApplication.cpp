@@ -8,6 +8,8 @@
 #include "boost/program_options.hpp"
 #include "pelican/utility/Config.h"
 #include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/TaskScheduler.h"
+#include "pelican/utility/ThreadPlacement.h"
 #include "pelican/output/OutputStreamManager.h"
 #include <string>
 #include <csignal>
@@ -51,6 +53,7 @@ void PipelineApplication::_init()
      _adapterFactory = 0;
      _clientFactory = 0;
      _moduleFactory = 0;
+     _taskScheduler = 0;
 
     // Check for QCoreApplication
     if (QCoreApplication::instance() == NULL)
@@ -71,9 +74,21 @@ void PipelineApplication::_init()
             adapterFactory() );
     _moduleFactory = new FactoryConfig<AbstractModule>(config(), "pipeline", "modules", false);
 
+    // Read the placement of the output threads (see ThreadPlacement).
+    ThreadPlacement::configure(_config.get(pipelineConfig));
+
+    // Construct the task scheduler shared by the pipelines and modules.
+    Config::TreeAddress schedulerConfig( pipelineConfig );
+    schedulerConfig << Config::NodeId("scheduler", "");
+    ConfigNode scheduler = _config.get(schedulerConfig);
+    _taskScheduler = new TaskScheduler(
+            scheduler.getAttribute("threads").toInt(),
+            TaskScheduler::parseCpus(scheduler.getAttribute("cpus")) );
+
     // Construct the pipeline driver.
     _driver = new PipelineDriver( dataBlobFactory(), _moduleFactory, _clientFactory, 
                                   outputStreamManager(), &_config, pipelineConfig );
+    _driver->setTaskScheduler(_taskScheduler);
     _allDrivers.append(_driver);
 
     // install signal handlers
@@ -101,6 +116,7 @@ PipelineApplication::~PipelineApplication()
     _driver->stop();
     _allDrivers.removeAll(_driver);
     delete _driver;
+    delete _taskScheduler;
     delete _adapterFactory;
     delete _clientFactory;
     delete _moduleFactory;
@@ -174,6 +190,11 @@ void PipelineApplication::addPipelineSwitcher(const PipelineSwitcher& switcher)
     _driver->addPipelineSwitcher(switcher);
 }
 
+void PipelineApplication::addPipelineReplicas(const PipelineReplicas& replicas)
+{
+    _driver->addPipelineReplicas(replicas);
+}
+
 /**
  * @details
  * Sets (and creates) the given data client based on the named argument.
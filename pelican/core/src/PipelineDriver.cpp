@@ -8,16 +8,92 @@
 #include "pelican/data/DataBlobBuffer.h"
 #include "pelican/utility/Config.h"
 #include "pelican/utility/ConfigNode.h"
+#include "pelican/core/PipelineReplicas.h"
 #include "pelican/core/PipelineSwitcher.h"
+#include "pelican/utility/LatencyMonitor.h"
+#include "pelican/utility/SequenceGate.h"
+#include "pelican/utility/BufferMemory.h"
+#include "pelican/utility/TaskScheduler.h"
 
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
 #include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 #include <QtCore/QtGlobal>
 #include <QtCore/QtDebug>
+#include <QtCore/QTime>
 #include <iostream>
 
 
 namespace pelican {
 
+/**
+ * @details
+ * Runs a pipeline on the thread pool of the driver, telling the driver
+ * when it has finished.
+ */
+class PipelineDriver::PipelineTask : public QRunnable
+{
+    public:
+        PipelineTask(PipelineDriver* driver, AbstractPipeline* pipeline,
+                const QHash<QString, DataBlob*>& data,
+                const QList<DataBlob*>& blobs)
+            : _driver(driver), _pipeline(pipeline), _data(data), _blobs(blobs) {}
+
+        void run()
+        {
+            QString error;
+            try {
+                _pipeline->exec(_data);
+            }
+            catch (const QString& e) {
+                error = e;
+            }
+            catch (...) {
+                error = "PipelineDriver: unknown exception thrown by a pipeline";
+            }
+            _driver->_pipelineDone(_pipeline, _blobs, error);
+        }
+
+    private:
+        PipelineDriver* _driver;
+        AbstractPipeline* _pipeline;
+        QHash<QString, DataBlob*> _data;
+        QList<DataBlob*> _blobs;
+};
+
+/**
+ * @details
+ * Fetches data from the data client ahead of the pipelines.
+ */
+class PipelineDriver::Acquirer : public QThread
+{
+    public:
+        Acquirer(PipelineDriver* driver) : _driver(driver) {}
+
+    protected:
+        void run()
+        {
+            while( _driver->_acquire() ) {}
+        }
+
+    private:
+        PipelineDriver* _driver;
+};
+
+/**
+ * @details
+ * Replicas of a pipeline, given data in turn.
+ */
+struct PipelineDriver::ReplicaSet
+{
+    QList<AbstractPipeline*> pipelines;
+    int next;               ///< The replica to run on the next data.
+    quint64 sequence;       ///< The number of the next run.
+    SequenceGate gate;      ///< Orders the output of the runs.
+};
+
 /**
  * @details
  * PipelineDriver constructor, which takes pointers to the allocated factories.
@@ -41,6 +117,25 @@ PipelineDriver::PipelineDriver(FactoryGeneric<DataBlob>* blobFactory,
     Q_ASSERT(_blobFactory != 0 );
     Q_ASSERT(_moduleFactory != 0 );
     Q_ASSERT(_clientFactory != 0 );
+
+    // Run the pipelines on a pool of threads, if asked to.
+    // (The config argument hides the config() member, hence this->.)
+    ConfigNode driver = this->config("driver");
+    _pool = 0;
+    int threads = driver.getAttribute("threads").toInt();
+    if( threads > 1 ) {
+        _pool = new QThreadPool;
+        _pool->setMaxThreadCount(threads);
+    }
+    _latencyReport = this->config("latency").getAttribute("report").toInt();
+
+    // Fetch data on a separate thread, if asked to.
+    _acquirer = 0;
+    _acquiring = false;
+    _acquireQueue = driver.getAttribute("acquireQueue").toInt();
+
+    _taskScheduler = 0;
+    _ownsTaskScheduler = false;
 }
 
 /**
@@ -49,6 +144,14 @@ PipelineDriver::PipelineDriver(FactoryGeneric<DataBlob>* blobFactory,
  */
 PipelineDriver::~PipelineDriver()
 {
+    // Let any running pipelines finish.
+    _stopAcquisition();
+    delete _acquirer;
+    if( _pool ) {
+        _pool->waitForDone();
+        delete _pool;
+    }
+
     // Delete the pipelines.
     foreach (AbstractPipeline* pipeline, _registeredPipelines) {
         delete pipeline;
@@ -58,6 +161,9 @@ PipelineDriver::~PipelineDriver()
         delete buffer;
     }
     _dataBuffers.clear();
+    qDeleteAll(_replicaSets);
+    if( _ownsTaskScheduler )
+        delete _taskScheduler;
 }
 
 /**
@@ -94,6 +200,7 @@ void PipelineDriver::_registerPipeline(AbstractPipeline *pipeline)
     // determine any pipeline configuration
     
     pipeline->init();
+    pipeline->buildModuleGraph();
 
     // Store the remote data requirements.
     _allDataReq.append(pipeline->dataRequirements());
@@ -106,6 +213,35 @@ ConfigNode PipelineDriver::config( const QString& tag, const QString& name ) con
     return _config->get(address);
 }
 
+/**
+ * @details
+ * Returns the task scheduler shared by the pipelines. If none has been
+ * set, one with a thread per core is started the first time it is needed.
+ */
+TaskScheduler* PipelineDriver::taskScheduler()
+{
+    QMutexLocker locker(&_mutex);
+    if( ! _taskScheduler ) {
+        _taskScheduler = new TaskScheduler;
+        _ownsTaskScheduler = true;
+    }
+    return _taskScheduler;
+}
+
+/**
+ * @details
+ * Sets the task scheduler shared by the pipelines, which must outlive the
+ * driver. This must be called before the pipelines are run.
+ */
+void PipelineDriver::setTaskScheduler(TaskScheduler* scheduler)
+{
+    QMutexLocker locker(&_mutex);
+    if( _ownsTaskScheduler )
+        delete _taskScheduler;
+    _taskScheduler = scheduler;
+    _ownsTaskScheduler = false;
+}
+
 void PipelineDriver::_activatePipeline(AbstractPipeline *pipeline) {
     _activePipelines.append(pipeline);
 }
@@ -124,14 +260,20 @@ void PipelineDriver::_activatePipelineBuffers(AbstractPipeline *pipeline)
         }
         foreach( const QString& type, _dataSpecs[pipeline].allData() ) {
             // add history requirements
-            _history[type].add( pipeline->historySize(type) );
+            _history[type].add( _historySize(pipeline, type) );
             // create a history buffer for each type
             if( ! _dataBuffers.contains(type) ) {
-                // ensure buffer exists
-                _dataBuffers.insert(type, new DataBlobBuffer );
+                // ensure buffer exists, allocating as configured
+                DataBlobBuffer* buffer = new DataBlobBuffer;
+                buffer->setMemory(BufferMemory(config("buffers"), type));
+                _dataBuffers.insert(type, buffer);
                 _dataHash.insert(type,NULL);
             }
             unsigned int max=_history[type].max();
+            // keep spare blobs for the client to fill while the
+            // pipelines run on the latest data
+            if( _acquireQueue > 0 ) max += _acquireQueue + 1;
+            else if( _pool ) ++max;
             if( max > (unsigned int)_dataBuffers[type]->size() ) { // scale up to required size
                 for(unsigned int i=_dataBuffers[type]->size(); i<max; ++i ) {
                     _dataBuffers[type]->addDataBlob(_blobFactory->create(type));
@@ -150,7 +292,11 @@ void PipelineDriver::deactivatePipeline(AbstractPipeline *pipeline)
 {
     if( pipeline ) {
         // queue the pipeline to be deactivated when it is safe to do so
-        _deactivateQueue.append(pipeline);
+        // (with all its replicas)
+        pipeline = _lead(pipeline);
+        QMutexLocker locker(&_mutex);
+        if( ! _deactivateQueue.contains(pipeline) )
+            _deactivateQueue.append(pipeline);
     }
 }
 
@@ -165,7 +311,7 @@ void PipelineDriver::_deactivatePipeline(AbstractPipeline *pipeline)
          // adjust history buffers
          foreach ( const QString& type, reqs.allData() ) {
               if( _history.contains(type) ) {
-                 _history[type].remove( pipeline->historySize(type) );
+                 _history[type].remove( _historySize(pipeline, type) );
                 if( _history[type].isEmpty() || _history[type].max() == 0 ) {
                     // remove the buffer completely when no longer needed
                     delete _dataBuffers[type];
@@ -209,6 +355,102 @@ void PipelineDriver::addPipelineSwitcher(const PipelineSwitcher& switcher)
      _activatePipeline(next);
 }
 
+/**
+ * @details
+ * Registers the replicas, which must have the same data requirements.
+ * Only the first is activated: when data is compatible with it, the next
+ * replica in turn is run on it. Deactivating any replica deactivates them
+ * all.
+ */
+void PipelineDriver::addPipelineReplicas(const PipelineReplicas& replicas)
+{
+    const QList<AbstractPipeline*>& pipes = replicas.pipelines();
+    if( pipes.isEmpty() )
+        throw QString("PipelineDriver: No pipelines in the replicas");
+    foreach( AbstractPipeline* pipe, pipes ) {
+        _registerPipeline(pipe);
+        if( pipe->dataRequirements() != pipes[0]->dataRequirements() )
+            throw( QString("PipelineDriver: Replicas with different Data requirements"
+                           " are not supported") );
+    }
+    // The replicas share the data, so only the first counts when checking
+    // that pipelines do not require the same data.
+    for( int i = 1; i < pipes.size(); ++i ) {
+        _allDataReq.removeLast();
+    }
+
+    ReplicaSet* set = new ReplicaSet;
+    set->pipelines = pipes;
+    set->next = 0;
+    set->sequence = 0;
+    _replicaSets.append(set);
+    foreach( AbstractPipeline* pipe, pipes ) {
+        _replicaMap.insert(pipe, set);
+    }
+    _activatePipeline(pipes[0]);
+}
+
+/**
+ * @details
+ * Returns the replica of the pipeline to run on the next data, or the
+ * pipeline itself if it has no replicas.
+ */
+AbstractPipeline* PipelineDriver::_nextReplica(AbstractPipeline* pipeline)
+{
+    ReplicaSet* set = _replicaMap.value(pipeline);
+    if( ! set ) return pipeline;
+    AbstractPipeline* replica = set->pipelines[set->next];
+    set->next = (set->next + 1) % set->pipelines.size();
+    return replica;
+}
+
+/**
+ * @details
+ * Returns the first of the replicas of the pipeline, which stands for them
+ * all in the active pipelines, or the pipeline itself if it has none.
+ */
+AbstractPipeline* PipelineDriver::_lead(AbstractPipeline* pipeline) const
+{
+    ReplicaSet* set = _replicaMap.value(pipeline);
+    return set ? set->pipelines.first() : pipeline;
+}
+
+/**
+ * @details
+ * Returns the number of blobs of the type that the pipeline, and all its
+ * replicas, can hold in their history.
+ */
+unsigned int PipelineDriver::_historySize(AbstractPipeline* pipeline,
+        const QString& type) const
+{
+    ReplicaSet* set = _replicaMap.value(pipeline);
+    return pipeline->historySize(type) * (set ? set->pipelines.size() : 1);
+}
+
+/**
+ * @details
+ * Gives the run of a replica the next sequence number, so that its output
+ * waits for the replicas running on earlier data.
+ */
+void PipelineDriver::_beginRun(AbstractPipeline* pipeline)
+{
+    ReplicaSet* set = _replicaMap.value(pipeline);
+    if( set )
+        pipeline->setOutputOrder(&set->gate, set->sequence++);
+}
+
+/**
+ * @details
+ * Marks the run of a replica as finished, letting the output of later
+ * runs through.
+ */
+void PipelineDriver::_endRun(AbstractPipeline* pipeline)
+{
+    ReplicaSet* set = _replicaMap.value(pipeline);
+    if( set )
+        set->gate.complete(pipeline->outputSequence());
+}
+
 /**
  * @details
  * Sets the given data client based on the named argument.
@@ -232,6 +474,22 @@ void PipelineDriver::setDataClient( AbstractDataClient* client ) {
  * starts the data flow through the pipelines.
  *
  * This public method is called by PipelineApplication start().
+ *
+ * With \verbatim <latency report="10"/> \endverbatim in the pipeline
+ * configuration, the latency of each stage of each stream (see
+ * LatencyMonitor) is printed every 10 seconds.
+ *
+ * With \verbatim <driver threads="4"/> \endverbatim the pipelines are run
+ * on a pool of threads (see _dispatchPipeline()). Before the client fills
+ * the next data blobs, the driver waits for any running pipeline that is
+ * still using them to finish. Pipelines are deactivated, and start()
+ * returns, only once all the running pipelines have finished.
+ *
+ * With \verbatim <driver acquireQueue="2"/> \endverbatim the data is
+ * fetched (and adapted) by the client on a separate thread, which fills up
+ * to that many sets of data blobs ahead of the pipelines. Before
+ * pipelines are deactivated the data already fetched is run through the
+ * other pipelines, and when the driver stops it is discarded.
  */
 void PipelineDriver::start()
 {
@@ -251,19 +509,39 @@ void PipelineDriver::start()
 
     // prepare the dataclient
     _dataClient->reset( _dataSpecs.values() );
+    _startAcquisition();
+
+    // Report the latency histograms every so many seconds, if asked to.
+    QTime reportTimer;
+    reportTimer.start();
 
     // Enter main program loop.
     _run = true;
     QString lastError;
     while (_run) {
-        // Get the data from the client.
-        QHash<QString, DataBlob*> validData;
-        foreach( const QString& type, _dataHash.keys() ) {
-            _dataHash[type]=_dataBuffers[type]->next();
+        if (_latencyReport > 0 && reportTimer.elapsed() >= _latencyReport * 1000) {
+            std::cout << LatencyMonitor::instance()->report().toStdString();
+            reportTimer.restart();
         }
+
+        // Get the data from the client, or from the acquisition thread.
+        QHash<QString, DataBlob*> validData;
         try {
-            if (_dataClient) {
-                validData = _dataClient->getData(_dataHash);
+            if( _acquirer ) {
+                validData = _takeData();
+            }
+            else {
+                foreach( const QString& type, _dataHash.keys() ) {
+                    _dataHash[type]=_dataBuffers[type]->next();
+                }
+                if( _pool ) {
+                    // don't fill blobs that a running pipeline is still using
+                    QMutexLocker locker(&_mutex);
+                    _waitForBlobs(_dataHash.values());
+                }
+                if (_dataClient) {
+                    validData = _dataClient->getData(_dataHash);
+                }
             }
         }
         catch(const QString& e)
@@ -281,18 +559,39 @@ void PipelineDriver::start()
         foreach(AbstractPipeline* p, _activePipelines ) {
             if( _dataSpecs[p].isCompatible(validData) ) {
                 ranPipeline = true;
-                p->exec(_dataHash);
+                AbstractPipeline* replica = _nextReplica(p);
+                if( _pool ) {
+                    _dispatchPipeline(replica);
+                }
+                else if( ! _deactivateQueue.contains(p) ) {
+                    _beginRun(replica);
+                    replica->exec(_dataHash);
+                    _endRun(replica);
+                }
             }
         }
 
-        // deactivate any pipelines
-        while( _deactivateQueue.size() > 0 ) {
-             _deactivatePipeline(_deactivateQueue[0]);
-             _deactivateQueue.pop_front();
+        // deactivate any pipelines, once none are running and the data
+        // already acquired for them has been used
+        _mutex.lock();
+        bool deactivate = _deactivateQueue.size() > 0;
+        _mutex.unlock();
+        if( deactivate ) {
+            _stopAcquisition();
+            if( _acquired.isEmpty() ) {
+                _waitForPipelines();
+                while( _deactivateQueue.size() > 0 ) {
+                     _deactivatePipeline(_deactivateQueue[0]);
+                     _deactivateQueue.pop_front();
+                }
+                _startAcquisition();
+            }
         }
 
         // Check if no pipelines were run.
         if (!ranPipeline) {
+            _stopAcquisition();
+            _waitForPipelines();
             QString msg;
             foreach( const QString& d, validData.keys() ) {
                 msg += " " + d;
@@ -301,6 +600,210 @@ void PipelineDriver::start()
                                 + msg );
         }
     }
+    _stopAcquisition();
+    _acquired.clear();
+    _waitForPipelines();
+}
+
+/**
+ * @details
+ * Starts the acquisition thread, if the driver is configured to fetch
+ * data ahead of the pipelines.
+ */
+void PipelineDriver::_startAcquisition()
+{
+    if( _acquireQueue <= 0 ) return;
+    if( ! _acquirer )
+        _acquirer = new Acquirer(this);
+    _mutex.lock();
+    _acquiring = true;
+    _mutex.unlock();
+    _acquirer->start();
+}
+
+/**
+ * @details
+ * Stops the acquisition thread, waiting for it to finish the data it is
+ * fetching. Any data already acquired stays queued for _takeData().
+ */
+void PipelineDriver::_stopAcquisition()
+{
+    if( ! _acquirer ) return;
+    _mutex.lock();
+    _acquiring = false;
+    _acquiredTaken.wakeAll();
+    _mutex.unlock();
+    _acquirer->wait();
+}
+
+/**
+ * @details
+ * Fetches the next set of data on the acquisition thread, once there is
+ * room for it in the queue. Returns false if the acquisition has been
+ * stopped.
+ */
+bool PipelineDriver::_acquire()
+{
+    QMutexLocker locker(&_mutex);
+    while( _acquiring && _acquired.size() >= _acquireQueue )
+        _acquiredTaken.wait(&_mutex);
+    if( ! _acquiring ) return false;
+
+    Acquired acquired;
+    foreach( const QString& type, _dataBuffers.keys() ) {
+        acquired.data.insert(type, _dataBuffers[type]->next());
+    }
+    // don't fill blobs that a running pipeline is still using
+    _waitForBlobs(acquired.data.values());
+    locker.unlock();
+
+    try {
+        acquired.valid = _dataClient->getData(acquired.data);
+    }
+    catch(const QString& e) {
+        acquired.error = e;
+    }
+
+    locker.relock();
+    _acquired.enqueue(acquired);
+    _dataAcquired.wakeAll();
+    return true;
+}
+
+/**
+ * @details
+ * Waits for the next set of data from the acquisition thread, making it
+ * the current data hash, and returns the valid data. Throws the error
+ * from the data client, if it failed.
+ */
+QHash<QString, DataBlob*> PipelineDriver::_takeData()
+{
+    QMutexLocker locker(&_mutex);
+    while( _acquired.isEmpty() )
+        _dataAcquired.wait(&_mutex);
+    Acquired acquired = _acquired.dequeue();
+    _acquiredTaken.wakeAll();
+    _dataHash = acquired.data;
+    if( ! acquired.error.isEmpty() )
+        throw acquired.error;
+    return acquired.valid;
+}
+
+/**
+ * @details
+ * Runs the pipeline on the thread pool with the current data hash.
+ *
+ * The driver first waits for the last run of the pipeline to finish and
+ * for any other running pipeline using the same data blobs. A pipeline
+ * that has asked to be deactivated is not run again. If a pipeline has
+ * thrown an error, the driver waits for the others to finish and throws it.
+ */
+void PipelineDriver::_dispatchPipeline(AbstractPipeline* pipeline)
+{
+    QMutexLocker locker(&_mutex);
+    while( _running.contains(pipeline) )
+        _pipelineFinished.wait(&_mutex);
+    if( ! _pipelineError.isEmpty() ) {
+        // Throws the error, unless another caller has already taken it.
+        locker.unlock();
+        _waitForPipelines();
+        locker.relock();
+    }
+    if( _deactivateQueue.contains(_lead(pipeline)) )
+        return;
+
+    QList<DataBlob*> blobs = _pipelineBlobs(pipeline);
+    _waitForBlobs(blobs);
+    foreach( DataBlob* blob, blobs ) {
+        ++_busy[blob];
+    }
+    _running.insert(pipeline);
+    _beginRun(pipeline);
+    _pool->start(new PipelineTask(this, pipeline, _dataHash, blobs));
+}
+
+/**
+ * @details
+ * Called from the pool thread when a pipeline has finished, to release
+ * its data blobs and record any error.
+ */
+void PipelineDriver::_pipelineDone(AbstractPipeline* pipeline,
+        const QList<DataBlob*>& blobs, const QString& error)
+{
+    QMutexLocker locker(&_mutex);
+    foreach( DataBlob* blob, blobs ) {
+        if( --_busy[blob] == 0 )
+            _busy.remove(blob);
+    }
+    _running.remove(pipeline);
+    _endRun(pipeline);
+    if( _pipelineError.isEmpty() )
+        _pipelineError = error;
+    _pipelineFinished.wakeAll();
+}
+
+/**
+ * @details
+ * Returns the blobs of the current data hash that the pipeline uses, with
+ * the older blobs it keeps in its stream history.
+ */
+QList<DataBlob*> PipelineDriver::_pipelineBlobs(AbstractPipeline* pipeline) const
+{
+    QList<DataBlob*> blobs;
+    foreach( const QString& type, _dataSpecs[_lead(pipeline)].allData() ) {
+        DataBlob* blob = _dataHash.value(type);
+        if( ! blob ) continue;
+        blobs.append(blob);
+        unsigned int history = pipeline->historySize(type);
+        if( history > 1 ) {
+            unsigned int kept = 1;
+            foreach( DataBlob* old, pipeline->streamHistory(type) ) {
+                if( kept == history ) break;
+                if( old == blob ) continue;
+                blobs.append(old);
+                ++kept;
+            }
+        }
+    }
+    return blobs;
+}
+
+/**
+ * @details
+ * Waits, with the mutex locked, until no running pipeline uses any of
+ * the blobs.
+ */
+void PipelineDriver::_waitForBlobs(const QList<DataBlob*>& blobs)
+{
+    bool busy = true;
+    while( busy ) {
+        busy = false;
+        foreach( DataBlob* blob, blobs ) {
+            if( _busy.contains(blob) ) {
+                busy = true;
+                _pipelineFinished.wait(&_mutex);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @details
+ * Waits for all the pipelines running on the thread pool to finish, then
+ * throws the first error thrown by any of them.
+ */
+void PipelineDriver::_waitForPipelines()
+{
+    if( ! _pool ) return;
+    QMutexLocker locker(&_mutex);
+    while( ! _running.isEmpty() )
+        _pipelineFinished.wait(&_mutex);
+    if( ! _pipelineError.isEmpty() ) {
+        QString error = _pipelineError;
+        _pipelineError.clear();
+        throw error;
+    }
 }
 
 /**
@@ -310,6 +813,7 @@ void PipelineDriver::start()
  */
 void PipelineDriver::stop()
 {
+    QMutexLocker locker(&_mutex);
     _run = false;
 }
 
@@ -326,7 +830,8 @@ void PipelineDriver::_checkDataRequirements()
     /* Check that the set of stream data required for each pipeline does not
      * intersect the set of stream data required by another.
      * Data is not currently copied, so this ensures that two pipelines do not
-     * try to modify the same data. */
+     * try to modify the same data. Pipelines in separate drivers can share
+     * a stream from a broadcast buffer, with different consumer names. */
     DataRequirements totalReq;
     foreach (const DataRequirements& req, _allDataReq ) {
 #ifdef BROKEN_QT_SET_HEADER
@@ -335,7 +840,8 @@ void PipelineDriver::_checkDataRequirements()
 #else
         if ((totalReq.allStreams() & req.allStreams()).size() > 0) {
 #endif
-            throw QString("Multiple pipelines requiring the same remote stream data are not supported.");
+            throw QString("Multiple pipelines requiring the same remote stream data are not supported"
+                    " (run them in separate pipeline applications, as broadcast consumers).");
         }
         totalReq += req;
     }
@@ -0,0 +1,26 @@
+#include "PipelineReplicas.h"
+
+
+namespace pelican {
+
+
+/**
+ * @details Constructs a PipelineReplicas object.
+ */
+PipelineReplicas::PipelineReplicas()
+{
+}
+
+/**
+ * @details Destroys the PipelineReplicas object.
+ */
+PipelineReplicas::~PipelineReplicas()
+{
+}
+
+void PipelineReplicas::addPipeline(AbstractPipeline* pipe)
+{
+     _pipelines.append(pipe);
+}
+
+} // namespace pelican
@@ -0,0 +1,276 @@
+#include "pelican/core/SharedMemoryDataClient.h"
+#include "pelican/data/DataBlob.h"
+#include "pelican/comms/PelicanClientProtocol.h"
+#include "pelican/comms/ServerResponse.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataChunk.h"
+#include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamDataResponse.h"
+#include "pelican/comms/SharedStreamDataResponse.h"
+#include "pelican/comms/ServiceDataRequest.h"
+#include "pelican/comms/ServiceDataResponse.h"
+#include "pelican/comms/DataSupportRequest.h"
+#include "pelican/comms/DataSupportResponse.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/SharedMemorySegment.h"
+
+#include <QtNetwork/QTcpSocket>
+#include <QtCore/QBuffer>
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QSet>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace pelican {
+
+/**
+ * @details
+ * Creates the client for the server socket given in the configuration.
+ */
+SharedMemoryDataClient::SharedMemoryDataClient(const ConfigNode& configNode,
+        const DataTypes& types, const Config* config)
+    : AbstractAdaptingDataClient(configNode, types, config),
+      _socket(0), _specReceived(false)
+{
+    _path = configNode.getOption("server", "socket");
+    if (_path.isEmpty())
+        throw QString("SharedMemoryDataClient: No server socket specified.");
+    _protocol = new PelicanClientProtocol;
+}
+
+
+/**
+ * @details
+ * Closes the connection (releasing any data still held for the client)
+ * and unmaps the segments.
+ */
+SharedMemoryDataClient::~SharedMemoryDataClient()
+{
+    delete _socket;
+    foreach (SharedMemorySegment* segment, _segments)
+        delete segment;
+    delete _protocol;
+}
+
+
+/**
+ * @details
+ * Requests the next stream data from the server, and adapts it along
+ * with any of its service data that has changed.
+ */
+AbstractDataClient::DataBlobHash SharedMemoryDataClient::getData(
+        DataBlobHash& dataHash)
+{
+    QSet<QString> reqs = _requireSet;
+    if( ! reqs.subtract(QSet<QString>::fromList(dataHash.keys())).isEmpty() )
+        throw(QString("SharedMemoryDataClient::getData() data hash does not "
+                "contain objects for all possible requests"));
+
+    StreamDataRequest request;
+    foreach(const DataSpec& d, dataRequirements())
+        request.addDataOption(d);
+    if (request.isEmpty())
+        throw QString("SharedMemoryDataClient::getData(): Request for non-stream data");
+
+    boost::shared_ptr<ServerResponse> r = _send(request);
+    if (r->type() != ServerResponse::SharedStreamData
+            && r->type() != ServerResponse::StreamData)
+        throw QString("SharedMemoryDataClient: Server Error: ") + r->message();
+
+    // The server holds a chunk in shared memory until it is released, even
+    // if it can not be adapted. Other stream data is not held.
+    bool held = r->type() == ServerResponse::SharedStreamData;
+    DataBlobHash validData;
+    try {
+        StreamData* sd = static_cast<StreamDataResponse*>(r.get())->streamData();
+        QByteArray data;
+        if (r->type() == ServerResponse::SharedStreamData) {
+            // Adapt the data in place.
+            SharedStreamDataResponse* resp =
+                    static_cast<SharedStreamDataResponse*>(r.get());
+            SharedMemorySegment* segment = _segment(resp->segment());
+            if (resp->offset() + sd->size() > segment->size())
+                throw QString("SharedMemoryDataClient: Stream data outside "
+                        "segment %1").arg(segment->name());
+            data = QByteArray::fromRawData(segment->data() + resp->offset(),
+                    sd->size());
+        }
+        else {
+            // Stream data not in shared memory is sent as usual.
+            data.resize(sd->size());
+            _read(*_socket, data.data(), sd->size());
+        }
+        validData.unite(_serviceData(sd, dataHash));
+        QBuffer buf(&data);
+        buf.open(QIODevice::ReadOnly);
+        validData.unite(adaptStream(buf, sd, dataHash));
+    }
+    catch (...) {
+        if (held) _release();
+        throw;
+    }
+    if (held) _release();
+    return validData;
+}
+
+
+const DataSpec& SharedMemoryDataClient::dataSpec() const
+{
+    if (!_specReceived) {
+        boost::shared_ptr<ServerResponse> r = _send(DataSupportRequest());
+        if (r->type() != ServerResponse::DataSupport)
+            throw QString("SharedMemoryDataClient: Server Error: ") + r->message();
+        DataSupportResponse* res = static_cast<DataSupportResponse*>(r.get());
+        _dataSpec.clear();
+        _dataSpec.addServiceData( res->serviceData() );
+        _dataSpec.addStreamData( res->streamData() );
+        _dataSpec.addAdapterTypes( res->defaultAdapters() );
+        _specReceived = true;
+    }
+    return _dataSpec;
+}
+
+
+/**
+ * @details
+ * Returns the connection to the server, (re)connecting to its Unix domain
+ * socket if it is not connected.
+ */
+QTcpSocket& SharedMemoryDataClient::_connection() const
+{
+    if (_socket && _socket->state() == QAbstractSocket::ConnectedState)
+        return *_socket;
+    delete _socket;
+    _socket = 0;
+
+    QByteArray name = QFile::encodeName(_path);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (name.size() >= (int)sizeof(addr.sun_path))
+        throw QString("SharedMemoryDataClient: Socket path too long: ") + _path;
+    strcpy(addr.sun_path, name.constData());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        QString error = strerror(errno);
+        if (fd >= 0) ::close(fd);
+        throw QString("SharedMemoryDataClient: Unable to connect to %1: %2")
+                .arg(_path).arg(error);
+    }
+    _socket = new QTcpSocket;
+    if (!_socket->setSocketDescriptor(fd)) {
+        ::close(fd);
+        throw QString("SharedMemoryDataClient: Unable to use socket %1: %2")
+                .arg(_path).arg(_socket->errorString());
+    }
+    return *_socket;
+}
+
+
+/**
+ * @details
+ * Sends the request to the server and waits for the response header.
+ */
+boost::shared_ptr<ServerResponse> SharedMemoryDataClient::_send(
+        const ServerRequest& request) const
+{
+    QTcpSocket& sock = _connection();
+    sock.write(_protocol->serialise(request));
+    sock.flush();
+    while (sock.bytesAvailable() == 0) {
+        if (!sock.waitForReadyRead(-1)
+                && sock.state() != QAbstractSocket::ConnectedState)
+            throw QString("SharedMemoryDataClient: Connection lost: ")
+                    + sock.errorString();
+    }
+    return _protocol->receive(sock);
+}
+
+
+/**
+ * @details
+ * Fetches (through the socket) and adapts the service data associated
+ * with the stream data that is not already at the right version.
+ */
+AbstractDataClient::DataBlobHash SharedMemoryDataClient::_serviceData(
+        const StreamData* sd, DataBlobHash& dataHash)
+{
+    DataBlobHash validData;
+    ServiceDataRequest req;
+    foreach (const boost::shared_ptr<DataChunk>& d, sd->associateData()) {
+        if (dataHash[d->name()]->version() != d->id())
+            req.request(d->name(), d->id());
+        validData[d->name()] = dataHash[d->name()];
+    }
+    if (req.isEmpty())
+        return validData;
+
+    boost::shared_ptr<ServerResponse> r = _send(req);
+    if (r->type() != ServerResponse::ServiceData)
+        throw QString("SharedMemoryDataClient: Server Error: ") + r->message();
+    foreach (const DataChunk* d, static_cast<ServiceDataResponse*>(r.get())->data()) {
+        QByteArray data(d->size(), 0);
+        _read(*_socket, data.data(), d->size());
+        QBuffer buf(&data);
+        buf.open(QIODevice::ReadOnly);
+        validData.unite(adaptService(buf, d, dataHash));
+    }
+    return validData;
+}
+
+
+/**
+ * @details
+ * Lets the server reuse the oldest chunk it holds for the client.
+ */
+void SharedMemoryDataClient::_release()
+{
+    if (_socket && _socket->state() == QAbstractSocket::ConnectedState) {
+        _socket->write(_protocol->serialise(ReleaseRequest(1)));
+        _socket->flush();
+    }
+}
+
+
+/**
+ * @details
+ * Returns the named segment of the server, mapping it on first use.
+ */
+SharedMemorySegment* SharedMemoryDataClient::_segment(const QString& name)
+{
+    SharedMemorySegment* segment = _segments.value(name);
+    if (!segment) {
+        segment = new SharedMemorySegment(name);
+        _segments.insert(name, segment);
+    }
+    return segment;
+}
+
+
+/**
+ * @details
+ * Reads the given number of bytes from the device.
+ */
+void SharedMemoryDataClient::_read(QIODevice& device, char* buffer, qint64 size)
+{
+    qint64 total = 0;
+    while (total < size) {
+        if (device.bytesAvailable() == 0 && !device.waitForReadyRead(2000))
+            throw QString("SharedMemoryDataClient: Timed out reading from server: ")
+                    + device.errorString();
+        qint64 n = device.read(buffer + total, size - total);
+        if (n < 0)
+            throw QString("SharedMemoryDataClient: Problem reading from server: ")
+                    + device.errorString();
+        total += n;
+    }
+}
+
+} // namespace pelican
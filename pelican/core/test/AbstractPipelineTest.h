@@ -23,6 +23,7 @@ class AbstractPipelineTest : public CppUnit::TestFixture
     public:
         CPPUNIT_TEST_SUITE( AbstractPipelineTest );
         CPPUNIT_TEST( test_createBlobs );
+        CPPUNIT_TEST( test_moduleGraph );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -31,6 +32,7 @@ class AbstractPipelineTest : public CppUnit::TestFixture
 
         // Test Methods
         void test_createBlobs();
+        void test_moduleGraph();
 
     public:
         AbstractPipelineTest(  );
@@ -26,6 +26,7 @@ class PelicanServerClientTestMT : public CppUnit::TestFixture
     public:
         CPPUNIT_TEST_SUITE( PelicanServerClientTestMT );
         CPPUNIT_TEST( test_getData );
+        CPPUNIT_TEST( test_prefetch );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -34,6 +35,7 @@ class PelicanServerClientTestMT : public CppUnit::TestFixture
 
         // Test Methods
         void test_getData();
+        void test_prefetch();
 
     public:
         PelicanServerClientTestMT(  );
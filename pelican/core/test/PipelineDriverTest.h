@@ -50,6 +50,9 @@ class PipelineDriverTest : public CppUnit::TestFixture
         CPPUNIT_TEST( test_start_multiPipelineRunDifferentData );
         CPPUNIT_TEST( test_start_multiPipelineRunOne );
         CPPUNIT_TEST( test_start_pipelineWithHistory );
+        CPPUNIT_TEST( test_start_threadPool );
+        CPPUNIT_TEST( test_start_acquireQueue );
+        CPPUNIT_TEST( test_start_replicas );
 */
         CPPUNIT_TEST_SUITE_END();
 
@@ -71,6 +74,9 @@ class PipelineDriverTest : public CppUnit::TestFixture
         void test_start_multiPipelineRunDifferentData();
         void test_start_multiPipelineRunOne();
         void test_start_pipelineWithHistory();
+        void test_start_threadPool();
+        void test_start_acquireQueue();
+        void test_start_replicas();
 
     public:
         PipelineDriverTest(  );
@@ -0,0 +1,48 @@
+#ifndef SHAREDMEMORYDATACLIENTTEST_H
+#define SHAREDMEMORYDATACLIENTTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file SharedMemoryDataClientTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @ingroup t_core
+ *
+ * @class SharedMemoryDataClientTest
+ *
+ * @brief
+ * Unit test for the SharedMemoryDataClient.
+ *
+ * @details
+ * The client talks to a server thread that answers its requests with a
+ * SharedMemoryProtocol, from a segment created by the test.
+ */
+class SharedMemoryDataClientTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( SharedMemoryDataClientTest );
+        CPPUNIT_TEST( test_getData );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_getData();
+
+    public:
+        /// SharedMemoryDataClientTest constructor.
+        SharedMemoryDataClientTest();
+
+        /// SharedMemoryDataClientTest destructor.
+        ~SharedMemoryDataClientTest();
+};
+
+} // namespace pelican
+
+#endif // SHAREDMEMORYDATACLIENTTEST_H
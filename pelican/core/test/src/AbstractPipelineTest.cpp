@@ -2,11 +2,36 @@
 #include "AbstractPipeline.h"
 #include "pelican/data/test/TestDataBlob.h"
 #include "TestPipeline.h"
+#include "pelican/utility/FactoryConfig.h"
+#include "pelican/utility/FactoryGeneric.h"
 
 
 namespace pelican {
 
 CPPUNIT_TEST_SUITE_REGISTRATION( AbstractPipelineTest );
+
+/**
+ * @details
+ * Module that records the order in which it writes its outputs.
+ */
+class GraphTestModule : public AbstractModule
+{
+    public:
+        GraphTestModule(const ConfigNode& config) : AbstractModule(config) {}
+        void execute(const QList<DataBlob*>& inputs,
+                const QList<DataBlob*>& outputs) {
+            foreach( DataBlob* in, inputs ) {
+                if( in && in != remote && ! written.contains(in) )
+                    throw QString("input not written");
+            }
+            written << outputs;
+        }
+        static QList<DataBlob*> written;
+        static DataBlob* remote;
+};
+QList<DataBlob*> GraphTestModule::written;
+DataBlob* GraphTestModule::remote = 0;
+PELICAN_DECLARE_MODULE(GraphTestModule)
 /**
  *@details AbstractPipelineTest 
  */
@@ -40,4 +65,68 @@ void AbstractPipelineTest::test_createBlobs()
         CPPUNIT_ASSERT( buffer[2]->type() == "TestDataBlob" ); // check datablob type
 }
 
+void AbstractPipelineTest::test_moduleGraph()
+{
+    FactoryGeneric<DataBlob> blobFactory(false);
+    FactoryConfig<AbstractModule> moduleFactory(0, "", "");
+    {
+        // Use Case:
+        // Two modules reading the remote data, and one joining their outputs
+        // Expect: each module to run after those writing its inputs
+        DataRequirements req;
+        req.addRequired("TestDataBlob");
+        test::TestPipeline p(req);
+        p.setBlobFactory(&blobFactory);
+        p.setModuleFactory(&moduleFactory);
+        DataBlob* a = p.createBlob("TestDataBlob", "a");
+        DataBlob* b = p.createBlob("TestDataBlob", "b");
+        DataBlob* c = p.createBlob("TestDataBlob", "c");
+        p.createModule("GraphTestModule", "join", QStringList() << "a" << "b",
+                QStringList() << "c");
+        p.createModule("GraphTestModule", "left", QStringList() << "TestDataBlob",
+                QStringList() << "a");
+        p.createModule("GraphTestModule", "right", QStringList() << "TestDataBlob",
+                QStringList() << "b");
+        p.buildModuleGraph();
+
+        test::TestDataBlob remote;
+        QHash<QString, DataBlob*> data;
+        data.insert("TestDataBlob", &remote);
+        GraphTestModule::remote = &remote;
+        GraphTestModule::written.clear();
+        p.runModules(data);
+        CPPUNIT_ASSERT_EQUAL( 3, GraphTestModule::written.size() );
+        CPPUNIT_ASSERT( GraphTestModule::written.contains(a) );
+        CPPUNIT_ASSERT( GraphTestModule::written.contains(b) );
+        CPPUNIT_ASSERT( GraphTestModule::written[2] == c );
+    }
+    {
+        // Use Case:
+        // Modules depending on each other
+        // Expect: to throw when the graph is built
+        test::TestPipeline p;
+        p.setBlobFactory(&blobFactory);
+        p.setModuleFactory(&moduleFactory);
+        p.createBlob("TestDataBlob", "a");
+        p.createBlob("TestDataBlob", "b");
+        p.createModule("GraphTestModule", "x", QStringList() << "a",
+                QStringList() << "b");
+        p.createModule("GraphTestModule", "y", QStringList() << "b",
+                QStringList() << "a");
+        CPPUNIT_ASSERT_THROW( p.buildModuleGraph(), QString );
+    }
+    {
+        // Use Case:
+        // A module reading data that is neither remote nor a named blob
+        // Expect: to throw when the graph is built
+        test::TestPipeline p;
+        p.setBlobFactory(&blobFactory);
+        p.setModuleFactory(&moduleFactory);
+        p.createBlob("TestDataBlob", "a");
+        p.createModule("GraphTestModule", "x", QStringList() << "missing",
+                QStringList() << "a");
+        CPPUNIT_ASSERT_THROW( p.buildModuleGraph(), QString );
+    }
+}
+
 } // namespace pelican
@@ -168,4 +168,67 @@ void PelicanServerClientTestMT::test_getData()
     }
 }
 
+void PelicanServerClientTestMT::test_prefetch()
+{
+    // Use Case:
+    // Two stream chunks sharing service data, fetched ahead by the client.
+    // Expect:
+    // each call to getData returns the next chunk with its service data
+    TestServiceAdapter serviceAdapter;
+    TestStreamAdapter streamAdapter;
+    TestServer server;
+    QString stream1("stream1");
+    QString service1("service1");
+    QByteArray data1("pelican/data1");
+    QByteArray data2("pelican/data2");
+    QByteArray data3("pelican/data3");
+    DataChunk servd(service1, "service_version", data3);
+    server.serveServiceData(servd);
+    QString version1("version1");
+    QString version2("version2");
+    StreamData sd1(stream1, version1, data1);
+    StreamData sd2(stream1, version2, data2);
+    server.serveStreamData(sd1);
+    server.serveStreamData(sd2);
+
+    Config config;
+    config.setFromString(
+        "",
+        "<testconfig>"
+        "   <server host=\"127.0.0.1\" prefetch=\"2\"/>"
+        "</testconfig>"
+    );
+    Config::TreeAddress address;
+    address << Config::NodeId("server", "");
+    address << Config::NodeId("testconfig", "");
+    ConfigNode configNode = config.get(address);
+
+    DataSpec req;
+    req.addServiceData(service1);
+    req.addStreamData(stream1);
+    QList<DataSpec> lreq;
+    lreq.append(req);
+    DataTypes dt;
+    dt.setAdapter(stream1, &streamAdapter);
+    dt.setAdapter(service1, &serviceAdapter);
+    dt.addData(lreq);
+    PelicanServerClient client(configNode, dt, 0);
+    client.setPort(server.port());
+
+    QHash<QString, DataBlob*> dataHash;
+    TestDataBlob db;
+    TestDataBlob db_service;
+    dataHash.insert(stream1, &db);
+    dataHash.insert(service1, &db_service);
+    client.getData(dataHash);
+    CPPUNIT_ASSERT_EQUAL( version1.toStdString(), db.version().toStdString() );
+    CPPUNIT_ASSERT_EQUAL( std::string(data1.data()), std::string(db.data()) );
+    CPPUNIT_ASSERT_EQUAL( std::string("service_version"), db_service.version().toStdString() );
+    CPPUNIT_ASSERT_EQUAL( std::string(data3.data()), std::string(db_service.data()) );
+    client.getData(dataHash);
+    CPPUNIT_ASSERT_EQUAL( version2.toStdString(), db.version().toStdString() );
+    CPPUNIT_ASSERT_EQUAL( std::string(data2.data()), std::string(db.data()) );
+    CPPUNIT_ASSERT_EQUAL( std::string("service_version"), db_service.version().toStdString() );
+}
+
 } // namespace pelican
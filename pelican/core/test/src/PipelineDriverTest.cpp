@@ -4,10 +4,13 @@
 #include "pelican/core/DataClientFactory.h"
 #include "pelican/core/DataTypes.h"
 #include "pelican/core/PipelineDriver.h"
+#include "pelican/core/PipelineReplicas.h"
 #include "pelican/core/test/TestPipeline.h"
 #include "pelican/core/test/TestDataClient.h"
+#include "pelican/data/DataBlobBuffer.h"
 #include "pelican/data/DataRequirements.h"
 #include "pelican/data/test/TestDataBlob.h"
+#include "pelican/utility/Config.h"
 
 #include <QtCore/QCoreApplication>
 
@@ -517,6 +520,168 @@ void PipelineDriverTest::test_start_pipelineWithHistory()
     }
 }
 
+/**
+ * @details
+ * Tests the start() method with the pipelines run on a thread pool, with
+ * two pipelines requiring different data, one with history.
+ *
+ * Expect both pipelines to run (with their history kept), until one stops
+ * the driver.
+ */
+void PipelineDriverTest::test_start_threadPool()
+{
+    try {
+        Config config;
+        Config::TreeAddress address;
+        config.setAttribute(Config::TreeAddress() << Config::NodeId("driver", ""),
+                "threads", "2");
+        PipelineDriver driver(_dataBlobFactory, _moduleFactory,
+                _clientFactory, _osmanager, &config, address);
+        CPPUNIT_ASSERT( driver._pool != 0 );
+
+        int num = 10;
+        int history = 3;
+        DataRequirements pipelineReq1, pipelineReq2;
+        QString type1 = "FloatData", type2 = "DoubleData";
+        pipelineReq1.addRequired(type1);
+        pipelineReq2.addRequired(type2);
+        TestPipeline *pipeline1 = new TestPipeline(pipelineReq1, num);
+        TestPipeline *pipeline2 = new TestPipeline(pipelineReq2, num);
+        pipeline1->setHistory(type1, history);
+        driver.registerPipeline(pipeline1);
+        driver.registerPipeline(pipeline2);
+
+        // Create the data client.
+        ConfigNode clientConfig;
+        DataSpec clientTypes;
+        clientTypes.addStreamData(type1);
+        clientTypes.addStreamData(type2);
+        TestDataClient client(clientConfig, clientTypes);
+        driver._dataClient = &client;
+
+        // Start the pipeline driver.
+        driver.start();
+        CPPUNIT_ASSERT( ! driver._running.size() );
+        CPPUNIT_ASSERT( pipeline1->count() >= num );
+        CPPUNIT_ASSERT_EQUAL(pipeline1->count(), pipeline1->matchedCounter());
+        CPPUNIT_ASSERT( pipeline2->count() >= num );
+        CPPUNIT_ASSERT_EQUAL(pipeline2->count(), pipeline2->matchedCounter());
+
+        // The history is kept, with a spare blob in the buffer.
+        const QList<DataBlob*> h = pipeline1->streamHistory(type1);
+        CPPUNIT_ASSERT_EQUAL( history, h.size() );
+        CPPUNIT_ASSERT_EQUAL( (unsigned int)history + 1, driver._dataBuffers[type1]->size() );
+    }
+    catch(const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " + e.toStdString());
+    }
+}
+
+/**
+ * @details
+ * Tests the start() method with the data fetched on the acquisition thread,
+ * with a pipeline that keeps history.
+ *
+ * Expect the pipeline to run on all the data fetched, with its history
+ * kept, and the buffer to have room for the data fetched ahead.
+ */
+void PipelineDriverTest::test_start_acquireQueue()
+{
+    try {
+        Config config;
+        Config::TreeAddress address;
+        config.setAttribute(Config::TreeAddress() << Config::NodeId("driver", ""),
+                "acquireQueue", "2");
+        PipelineDriver driver(_dataBlobFactory, _moduleFactory,
+                _clientFactory, _osmanager, &config, address);
+
+        int num = 10;
+        int history = 3;
+        DataRequirements pipelineReq;
+        QString type1 = "FloatData";
+        pipelineReq.addRequired(type1);
+        TestPipeline *pipeline1 = new TestPipeline(pipelineReq, num);
+        pipeline1->setHistory(type1, history);
+        driver.registerPipeline(pipeline1);
+
+        // Create the data client.
+        ConfigNode clientConfig;
+        DataSpec clientTypes;
+        clientTypes.addStreamData(type1);
+        TestDataClient client(clientConfig, clientTypes);
+        driver._dataClient = &client;
+
+        // Start the pipeline driver.
+        driver.start();
+        CPPUNIT_ASSERT( ! driver._acquiring );
+        CPPUNIT_ASSERT_EQUAL(num, pipeline1->count());
+        CPPUNIT_ASSERT_EQUAL(pipeline1->count(), pipeline1->matchedCounter());
+
+        const QList<DataBlob*> h = pipeline1->streamHistory(type1);
+        CPPUNIT_ASSERT_EQUAL( history, h.size() );
+        CPPUNIT_ASSERT_EQUAL( (unsigned int)history + 3, driver._dataBuffers[type1]->size() );
+    }
+    catch(const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " + e.toStdString());
+    }
+}
+
+/**
+ * @details
+ * Tests the start() method with replicas of a pipeline, run on a thread
+ * pool.
+ *
+ * Expect the replicas to be run in turn, until one of them stops the
+ * driver.
+ */
+void PipelineDriverTest::test_start_replicas()
+{
+    try {
+        Config config;
+        Config::TreeAddress address;
+        config.setAttribute(Config::TreeAddress() << Config::NodeId("driver", ""),
+                "threads", "3");
+        PipelineDriver driver(_dataBlobFactory, _moduleFactory,
+                _clientFactory, _osmanager, &config, address);
+
+        int num = 4;
+        DataRequirements pipelineReq;
+        QString type1 = "FloatData";
+        pipelineReq.addRequired(type1);
+        PipelineReplicas replicas;
+        QList<TestPipeline*> pipelines;
+        for( int i = 0; i < 3; ++i ) {
+            pipelines.append(new TestPipeline(pipelineReq, num));
+            replicas.addPipeline(pipelines.last());
+        }
+        driver.addPipelineReplicas(replicas);
+        CPPUNIT_ASSERT_EQUAL( 1, driver._activePipelines.size() );
+
+        // Create the data client.
+        ConfigNode clientConfig;
+        DataSpec clientTypes;
+        clientTypes.addStreamData(type1);
+        TestDataClient client(clientConfig, clientTypes);
+        driver._dataClient = &client;
+
+        // Start the pipeline driver.
+        driver.start();
+        CPPUNIT_ASSERT( pipelines[0]->count() >= num );
+        CPPUNIT_ASSERT( pipelines[1]->count() >= num - 1 );
+        CPPUNIT_ASSERT( pipelines[2]->count() >= num - 1 );
+        foreach( TestPipeline* p, pipelines ) {
+            CPPUNIT_ASSERT_EQUAL(p->count(), p->matchedCounter());
+        }
+
+        // Each replica keeps its own history, so the buffer holds one
+        // blob for each, and a spare.
+        CPPUNIT_ASSERT_EQUAL( 4u, driver._dataBuffers[type1]->size() );
+    }
+    catch(const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " + e.toStdString());
+    }
+}
+
 void PipelineDriverTest::_setTestClient() {
     if ( ! _client  ) {
         ConfigNode config;
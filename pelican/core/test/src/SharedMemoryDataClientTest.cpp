@@ -0,0 +1,233 @@
+#include "SharedMemoryDataClientTest.h"
+#include "SharedMemoryDataClient.h"
+#include "pelican/data/DataSpec.h"
+
+#include "pelican/data/test/TestDataBlob.h"
+#include "pelican/core/test/TestStreamAdapter.h"
+
+#include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/SharedMemorySegment.h"
+#include "pelican/comms/SharedMemoryProtocol.h"
+#include "pelican/comms/ServerRequest.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataSupportResponse.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <QtNetwork/QTcpSocket>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace pelican {
+
+using test::TestDataBlob;
+using test::TestStreamAdapter;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SharedMemoryDataClientTest );
+
+// Serves one client on a Unix domain socket: each stream data request is
+// answered with the next of the given stream data, and the chunks released
+// by the client are counted.
+class SharedMemoryTestServer : public QThread
+{
+    public:
+        SharedMemoryTestServer(const QString& path) : releases(0), _stop(false)
+        {
+            _path = QFile::encodeName(path);
+            ::unlink(_path.constData());
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strcpy(addr.sun_path, _path.constData());
+            _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (_fd < 0 || ::bind(_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+                    || ::listen(_fd, 1) != 0)
+                throw QString("SharedMemoryTestServer: Unable to listen");
+        }
+        ~SharedMemoryTestServer()
+        {
+            _stop = true;
+            wait();
+            ::close(_fd);
+            ::unlink(_path.constData());
+        }
+
+        QList<StreamData*> responses;
+        QList<int> releasesBefore; ///< Releases counted before each response.
+        volatile int releases;
+
+    protected:
+        void run()
+        {
+            struct pollfd p;
+            p.fd = _fd;
+            p.events = POLLIN;
+            while (!_stop && ::poll(&p, 1, 100) <= 0) {}
+            if (_stop) return;
+            QTcpSocket socket;
+            socket.setSocketDescriptor(::accept(_fd, 0, 0));
+            SharedMemoryProtocol protocol;
+            while (!_stop && socket.state() == QAbstractSocket::ConnectedState) {
+                if (socket.bytesAvailable() == 0) {
+                    socket.waitForReadyRead(100);
+                    continue;
+                }
+                boost::shared_ptr<ServerRequest> req = protocol.request(socket);
+                if (req->type() == ServerRequest::Release) {
+                    releases += static_cast<ReleaseRequest*>(req.get())->count();
+                }
+                else if (req->type() == ServerRequest::StreamData
+                        && !responses.isEmpty()) {
+                    releasesBefore.append(releases);
+                    AbstractProtocol::StreamData_t data;
+                    data.append(responses.takeFirst());
+                    protocol.send(socket, data);
+                    socket.waitForBytesWritten(1000);
+                }
+                else if (req->type() == ServerRequest::DataSupport) {
+                    QSet<QString> streams;
+                    streams.insert("stream1");
+                    protocol.send(socket, DataSupportResponse(streams));
+                    socket.waitForBytesWritten(1000);
+                }
+            }
+        }
+
+    private:
+        QByteArray _path;
+        int _fd;
+        volatile bool _stop;
+};
+
+// Stream adapter that fails when asked to.
+class FailingStreamAdapter : public TestStreamAdapter
+{
+    public:
+        FailingStreamAdapter() : fail(false) {}
+        bool fail;
+        void deserialise(QIODevice* in)
+        {
+            if (fail) throw QString("FailingStreamAdapter: Failed");
+            TestStreamAdapter::deserialise(in);
+        }
+};
+
+SharedMemoryDataClientTest::SharedMemoryDataClientTest()
+    : CppUnit::TestFixture()
+{
+}
+
+SharedMemoryDataClientTest::~SharedMemoryDataClientTest()
+{
+}
+
+void SharedMemoryDataClientTest::setUp()
+{
+}
+
+void SharedMemoryDataClientTest::tearDown()
+{
+}
+
+void SharedMemoryDataClientTest::test_getData()
+{
+    try {
+        QString path = QDir::tempPath()
+                + QString("/SharedMemoryDataClientTest.%1.socket").arg(getpid());
+        SharedMemorySegment segment(
+                QString("/pelican.SharedMemoryDataClientTest.%1").arg(getpid()),
+                4096);
+        strcpy(segment.data() + 128, "data1");
+        strcpy(segment.data() + 256, "data5");
+        QByteArray local("data4");
+
+        // In place, outside the segment, failing to adapt, not in shared
+        // memory, and in place again.
+        StreamData sd1("stream1", segment.data() + 128, 5);
+        sd1.setId("v1");
+        StreamData sd2("stream1", segment.data() + 4090, 16);
+        sd2.setId("v2");
+        StreamData sd3("stream1", segment.data() + 128, 5);
+        sd3.setId("v3");
+        StreamData sd4("stream1", local.data(), local.size());
+        sd4.setId("v4");
+        StreamData sd5("stream1", segment.data() + 256, 5);
+        sd5.setId("v5");
+
+        SharedMemoryTestServer server(path);
+        server.responses << &sd1 << &sd2 << &sd3 << &sd4 << &sd5;
+        server.start();
+
+        FailingStreamAdapter adapter;
+        DataSpec req;
+        req.addStreamData("stream1");
+        QList<DataSpec> lreq;
+        lreq.append(req);
+        DataTypes dt;
+        dt.setAdapter("stream1", &adapter);
+        dt.addData(lreq);
+        ConfigNode configNode(QString("<SharedMemoryDataClient>"
+                "<server socket=\"%1\"/></SharedMemoryDataClient>").arg(path));
+        SharedMemoryDataClient client(configNode, dt, 0);
+        TestDataBlob db;
+        QHash<QString, DataBlob*> dataHash;
+        dataHash.insert("stream1", &db);
+
+        // Use Case:
+        // Stream data in a shared memory segment
+        // Expect it to be adapted from the segment
+        QHash<QString, DataBlob*> valid = client.getData(dataHash);
+        CPPUNIT_ASSERT( valid.contains("stream1") );
+        CPPUNIT_ASSERT_EQUAL( std::string("v1"), db.version().toStdString() );
+        CPPUNIT_ASSERT_EQUAL( std::string("data1"),
+                std::string(db.data().constData(), db.data().size()) );
+
+        // Use Case:
+        // Stream data described as running past the end of the segment
+        // Expect to throw
+        CPPUNIT_ASSERT_THROW( client.getData(dataHash), QString );
+
+        // Use Case:
+        // The adapter fails
+        // Expect to throw
+        adapter.fail = true;
+        CPPUNIT_ASSERT_THROW( client.getData(dataHash), QString );
+        adapter.fail = false;
+
+        // Use Case:
+        // Stream data not in shared memory
+        // Expect it to be read from the socket
+        client.getData(dataHash);
+        CPPUNIT_ASSERT_EQUAL( std::string("data4"),
+                std::string(db.data().constData(), db.data().size()) );
+
+        client.getData(dataHash);
+        CPPUNIT_ASSERT_EQUAL( std::string("data5"),
+                std::string(db.data().constData(), db.data().size()) );
+
+        // Expect every chunk in shared memory to have been released, even
+        // when the client failed, and none of the others.
+        QTime timer;
+        timer.start();
+        while (server.releases < 4 && timer.elapsed() < 5000)
+            usleep(1000);
+        CPPUNIT_ASSERT_EQUAL( 5, server.releasesBefore.size() );
+        int expected[] = { 0, 1, 2, 3, 3 };
+        for (int i = 0; i < 5; ++i)
+            CPPUNIT_ASSERT_EQUAL( expected[i], server.releasesBefore[i] );
+        CPPUNIT_ASSERT_EQUAL( 4, (int)server.releases );
+    }
+    catch (const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " + e.toStdString());
+    }
+}
+
+} // namespace pelican
@@ -6,6 +6,7 @@
  */
 
 #include "pelican/data/DataBlob.h"
+#include "pelican/utility/BufferMemory.h"
 #include <vector>
 
 namespace pelican {
@@ -19,17 +20,33 @@ namespace pelican {
  * Data blob to hold an array.
  *
  * @details
- * This data blob holds an array.
+ * This data blob holds an array, allocated as set with setMemory().
  */
 template <class T>
 class ArrayData : public DataBlob
 {
     private:
-        std::vector<T> _data;
+        BufferMemory _memory;
+        std::vector<T, BufferAllocator<T> > _data;
 
     public:
         /// Constructor.
-        ArrayData(const QString& type) : DataBlob(type) {}
+        ArrayData(const QString& type)
+            : DataBlob(type), _data(BufferAllocator<T>(&_memory)) {}
+
+        /// Copy constructor.
+        ArrayData(const ArrayData& other)
+            : DataBlob(other), _memory(other._memory),
+              _data(other._data.begin(), other._data.end(),
+                    BufferAllocator<T>(&_memory)) {}
+
+        /// Assignment operator.
+        ArrayData& operator=(const ArrayData& other) {
+            DataBlob::operator=(other);
+            _memory = other._memory;
+            _data.assign(other._data.begin(), other._data.end());
+            return *this;
+        }
 
         /// Destructor.
         virtual ~ArrayData() {}
@@ -45,6 +62,14 @@ class ArrayData : public DataBlob
 
         /// Returns the size of the data.
         unsigned size() { return _data.size(); }
+
+        /// Allocates the array as given, moving any data already held.
+        void setMemory(const BufferMemory& memory) {
+            _memory = memory;
+            std::vector<T, BufferAllocator<T> > data(_data.begin(),
+                    _data.end(), BufferAllocator<T>(&_memory));
+            _data.swap(data);
+        }
 };
 
 
@@ -6,6 +6,7 @@
  */
 
 #include "pelican/utility/FactoryRegistrar.h"
+#include "pelican/utility/LatencyTrace.h"
 
 #include <QtCore/QString>
 #include <QtCore/QSysInfo>
@@ -15,6 +16,8 @@ class QIODevice;
 
 namespace pelican {
 
+class BufferMemory;
+
 /**
  * This macro is used to register the named data blob type.
  */
@@ -31,6 +34,13 @@ namespace pelican {
  * @details
  * This is the base class used for all Pelican data blobs required by
  * pipeline modules.
+ *
+ * Blobs adapted from stream data carry the times the data passed each
+ * stage from the server to the pipeline (see LatencyTrace).
+ *
+ * Blobs holding large arrays can allocate them as configured for their
+ * buffer in the pipeline (huge pages, locking, NUMA node) by overriding
+ * setMemory() (see ArrayData).
  */
 
 class DataBlob
@@ -53,6 +63,10 @@ class DataBlob
         /// Returns the version of the DataBlob.
         const QString& version() const { return _version; }
 
+        /// Returns the times the data passed each stage.
+        LatencyTrace& latencyTrace() { return _trace; }
+        const LatencyTrace& latencyTrace() const { return _trace; }
+
     public:
         /// Serialise the DataBlob into the QIODevice.
         virtual void serialise(QIODevice&) const;
@@ -63,9 +77,13 @@ class DataBlob
         /// Deserialises the DataBlob from the QIODevice.
         virtual void deserialise(QIODevice&, QSysInfo::Endian endianness);
 
+        /// Sets how the blob allocates its data (ignored by default).
+        virtual void setMemory(const BufferMemory&) {}
+
     private:
         QString _version;
         QString _type;
+        LatencyTrace _trace;
 };
 
 } // namespace pelican
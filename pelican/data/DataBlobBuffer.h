@@ -1,6 +1,7 @@
 #ifndef DATABLOBBUFFER_H
 #define DATABLOBBUFFER_H
 
+#include "pelican/utility/BufferMemory.h"
 #include <QtCore/QList>
 
 
@@ -18,6 +19,8 @@ namespace pelican {
  * @details
  *    At least one DataBlob must be provided otherwise this
  *    is undefined
+ *
+ *    The blobs allocate their data as set with setMemory().
  */
 
 class ConfigNode;
@@ -41,7 +44,11 @@ class DataBlobBuffer
         /// return the size (number of DataBlobs) held in the Buffer
         unsigned int size() { return _size; }
 
+        /// set how the DataBlobs allocate their data
+        void setMemory(const BufferMemory& memory);
+
     private:
+        BufferMemory _memory;
         QList<DataBlob*> _data;
         unsigned int _index;
         unsigned int _size;
@@ -24,10 +24,24 @@ DataBlobBuffer::~DataBlobBuffer()
 
 void DataBlobBuffer::addDataBlob(DataBlob* blob)
 {
+     if( ! _memory.isDefault() ) blob->setMemory(_memory);
      _data.append(blob);
      _size = _data.size();
 }
 
+/**
+ *@details
+ * Sets how the DataBlobs in the buffer, and those added later, allocate
+ * their data (see DataBlob::setMemory()).
+ */
+void DataBlobBuffer::setMemory(const BufferMemory& memory)
+{
+     _memory = memory;
+     foreach(DataBlob* blob, _data) {
+        blob->setMemory(_memory);
+     }
+}
+
 DataBlob* DataBlobBuffer::next() {
     _index=++_index%_size; // FIXME this line is a bit dodgy
     return _data[_index];
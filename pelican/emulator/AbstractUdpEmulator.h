@@ -29,6 +29,11 @@ class ConfigNode;
  * The default values are:
  *
  * @verbatim <connection host="127.0.0.1" port="2001" /> @endverbatim
+ *
+ * A \c threads section in the node places the thread of the EmulatorDriver
+ * (see ThreadPlacement), e.g.
+ *
+ * @verbatim <threads><EmulatorDriver cpus="3"/></threads> @endverbatim
  */
 class AbstractUdpEmulator : public AbstractEmulator
 {
@@ -28,7 +28,10 @@ class AbstractEmulator;
  * it on destruction.
  *
  * The thread created by this class repeatedly calls getPacketData() on the
- * emulator, and then sleeps for the specified interval.
+ * emulator, and then sleeps for the specified interval. It is placed as
+ * configured for \c EmulatorDriver threads in the \c threads section of
+ * the emulator's configuration (read by AbstractUdpEmulator, or by a call
+ * to ThreadPlacement::configure() in other emulators).
  */
 class EmulatorDriver : public QThread
 {
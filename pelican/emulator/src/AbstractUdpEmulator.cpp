@@ -1,5 +1,6 @@
 #include "pelican/emulator/AbstractUdpEmulator.h"
 #include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/ThreadPlacement.h"
 
 #include <QtNetwork/QUdpSocket>
 
@@ -7,6 +8,7 @@ namespace pelican {
 
 /**
  * @details AbstractUdpEmulator
+ * Also reads the placement of the driver thread from the \c threads section.
  */
 AbstractUdpEmulator::AbstractUdpEmulator(const ConfigNode& configNode)
     : AbstractEmulator()
@@ -14,6 +16,7 @@ AbstractUdpEmulator::AbstractUdpEmulator(const ConfigNode& configNode)
     _host = QHostAddress(configNode.getOption("connection", "host",
             "127.0.0.1"));
     _port = configNode.getOption("connection", "port", "2001").toShort();
+    ThreadPlacement::configure(configNode);
 }
 
 /**
@@ -1,5 +1,6 @@
 #include "pelican/emulator/EmulatorDriver.h"
 #include "pelican/emulator/AbstractEmulator.h"
+#include "pelican/utility/ThreadPlacement.h"
 
 #include <QtCore/QIODevice>
 #include <QtCore/QCoreApplication>
@@ -43,6 +44,7 @@ EmulatorDriver::~EmulatorDriver()
  */
 void EmulatorDriver::run()
 {
+    ThreadPlacement::place("EmulatorDriver");
     try {
         // Create the device.
         _device = _emulator->createDevice();
@@ -21,6 +21,7 @@ class SignalAmplifier : public AbstractModule
 
     private:
         float gain;
+        int grain;
 };
 
 PELICAN_DECLARE_MODULE(SignalAmplifier)
@@ -2,12 +2,31 @@
 #include "tutorial/SignalData.h"
 #include "pelican/utility/Config.h"
 
+// Amplifies a range of samples. The pipeline's task scheduler calls this
+// on pieces of the signal at the same time, from different threads.
+struct Amplify
+{
+    const float* in;
+    float* out;
+    float gain;
+
+    void operator()(int begin, int end) const
+    {
+        for (int i = begin; i < end; ++i) {
+            out[i] = gain * in[i];
+        }
+    }
+};
+
 // Construct the example module.
 SignalAmplifier::SignalAmplifier(const ConfigNode& config)
     : AbstractModule(config)
 {
     // Set amplifier gain from the XML configuration.
     gain = config.getOption("gain", "value").toDouble();
+
+    // Set the number of samples amplified by each task (optional).
+    grain = config.getOption("grain", "value", "0").toInt();
 }
 
 // Runs the module.
@@ -19,11 +38,11 @@ void SignalAmplifier::run(const SignalData* input, SignalData* output)
         output->resize(nPts);
 
     // Get pointers to the memory to use from the data blobs.
-    const float* in = input->ptr();
-    float* out = output->ptr();
+    Amplify amplify;
+    amplify.in = input->ptr();
+    amplify.out = output->ptr();
+    amplify.gain = gain;
 
-    // Perform the operation.
-    for (unsigned i = 0; i < nPts; ++i) {
-        out[i] = gain * in[i];
-    }
+    // Perform the operation, split over the threads of the scheduler.
+    parallelFor(0, nPts, amplify, grain);
 }
@@ -0,0 +1,81 @@
+#include "pelican/core/AbstractPipeline.h"
+#include "pelican/core/PipelineApplication.h"
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/utility/TaskScheduler.h"
+#include "tutorial/SignalAmplifier.h"
+#include "tutorial/SignalData.h"
+#include <QtCore/QCoreApplication>
+#include <iostream>
+
+// A pipeline that just holds an amplifier, so that the module can use the
+// task scheduler of the pipeline application.
+class BenchmarkPipeline : public AbstractPipeline
+{
+    public:
+        BenchmarkPipeline() : AbstractPipeline(), amplifier(0) {}
+        ~BenchmarkPipeline() { delete amplifier; }
+        void init() { amplifier = (SignalAmplifier*) createModule("SignalAmplifier"); }
+        void run(QHash<QString, DataBlob*>&) {}
+        SignalAmplifier* amplifier;
+};
+
+// Returns the mean time in milliseconds to amplify the signal.
+double timeAmplifier(SignalAmplifier* amplifier, const SignalData& input,
+        SignalData& output, int iterations)
+{
+    amplifier->run(&input, &output); // Warm up.
+    quint64 start = AtomicCounter::now();
+    for (int i = 0; i < iterations; ++i)
+        amplifier->run(&input, &output);
+    return (AtomicCounter::now() - start) / (iterations * 1.0e6);
+}
+
+// Times the SignalAmplifier module on a large signal, run on a single
+// thread and then on the threads of the task scheduler, e.g.
+//
+//     signalBenchmark --config=pipelineConfig.xml
+//
+// The threads and grain size are set in the configuration file with
+// <scheduler threads="4"/> in the pipelineConfig section and
+// <grain value="65536"/> in the SignalAmplifier section.
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    try {
+        PipelineApplication pApp(argc, argv);
+
+        // The module created by the factory is not in a pipeline, so runs
+        // on the calling thread.
+        SignalAmplifier* serial =
+                (SignalAmplifier*) pApp.moduleFactory()->create("SignalAmplifier");
+
+        // The module created by the registered pipeline uses the scheduler.
+        BenchmarkPipeline* pipeline = new BenchmarkPipeline;
+        pApp.registerPipeline(pipeline);
+
+        // A signal of 16 million samples.
+        SignalData input, output;
+        input.resize(1 << 24);
+        float* in = input.ptr();
+        for (unsigned i = 0; i < input.size(); ++i)
+            in[i] = (float)(i % 1000);
+
+        int iterations = 20;
+        double serialTime = timeAmplifier(serial, input, output, iterations);
+        double parallelTime = timeAmplifier(pipeline->amplifier, input, output, iterations);
+        std::cout << "Samples:   " << input.size() << std::endl;
+        std::cout << "Threads:   " << pApp.taskScheduler()->threads() << std::endl;
+        std::cout << "Serial:    " << serialTime << " ms" << std::endl;
+        std::cout << "Parallel:  " << parallelTime << " ms" << std::endl;
+        std::cout << "Speed-up:  " << serialTime / parallelTime << std::endl;
+        delete serial;
+    }
+
+    // Catch any error messages from Pelican.
+    catch (const QString& err) {
+        std::cerr << "Error: " << err.toStdString() << std::endl;
+    }
+
+    return 0;
+}
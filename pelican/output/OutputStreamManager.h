@@ -9,6 +9,7 @@
 #include "pelican/utility/FactoryConfig.h"
 #include "pelican/utility/Config.h"
 #include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/LatencyTrace.h"
 
 // include the basic types available for all pelican users
 // to ensure the factory is aware of them
@@ -18,6 +19,7 @@
 #include <QtCore/QString>
 #include <QtCore/QMap>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
 
 namespace pelican {
 
@@ -34,6 +36,9 @@ class DataBlob;
  *   Data output streams are managed by this object and, any data sent will be routed through to
  *   the correct output channel. Any streamer added to this object will become owned by this object.
  *
+ *   The latency of the data sent (from its ingest by the server) is
+ *   recorded with the LatencyMonitor.
+ *
  *   Configuration xml format:
  *   @code
  *   <output>
@@ -62,7 +67,10 @@ class OutputStreamManager
         ~OutputStreamManager();
 
         /// send data to all relevant outputs on the specified stream
-        void send( const DataBlob* data, const QString& stream );
+        //  (with the latency trace of the data it was made from, if not
+        //  the blob's own)
+        void send( const DataBlob* data, const QString& stream,
+                const LatencyTrace* trace = 0 );
 
         /// associate an output streamer to a specific data stream
         void connectToStream( AbstractOutputStream* streamer, const QString& stream);
@@ -73,6 +81,7 @@ class OutputStreamManager
     private:
         FactoryConfig<AbstractOutputStream>* _factory;
         QMap< QString, QList<AbstractOutputStream*> > _streamers;
+        QMutex _mutex;
 
 };
 
@@ -1,9 +1,12 @@
 #include <iostream>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QtDebug>
 #include <QtCore/QStringList>
 #include "OutputStreamManager.h"
 #include "pelican/utility/Config.h"
 #include "pelican/utility/ConfigNode.h"
+#include "pelican/utility/LatencyMonitor.h"
+#include "pelican/data/DataBlob.h"
 
 namespace pelican {
 
@@ -108,12 +111,28 @@ void OutputStreamManager::connectToStream(AbstractOutputStream* streamer, const
     _streamers[stream].append(streamer);
 }
 
-void OutputStreamManager::send( const DataBlob* data, const QString& stream )
+/**
+ * @details
+ * Sends the data to the streamers of the stream, and records the latency
+ * of the output from the given trace or, if that is not valid, the blob's
+ * own trace.
+ */
+void OutputStreamManager::send( const DataBlob* data, const QString& stream,
+        const LatencyTrace* trace )
 {
+    // Pipelines may be run on several threads (see PipelineDriver).
+    QMutexLocker locker(&_mutex);
     if( _streamers.contains(stream) ) {
         foreach( AbstractOutputStream* out, _streamers[stream]) {
             out->send(stream, data);
         }
+        if( ! trace || ! trace->isValid() )
+            trace = &data->latencyTrace();
+        if( trace->isValid() ) {
+            LatencyTrace sent(*trace);
+            sent.stamp(LatencyTrace::Output);
+            LatencyMonitor::instance()->record(sent, LatencyTrace::Output);
+        }
     }
 }
 
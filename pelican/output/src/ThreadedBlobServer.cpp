@@ -1,5 +1,6 @@
 #include "pelican/output/ThreadedBlobServer.h"
 #include "pelican/output/TCPConnectionManager.h"
+#include "pelican/utility/ThreadPlacement.h"
 
 #include <QtCore/QTimer>
 
@@ -42,6 +43,7 @@ int ThreadedBlobServer::clientsForStream(const QString& stream) const
 
 void ThreadedBlobServer::run()
 {
+    ThreadPlacement::place("ThreadedBlobServer");
     // Create a connection manager in the thread and run it inside the event loop
     // using a boost shared_ptr will ensure it gets deleted when we leave the scope
     _manager.reset( new TCPConnectionManager(_port) );
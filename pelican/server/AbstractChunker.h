@@ -36,8 +36,11 @@ class ConfigNode;
 class AbstractChunker
 {
     private:
+        friend class PacketReassembler;
+
         QString _host;      ///< Host address for incoming connections.
         quint16 _port;      ///< Port for incoming connections.
+        int _threads;       ///< Receiver threads sharing the port.
 
         DataManager* _dataManager;  ///< Data manager used to access writable data objects.
         QList<QString> _chunkTypes; ///< List of the chunk data types written.
@@ -52,7 +55,7 @@ class AbstractChunker
         AbstractChunker(const ConfigNode& config);
 
         /// Constructs a new AbstractChunker (used in testing).
-        AbstractChunker() : _host(""), _port(0), _dataManager(0),
+        AbstractChunker() : _host(""), _port(0), _threads(1), _dataManager(0),
         _active(false)
         {}
 
@@ -82,6 +85,12 @@ class AbstractChunker
         /// Returns the port.
         quint16 port() { return _port; }
 
+        /// Sets the number of receiver threads sharing the port.
+        void setThreads(int threads) { _threads = threads; }
+
+        /// Returns the number of receiver threads sharing the port.
+        int threads() const { return _threads; }
+
         /// Sets the type name to be associated with this data.
         void setChunkTypes(const QList<QString> & types) { _chunkTypes = types; }
 
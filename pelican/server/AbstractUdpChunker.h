@@ -0,0 +1,164 @@
+#ifndef ABSTRACTUDPCHUNKER_H
+#define ABSTRACTUDPCHUNKER_H
+
+/**
+ * @file AbstractUdpChunker.h
+ */
+
+#include "pelican/server/AbstractChunker.h"
+#include "pelican/utility/AtomicCounter.h"
+
+#include <QtCore/QVector>
+
+namespace pelican {
+
+/**
+ * @ingroup c_server
+ *
+ * @class AbstractUdpChunker
+ *
+ * @brief
+ * Base class for chunkers of fixed-size UDP packets at high rates.
+ *
+ * @details
+ * The chunker owns its UDP socket and receives batches of datagrams with
+ * recvmmsg() directly into the chunk memory, one packet after another,
+ * without reading them one at a time through a QUdpSocket. A derived
+ * chunker only implements parseHeader() to check each packet, e.g.
+ *
+ * \code
+ * class MyChunker : public AbstractUdpChunker
+ * {
+ *     public:
+ *         MyChunker(const ConfigNode& config) : AbstractUdpChunker(config) {}
+ *     protected:
+ *         bool parseHeader(const char* packet, int size) {
+ *             return ((const MyHeader*)packet)->magic == MY_MAGIC;
+ *         }
+ * };
+ * PELICAN_DECLARE_CHUNKER(MyChunker)
+ * \endcode
+ *
+ * and is configured with e.g.
+ *
+ * \verbatim
+ * <MyChunker>
+ *     <connection host="0.0.0.0" port="4000"/>
+ *     <data type="VisibilityData" chunkSize="1048576"/>
+ *     <packet size="8192" batch="64"/>
+ *     <socket receiveBuffer="67108864" busyPoll="50"/>
+ * </MyChunker>
+ * \endverbatim
+ *
+ * Each chunk holds \c chunkSize / \c size packets, which must divide
+ * exactly. Datagrams of any other size, or rejected by parseHeader(), are
+ * dropped and their place taken by the next packet. Up to \c batch
+ * (default 64) datagrams are received with each call.
+ *
+ * The socket's receive buffer is set to \c receiveBuffer bytes (default
+ * 64 MiB; above the kernel's net.core.rmem_max this needs CAP_NET_ADMIN).
+ * With \c busyPoll set (in microseconds) the chunker polls the socket
+ * without sleeping, and asks the kernel to busy-poll the device queue
+ * (SO_BUSY_POLL), trading a core for lower latency; otherwise it sleeps
+ * in poll() until data arrives.
+ *
+ * With \c threads set on the connection tag, e.g.
+ *
+ * \verbatim
+ * <connection host="0.0.0.0" port="4000" threads="4"/>
+ * \endverbatim
+ *
+ * the server runs that many copies of the chunker, each on its own receiver
+ * thread with its own socket bound to the port with SO_REUSEPORT. The
+ * kernel spreads the datagrams over the sockets by a hash of their source
+ * and destination addresses and ports, so the senders must use at least
+ * as many source ports (or hosts) as there are threads, and each chunk
+ * should be sent from one of them. To serve the chunks in order, a
+ * derived chunker implements sequence() to read a packet's sequence
+ * number, which is set for the chunk from its first packet (see
+ * PacketStats), and the stream buffer puts the chunks of all the threads
+ * back in sequence order (see StreamDataBuffer::setOrdered()).
+ *
+ * Packets dropped by the kernel because the receive buffer was full are
+ * counted by kernelDrops(), from the socket's SO_RXQ_OVFL counter, and
+ * packets that found no room in the stream buffer by discarded().
+ *
+ * Requires Linux.
+ */
+class AbstractUdpChunker : public AbstractChunker
+{
+    public:
+        /// Constructs the chunker.
+        AbstractUdpChunker(const ConfigNode& config);
+
+        /// Destroys the chunker.
+        virtual ~AbstractUdpChunker();
+
+        /// Opens and binds the UDP socket.
+        virtual QIODevice* newDevice();
+
+        /// Receives packets into chunks until the chunker is stopped.
+        virtual void next(QIODevice*);
+
+        /// Returns the number of packets written to chunks.
+        quint64 received() const { return _received.value(); }
+
+        /// Returns the number of datagrams rejected (size or header).
+        quint64 rejected() const { return _rejected.value(); }
+
+        /// Returns the number of packets that found no room in the buffer.
+        quint64 discarded() const { return _discarded.value(); }
+
+        /// Returns the number of packets dropped by the kernel.
+        quint64 kernelDrops() const { return _kernelDrops.value(); }
+
+    protected:
+        /// Checks a packet received into a chunk, returning false to drop
+        /// it (pure virtual).
+        virtual bool parseHeader(const char* packet, int size) = 0;
+
+        /// Sets the sequence number of a packet kept by parseHeader(),
+        /// returning false if packets are not numbered (the default).
+        virtual bool sequence(const char*, quint64*) { return false; }
+
+        /// Returns the size of each packet.
+        int packetSize() const { return _packetSize; }
+
+        /// Returns the number of packets in each chunk.
+        int packetsPerChunk() const { return _packetsPerChunk; }
+
+    private:
+        struct Messages;
+
+        /// Receives up to n packets into consecutive slots from ptr,
+        /// returning the number of datagrams received.
+        int _receive(char* ptr, int n);
+
+        /// Keeps the valid packets of those received into slots from
+        /// ptr, moving them together, and returns how many were kept.
+        int _keep(char* ptr, int n);
+
+        /// Sets the sequence number of a chunk from its first packet.
+        void _setSequence(WritableData& writableData, int filled);
+
+        /// Sets a socket option, returning false if it failed.
+        bool _setOption(int level, int option, int value);
+
+    private:
+        int _socket;
+        int _packetSize;
+        int _packetsPerChunk;
+        int _batch;
+        int _receiveBuffer;
+        int _busyPoll;
+        QVector<char> _scratch;
+        Messages* _messages;
+        AtomicCounter _received;
+        AtomicCounter _rejected;
+        AtomicCounter _discarded;
+        AtomicCounter _kernelDrops;
+};
+
+} // namespace pelican
+
+#endif // ABSTRACTUDPCHUNKER_H
@@ -0,0 +1,124 @@
+#ifndef CHUNKSCHEDULER_H
+#define CHUNKSCHEDULER_H
+
+/**
+ * @file ChunkScheduler.h
+ */
+
+#include <QtCore/QString>
+#include <QtCore/QSet>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+namespace pelican {
+
+class DataManager;
+
+/**
+ * @ingroup c_server
+ *
+ * @class ChunkScheduler
+ *
+ * @brief
+ * Decides which of the sessions waiting for stream data is served next.
+ *
+ * @details
+ * Without a scheduler, sessions waiting for the same stream race for each
+ * chunk as it is activated. With one, a session asks mayTake() before
+ * taking stream data, and is only allowed to if no other waiting session
+ * that wants any of the same streams is a better choice: the one with the
+ * fewest chunks outstanding (served but not yet finished with by the
+ * client), then the one that has waited longest. A slow client therefore
+ * builds up outstanding work and is passed over in favour of idle ones.
+ *
+ * Sessions report chunks sent with served(), and chunks the client has
+ * finished with (e.g. on a new request or a returned credit) with
+ * completed().
+ *
+ * Throughput (an exponentially weighted moving average) and queue depth
+ * are kept for each client name, and reported by stats().
+ *
+ * All methods are thread safe.
+ */
+class ChunkScheduler
+{
+    public:
+        /// Statistics for a client.
+        struct ClientStats {
+            QString name;      ///< Client name.
+            int sessions;      ///< Sessions open for the client.
+            quint64 chunks;    ///< Chunks served.
+            quint64 bytes;     ///< Bytes of stream data served.
+            double chunkRate;  ///< Recent chunks served per second.
+            double byteRate;   ///< Recent bytes served per second.
+            int outstanding;   ///< Chunks served but not yet completed.
+            int waiting;       ///< Sessions waiting for data.
+        };
+
+    public:
+        /// Creates a scheduler that wakes the data manager's waiters.
+        ChunkScheduler(DataManager* manager = 0);
+
+        /// Destroys the scheduler.
+        ~ChunkScheduler();
+
+        /// Registers a session for the named client, returning its handle.
+        int add(const QString& name);
+
+        /// Unregisters the session.
+        void remove(int handle);
+
+        /// Marks the session as waiting for the streams, and returns true
+        /// if it should be the one to take the next chunk.
+        bool mayTake(int handle, const QSet<QString>& streams);
+
+        /// Marks the session as no longer waiting.
+        void cancel(int handle);
+
+        /// Records a chunk of the given size served to the session.
+        void served(int handle, quint64 bytes);
+
+        /// Records chunks completed by the client (< 0 for all).
+        void completed(int handle, int chunks = -1);
+
+        /// Returns the statistics for each client.
+        QList<ClientStats> stats();
+
+    private:
+        /// State of a registered session.
+        struct Entry {
+            QString name;
+            int outstanding;
+            quint64 ticket;    ///< Order in which it started waiting (0 = not waiting).
+            QSet<QString> streams;
+        };
+
+        /// Running totals for a client.
+        struct Totals {
+            int sessions;
+            quint64 chunks;
+            quint64 bytes;
+            double chunkRate;
+            double byteRate;
+            double last;       ///< Time of the last chunk served (s).
+        };
+
+    private:
+        ChunkScheduler(const ChunkScheduler&); // Disallow copying.
+
+        /// Returns the time in seconds.
+        static double _now();
+
+    private:
+        DataManager* _manager;
+        QMutex _mutex;
+        QHash<int, Entry> _sessions;
+        QHash<QString, Totals> _clients;
+        int _nextHandle;
+        quint64 _nextTicket;
+};
+
+} // namespace pelican
+
+#endif // CHUNKSCHEDULER_H
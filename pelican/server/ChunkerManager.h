@@ -34,6 +34,14 @@ class DataManager;
  * @details
  * Anything coming through a stream data chunker will be associated with the
  * current version of service data service data has no such association.
+ *
+ * Each chunker is run by its own DataReceiver thread. A stream chunker
+ * derived from the AbstractUdpChunker and configured with more than one
+ * thread (see AbstractChunker::threads()) is created that many times, each
+ * copy with its own receiver and socket on the same port, writing into the
+ * same stream buffers, which then serve the chunks in sequence order (see
+ * StreamDataBuffer::setOrdered()). Other chunkers can not share a port, so
+ * are refused more than one thread.
  */
 
 class ChunkerManager
@@ -71,15 +79,21 @@ class ChunkerManager
 
     private:
         // Adds an allocated chunker to the manager.
-        void _addChunker( AbstractChunker* chunker);
+        void _addChunker( AbstractChunker* chunker, const QString& name);
+
+        // Adds a copy of the chunker for each of its further threads.
+        void _addThreads(AbstractChunker* chunker, const QString& type,
+                const QString& name);
 
     private:
         FactoryConfig<AbstractChunker> *_factory;
         QMap<QPair<QString,quint16>,AbstractChunker* > _chunkerPortMap;
         QSet<AbstractChunker* > _chunkers;
         QSet<QString> _streamDataTypes;
+        QHash<QString, int> _streamThreads; ///< Receiver threads, by stream.
         QSet<QString> _serviceDataTypes;
         QHash<AbstractChunker*, DataReceiver*> _dataReceivers;
+        QHash<AbstractChunker*, QString> _chunkerNames;
 };
 
 } // namespace pelican
@@ -7,16 +7,23 @@
 
 #include <QtCore/QString>
 #include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMap>
 #include "pelican/server/StreamDataBuffer.h"
 #include "pelican/server/ServiceDataBuffer.h"
 #include "pelican/server/LockedData.h"
 #include "pelican/data/DataSpec.h"
 #include "pelican/utility/Config.h"
+#include "pelican/utility/EventCount.h"
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/comms/ServerRequest.h"
 
 namespace pelican {
 
 class DataChunk;
 class StreamData;
+class ChunkScheduler;
+class StreamRecorder;
 
 /**
  * @ingroup c_server
@@ -38,6 +45,76 @@ class StreamData;
  * <MyStream>
  *      <buffer maxSize="10240"> tags
  * </MyStream>
+ *
+ * Stream buffers allocate memory for each chunk as it is needed by default.
+ * Setting the allocation attribute to "slab" reserves the whole buffer up
+ * front as a ring of maxChunkSize slots (see StreamDataBuffer), e.g.
+ *
+ * <MyStream>
+ *      <buffer maxSize="10485760" maxChunkSize="8192" allocation="slab"/>
+ * </MyStream>
+ *
+ * Setting allocation="shared" places the slab in POSIX shared memory, for
+ * clients on the same host served by a SharedMemoryProtocol.
+ *
+ * Setting serveQueue="lockfree" on the buffer tag selects the lock-free
+ * serve queue (and implies slab allocation).
+ *
+ * Setting broadcast="true" serves every chunk of the stream to every
+ * consumer (see StreamDataBuffer::setBroadcast()), e.g.
+ *
+ * <MyStream>
+ *      <buffer maxSize="10485760" broadcast="true" lagPolicy="drop"
+ *              maxLag="16" consumers="science,monitoring"/>
+ * </MyStream>
+ *
+ * lagPolicy is "drop" (the default) or "wait", maxLag defaults to 0 (no
+ * limit) and the consumers listed are registered when the buffer is
+ * created, so that data is kept for them before they first connect.
+ *
+ * Setting spillSize (in bytes) writes chunks that do not fit in the buffer
+ * to a memory-mapped file, rather than dropping waiting data (see
+ * StreamDataBuffer::setSpillFile()), e.g.
+ *
+ * <MyStream>
+ *      <buffer maxSize="10485760" spillSize="1073741824"
+ *              spillFile="/data/spill/MyStream"/>
+ * </MyStream>
+ *
+ * The file defaults to pelican.<pid>.<stream>.spill in the temporary
+ * directory.
+ *
+ * The memory of stream and service buffers can be put on huge pages
+ * (pages="2M" or "1G", falling back to normal pages if none are reserved),
+ * locked into RAM (lock="true") and bound to a NUMA node (numaNode="1"),
+ * see BufferMemory, e.g.
+ *
+ * <MyStream>
+ *      <buffer maxSize="1073741824" maxChunkSize="2097152" allocation="slab"
+ *              pages="2M" lock="true" numaNode="0"/>
+ * </MyStream>
+ *
+ * Sessions competing for the same stream data can be scheduled, rather
+ * than racing for each chunk, by enabling a ChunkScheduler with
+ * setScheduling() (see the \c loadBalance attribute of the server's
+ * \c sessions tag).
+ *
+ * Every chunk activated on the stream buffers can be written to a file
+ * with setRecording() (see the \c record tag of the server section), for
+ * replay with the ReplayChunker.
+ *
+ * metrics() collects the counters of every buffer, the requests handled by
+ * sessions (reported with requestCompleted()) and the scheduler statistics,
+ * for the ServerRequest::Metrics request.
+ *
+ * Consumers waiting for stream data can block until a chunk is activated
+ * on any stream buffer:
+ *
+ * @code
+ * EventCount::Key key = manager.prepareStreamDataWait();
+ * if( ! dataReady() ) manager.waitForStreamData(key, timeout);
+ * else manager.cancelStreamDataWait();
+ * @endcode
  */
 class DataManager
 {
@@ -69,15 +146,17 @@ class DataManager
 
         /// Return a list of Stream Data objects corresponding
         //  to a DataSpec object
-        QList<LockedData> getDataRequirements(const DataSpec& req);
+        QList<LockedData> getDataRequirements(const DataSpec& req,
+                const QString& consumer = QString());
 
         /// Return the next unlocked data block from Stream Data.
         /// If the associate data requested is unavailable,
         /// LockedData will be invalid.
-        LockedData getNext(const QString& type, const QSet<QString>& associateData);
+        LockedData getNext(const QString& type, const QSet<QString>& associateData,
+                const QString& consumer = QString());
 
         /// Return the next unlocked data block from Stream Data.
-        LockedData getNext(const QString& type);
+        LockedData getNext(const QString& type, const QString& consumer = QString());
 
         /// Return the requested Service Data.
         LockedData getServiceData(const QString& type, const QString& version);
@@ -107,6 +186,54 @@ class DataManager
         //  to be called by the streambuffer only
         void emptiedBuffer(StreamDataBuffer* buffer);
 
+        /// indicate that a chunk has been activated on a stream buffer
+        //  (or may be taken by another session, if scheduled)
+        void streamDataActivated();
+
+        /// Enables or disables scheduling of the sessions taking stream data.
+        void setScheduling(bool enabled);
+
+        /// Returns the session scheduler, or 0 if scheduling is disabled.
+        ChunkScheduler* scheduler() const { return _scheduler; }
+
+        /// Records the chunks activated on every stream buffer to the file
+        /// (an empty path stops recording).
+        void setRecording(const QString& path);
+
+        /// Returns the stream recorder, or 0 if not recording.
+        StreamRecorder* recorder() const { return _recorder; }
+
+        /// Records a request of the given type handled in the given time (ns).
+        void requestCompleted(ServerRequest::Request type, quint64 time);
+
+        /// Returns the current metrics of the buffers and requests.
+        QMap<QString, double> metrics() const;
+
+        /// Announce the intention to wait for stream data, returning the
+        /// key to pass to waitForStreamData().
+        EventCount::Key prepareStreamDataWait()
+        { return _streamDataActivated.prepareWait(); }
+
+        /// Withdraw a prepareStreamDataWait() without waiting.
+        void cancelStreamDataWait() { _streamDataActivated.cancelWait(); }
+
+        /// Block until a stream chunk is activated after the key was taken,
+        /// or until timeout ms (< 0 to wait forever) have passed.
+        bool waitForStreamData(EventCount::Key key, int timeout = -1)
+        { return _streamDataActivated.wait(key, timeout); }
+
+        /// Register a descriptor (e.g. an eventfd) to be written to on the
+        /// next stream data activation after it is armed.
+        /// Returns a handle for the other wakeup descriptor methods.
+        int addWakeupDescriptor(int fd);
+
+        /// Arm the wakeup descriptor for the next stream data activation.
+        void armWakeupDescriptor(int handle);
+
+        /// Unregister a wakeup descriptor, waiting for any write to it
+        /// to finish.
+        void removeWakeupDescriptor(int handle);
+
         /// set the max buffer size to be used for any new buffers
         //  to be created of the specified stream
         void setMaxBufferSize( const QString& stream, size_t size );
@@ -125,6 +252,26 @@ class DataManager
         QHash<QString,size_t> _bufferMaxSizes;
         QHash<QString,size_t> _bufferMaxChunkSizes;
         int _verboseLevel;
+        EventCount _streamDataActivated;
+        ChunkScheduler* _scheduler;
+        StreamRecorder* _recorder;
+
+        /// Request counters, indexed by request type.
+        enum { requestTypes = ServerRequest::Metrics + 1 };
+        AtomicCounter _requests[requestTypes];
+        AtomicCounter _requestTime[requestTypes];
+        AtomicCounter _requestMaxTime[requestTypes];
+
+        /// Descriptors written to on stream data activation.
+        struct WakeupDescriptor {
+            volatile int fd;
+            volatile int armed;
+            volatile int writers; ///< Writes to fd in progress.
+        };
+        enum { maxWakeupDescriptors = 64 };
+        WakeupDescriptor _wakeups[maxWakeupDescriptors];
+        volatile int _wakeupCount;
+        QMutex _wakeupMutex;
 };
 
 } // namespace pelican
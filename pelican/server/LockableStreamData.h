@@ -50,6 +50,9 @@ class LockableStreamData : public AbstractLockableData
         /// Returns true if the object has been served.
         bool& served() { return _served; };
 
+        /// Returns the number of broadcast consumers yet to take the object.
+        int& readers() { return _readers; }
+
         /// Test validity of data only taking into account the named associates.
         bool isValid(const QSet<QString>&) const;
 
@@ -71,6 +74,7 @@ class LockableStreamData : public AbstractLockableData
         DataList_t _serviceData;
         QSet<QString> _serviceDataTypes;
         bool _served;
+        int _readers;
 };
 
 } // namespace pelican
@@ -0,0 +1,51 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QtNetwork/QTcpServer>
+
+/**
+ * @file MetricsServer.h
+ */
+
+namespace pelican {
+
+class DataManager;
+
+/**
+ * @ingroup c_server
+ *
+ * @class MetricsServer
+ *
+ * @brief
+ *    Serves the server metrics over HTTP in the Prometheus text format.
+ *
+ * @details
+ *    Internal class used by PelicanServer. Any GET request is answered
+ *    with the metrics of the data manager (see DataManager::metrics())
+ *    and the connection is closed.
+ *
+ *    The server handles its connections in the thread that owns it, so
+ *    that thread must run an event loop.
+ */
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+
+    public:
+        /// Creates a server for the data manager's metrics.
+        MetricsServer(DataManager* data, QObject* parent = 0);
+
+        /// Destroys the server.
+        ~MetricsServer();
+
+    private slots:
+        void _newConnection();
+        void _readRequest();
+
+    private:
+        DataManager* _data;
+};
+
+} // namespace pelican
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,187 @@
+#ifndef PACKETREASSEMBLER_H
+#define PACKETREASSEMBLER_H
+
+/**
+ * @file PacketReassembler.h
+ */
+
+#include "pelican/server/WritableData.h"
+#include "pelican/comms/PacketStats.h"
+#include "pelican/utility/AtomicCounter.h"
+
+#include <QtCore/QBitArray>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+namespace pelican {
+
+class AbstractChunker;
+class ConfigNode;
+
+/**
+ * @ingroup c_server
+ *
+ * @class PacketReassembler
+ *
+ * @brief
+ * Assembles chunks from sequence numbered packets, in order.
+ *
+ * @details
+ * A chunker passes each packet it receives to add(). The reassembler
+ * reads the packet's sequence number and timestamp with the chunker's
+ * Header functor and copies the payload (the packet after the header) to
+ * its place in the chunk for that sequence number, so that packets that
+ * arrive out of order end up in order.
+ *
+ * Chunks hold a fixed number of packets, starting from the first sequence
+ * number received. A chunk is released to be served once it is full, or
+ * once a packet arrives that is more than the reorder window past its last
+ * packet, at which point its missing packets are counted as lost. Chunks
+ * are released in order, so several are held open while the window spans
+ * a chunk boundary. Packets for a chunk already released are counted as
+ * late and dropped.
+ *
+ * The gaps left by lost packets are zero-filled or, with \c gaps="flag",
+ * left as they are and listed in the chunk's PacketStats, which also
+ * records the packets lost and reordered. A chunk with no packets at all
+ * is not served.
+ *
+ * Configured from the chunker's configuration node, e.g.
+ *
+ * \verbatim
+ * <reassembly header="16" payload="8192" packets="128" window="256" gaps="zero"/>
+ * \endverbatim
+ *
+ * where \c header and \c payload are bytes, and \c packets is the number
+ * of packets in each chunk.
+ *
+ * For example:
+ *
+ * \code
+ * struct MyHeader : public PacketReassembler::Header {
+ *     bool operator()(const char* packet, int size, quint64* sequence,
+ *             quint64* timestamp) const {
+ *         const MyPacketHeader* h = (const MyPacketHeader*)packet;
+ *         *sequence = h->sequence;
+ *         *timestamp = h->timestamp;
+ *         return size == sizeof(MyPacketHeader) + 8192;
+ *     }
+ * };
+ *
+ * // In the chunker (with a MyHeader _header member):
+ * _reassembler = new PacketReassembler(this, &_header, config);
+ * ...
+ * _reassembler->add(packet, size); // for each packet received
+ * \endcode
+ */
+class PacketReassembler
+{
+    public:
+        /// Reads the sequence number and timestamp of a packet.
+        class Header
+        {
+            public:
+                virtual ~Header() {}
+
+                /// Sets the sequence number and timestamp of the packet,
+                /// returning false if it is not a valid packet.
+                virtual bool operator()(const char* packet, int size,
+                        quint64* sequence, quint64* timestamp) const = 0;
+        };
+
+        /// What to do with the gaps left by lost packets.
+        typedef enum { ZeroFill, Flag } GapPolicy;
+
+    public:
+        /// Constructs a reassembler writing the chunker's chunks.
+        PacketReassembler(AbstractChunker* chunker, const Header* header,
+                const ConfigNode& config, const QString& stream = QString());
+
+        /// Constructs a reassembler with the given layout.
+        PacketReassembler(AbstractChunker* chunker, const Header* header,
+                int headerSize, int payloadSize, int packets, int window,
+                GapPolicy gaps = ZeroFill, const QString& stream = QString());
+
+        /// Releases the open chunks.
+        ~PacketReassembler();
+
+        /// Places a packet in its chunk.
+        void add(const char* packet, int size);
+
+        /// Releases the open chunks, counting their missing packets lost.
+        void flush();
+
+        /// Returns the size of each chunk (bytes).
+        size_t chunkSize() const { return (size_t)_packets * _payloadSize; }
+
+        /// Returns the number of packets placed in chunks.
+        quint64 received() const { return _received.value(); }
+
+        /// Returns the number of packets lost from released chunks.
+        quint64 lost() const { return _lost.value(); }
+
+        /// Returns the number of packets that arrived out of order.
+        quint64 reordered() const { return _reordered.value(); }
+
+        /// Returns the number of packets that arrived after their chunk
+        /// was released.
+        quint64 late() const { return _late.value(); }
+
+        /// Returns the number of packets received more than once.
+        quint64 duplicates() const { return _duplicates.value(); }
+
+        /// Returns the number of packets the header functor rejected.
+        quint64 rejected() const { return _rejected.value(); }
+
+        /// Returns the number of packets for chunks that found no room in
+        /// the buffer.
+        quint64 discarded() const { return _discarded.value(); }
+
+    private:
+        /// A chunk being assembled.
+        struct Chunk {
+            WritableData data;
+            quint64 first;
+            QBitArray filled;
+            int count;
+            int earliest;
+            PacketStats stats;
+        };
+
+        /// Sets up the reassembler.
+        void _init();
+
+        /// Opens the chunk starting at the given sequence number.
+        void _open(quint64 first);
+
+        /// Releases the oldest open chunk.
+        void _release();
+
+    private:
+        AbstractChunker* _chunker;
+        const Header* _header;
+        QString _stream;
+        int _headerSize;
+        int _payloadSize;
+        int _packets;
+        int _window;
+        GapPolicy _gaps;
+
+        bool _started;
+        quint64 _base;     ///< Sequence number of the first chunk.
+        quint64 _next;     ///< First sequence number of the next chunk to open.
+        quint64 _highest;  ///< Highest sequence number received.
+        QList<Chunk*> _chunks;
+
+        AtomicCounter _received;
+        AtomicCounter _lost;
+        AtomicCounter _reordered;
+        AtomicCounter _late;
+        AtomicCounter _duplicates;
+        AtomicCounter _rejected;
+        AtomicCounter _discarded;
+};
+
+} // namespace pelican
+
+#endif // PACKETREASSEMBLER_H
@@ -3,6 +3,8 @@
 
 
 #include <QtNetwork/QTcpServer>
+#include <QtCore/QList>
+#include <QtCore/QString>
 
 /**
  * @file PelicanPortServer.h
@@ -23,8 +25,17 @@ class DataManager;
  *    Internal class used by PelicanServer
  *    Each port is associated with a single protocol
  *
+ *    By default each connection is handed to a new Session thread that
+ *    handles a single request. In keep-alive mode connections carry any
+ *    number of requests, and are handled either by a Session thread each
+ *    or, if worker threads are set, shared between a fixed pool of
+ *    SessionWorker threads.
+ *
+ *    The server can also listen on a Unix domain socket, for clients on
+ *    the same host, with listenLocal().
  */
 class Session;
+class SessionWorker;
 
 class PelicanPortServer : public QTcpServer
 {
@@ -37,6 +48,16 @@ class PelicanPortServer : public QTcpServer
 
         void setVerbosity(int level) { _verboseLevel=level; };
 
+        /// Serve many requests per connection (default false).
+        void setKeepAlive(bool keepAlive) { _keepAlive = keepAlive; }
+
+        /// Use a pool of worker threads for keep-alive connections
+        /// (0 = a thread per connection).
+        void setWorkerThreads(int threads);
+
+        /// Listen on a Unix domain socket at the given path.
+        bool listenLocal(const QString& path);
+
     protected:
         /// Reimplemented from QTcpServer.
         void incomingConnection(int socketDescriptor);
@@ -45,6 +66,10 @@ class PelicanPortServer : public QTcpServer
         AbstractProtocol* _proto;
         DataManager* _data;
         int _verboseLevel;
+        bool _keepAlive;
+        QList<SessionWorker*> _workers;
+        int _nextWorker;
+        QString _localPath;
 };
 
 } // namespace pelican
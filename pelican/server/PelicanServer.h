@@ -35,6 +35,36 @@ class PelicanPortServer;
  * and listens on the specified socket. On an connection a Session
  * object is spawned in another thread
  *
+ * Connections can be kept open for many requests by setting
+ * \verbatim <sessions keepAlive="true" threads="4"/> \endverbatim
+ * in the \c server configuration section. With \c threads set, the
+ * connections are shared between that many SessionWorker threads instead
+ * of using a thread per connection.
+ *
+ * Setting \c zeroCopy="true" on the \c sessions tag sends large stream
+ * data chunks with MSG_ZEROCOPY (see PelicanProtocol::setZeroCopy()),
+ * except on the connections of SessionWorker threads, which do not wait
+ * for their sends.
+ *
+ * Setting \c loadBalance="true" on the \c sessions tag schedules the
+ * sessions that compete for the same stream data (see ChunkScheduler), so
+ * that each chunk goes to the least loaded waiting client, rather than to
+ * whichever session wakes first.
+ *
+ * Every chunk of stream data received can be recorded to a file with
+ * \verbatim <record file="capture.rec"/> \endverbatim
+ * in the \c server section, and replayed later with the ReplayChunker.
+ *
+ * Clients can ask for the server metrics (buffer occupancy, chunks written,
+ * served and dropped, request latency) with a ServerRequest::Metrics.
+ * They are also served over HTTP, in the Prometheus text format, with
+ * \verbatim <metrics port="9100" host="127.0.0.1"/> \endverbatim
+ * (the host defaults to the loopback interface).
+ *
+ * Protocols can also be served on Unix domain sockets with
+ * addLocalProtocol(), for clients on the same host. Local connections are
+ * always kept alive.
+ *
  * \par Example of using the server:
  * \include examples/mainServerExample.cpp
  */
@@ -51,6 +81,10 @@ class PelicanServer : public QThread
         /// Ownership of AbstractProtocol is transferred to this class.
         void addProtocol(AbstractProtocol*, quint16 port);
 
+        /// Associate a Unix domain socket with a particular protocol.
+        /// Ownership of AbstractProtocol is transferred to this class.
+        void addLocalProtocol(AbstractProtocol*, const QString& path);
+
         /// Adds a stream chunker.
         void addStreamChunker(QString type, QString name = QString());
 
@@ -70,6 +104,7 @@ class PelicanServer : public QThread
 
     private:
         QMap<quint16,AbstractProtocol*> _protocolPortMap;
+        QMap<QString,AbstractProtocol*> _protocolPathMap;
         QMutex _mutex;
         ChunkerManager* _chunkerManager;
         bool _ready;
@@ -0,0 +1,76 @@
+#ifndef REPLAYCHUNKER_H
+#define REPLAYCHUNKER_H
+
+
+#include "pelican/server/AbstractChunker.h"
+
+/**
+ * @file ReplayChunker.h
+ */
+
+namespace pelican {
+
+class StreamRecording;
+
+/**
+ * @ingroup c_server
+ *
+ * @class ReplayChunker
+ *
+ * @brief
+ *   Chunker that replays a recording of stream data.
+ * @details
+ *   Writes the chunks of a recording made with a StreamRecorder into the
+ *   server's stream buffers, byte for byte, so that the same load can be
+ *   served repeatedly, e.g.
+ *
+ * \verbatim
+ * <ReplayChunker file="capture.rec" speed="1" loops="1">
+ *     <data type="VisibilityData"/>
+ * </ReplayChunker>
+ * \endverbatim
+ *
+ *   Only the chunks of the streams given by the \c data tags are replayed.
+ *   With \c speed="1" (the default) the chunks are written with the timing
+ *   they were recorded with, with \c speed="N" N times as fast, and with
+ *   \c speed="0" as fast as the buffers take them. The recording is played
+ *   \c loops times (0 to repeat until the server stops).
+ *
+ *   Chunks that find no room in their buffer are dropped, as for a live
+ *   stream, and counted by dropped().
+ */
+class ReplayChunker : public AbstractChunker
+{
+    public:
+        /// ReplayChunker constructor.
+        ReplayChunker(const ConfigNode& config);
+
+        /// ReplayChunker destructor.
+        ~ReplayChunker();
+
+        virtual QIODevice* newDevice();
+        virtual void next(QIODevice*);
+
+        /// Returns the number of chunks written to the buffers.
+        quint64 replayed() const { return _replayed; }
+
+        /// Returns the number of chunks that found no room in their buffer.
+        quint64 dropped() const { return _dropped; }
+
+    private:
+        /// Waits until the given time (ns), returning false if stopped.
+        bool _waitUntil(qint64 time) const;
+
+    private:
+        QString _fileName;
+        double _speed;
+        int _loops;
+        StreamRecording* _recording;
+        quint64 _replayed;
+        quint64 _dropped;
+};
+PELICAN_DECLARE_CHUNKER(ReplayChunker)
+
+} // namespace pelican
+
+#endif // REPLAYCHUNKER_H
@@ -2,9 +2,12 @@
 #define SERVICEDATABUFFER_H
 
 #include "pelican/server/AbstractDataBuffer.h"
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/utility/BufferMemory.h"
 
 #include <QtCore/QObject>
 #include <QtCore/QHash>
+#include <QtCore/QMap>
 
 /**
  * @file ServiceDataBuffer.h
@@ -29,6 +32,11 @@ class LockedData;
  * method.
  * Multiple threads may access the same data at the same time for
  * reading.
+ *
+ * The memory for each version is allocated as set by the BufferMemory
+ * given on construction.
+ *
+ * The versions written and served are counted, see metrics().
  */
 class ServiceDataBuffer : public AbstractDataBuffer
 {
@@ -39,6 +47,7 @@ class ServiceDataBuffer : public AbstractDataBuffer
         ServiceDataBuffer(const QString& type,
                 const size_t max = 10240,
                 const size_t maxChunkSize = 10240,
+                const BufferMemory& memory = BufferMemory(),
                 QObject* parent = 0);
 
         /// Destroys the service data buffer.
@@ -53,6 +62,9 @@ class ServiceDataBuffer : public AbstractDataBuffer
         /// Returns a section of writable memory to be filled.
         WritableData getWritable(size_t size);
 
+        /// Adds the buffer's counters to the map of metrics.
+        void metrics(QMap<QString, double>& values) const;
+
     protected slots:
         void activateData();
         void deactivateData();
@@ -61,6 +73,10 @@ class ServiceDataBuffer : public AbstractDataBuffer
         void activateData(LockableServiceData*);
         void deactivateData(LockableServiceData*);
 
+    private:
+        /// Counts service data served.
+        void _served(LockableServiceData* data);
+
     private:
         QHash<QString, LockableServiceData*> _data;
         QList<LockableServiceData*> _expiredData;
@@ -70,6 +86,12 @@ class ServiceDataBuffer : public AbstractDataBuffer
         size_t _maxChunkSize;
         size_t _space;
         unsigned long _id;
+        BufferMemory _memory;
+
+        AtomicCounter _chunksWritten;
+        AtomicCounter _bytesWritten;
+        AtomicCounter _chunksServed;
+        AtomicCounter _bytesServed;
 
     friend class ServiceDataBufferTest;
 };
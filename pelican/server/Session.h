@@ -3,7 +3,10 @@
 
 #include <QtCore/QThread>
 #include <QtCore/QList>
+#include <QtCore/QHash>
 #include <QtNetwork/QTcpSocket>
+#include "pelican/server/LockedData.h"
+#include <boost/shared_ptr.hpp>
 #include <string>
 
 /**
@@ -15,9 +18,11 @@ namespace pelican {
 class ServerRequest;
 class ServiceDataRequest;
 class StreamDataRequest;
+class StreamSubscriptionRequest;
 class LockedData;
 class AbstractProtocol;
 class DataManager;
+class ChunkScheduler;
 
 /**
  * @ingroup c_server
@@ -28,7 +33,21 @@ class DataManager;
  * Class to process a single server request.
  *
  * @details
+ * Once a client has sent a StreamSubscriptionRequest the session pushes
+ * matching stream data to it as it becomes available, for as long as the
+ * client has credits (see pushStreamData()).
  *
+ * If the protocol sends stream data by reference (e.g. in shared memory)
+ * the session keeps the data locked until the client releases it with a
+ * ReleaseRequest, or disconnects.
+ *
+ * A client that names itself with a ConsumerRequest is served stream data
+ * from broadcast buffers through its own read cursor; the connection is
+ * then kept alive.
+ *
+ * If the data manager has a ChunkScheduler the session only takes stream
+ * data when the scheduler chooses it over the other waiting sessions, and
+ * reports the chunks it sends and the client completes.
  */
 class Session : public QThread
 {
@@ -51,6 +70,30 @@ class Session : public QThread
         /// Process a request to the server sending the appropriate response.
         void processRequest(const ServerRequest&, QIODevice&, unsigned timeout = 0 );
 
+        /// Process a request only if it can be done without waiting for data.
+        bool tryProcessRequest(const ServerRequest&, QIODevice&);
+
+        /// Push the next chunk for the connection's subscription, if any.
+        bool pushStreamData(QIODevice&);
+
+        /// Returns true if the client has subscribed to stream data.
+        bool hasSubscription() const { return _subscription.get() != 0; }
+
+        /// Returns the number of chunks that may be pushed to the client.
+        quint32 credits() const { return _subscription ? _credits : 0; }
+
+        /// Returns the number of chunks held for the client.
+        int held() const { return _held.size(); }
+
+        /// Returns the name of the client as a broadcast consumer.
+        const QString& consumer() const { return _consumer; }
+
+        /// Handle requests until the client disconnects (default false).
+        void setKeepAlive(bool keepAlive) { _keepAlive = keepAlive; }
+
+        /// Set the client information used in verbose messages.
+        void setClientInfo(const QString& info);
+
         // set the verbosity level ( 0 = off )
         void setVerbosity(int level);
 
@@ -62,15 +105,42 @@ class Session : public QThread
         QList<LockedData> processServiceDataRequest(const ServiceDataRequest& req);
         void verbose( const QString& msg, int verboseLevel = 1 );
 
+    private:
+        /// Returns stream data for the request if it is available now.
+        QList<LockedData> _streamDataAvailable(const StreamDataRequest& req);
+
+        /// Sends the stream data and marks it as served.
+        void _sendStreamData(const QList<LockedData>& dataList, QIODevice& out);
+
+        /// Tells the scheduler (if any) the session is no longer waiting.
+        void _cancelWait();
+
+        /// Tells the scheduler (if any) the client has completed chunks.
+        void _completed(int chunks = -1);
+
     signals:
         void error(QTcpSocket::SocketError socketError);
 
+    private:
+        /// Longest single wait (ms) for stream data before looking again.
+        static const int maxWaitInterval = 100;
+
     private:
         int _socketDescriptor;
         DataManager* _dataManager;
         AbstractProtocol* _protocol;
         int _verboseLevel;
         std::string _clientInfo;
+        bool _keepAlive;
+        volatile bool _stopping;
+        boost::shared_ptr<StreamSubscriptionRequest> _subscription;
+        quint32 _credits;
+        QHash<QString, QString> _serviceVersionsSent;
+        QList<QList<LockedData> > _held; ///< Data sent by reference, oldest first.
+        QString _consumer; ///< Broadcast consumer name (empty if not named).
+        QString _clientName; ///< Client address, used if there is no consumer name.
+        ChunkScheduler* _scheduler; ///< Scheduler the session is registered with.
+        int _schedulerHandle;
         friend class SessionTest; // unit test
 };
 
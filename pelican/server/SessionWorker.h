@@ -0,0 +1,108 @@
+#ifndef SESSIONWORKER_H
+#define SESSIONWORKER_H
+
+/**
+ * @file SessionWorker.h
+ */
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QList>
+#include <QtCore/QHash>
+#include <boost/shared_ptr.hpp>
+
+class QTcpSocket;
+
+namespace pelican {
+
+class AbstractProtocol;
+class DataManager;
+class ServerRequest;
+class Session;
+
+/**
+ * @ingroup c_server
+ *
+ * @class SessionWorker
+ *
+ * @brief
+ * Serves requests on many persistent client connections from one thread.
+ *
+ * @details
+ * Used by the PelicanPortServer in keep-alive mode with a fixed number of
+ * worker threads. Each worker waits on its connections with epoll and
+ * handles each request as it arrives.
+ *
+ * A stream data request that can not be satisfied straight away is parked
+ * on its connection (which is not read again until it has been answered),
+ * and retried whenever the DataManager signals that stream data has been
+ * activated, through an eventfd registered as a wakeup descriptor.
+ * Connections with a stream subscription are pushed data at the same
+ * points, while they have credits.
+ *
+ * The worker never waits for a client to read: replies are queued on the
+ * connection's socket (see AbstractProtocol::deferredWritesProperty()),
+ * and what the kernel does not take at once is sent when epoll reports
+ * the socket writable. Until then no further requests are read from the
+ * connection, and no further data pushed to it.
+ */
+class SessionWorker : public QThread
+{
+    Q_OBJECT
+
+    public:
+        /// Constructs a session worker.
+        SessionWorker(AbstractProtocol* proto, DataManager* data,
+                QObject* parent = 0);
+
+        /// Stops the worker, closing its connections.
+        ~SessionWorker();
+
+        /// Hand a newly accepted connection to the worker (thread safe).
+        void addConnection(int socketDescriptor);
+
+        /// Set the verbosity level ( 0 = off ).
+        void setVerbosity(int level) { _verboseLevel = level; }
+
+    protected:
+        /// Runs the worker's epoll loop.
+        void run();
+
+    private:
+        struct Connection {
+            int fd;
+            QTcpSocket* socket;
+            Session* session;
+            boost::shared_ptr<ServerRequest> pending; ///< Unanswered request.
+            bool subscribed;
+            quint32 events; ///< The epoll events watched for.
+        };
+
+    private:
+        void _adoptConnections();
+        void _process(Connection* c);
+        bool _retryPending();
+        void _updateSubscription(Connection* c);
+        void _flush(Connection* c);
+        void _watch(Connection* c);
+        void _close(Connection* c);
+        void _wake();
+
+    private:
+        AbstractProtocol* _protocol;
+        DataManager* _dataManager;
+        int _epollFd;
+        int _eventFd;
+        int _wakeupHandle;
+        QMutex _mutex;
+        QList<int> _incoming;  ///< Accepted descriptors not yet adopted.
+        QHash<int, Connection*> _connections;
+        int _pendingCount;
+        int _subscribedCount;
+        volatile bool _stopping;
+        int _verboseLevel;
+};
+
+} // namespace pelican
+
+#endif // SESSIONWORKER_H
@@ -6,7 +6,15 @@
  */
 
 #include "pelican/server/AbstractDataBuffer.h"
+#include "pelican/utility/LockFreeQueue.hpp"
+#include "pelican/utility/EventCount.h"
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/utility/BufferMemory.h"
 #include <QtCore/QQueue>
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QMap>
 #include <QtCore/QObject>
 
 namespace pelican {
@@ -16,6 +24,9 @@ class DataChunk;
 class DataManager;
 class LockedData;
 class WritableData;
+class SharedMemorySegment;
+class StreamSpillFile;
+class StreamRecorder;
 
 /**
  * @ingroup c_server
@@ -28,6 +39,65 @@ class WritableData;
  * @details
  * Encapsulates memory allocation for streams, with locking and data
  * consistency checking.
+ *
+ * Two allocation schemes are supported:
+ * - \c Dynamic (the default) allocates a new block of memory for each chunk
+ *   until the maximum buffer size is reached, and then reuses the first
+ *   free block that is large enough.
+ * - \c Slab reserves (and pre-faults) a single contiguous block of memory on
+ *   construction, and divides it into maxSize / maxChunkSize equally sized
+ *   slots. Free slots are handed out and returned through a ring, so that
+ *   allocation and release are O(1).
+ * - \c Shared is Slab allocation from a POSIX shared memory segment
+ *   (named by sharedMemoryName()), so that pipelines on the same host can
+ *   read the chunks in place (see SharedMemoryProtocol).
+ *
+ * The chunk memory can be put on huge pages, locked into RAM and bound to
+ * a NUMA node with a BufferMemory given on construction. (Shared segments
+ * are bound and locked, but stay on normal pages.)
+ *
+ * Chunks waiting to be served are held either on a mutex protected queue
+ * (\c Locking, the default) or, for Slab buffers, on a LockFreeQueue
+ * (\c LockFree). In LockFree mode the free slots are also held on a
+ * LockFreeQueue, and chunks are activated and released directly in the
+ * thread that unlocks them, so that consumers never take a mutex. Unserved
+ * chunks returned by a consumer are then held on a retry queue, which is
+ * served before the serve queue, so that chunks are still served in the
+ * order they were activated.
+ *
+ * Consumers may block until data is available with getNext(LockedData&, int).
+ *
+ * By default each chunk is served once, to whichever consumer asks first.
+ * In broadcast mode (see setBroadcast()) every named consumer has its own
+ * read cursor and is served every chunk activated after it registered.
+ * Chunks stay on the serve queue, counting the consumers that have still
+ * to read them (LockableStreamData::readers()), and are recycled once
+ * every consumer has read and unlocked them. A consumer that falls behind
+ * either loses its oldest chunks when the buffer needs the space
+ * (\c DropOldest) or holds on to them, so that new data can not be
+ * written until it catches up (\c Wait). With a maximum lag set, a
+ * consumer more than that many chunks behind is moved forward regardless.
+ * Consumers that do not give a name share the unnamed consumer. A chunk
+ * taken by a consumer but not sent (e.g. as another stream of the request
+ * was not available) must be given back with unread(), and is served to
+ * the consumer again before its later chunks.
+ * Broadcast mode requires the Locking serve queue.
+ *
+ * With a spill file (see setSpillFile()), chunks that do not fit in the
+ * buffer's memory are written to a memory-mapped file rather than
+ * evicting waiting data. They are activated and served in order with the
+ * chunks in memory, straight from the mapped file, and their space in the
+ * file is reused once they are released.
+ *
+ * Every chunk activated can also be written to a StreamRecorder (see
+ * setRecorder()).
+ *
+ * Chunks written concurrently by several receivers of the same stream can
+ * be served in the order of their sequence numbers (see setOrdered()).
+ *
+ * Counts of the chunks and bytes written, served and dropped, the number
+ * of chunks in use and the time spent in getWritable() are kept without
+ * locks, and reported by metrics().
  */
 class StreamDataBuffer : public AbstractDataBuffer
 {
@@ -36,6 +106,16 @@ class StreamDataBuffer : public AbstractDataBuffer
     private:
         friend class StreamDataBufferTest;
 
+    public:
+        /// Memory allocation schemes.
+        typedef enum { Dynamic, Slab, Shared } Allocation;
+
+        /// Serve queue implementations.
+        typedef enum { Locking, LockFree } ServeQueue;
+
+        /// Policies for broadcast consumers that fall behind.
+        typedef enum { DropOldest, Wait } LagPolicy;
+
     public:
         /// Constructs a stream data buffer.
         StreamDataBuffer(const QString& type,
@@ -43,12 +123,29 @@ class StreamDataBuffer : public AbstractDataBuffer
                          const size_t maxChunkSize = 10240,
                          QObject* parent = 0);
 
+        /// Constructs a stream data buffer using the given allocation scheme.
+        StreamDataBuffer(const QString& type,
+                         const size_t max,
+                         const size_t maxChunkSize,
+                         Allocation allocation,
+                         ServeQueue serveQueue = Locking,
+                         const BufferMemory& memory = BufferMemory(),
+                         QObject* parent = 0);
+
         /// Destroys the stream data buffer.
         ~StreamDataBuffer();
 
         /// Get the next data object that is ready to be served.
         void getNext(LockedData&);
 
+        /// Get the next data object that is ready to be served, waiting
+        /// up to timeout ms (< 0 to wait forever) for one to be activated.
+        void getNext(LockedData&, int timeout);
+
+        /// Get the next data object to serve to the named consumer, waiting
+        /// up to timeout ms (< 0 to wait forever) for one to be activated.
+        void getNext(LockedData&, const QString& consumer, int timeout = 0);
+
         /// Get a data object that is ready to be written to.
         WritableData getWritable(size_t size);
 
@@ -56,15 +153,75 @@ class StreamDataBuffer : public AbstractDataBuffer
         void setDataManager(DataManager* manager) {_manager = manager;}
 
         /// Sets the maximum size of the buffer in bytes.
+        /// (Ignored for Slab allocation once the buffer is constructed.)
         void setMaxSize(const size_t size) { _max = size; }
         size_t size() const { return _max; }
 
         /// Sets the maximum chunk size of the in bytes.
+        /// (Ignored for Slab allocation once the buffer is constructed.)
         void setMaxChunkSize(const size_t size) { _maxChunkSize = size; }
 
+        /// Returns the allocation scheme used by the buffer.
+        Allocation allocation() const { return _allocation; }
+
+        /// Returns how the buffer's memory is allocated.
+        const BufferMemory& memory() const { return _memory; }
+
+        /// Returns the serve queue implementation used by the buffer.
+        ServeQueue serveQueue() const { return _serveQueueType; }
+
+        /// Returns the name of the shared memory segment holding the
+        /// buffer (Shared allocation only).
+        QString sharedMemoryName() const;
+
         /// get the number of chunks waiting on the serve queue
         int numberOfActiveChunks() const;
 
+        /// Serves every chunk to every consumer.
+        void setBroadcast(LagPolicy policy = DropOldest, int maxLag = 0);
+
+        /// Returns true if the buffer is in broadcast mode.
+        bool isBroadcast() const { return _broadcast; }
+
+        /// Returns the policy for broadcast consumers that fall behind.
+        LagPolicy lagPolicy() const { return _lagPolicy; }
+
+        /// Registers a broadcast consumer.
+        void addConsumer(const QString& name);
+
+        /// Removes a broadcast consumer, giving up the chunks it has not read.
+        void removeConsumer(const QString& name);
+
+        /// Returns the names of the broadcast consumers.
+        QStringList consumers();
+
+        /// Returns the number of chunks the broadcast consumer has not read.
+        int backlog(const QString& consumer);
+
+        /// Gives a broadcast chunk back unserved, to be served to the
+        /// consumer again.
+        void unread(LockableStreamData* data, const QString& consumer);
+
+        /// Writes chunks that do not fit in memory to a file of up to
+        /// maxSize bytes.
+        void setSpillFile(const QString& path, size_t maxSize);
+
+        /// Returns the spill file (0 if there is none).
+        const StreamSpillFile* spillFile() const { return _spill; }
+
+        /// Records every chunk activated (0 to stop recording).
+        void setRecorder(StreamRecorder* recorder) { _recorder = recorder; }
+
+        /// Activates chunks in sequence number order, holding up to window
+        /// chunks (0 for none) for at most timeout ms.
+        void setOrdered(int window, int timeout = 100);
+
+        /// Returns the number of chunks held for ordering (0 if unordered).
+        int orderWindow() const { return _orderWindow; }
+
+        /// Adds the buffer's metrics to the map.
+        void metrics(QMap<QString, double>& values) const;
+
     protected slots:
         /// Places the data chunk that emitted the signal on the serve queue.
         void activateData();
@@ -83,6 +240,58 @@ class StreamDataBuffer : public AbstractDataBuffer
     private:
         StreamDataBuffer(const StreamDataBuffer&); // Disallow copying.
 
+        /// Initialises the buffer members.
+        void _init(const size_t max, const size_t maxChunkSize);
+
+        /// Reserves the slab and creates a chunk for each of its slots.
+        void _allocateSlab();
+
+        /// Creates a new chunk wrapping the given memory.
+        LockableStreamData* _newChunk(void* memory, size_t size);
+
+        /// Returns a chunk to the pool of free chunks.
+        void _release(LockableStreamData*);
+
+        /// Takes the next chunk from the free slot ring.
+        LockableStreamData* _popFreeSlot();
+
+        /// Takes the next chunk from the serve queue.
+        LockableStreamData* _dequeueServe(const QString& consumer = QString());
+
+        /// Returns the consumer's next chunk (locked) in broadcast mode.
+        LockableStreamData* _nextBroadcast(const QString& consumer);
+
+        /// Moves a broadcast cursor forward, giving up the chunks skipped.
+        void _advance(qint64& cursor, qint64 to);
+
+        /// Removes the chunks every broadcast consumer has finished with.
+        QList<LockableStreamData*> _trim();
+
+        /// Takes the oldest unread broadcast chunk, if the policy allows.
+        LockableStreamData* _dropOldest(size_t size);
+
+        /// Returns the chunks to the pool of free chunks.
+        void _recycle(const QList<LockableStreamData*>& chunks);
+
+        /// Takes a chunk in the spill file, if there is room.
+        LockableStreamData* _spillChunk(size_t size);
+
+        /// Puts an activated chunk on the serve queue.
+        void _serve(LockableStreamData* data);
+
+        /// Holds an activated chunk until the chunks before it are served.
+        void _order(LockableStreamData* data);
+
+        /// Serves the held chunks that are next in order, or have been held
+        /// too long (all of them if flush is set).
+        void _releaseHeld(bool flush);
+
+        /// Serves the held chunks that have been held too long.
+        void _releaseExpired();
+
+        /// Counts a chunk (if any) taken from the free pool, and returns it.
+        LockableStreamData* _taken(LockableStreamData* data);
+
     private:
         size_t _max;
         size_t _maxChunkSize;
@@ -91,6 +300,62 @@ class StreamDataBuffer : public AbstractDataBuffer
         QQueue<LockableStreamData*> _serveQueue; ///< Queue of blocks waiting to be served.
         QList<LockableStreamData*> _emptyQueue; ///< List of all available blocks.
         DataManager* _manager;
+
+        Allocation _allocation;
+        BufferMemory _memory;
+        char* _slab; ///< Contiguous memory used for Slab allocation.
+        SharedMemorySegment* _segment; ///< Holds the slab for Shared allocation.
+        QVector<LockableStreamData*> _freeSlots; ///< Ring of free slab slots.
+        int _freeHead;  ///< Index of the first free slot in the ring.
+        int _freeCount; ///< Number of free slots in the ring.
+
+        ServeQueue _serveQueueType;
+        LockFreeQueue<LockableStreamData*>* _lockFreeServeQueue;
+        LockFreeQueue<LockableStreamData*>* _lockFreeSlots;
+        LockFreeQueue<LockableStreamData*>* _lockFreeRetry; ///< Unserved chunks handed back.
+        EventCount _activated; ///< Notified when a chunk is put on the serve queue.
+
+        bool _broadcast;
+        LagPolicy _lagPolicy;
+        int _maxLag;       ///< Chunks a broadcast consumer may fall behind (0 = no limit).
+        qint64 _logStart;  ///< Sequence number of the chunk at the head of the serve queue.
+        QHash<QString, qint64> _cursors; ///< Next sequence number to read, by consumer.
+        QHash<QString, QList<qint64> > _unread; ///< Chunks given back, by consumer.
+
+        StreamSpillFile* _spill; ///< Overflow file (0 if none).
+        QVector<LockableStreamData*> _spillChunks; ///< Chunk for each spill slot, once used.
+
+        StreamRecorder* _recorder; ///< Records activated chunks (not owned).
+
+        /// A chunk held for ordering, and when it was activated (ns).
+        struct HeldChunk {
+            LockableStreamData* data;
+            quint64 since;
+        };
+        int _orderWindow;   ///< Chunks held for ordering (0 = unordered).
+        int _orderTimeout;  ///< Longest a chunk is held (ms).
+        QMutex _orderMutex;
+        QMap<quint64, HeldChunk> _held; ///< Held chunks, by sequence number.
+        bool _orderStarted;
+        quint64 _lastSequence;    ///< Sequence number of the last chunk served.
+        quint64 _nextSequence;    ///< Sequence number following the chunks served.
+        quint64 _highestSequence; ///< Highest sequence number activated.
+
+        AtomicCounter _chunksWritten;  ///< Chunks activated.
+        AtomicCounter _bytesWritten;
+        AtomicCounter _chunksServed;   ///< Chunks taken by consumers.
+        AtomicCounter _bytesServed;
+        AtomicCounter _chunksDropped;  ///< Waiting chunks overwritten.
+        AtomicCounter _chunksRejected; ///< Requests for writable data refused.
+        AtomicCounter _chunksInUse;    ///< Chunks not in the free pool.
+        AtomicCounter _highWater;      ///< Most chunks in use at once.
+        AtomicCounter _writableCalls;
+        AtomicCounter _writableTime;   ///< Total time in getWritable() (ns).
+        AtomicCounter _writableMaxTime; ///< Longest time in getWritable() (ns).
+        AtomicCounter _packetsLost;    ///< Packets missing from the chunks written.
+        AtomicCounter _packetsReordered;
+        AtomicCounter _chunksReordered; ///< Chunks activated after a later chunk.
+        AtomicCounter _chunksLate;      ///< Chunks activated after a later chunk was served.
 };
 
 } // namespace pelican
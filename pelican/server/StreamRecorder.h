@@ -0,0 +1,95 @@
+#ifndef STREAMRECORDER_H
+#define STREAMRECORDER_H
+
+/**
+ * @file StreamRecorder.h
+ */
+
+#include <QtCore/QString>
+#include <QtCore/QHash>
+#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+#include <QtCore/QMutex>
+
+namespace pelican {
+
+class StreamData;
+
+/**
+ * @ingroup c_server
+ *
+ * @class StreamRecorder
+ *
+ * @brief
+ * Writes the chunks of stream data activated on the server to a file.
+ *
+ * @details
+ * Each record holds the stream name, the time the chunk was activated (in
+ * nanoseconds since the epoch), the versions of the service data
+ * associated with it and the payload, exactly as written by the chunker.
+ * An index of the records is appended when the recorder is closed. The
+ * recording is read back with StreamRecording, and replayed into a server
+ * with the ReplayChunker.
+ *
+ * Chunks are recorded by a StreamDataBuffer given the recorder with
+ * StreamDataBuffer::setRecorder() (see DataManager::setRecording()).
+ *
+ * All methods are thread safe.
+ */
+class StreamRecorder
+{
+    public:
+        /// Identifies a recording file.
+        static const quint32 magic = 0x50524543; // "PREC"
+
+        /// Format version of recordings.
+        static const quint32 version = 1;
+
+    public:
+        /// Creates the recording file, replacing any existing file.
+        StreamRecorder(const QString& path);
+
+        /// Closes the recording.
+        ~StreamRecorder();
+
+    public:
+        /// Records a chunk of the named stream, activated now.
+        void record(const QString& stream, const StreamData* data);
+
+        /// Records a chunk of the named stream.
+        void record(const QString& stream, qint64 time,
+                const QHash<QString, QString>& versions,
+                const char* data, quint64 size);
+
+        /// Writes the index and closes the file.
+        void close();
+
+        /// Returns the path of the recording.
+        const QString& path() const { return _path; }
+
+        /// Returns the number of chunks recorded.
+        quint64 count();
+
+        /// Returns the number of payload bytes recorded.
+        quint64 bytes();
+
+        /// Returns the time in nanoseconds since the epoch.
+        static qint64 now();
+
+    private:
+        StreamRecorder(const StreamRecorder&); // Disallow copying.
+
+    private:
+        QString _path;
+        QMutex _mutex;
+        QFile _file;
+        QDataStream _out;
+        QVector<QPair<quint64, qint64> > _index; ///< Offset and time of each record.
+        quint64 _bytes;
+};
+
+} // namespace pelican
+
+#endif // STREAMRECORDER_H
@@ -0,0 +1,86 @@
+#ifndef STREAMRECORDING_H
+#define STREAMRECORDING_H
+
+/**
+ * @file StreamRecording.h
+ */
+
+#include <QtCore/QString>
+#include <QtCore/QHash>
+#include <QtCore/QFile>
+#include <QtCore/QVector>
+
+namespace pelican {
+
+/**
+ * @ingroup c_server
+ *
+ * @class StreamRecording
+ *
+ * @brief
+ * Reads a recording of stream data written by a StreamRecorder.
+ *
+ * @details
+ * The file is mapped read-only, and the payload of each record is returned
+ * in place. Records are found through the index at the end of the file, or
+ * by reading the file from the start if the recording was not closed (e.g.
+ * the server was killed), in which case a partly written last record is
+ * ignored.
+ */
+class StreamRecording
+{
+    public:
+        /// A recorded chunk of stream data.
+        struct Record {
+            QString stream;                  ///< Stream name.
+            qint64 time;                     ///< Activation time (ns since the epoch).
+            QHash<QString, QString> versions; ///< Service data versions.
+            const char* data;                ///< Payload (in the mapped file).
+            quint64 size;                    ///< Payload size in bytes.
+        };
+
+    public:
+        /// Opens and maps the recording.
+        StreamRecording(const QString& path);
+
+        /// Unmaps the recording.
+        ~StreamRecording();
+
+    public:
+        /// Returns the path of the recording.
+        QString path() const { return _file.fileName(); }
+
+        /// Returns the number of records.
+        int count() const { return _offsets.size(); }
+
+        /// Returns the record at the given index.
+        Record record(int index) const;
+
+        /// Returns the time of the record at the given index.
+        qint64 time(int index) const { return _times[index]; }
+
+    private:
+        StreamRecording(const StreamRecording&); // Disallow copying.
+
+        /// Reads the index at the end of the file, returning false if there
+        /// is none.
+        bool _readIndex();
+
+        /// Finds the records by reading the file from the start.
+        void _scan();
+
+        /// Reads the record at the offset, returning false if it is not
+        /// complete.
+        bool _read(quint64 offset, Record& record, quint64* end = 0) const;
+
+    private:
+        QFile _file;
+        const char* _data;
+        quint64 _size;
+        QVector<quint64> _offsets;
+        QVector<qint64> _times;
+};
+
+} // namespace pelican
+
+#endif // STREAMRECORDING_H
@@ -0,0 +1,104 @@
+#ifndef STREAMSPILLFILE_H
+#define STREAMSPILLFILE_H
+
+/**
+ * @file StreamSpillFile.h
+ */
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <cstddef>
+
+namespace pelican {
+
+/**
+ * @ingroup c_server
+ *
+ * @class StreamSpillFile
+ *
+ * @brief
+ * Memory-mapped file that takes the overflow of a stream data buffer.
+ *
+ * @details
+ * The file is created (replacing any file of the same name), sized and
+ * mapped read-write on construction, and removed on destruction. It is
+ * divided into slots of a fixed size, which are handed out with take() in
+ * the order they were given back with release(), so that while chunks are
+ * served in order the file is written as an append-only ring.
+ *
+ * Pages of the file are only given disk space when first written, and are
+ * written back by the kernel as memory is needed, so the file absorbs
+ * bursts larger than the memory the buffer may use.
+ *
+ * Not thread safe: StreamDataBuffer calls it with its write mutex held.
+ */
+class StreamSpillFile
+{
+    public:
+        /// Creates and maps a spill file of up to size bytes.
+        StreamSpillFile(const QString& path, size_t size, size_t slotSize);
+
+        /// Unmaps and removes the file.
+        ~StreamSpillFile();
+
+    public:
+        /// Returns the path of the file.
+        const QString& path() const { return _path; }
+
+        /// Returns the size of the mapped file in bytes.
+        size_t size() const { return _slotSize * _slots; }
+
+        /// Returns the number of slots in the file.
+        int slots() const { return _slots; }
+
+        /// Returns the size of each slot in bytes.
+        size_t slotSize() const { return _slotSize; }
+
+        /// Returns the memory of the given slot.
+        char* slot(int index) const { return _data + index * _slotSize; }
+
+        /// Returns the slot holding the address, or -1 if not in the file.
+        int slotOf(const void* ptr) const;
+
+        /// Takes the next free slot for a chunk of the given size,
+        /// returning -1 if there is none.
+        int take(size_t size);
+
+        /// Gives a slot back.
+        void release(int index);
+
+        /// Returns the number of chunks written to the file.
+        quint64 spilled() const { return _spilled; }
+
+        /// Returns the number of bytes written to the file.
+        quint64 spilledBytes() const { return _spilledBytes; }
+
+        /// Returns the number of chunks that did not fit in the file.
+        quint64 rejected() const { return _rejected; }
+
+        /// Returns the number of slots in use.
+        int inUse() const { return _slots - _freeCount; }
+
+        /// Returns the largest number of slots that have been in use.
+        int highWater() const { return _highWater; }
+
+    private:
+        StreamSpillFile(const StreamSpillFile&); // Disallow copying.
+
+    private:
+        QString _path;
+        char* _data;
+        size_t _slotSize;
+        int _slots;
+        QVector<int> _free; ///< Ring of free slots.
+        int _freeHead;
+        int _freeCount;
+        quint64 _spilled;
+        quint64 _spilledBytes;
+        quint64 _rejected;
+        int _highWater;
+};
+
+} // namespace pelican
+
+#endif // STREAMSPILLFILE_H
@@ -10,6 +10,9 @@ namespace pelican {
  *  Setup options in the configuration file:
  *    listen to an incoming port
  *    <connection host="dataHost" port="12345" />
+ *    To receive on several threads, each with its own socket on the port
+ *    (stream chunkers derived from AbstractUdpChunker only)
+ *    <connection host="dataHost" port="12345" threads="4" />
  *    To set the stream name for the chunker
  *    <data type="streamName" />
  *    To set a default adapter for the specifc stream
@@ -24,6 +27,10 @@ AbstractChunker::AbstractChunker(const ConfigNode& config)
     _adapterTypes = config.getOptionHash("data","type","adapter");
     _host = config.getOption("connection", "host", "");
     _port = (quint16)config.getOption("connection", "port", "0").toUInt();
+    _threads = config.getOption("connection", "threads", "1").toInt();
+    if (_threads < 1)
+        throw QString("AbstractChunker: Invalid number of threads \"%1\".")
+                .arg(config.getOption("connection", "threads"));
 
     _active = true;
 }
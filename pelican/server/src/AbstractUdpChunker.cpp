@@ -0,0 +1,271 @@
+#include "pelican/server/AbstractUdpChunker.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/utility/ConfigNode.h"
+
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QUdpSocket>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+
+namespace pelican {
+
+/**
+ * @details
+ * The message headers, buffer descriptors and control buffers (for the
+ * kernel drop counter) of a batch of datagrams.
+ */
+struct AbstractUdpChunker::Messages
+{
+    std::vector<mmsghdr> headers;
+    std::vector<iovec> buffers;
+    std::vector<char> control;
+};
+
+static const size_t controlSize = CMSG_SPACE(sizeof(quint32));
+
+
+/**
+ * @details
+ * Constructs the chunker from its configuration (see the class
+ * description). Throws if the chunk size is not a whole number of packets.
+ */
+AbstractUdpChunker::AbstractUdpChunker(const ConfigNode& config)
+    : AbstractChunker(config), _socket(-1), _messages(new Messages)
+{
+    qint64 chunkSize = config.getOption("data", "chunkSize").toLongLong();
+    _packetSize = config.getOption("packet", "size").toInt();
+    _batch = config.getOption("packet", "batch", "64").toInt();
+    _receiveBuffer = config.getOption("socket", "receiveBuffer", "67108864").toInt();
+    _busyPoll = config.getOption("socket", "busyPoll", "0").toInt();
+    if( _packetSize <= 0 || chunkSize <= 0 || chunkSize % _packetSize != 0 )
+        throw QString("AbstractUdpChunker: chunkSize (%1) must be a multiple "
+                "of the packet size (%2)").arg(chunkSize).arg(_packetSize);
+    if( _batch <= 0 )
+        throw QString("AbstractUdpChunker: invalid batch \"%1\"").arg(_batch);
+    _packetsPerChunk = (int)(chunkSize / _packetSize);
+    _scratch.resize(_batch * _packetSize);
+    _messages->headers.resize(_batch);
+    _messages->buffers.resize(_batch);
+    _messages->control.resize(_batch * controlSize);
+}
+
+/**
+ * @details
+ * Destroys the chunker. The socket is closed by its device.
+ */
+AbstractUdpChunker::~AbstractUdpChunker()
+{
+    delete _messages;
+}
+
+/**
+ * @details
+ * Creates the UDP socket, sets its options and binds it to the configured
+ * host and port. Options the kernel refuses are reported, but are not
+ * errors. The socket is returned wrapped in a QUdpSocket (which owns it),
+ * so that the receiver calls next() when the first data arrives.
+ */
+QIODevice* AbstractUdpChunker::newDevice()
+{
+    _socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if( _socket < 0 )
+        throw QString("AbstractUdpChunker: unable to create socket: %1")
+                .arg(strerror(errno));
+
+    // Ask for a large receive buffer, beyond rmem_max if allowed to.
+    if( ! _setOption(SOL_SOCKET, SO_RCVBUFFORCE, _receiveBuffer) )
+        _setOption(SOL_SOCKET, SO_RCVBUF, _receiveBuffer);
+    int size = 0;
+    socklen_t length = sizeof(size);
+    getsockopt(_socket, SOL_SOCKET, SO_RCVBUF, &size, &length);
+    if( size / 2 < _receiveBuffer ) // The kernel reports double the size.
+        std::cerr << "AbstractUdpChunker: receive buffer limited to "
+                  << size / 2 << " bytes (see net.core.rmem_max)" << std::endl;
+
+    // Share the port with the sockets of the chunker's other threads.
+    if( threads() > 1 && ! _setOption(SOL_SOCKET, SO_REUSEPORT, 1) ) {
+        QString error = strerror(errno);
+        ::close(_socket);
+        _socket = -1;
+        throw QString("AbstractUdpChunker: unable to set SO_REUSEPORT: %1")
+                .arg(error);
+    }
+
+#ifdef SO_RXQ_OVFL
+    if( ! _setOption(SOL_SOCKET, SO_RXQ_OVFL, 1) )
+        std::cerr << "AbstractUdpChunker: kernel drops will not be counted"
+                  << std::endl;
+#endif
+#ifdef SO_BUSY_POLL
+    if( _busyPoll > 0 && ! _setOption(SOL_SOCKET, SO_BUSY_POLL, _busyPoll) )
+        std::cerr << "AbstractUdpChunker: unable to set SO_BUSY_POLL"
+                  << std::endl;
+#endif
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port());
+    address.sin_addr.s_addr = htonl(QHostAddress(host()).toIPv4Address());
+    if( ::bind(_socket, (sockaddr*)&address, sizeof(address)) != 0 ) {
+        QString error = strerror(errno);
+        ::close(_socket);
+        _socket = -1;
+        throw QString("AbstractUdpChunker: unable to bind to %1:%2: %3")
+                .arg(host()).arg(port()).arg(error);
+    }
+
+    QUdpSocket* device = new QUdpSocket;
+    device->setSocketDescriptor(_socket, QUdpSocket::BoundState,
+            QIODevice::ReadOnly);
+    return device;
+}
+
+/**
+ * @details
+ * Fills chunks with packets until the chunker is stopped. A chunk that is
+ * not full when the chunker stops is cut to the packets it holds. While
+ * there is no room in the buffer the packets are received and discarded,
+ * so that the socket does not fill up with stale data.
+ */
+void AbstractUdpChunker::next(QIODevice*)
+{
+    size_t chunkSize = (size_t)_packetsPerChunk * _packetSize;
+    try {
+        while( isActive() ) {
+            WritableData writableData = getDataStorage(chunkSize);
+            if( ! writableData.isValid() ) {
+                _discarded.add( _receive(_scratch.data(), _batch) );
+                continue;
+            }
+            char* ptr = (char*)writableData.ptr();
+            int filled = 0;
+            while( filled < _packetsPerChunk && isActive() ) {
+                char* slot = ptr + (size_t)filled * _packetSize;
+                filled += _keep(slot, _receive(slot, _packetsPerChunk - filled));
+            }
+            if( filled < _packetsPerChunk )
+                writableData.data()->data()->setSize((size_t)filled * _packetSize);
+            _setSequence(writableData, filled);
+        }
+    }
+    catch( const QString& error ) {
+        std::cerr << error.toStdString() << std::endl;
+    }
+}
+
+/**
+ * @details
+ * Waits up to 100 ms for data (unless busy polling), then receives up to n
+ * datagrams (no more than the batch size) into consecutive packet slots,
+ * and updates the kernel drop count.
+ */
+int AbstractUdpChunker::_receive(char* ptr, int n)
+{
+    n = qMin(n, _batch);
+    Messages& m = *_messages;
+    for( int i = 0; i < n; ++i ) {
+        m.buffers[i].iov_base = ptr + (size_t)i * _packetSize;
+        m.buffers[i].iov_len = _packetSize;
+        memset(&m.headers[i], 0, sizeof(mmsghdr));
+        m.headers[i].msg_hdr.msg_iov = &m.buffers[i];
+        m.headers[i].msg_hdr.msg_iovlen = 1;
+        m.headers[i].msg_hdr.msg_control = &m.control[i * controlSize];
+        m.headers[i].msg_hdr.msg_controllen = controlSize;
+    }
+
+    if( _busyPoll <= 0 ) {
+        pollfd p;
+        p.fd = _socket;
+        p.events = POLLIN;
+        p.revents = 0;
+        if( ::poll(&p, 1, 100) <= 0 ) return 0;
+    }
+
+    int count = ::recvmmsg(_socket, &m.headers[0], n, MSG_DONTWAIT, 0);
+    if( count < 0 ) {
+        if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+            return 0;
+        throw QString("AbstractUdpChunker: receive failed: %1")
+                .arg(strerror(errno));
+    }
+
+#ifdef SO_RXQ_OVFL
+    // The counter is the total dropped by the socket, so the last is kept.
+    for( int i = 0; i < count; ++i ) {
+        msghdr* header = &m.headers[i].msg_hdr;
+        for( cmsghdr* c = CMSG_FIRSTHDR(header); c; c = CMSG_NXTHDR(header, c) ) {
+            if( c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL ) {
+                quint32 drops;
+                memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+                _kernelDrops.set(drops);
+            }
+        }
+    }
+#endif
+    return count;
+}
+
+/**
+ * @details
+ * Checks the n datagrams received into the slots from ptr, counting those
+ * rejected, and moves the packets kept down over the gaps they leave.
+ */
+int AbstractUdpChunker::_keep(char* ptr, int n)
+{
+    int kept = 0;
+    for( int i = 0; i < n; ++i ) {
+        char* packet = ptr + (size_t)i * _packetSize;
+        const mmsghdr& header = _messages->headers[i];
+        int size = (int)header.msg_len;
+        if( size != _packetSize || (header.msg_hdr.msg_flags & MSG_TRUNC)
+                || ! parseHeader(packet, size) ) {
+            _rejected.add();
+            continue;
+        }
+        if( kept != i )
+            memmove(ptr + (size_t)kept * _packetSize, packet, _packetSize);
+        ++kept;
+    }
+    _received.add(kept);
+    return kept;
+}
+
+/**
+ * @details
+ * Sets the sequence number of a chunk holding the given number of packets
+ * from that of its first packet, if the packets are numbered.
+ */
+void AbstractUdpChunker::_setSequence(WritableData& writableData, int filled)
+{
+    quint64 first = 0;
+    if( filled == 0 || ! sequence((const char*)writableData.ptr(), &first) )
+        return;
+    DataChunk* data = writableData.data()->data().get();
+    if( StreamData* streamData = dynamic_cast<StreamData*>(data) ) {
+        PacketStats& stats = streamData->packetStats();
+        stats.setSequence(first);
+        stats.setPackets(filled);
+    }
+}
+
+/**
+ * @details
+ * Sets an integer option of the socket.
+ */
+bool AbstractUdpChunker::_setOption(int level, int option, int value)
+{
+    return setsockopt(_socket, level, option, &value, sizeof(value)) == 0;
+}
+
+} // namespace pelican
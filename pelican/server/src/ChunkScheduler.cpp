@@ -0,0 +1,236 @@
+#include "pelican/server/ChunkScheduler.h"
+#include "pelican/server/DataManager.h"
+
+#include <QtCore/QMutexLocker>
+#include <sys/time.h>
+#include <cmath>
+
+namespace pelican {
+
+// Time constant (s) of the throughput averages.
+static const double rateTimeConstant = 5.0;
+
+/**
+ * @details
+ * Creates the scheduler. If a data manager is given, its stream data
+ * waiters are woken whenever a chunk is served while other sessions are
+ * waiting, as the chunk may have been one of several available.
+ */
+ChunkScheduler::ChunkScheduler(DataManager* manager)
+    : _manager(manager), _nextHandle(1), _nextTicket(1)
+{
+}
+
+
+ChunkScheduler::~ChunkScheduler()
+{
+}
+
+
+/**
+ * @details
+ * Registers a session of the named client (e.g. its address or consumer
+ * name). Statistics are kept per name, over all its sessions.
+ */
+int ChunkScheduler::add(const QString& name)
+{
+    QMutexLocker locker(&_mutex);
+    Entry e;
+    e.name = name;
+    e.outstanding = 0;
+    e.ticket = 0;
+    int handle = _nextHandle++;
+    _sessions.insert(handle, e);
+    if (!_clients.contains(name)) {
+        Totals t;
+        t.sessions = 0;
+        t.chunks = 0;
+        t.bytes = 0;
+        t.chunkRate = 0.0;
+        t.byteRate = 0.0;
+        t.last = _now();
+        _clients.insert(name, t);
+    }
+    ++_clients[name].sessions;
+    return handle;
+}
+
+
+/**
+ * @details
+ * Unregisters the session. The client's statistics are kept.
+ */
+void ChunkScheduler::remove(int handle)
+{
+    QMutexLocker locker(&_mutex);
+    QHash<int, Entry>::iterator it = _sessions.find(handle);
+    if (it == _sessions.end())
+        return;
+    --_clients[it->name].sessions;
+    bool waiting = it->ticket != 0;
+    _sessions.erase(it);
+    locker.unlock();
+
+    // Another session may now be the best choice.
+    if (waiting && _manager)
+        _manager->streamDataActivated();
+}
+
+
+/**
+ * @details
+ * Marks the session as waiting for data from any of the given streams (if
+ * it is not already) and returns true if it is the best choice of the
+ * waiting sessions that want any of the same streams.
+ */
+bool ChunkScheduler::mayTake(int handle, const QSet<QString>& streams)
+{
+    QMutexLocker locker(&_mutex);
+    QHash<int, Entry>::iterator self = _sessions.find(handle);
+    if (self == _sessions.end())
+        return true;
+    if (self->ticket == 0) {
+        self->ticket = _nextTicket++;
+        self->streams = streams;
+    }
+
+    QHash<int, Entry>::const_iterator it = _sessions.constBegin();
+    for (; it != _sessions.constEnd(); ++it) {
+        const Entry& e = it.value();
+        if (it.key() == handle || e.ticket == 0)
+            continue;
+        if (e.outstanding > self->outstanding)
+            continue;
+        if (e.outstanding == self->outstanding && e.ticket > self->ticket)
+            continue;
+#ifdef BROKEN_QT_SET_HEADER
+        QSet<QString> temp = e.streams;
+        if (!(temp & self->streams).isEmpty())
+#else
+        if (!(e.streams & self->streams).isEmpty())
+#endif
+            return false;
+    }
+    return true;
+}
+
+
+/**
+ * @details
+ * Marks the session as no longer waiting (e.g. when its request times out).
+ */
+void ChunkScheduler::cancel(int handle)
+{
+    QMutexLocker locker(&_mutex);
+    QHash<int, Entry>::iterator it = _sessions.find(handle);
+    if (it == _sessions.end() || it->ticket == 0)
+        return;
+    it->ticket = 0;
+    locker.unlock();
+    if (_manager)
+        _manager->streamDataActivated();
+}
+
+
+/**
+ * @details
+ * Records a chunk of stream data served to the session, which then stops
+ * waiting, and updates the client's throughput.
+ */
+void ChunkScheduler::served(int handle, quint64 bytes)
+{
+    bool othersWaiting = false;
+    {
+        QMutexLocker locker(&_mutex);
+        QHash<int, Entry>::iterator it = _sessions.find(handle);
+        if (it == _sessions.end())
+            return;
+        it->ticket = 0;
+        ++it->outstanding;
+
+        Totals& t = _clients[it->name];
+        double now = _now();
+        double decay = std::exp(-(now - t.last) / rateTimeConstant);
+        t.chunkRate = t.chunkRate * decay + 1.0 / rateTimeConstant;
+        t.byteRate = t.byteRate * decay + bytes / rateTimeConstant;
+        t.last = now;
+        ++t.chunks;
+        t.bytes += bytes;
+
+        foreach (const Entry& e, _sessions) {
+            if (e.ticket != 0) {
+                othersWaiting = true;
+                break;
+            }
+        }
+    }
+    // Let the next session in line look for data.
+    if (othersWaiting && _manager)
+        _manager->streamDataActivated();
+}
+
+
+/**
+ * @details
+ * Records that the client has finished with the given number of the
+ * chunks served to the session, or with all of them if \p chunks < 0.
+ */
+void ChunkScheduler::completed(int handle, int chunks)
+{
+    QMutexLocker locker(&_mutex);
+    QHash<int, Entry>::iterator it = _sessions.find(handle);
+    if (it == _sessions.end())
+        return;
+    if (chunks < 0 || chunks > it->outstanding)
+        it->outstanding = 0;
+    else
+        it->outstanding -= chunks;
+}
+
+
+/**
+ * @details
+ * Returns the statistics of every client seen, with the throughput
+ * averages decayed to the present.
+ */
+QList<ChunkScheduler::ClientStats> ChunkScheduler::stats()
+{
+    QMutexLocker locker(&_mutex);
+    double now = _now();
+    QHash<QString, ClientStats> result;
+    QHash<QString, Totals>::const_iterator it = _clients.constBegin();
+    for (; it != _clients.constEnd(); ++it) {
+        const Totals& t = it.value();
+        double decay = std::exp(-(now - t.last) / rateTimeConstant);
+        ClientStats s;
+        s.name = it.key();
+        s.sessions = t.sessions;
+        s.chunks = t.chunks;
+        s.bytes = t.bytes;
+        s.chunkRate = t.chunkRate * decay;
+        s.byteRate = t.byteRate * decay;
+        s.outstanding = 0;
+        s.waiting = 0;
+        result.insert(s.name, s);
+    }
+    foreach (const Entry& e, _sessions) {
+        ClientStats& s = result[e.name];
+        s.outstanding += e.outstanding;
+        if (e.ticket != 0) ++s.waiting;
+    }
+    return result.values();
+}
+
+
+/**
+ * @details
+ * Returns the time of day in seconds.
+ */
+double ChunkScheduler::_now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+} // namespace pelican
@@ -2,6 +2,7 @@
 #include "pelican/server/DataReceiver.h"
 #include "pelican/server/DataManager.h"
 #include "pelican/server/AbstractChunker.h"
+#include "pelican/server/AbstractUdpChunker.h"
 
 #include <QtCore/QVector>
 #include <boost/shared_ptr.hpp>
@@ -62,9 +63,13 @@ ChunkerManager::~ChunkerManager()
  */
 bool ChunkerManager::init(DataManager& dataManager)
 {
-    // Create the stream and service data buffers.
+    // Create the stream and service data buffers. The chunks of streams
+    // written by several receiver threads are served in sequence order.
     foreach (const QString& type, _streamDataTypes) {
-        dataManager.getStreamBuffer(type);
+        StreamDataBuffer* buffer = dataManager.getStreamBuffer(type);
+        int threads = _streamThreads.value(type, 1);
+        if (threads > 1)
+            buffer->setOrdered(threads);
     }
 
     foreach (const QString& type, _serviceDataTypes) {
@@ -76,6 +81,7 @@ bool ChunkerManager::init(DataManager& dataManager)
         foreach (AbstractChunker* chunker, _chunkers ) {
             chunker->setDataManager(&dataManager);
             DataReceiver* receiver = new DataReceiver(chunker);
+            receiver->setObjectName(_chunkerNames.value(chunker));
             _dataReceivers.insert( chunker, receiver);
             receiver->start();
         }
@@ -114,6 +120,16 @@ AbstractChunker* ChunkerManager::addStreamChunker(QString chunkerType, QString n
     // Create a chunker of the specified type with the factory.
     AbstractChunker* chunker = _factory->create(chunkerType, name);
 
+    // Only the AbstractUdpChunker binds its socket so that the copies for
+    // further threads can share the port.
+    if (chunker->threads() > 1 && !dynamic_cast<AbstractUdpChunker*>(chunker))
+    {
+        delete chunker;
+        throw QString("ChunkerManager::addStreamChunker(): "
+                "Chunker '%1' can not have more than one thread, "
+                "as it is not an AbstractUdpChunker.").arg(chunkerType);
+    }
+
     // If no data chunk types are registered to the chunker, set the chunker
     // data type to the chunker name.
     // NOTE: This should probably never happen!
@@ -125,13 +141,17 @@ AbstractChunker* ChunkerManager::addStreamChunker(QString chunkerType, QString n
         chunker->addChunkType(chunkerType);
     }
 
-    // Add the chunker to the chunker manager.
-    _addChunker(chunker);
+    // Add the chunker to the chunker manager, with a copy for each
+    // further receiver thread.
+    _addChunker(chunker, name.isEmpty() ? chunkerType : name);
+    _addThreads(chunker, chunkerType, name);
 
     // Loop over the list of chunk types written into the data buffer
     // by the chunker and add them to the list of stream data types.
-    foreach( const QString& chunkType, chunker->chunkTypes())
+    foreach( const QString& chunkType, chunker->chunkTypes()) {
         _streamDataTypes.insert(chunkType);
+        _streamThreads[chunkType] += chunker->threads();
+    }
 
     return chunker;
 }
@@ -150,6 +170,10 @@ AbstractChunker* ChunkerManager::addServiceChunker(QString type, QString name)
 
     // Create a chunker of the specified type with the factory.
     AbstractChunker* chunker = _factory->create(type, name);
+    if (chunker->threads() > 1)
+        throw QString("ChunkerManager::addServiceChunker(): "
+                "Service chunker '%1' can not have more than one thread.")
+                .arg(type);
 
     // If no types are registered to the chunker set the chunker data type
     // to the chunker name.
@@ -162,7 +186,7 @@ AbstractChunker* ChunkerManager::addServiceChunker(QString type, QString name)
     }
 
     // Add the chunker to the chunker manager.
-    _addChunker(chunker);
+    _addChunker(chunker, name.isEmpty() ? type : name);
 
     // Loop over the list of chunk types written into the data buffer
     // by the chunker and add them to the list of service data types.
@@ -185,8 +209,9 @@ QIODevice* ChunkerManager::getCurrentDevice( AbstractChunker* chunker ) const
  * Adds the allocated chunker to the map of known chunkers.
  *
  * @param[in] chunker  Pointer to the allocated chunker.
+ * @param[in] name     The chunker's configuration name, or its type.
  */
-void ChunkerManager::_addChunker(AbstractChunker* chunker)
+void ChunkerManager::_addChunker(AbstractChunker* chunker, const QString& name)
 {
     if (chunker)
     {
@@ -207,6 +232,31 @@ void ChunkerManager::_addChunker(AbstractChunker* chunker)
             _chunkerPortMap[pair] = chunker;
         }
         _chunkers.insert(chunker);
+        _chunkerNames.insert(chunker, name);
+    }
+}
+
+/**
+ * @details
+ * Adds a copy of the chunker for each of its threads after the first,
+ * created by the factory from the same configuration. The copies share
+ * the chunker's host and port, bound with SO_REUSEPORT by the
+ * AbstractUdpChunker (the only chunker allowed more than one thread), and
+ * its name, so that their receivers
+ * are placed as one (see ThreadPlacement).
+ *
+ * @param[in] chunker  Pointer to the allocated chunker.
+ * @param[in] type     The chunker type (class name).
+ * @param[in] name     The optional chunker configuration name.
+ */
+void ChunkerManager::_addThreads(AbstractChunker* chunker, const QString& type,
+        const QString& name)
+{
+    for (int i = 1; i < chunker->threads(); ++i) {
+        AbstractChunker* copy = _factory->create(type, name);
+        copy->setChunkTypes(chunker->chunkTypes());
+        _chunkers.insert(copy);
+        _chunkerNames.insert(copy, name.isEmpty() ? type : name);
     }
 }
 
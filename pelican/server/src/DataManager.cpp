@@ -1,14 +1,22 @@
 #include "pelican/server/DataManager.h"
 
+#include "pelican/server/ChunkScheduler.h"
+#include "pelican/server/StreamRecorder.h"
 #include "pelican/server/LockableServiceData.h"
 #include "pelican/server/LockableStreamData.h"
 #include "pelican/server/WritableData.h"
 #include "pelican/comms/StreamData.h"
+#include "pelican/comms/MetricsResponse.h"
 #include "pelican/utility/Config.h"
+#include "pelican/utility/BufferMemory.h"
+#include "pelican/utility/LatencyMonitor.h"
 
 #include <iostream>
+#include <unistd.h>
+#include <sched.h>
 #include <QtCore/QMutexLocker>
 #include <QtCore/QDebug>
+#include <QtCore/QDir>
 
 namespace pelican {
 
@@ -18,14 +26,16 @@ namespace pelican {
  * DataManager constructor.
  */
 DataManager::DataManager(const Config* config, const QString section)
-    : _config(config), _verboseLevel(0)
+    : _config(config), _verboseLevel(0), _scheduler(0), _recorder(0),
+      _wakeupCount(0)
 {
     _bufferConfigBaseAddress << Config::NodeId(section,"");
     _bufferConfigBaseAddress << Config::NodeId("buffers","");
 }
 
 DataManager::DataManager(const Config* config, const Config::TreeAddress& base)
-    : _config(config), _verboseLevel(0)
+    : _config(config), _verboseLevel(0), _scheduler(0), _recorder(0),
+      _wakeupCount(0)
 {
     _bufferConfigBaseAddress = base;
 }
@@ -45,6 +55,90 @@ DataManager::~DataManager()
     foreach(ServiceDataBuffer* s, _service) {
         delete s;
     }
+    delete _scheduler;
+    delete _recorder;
+}
+
+
+/**
+ * @details
+ * Enables (or disables) the ChunkScheduler used by sessions to decide which
+ * of them takes the next chunk of stream data. Should be set before any
+ * sessions are started.
+ */
+void DataManager::setScheduling(bool enabled)
+{
+    if (enabled && !_scheduler)
+        _scheduler = new ChunkScheduler(this);
+    else if (!enabled) {
+        delete _scheduler;
+        _scheduler = 0;
+    }
+}
+
+
+/**
+ * @details
+ * Called by sessions when they have handled a request, with the time taken
+ * in nanoseconds.
+ */
+void DataManager::requestCompleted(ServerRequest::Request type, quint64 time)
+{
+    if (type < 0 || type >= requestTypes) return;
+    _requests[type].add();
+    _requestTime[type].add(time);
+    _requestMaxTime[type].max(time);
+}
+
+
+/**
+ * @details
+ * Returns the metrics of the server: the counters of each stream and
+ * service buffer (see StreamDataBuffer::metrics()), the number of requests
+ * of each type handled with the total and longest time taken (seconds),
+ * the statistics of each client if sessions are scheduled, the number
+ * of chunks recorded, and the latency histograms of the process (see
+ * LatencyMonitor).
+ */
+QMap<QString, double> DataManager::metrics() const
+{
+    static const char* names[requestTypes] = {
+        "Error", "Acknowledge", "StreamData", "ServiceData", "DataSupport",
+        "StreamSubscription", "Credit", "ProtocolVersion", "Release",
+        "Consumer", "Metrics"
+    };
+    QMap<QString, double> values;
+    foreach (StreamDataBuffer* s, _streams)
+        s->metrics(values);
+    foreach (ServiceDataBuffer* s, _service)
+        s->metrics(values);
+    for (int i = 0; i < requestTypes; ++i) {
+        if (_requests[i].value() == 0) continue;
+        values.insert(MetricsResponse::name("pelican_requests_total",
+                "type", names[i]), _requests[i].value());
+        values.insert(MetricsResponse::name("pelican_request_seconds_total",
+                "type", names[i]), _requestTime[i].value() * 1e-9);
+        values.insert(MetricsResponse::name("pelican_request_seconds_max",
+                "type", names[i]), _requestMaxTime[i].value() * 1e-9);
+    }
+    if (_scheduler) {
+        foreach (const ChunkScheduler::ClientStats& c, _scheduler->stats()) {
+            values.insert(MetricsResponse::name("pelican_client_sessions",
+                    "client", c.name), c.sessions);
+            values.insert(MetricsResponse::name("pelican_client_chunks_total",
+                    "client", c.name), c.chunks);
+            values.insert(MetricsResponse::name("pelican_client_bytes_total",
+                    "client", c.name), c.bytes);
+            values.insert(MetricsResponse::name("pelican_client_chunk_rate",
+                    "client", c.name), c.chunkRate);
+            values.insert(MetricsResponse::name("pelican_client_outstanding",
+                    "client", c.name), c.outstanding);
+        }
+    }
+    if (_recorder)
+        values.insert("pelican_recorded_chunks_total", _recorder->count());
+    LatencyMonitor::instance()->metrics(values);
+    return values;
 }
 
 
@@ -99,7 +193,41 @@ StreamDataBuffer* DataManager::getStreamBuffer(const QString& type)
             _bufferMaxChunkSizes[type] = config.getOption("buffer", "maxChunkSize", 0).toULongLong();
             if( ! _bufferMaxChunkSizes[type] ) _bufferMaxChunkSizes[type]=_bufferMaxSizes[type];
         }
-        setStreamDataBuffer( type, new StreamDataBuffer(type, _bufferMaxSizes[type], _bufferMaxChunkSizes[type]) );
+        StreamDataBuffer::Allocation allocation = StreamDataBuffer::Dynamic;
+        QString allocationOption =
+                config.getOption("buffer", "allocation", "dynamic").toLower();
+        if (allocationOption == "slab")
+            allocation = StreamDataBuffer::Slab;
+        else if (allocationOption == "shared")
+            allocation = StreamDataBuffer::Shared;
+        StreamDataBuffer::ServeQueue serveQueue = StreamDataBuffer::Locking;
+        if (config.getOption("buffer", "serveQueue", "locking").toLower() == "lockfree") {
+            // The lock-free queue is only available with slab allocation.
+            serveQueue = StreamDataBuffer::LockFree;
+            if (allocation == StreamDataBuffer::Dynamic)
+                allocation = StreamDataBuffer::Slab;
+        }
+        StreamDataBuffer* buffer = new StreamDataBuffer(type,
+                _bufferMaxSizes[type], _bufferMaxChunkSizes[type],
+                allocation, serveQueue, BufferMemory(config, "buffer"));
+        if (config.getOption("buffer", "broadcast", "false").toLower() == "true") {
+            StreamDataBuffer::LagPolicy policy = StreamDataBuffer::DropOldest;
+            if (config.getOption("buffer", "lagPolicy", "drop").toLower() == "wait")
+                policy = StreamDataBuffer::Wait;
+            buffer->setBroadcast(policy,
+                    config.getOption("buffer", "maxLag", "0").toInt());
+            QString consumers = config.getOption("buffer", "consumers");
+            foreach (const QString& name, consumers.split(",", QString::SkipEmptyParts))
+                buffer->addConsumer(name.trimmed());
+        }
+        qulonglong spillSize = config.getOption("buffer", "spillSize", "0").toULongLong();
+        if (spillSize > 0) {
+            QString spillFile = config.getOption("buffer", "spillFile",
+                    QString("%1/pelican.%2.%3.spill").arg(QDir::tempPath())
+                    .arg(getpid()).arg(type));
+            buffer->setSpillFile(spillFile, spillSize);
+        }
+        setStreamDataBuffer(type, buffer);
     }
     return _streams[type];
 }
@@ -135,12 +263,30 @@ ServiceDataBuffer* DataManager::getServiceBuffer(const QString& type)
         }
 
         setServiceDataBuffer(type, new ServiceDataBuffer(type,
-                _bufferMaxSizes[type], _bufferMaxChunkSizes[type]));
+                _bufferMaxSizes[type], _bufferMaxChunkSizes[type],
+                BufferMemory(config, "buffer")));
     }
     return _service[type];
 }
 
 
+/**
+ * @details
+ * Starts recording the chunks activated on every stream buffer (including
+ * those created later) to a new file, replacing any earlier recording,
+ * which is closed. An empty path stops recording. Should be called before
+ * any data is written.
+ */
+void DataManager::setRecording(const QString& path)
+{
+    StreamRecorder* old = _recorder;
+    _recorder = path.isEmpty() ? 0 : new StreamRecorder(path);
+    foreach (StreamDataBuffer* s, _streams)
+        s->setRecorder(_recorder);
+    delete old;
+}
+
+
 /**
  * @details
  * Note that the DataManager takes ownership of the StreamDataBuffer, and will
@@ -153,6 +299,7 @@ void DataManager::setStreamDataBuffer(const QString& name, StreamDataBuffer* buf
     _specs.addStreamData(name);
     buffer->setVerbosity(_verboseLevel);
     buffer->setDataManager(this);
+    buffer->setRecorder(_recorder);
     _streams[name]=buffer;
 }
 
@@ -184,9 +331,10 @@ void DataManager::setServiceDataBuffer(const QString& name, ServiceDataBuffer* b
  * We make the assumption that this method will not be called with an
  * invalid type. No checking in order to speed things up.
  */
-LockedData DataManager::getNext(const QString& type, const QSet<QString>& associateData )
+LockedData DataManager::getNext(const QString& type,
+        const QSet<QString>& associateData, const QString& consumer)
 {
-    LockedData lockedData = getNext(type);
+    LockedData lockedData = getNext(type, consumer);
 
     if( lockedData.isValid() )
     {
@@ -201,6 +349,7 @@ LockedData DataManager::getNext(const QString& type, const QSet<QString>& associ
 #else
         if(! ( associateData - test ).isEmpty() ) {
 #endif // BROKEN_QT_SET_HEADER
+            _streams[type]->unread(streamData, consumer);
             return LockedData(0);
         }
     }
@@ -216,12 +365,12 @@ LockedData DataManager::getNext(const QString& type, const QSet<QString>& associ
  *
  * WARNING: No checking in order to speed things up.
  */
-LockedData DataManager::getNext(const QString& type)
+LockedData DataManager::getNext(const QString& type, const QString& consumer)
 {
     LockedData lockedData(type, 0);
 
     verbose("getNext(" + type + ") called", 2 );
-    _streams[type]->getNext(lockedData);
+    _streams[type]->getNext(lockedData, consumer);
     return lockedData;
 }
 
@@ -229,11 +378,13 @@ LockedData DataManager::getNext(const QString& type)
 /**
  * @details
  *         Attempt to fulfill a DataRequirement request for data
+ *         (for the named consumer of broadcast streams).
  * @return A list of locked data containing streams data objects (with the
  *         associated service data) or the request
  *         returns an empty string
  */
-QList<LockedData> DataManager::getDataRequirements(const DataSpec& req)
+QList<LockedData> DataManager::getDataRequirements(const DataSpec& req,
+        const QString& consumer)
 {
     QList<LockedData> dataList;
     if( ! req.isCompatible( dataSpec() ) ) {
@@ -244,8 +395,12 @@ QList<LockedData> DataManager::getDataRequirements(const DataSpec& req)
     }
     foreach (const QString stream, req.streamData() )
     {
-        LockedData data = getNext(stream, req.serviceData());
+        LockedData data = getNext(stream, req.serviceData(), consumer);
         if( ! data.isValid() ) {
+            // Broadcast consumers must be served the chunks taken again.
+            foreach (const LockedData& d, dataList)
+                _streams[d.name()]->unread(
+                        static_cast<LockableStreamData*>(d.object()), consumer);
             dataList.clear();
             break; // one invalid stream invalidates the request
         }
@@ -306,6 +461,82 @@ void DataManager::emptiedBuffer(StreamDataBuffer* buffer)
     }
 }
 
+/**
+ * @details
+ * Wakes any threads waiting in waitForStreamData(), and writes to any armed
+ * wakeup descriptors (disarming them).
+ *
+ * Each write is counted in the descriptor's writers before the descriptor
+ * is read, so that removeWakeupDescriptor() can wait for it to finish.
+ */
+void DataManager::streamDataActivated()
+{
+    _streamDataActivated.notifyAll();
+    for (int i = 0; i < _wakeupCount; ++i) {
+        WakeupDescriptor& w = _wakeups[i];
+        if (w.armed && __sync_lock_test_and_set(&w.armed, 0)) {
+            __sync_add_and_fetch(&w.writers, 1);
+            int fd = w.fd;
+            quint64 one = 1;
+            if (fd >= 0 && ::write(fd, &one, sizeof(one)) < 0) {
+                // The descriptor is already readable.
+            }
+            __sync_sub_and_fetch(&w.writers, 1);
+        }
+    }
+}
+
+
+/**
+ * @details
+ * Wakeup descriptors let event driven consumers (e.g. the SessionWorker
+ * epoll loop) be woken by stream data activation. The descriptor must
+ * accept 8 byte writes, as an eventfd does.
+ */
+int DataManager::addWakeupDescriptor(int fd)
+{
+    QMutexLocker locker(&_wakeupMutex);
+    for (int i = 0; i < _wakeupCount; ++i) {
+        if (_wakeups[i].fd == -1) {
+            _wakeups[i].armed = 0;
+            _wakeups[i].fd = fd;
+            __sync_synchronize();
+            return i;
+        }
+    }
+    if (_wakeupCount == maxWakeupDescriptors)
+        throw QString("DataManager: Too many wakeup descriptors.");
+    _wakeups[_wakeupCount].fd = fd;
+    _wakeups[_wakeupCount].armed = 0;
+    _wakeups[_wakeupCount].writers = 0;
+    __sync_synchronize();
+    return _wakeupCount++;
+}
+
+
+void DataManager::armWakeupDescriptor(int handle)
+{
+    __sync_lock_test_and_set(&_wakeups[handle].armed, 1);
+    __sync_synchronize();
+}
+
+
+/**
+ * @details
+ * Unregisters the wakeup descriptor, returning once no write to it is in
+ * progress, so that the caller may then close it.
+ */
+void DataManager::removeWakeupDescriptor(int handle)
+{
+    QMutexLocker locker(&_wakeupMutex);
+    WakeupDescriptor& w = _wakeups[handle];
+    w.armed = 0;
+    w.fd = -1;
+    __sync_synchronize();
+    while (w.writers > 0)
+        sched_yield();
+}
+
 void DataManager::addDefaultAdapters( const QHash<QString,QString>& types ) {
     _specs.addAdapterTypes( types );
 }
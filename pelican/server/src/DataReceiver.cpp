@@ -1,5 +1,6 @@
 #include "pelican/server/DataReceiver.h"
 #include "pelican/utility/pelicanTimer.h"
+#include "pelican/utility/ThreadPlacement.h"
 #include <QtCore/QIODevice>
 #include <QtCore/QTimer>
 #include <QtCore/QFile>
@@ -37,6 +38,8 @@ DataReceiver::~DataReceiver()
 /**
  * @details
  * Runs the thread owned by the DataReceiver object.
+ * The thread is first placed as configured for the DataReceiver of its
+ * chunker (see ThreadPlacement).
  * The thread creates and opens the socket and connects the readyRead()
  * socket signal to the private _processIncomingData() slot using a direct
  * connection, before entering its own event loop.
@@ -44,11 +47,10 @@ DataReceiver::~DataReceiver()
 void DataReceiver::run()
 {
     _active = true;
+    ThreadPlacement::place("DataReceiver", objectName());
     // Open up the device to use.
     // N.B. must be done in this thread (i.e. in run())
     _setupDevice();
-    //    int tid = syscall(__NR_gettid);
-    //    std::cout << "Thread ID : " << tid << std::endl;
     if (_device) {
         // process any existing data on the stream
         if( _device->bytesAvailable() > 0 )
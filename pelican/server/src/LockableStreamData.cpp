@@ -17,6 +17,7 @@ LockableStreamData::LockableStreamData(const QString& name, void* memory,
 {
     _data.reset( new StreamData(name, memory, size) );
     _served = false;
+    _readers = 0;
 }
 
 LockableStreamData::~LockableStreamData()
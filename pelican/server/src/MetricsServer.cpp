@@ -0,0 +1,73 @@
+#include "pelican/server/MetricsServer.h"
+#include "pelican/server/DataManager.h"
+#include "pelican/comms/MetricsResponse.h"
+
+#include <QtNetwork/QTcpSocket>
+
+namespace pelican {
+
+
+/**
+ * @details
+ * Creates a metrics server. Call listen() to start it.
+ */
+MetricsServer::MetricsServer(DataManager* data, QObject* parent)
+    : QTcpServer(parent), _data(data)
+{
+    connect(this, SIGNAL(newConnection()), SLOT(_newConnection()));
+}
+
+
+/**
+ * @details
+ * Destroys the metrics server.
+ */
+MetricsServer::~MetricsServer()
+{
+}
+
+
+/**
+ * @details
+ * Waits for the request on each new connection.
+ */
+void MetricsServer::_newConnection()
+{
+    while (hasPendingConnections()) {
+        QTcpSocket* socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), SLOT(_readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+
+/**
+ * @details
+ * Answers the request once its header has arrived: GET gives the metrics,
+ * anything else an error. The connection is then closed.
+ */
+void MetricsServer::_readRequest()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !socket->canReadLine())
+        return;
+    disconnect(socket, SIGNAL(readyRead()), this, SLOT(_readRequest()));
+
+    QByteArray request = socket->readLine();
+    QByteArray response;
+    if (request.startsWith("GET ")) {
+        QByteArray body = MetricsResponse(_data->metrics()).text().toUtf8();
+        response = "HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                "\r\n" + body;
+    }
+    else {
+        response = "HTTP/1.0 405 Method Not Allowed\r\n"
+                "Content-Length: 0\r\n\r\n";
+    }
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+} // namespace pelican
@@ -0,0 +1,224 @@
+#include "pelican/server/PacketReassembler.h"
+#include "pelican/server/AbstractChunker.h"
+#include "pelican/server/AbstractLockableData.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/utility/ConfigNode.h"
+
+#include <cstring>
+
+namespace pelican {
+
+
+/**
+ * @details
+ * Constructs a reassembler from the \c reassembly tag of the chunker's
+ * configuration (see the class description). Chunks are written to the
+ * given stream, or to the chunker's only stream if none is given.
+ */
+PacketReassembler::PacketReassembler(AbstractChunker* chunker,
+        const Header* header, const ConfigNode& config, const QString& stream)
+    : _chunker(chunker), _header(header), _stream(stream)
+{
+    _headerSize = config.getOption("reassembly", "header", "0").toInt();
+    _payloadSize = config.getOption("reassembly", "payload").toInt();
+    _packets = config.getOption("reassembly", "packets").toInt();
+    _window = config.getOption("reassembly", "window", "0").toInt();
+    QString gaps = config.getOption("reassembly", "gaps", "zero");
+    if( gaps == "zero" )
+        _gaps = ZeroFill;
+    else if( gaps == "flag" )
+        _gaps = Flag;
+    else
+        throw QString("PacketReassembler: unknown gaps \"%1\"").arg(gaps);
+    _init();
+}
+
+/**
+ * @details
+ * Constructs a reassembler for packets of a header and a payload of the
+ * given sizes, with the given number of packets in each chunk and the
+ * reorder window in packets.
+ */
+PacketReassembler::PacketReassembler(AbstractChunker* chunker,
+        const Header* header, int headerSize, int payloadSize, int packets,
+        int window, GapPolicy gaps, const QString& stream)
+    : _chunker(chunker), _header(header), _stream(stream),
+      _headerSize(headerSize), _payloadSize(payloadSize), _packets(packets),
+      _window(window), _gaps(gaps)
+{
+    _init();
+}
+
+/**
+ * @details
+ * Releases the chunks still open.
+ */
+PacketReassembler::~PacketReassembler()
+{
+    flush();
+}
+
+/**
+ * @details
+ * Checks the layout and clears the state.
+ */
+void PacketReassembler::_init()
+{
+    if( ! _chunker || ! _header )
+        throw QString("PacketReassembler: no chunker or header functor");
+    if( _headerSize < 0 || _payloadSize <= 0 || _packets <= 0 || _window < 0 )
+        throw QString("PacketReassembler: invalid layout (header %1, "
+                "payload %2, packets %3, window %4)").arg(_headerSize)
+                .arg(_payloadSize).arg(_packets).arg(_window);
+    _started = false;
+    _base = _next = _highest = 0;
+}
+
+/**
+ * @details
+ * Reads the packet's sequence number, releases the chunks the reorder
+ * window has passed, opens the chunks up to the packet's own, and copies
+ * the payload into place. Full chunks at the head of the queue are then
+ * released.
+ */
+void PacketReassembler::add(const char* packet, int size)
+{
+    quint64 sequence = 0, timestamp = 0;
+    if( size < _headerSize + _payloadSize
+            || ! (*_header)(packet, size, &sequence, &timestamp) ) {
+        _rejected.add();
+        return;
+    }
+    if( ! _started ) {
+        _started = true;
+        _base = _next = _highest = sequence;
+    }
+
+    quint64 oldest = _chunks.isEmpty() ? _next : _chunks.first()->first;
+    if( sequence < oldest ) {
+        _late.add();
+        return;
+    }
+    bool reordered = sequence < _highest;
+    if( sequence > _highest )
+        _highest = sequence;
+
+    // Release the chunks the window has passed.
+    quint64 span = (quint64)_packets + _window;
+    while( ! _chunks.isEmpty() && _chunks.first()->first + span <= sequence )
+        _release();
+
+    // Skip the chunks the window has passed without opening them.
+    if( _chunks.isEmpty() && _next + span <= sequence ) {
+        quint64 skip = (sequence - span - _next) / _packets + 1;
+        _lost.add(skip * _packets);
+        _next += skip * _packets;
+    }
+
+    quint64 first = _base + (sequence - _base) / _packets * _packets;
+    while( _next <= first )
+        _open(_next);
+
+    Chunk* chunk = _chunks[(int)((first - _chunks.first()->first) / _packets)];
+    int slot = (int)(sequence - first);
+    if( chunk->filled.testBit(slot) ) {
+        _duplicates.add();
+        return;
+    }
+    chunk->filled.setBit(slot);
+    ++chunk->count;
+    if( reordered ) {
+        _reordered.add();
+        chunk->stats.setReordered(chunk->stats.reordered() + 1);
+    }
+    if( slot < chunk->earliest ) {
+        chunk->earliest = slot;
+        chunk->stats.setTimestamp(timestamp);
+    }
+    if( chunk->data.isValid() ) {
+        char* ptr = (char*)chunk->data.ptr() + (size_t)slot * _payloadSize;
+        memcpy(ptr, packet + _headerSize, _payloadSize);
+        _received.add();
+    }
+    else {
+        _discarded.add();
+    }
+
+    while( ! _chunks.isEmpty() && _chunks.first()->count == _packets )
+        _release();
+}
+
+/**
+ * @details
+ * Releases all the open chunks, in order. Packets for them that arrive
+ * later are counted as late.
+ */
+void PacketReassembler::flush()
+{
+    while( ! _chunks.isEmpty() )
+        _release();
+}
+
+/**
+ * @details
+ * Opens the chunk starting at the given sequence number, taking storage
+ * for it from the chunker. If there is no room in the buffer the chunk is
+ * still tracked, so that its packets are counted, but not written.
+ */
+void PacketReassembler::_open(quint64 first)
+{
+    Chunk* chunk = new Chunk;
+    chunk->first = first;
+    chunk->filled.resize(_packets);
+    chunk->count = 0;
+    chunk->earliest = _packets;
+    chunk->stats.setSequence(first);
+    chunk->stats.setPackets(_packets);
+    if( _stream.isEmpty() )
+        chunk->data = _chunker->getDataStorage(chunkSize());
+    else
+        chunk->data = _chunker->getDataStorage(chunkSize(), _stream);
+    _chunks.append(chunk);
+    _next = first + _packets;
+}
+
+/**
+ * @details
+ * Counts the packets missing from the oldest open chunk as lost,
+ * zero-fills or lists the gaps they leave, attaches the statistics to the
+ * chunk, and releases it to be served (unless it has no packets at all).
+ */
+void PacketReassembler::_release()
+{
+    Chunk* chunk = _chunks.takeFirst();
+    int lost = _packets - chunk->count;
+    _lost.add(lost);
+    chunk->stats.setLost(lost);
+
+    if( chunk->data.isValid() ) {
+        char* ptr = (char*)chunk->data.ptr();
+        for( int i = 0; i < _packets; ) {
+            if( chunk->filled.testBit(i) ) {
+                ++i;
+                continue;
+            }
+            int end = i + 1;
+            while( end < _packets && ! chunk->filled.testBit(end) )
+                ++end;
+            if( _gaps == ZeroFill )
+                memset(ptr + (size_t)i * _payloadSize, 0,
+                        (size_t)(end - i) * _payloadSize);
+            else
+                chunk->stats.addGap(i, end - i);
+            i = end;
+        }
+        DataChunk* data = chunk->data.data()->data().get();
+        if( chunk->count == 0 )
+            data->setSize(0);
+        else if( StreamData* streamData = dynamic_cast<StreamData*>(data) )
+            streamData->packetStats() = chunk->stats;
+    }
+    delete chunk;
+}
+
+} // namespace pelican
@@ -1,25 +1,91 @@
 #include "pelican/server/PelicanPortServer.h"
 #include "pelican/server/Session.h"
+#include "pelican/server/SessionWorker.h"
 #include "pelican/comms/AbstractProtocol.h"
 
 #include <QtNetwork/QTcpSocket>
+#include <QtCore/QFile>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
 
 namespace pelican {
 
 // class PelicanPortServer
 PelicanPortServer::PelicanPortServer(AbstractProtocol* proto, DataManager* data, QObject* parent)
-    : QTcpServer(parent), _proto(proto), _data(data), _verboseLevel(0)
+    : QTcpServer(parent), _proto(proto), _data(data), _verboseLevel(0),
+      _keepAlive(false), _nextWorker(0)
 {
 }
 
 PelicanPortServer::~PelicanPortServer()
 {
+    foreach (SessionWorker* worker, _workers) delete worker;
+    if (!_localPath.isEmpty()) {
+        close();
+        unlink(QFile::encodeName(_localPath).constData());
+    }
+}
+
+/**
+ * @details
+ * Starts the given number of SessionWorker threads to handle keep-alive
+ * connections.
+ */
+void PelicanPortServer::setWorkerThreads(int threads)
+{
+    foreach (SessionWorker* worker, _workers) delete worker;
+    _workers.clear();
+    for (int i = 0; i < threads; ++i) {
+        SessionWorker* worker = new SessionWorker(_proto, _data);
+        worker->setVerbosity(_verboseLevel);
+        worker->start();
+        _workers.append(worker);
+    }
+}
+
+/**
+ * @details
+ * Listens on a Unix domain socket at the given path (replacing any socket
+ * left there) instead of a TCP port. Accepted connections are handled in
+ * the same way as TCP connections. The socket file is removed when the
+ * server is destroyed.
+ */
+bool PelicanPortServer::listenLocal(const QString& path)
+{
+    QByteArray name = QFile::encodeName(path);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (name.size() >= (int)sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, name.constData());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    unlink(addr.sun_path);
+    if (::bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+            || ::listen(fd, 50) != 0 || !setSocketDescriptor(fd)) {
+        ::close(fd);
+        return false;
+    }
+    _localPath = path;
+    return true;
 }
 
 void PelicanPortServer::incomingConnection(int socketDescriptor)
 {
+    if (_keepAlive && !_workers.isEmpty()) {
+        _workers[_nextWorker]->addConnection(socketDescriptor);
+        _nextWorker = (_nextWorker + 1) % _workers.size();
+        return;
+    }
     Session *thread = new Session(socketDescriptor, _proto, _data, this);
     thread->setVerbosity(_verboseLevel);
+    thread->setKeepAlive(_keepAlive);
     connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
     thread->start();
 }
@@ -7,7 +7,9 @@
 #include "pelican/server/DataReceiver.h"
 #include "pelican/comms/PelicanProtocol.h"
 #include "pelican/server/PelicanPortServer.h"
+#include "pelican/server/MetricsServer.h"
 #include "pelican/utility/Config.h"
+#include "pelican/utility/ThreadPlacement.h"
 
 #include <boost/shared_ptr.hpp>
 
@@ -48,6 +50,8 @@ PelicanServer::~PelicanServer()
     // Delete the protocols.
     foreach (AbstractProtocol* protocol, _protocolPortMap)
         delete protocol;
+    foreach (AbstractProtocol* protocol, _protocolPathMap)
+        delete protocol;
 }
 
 /**
@@ -67,6 +71,24 @@ void PelicanServer::addProtocol(AbstractProtocol* protocol, quint16 port)
     _protocolPortMap[port] = protocol;
 }
 
+/**
+ * @details
+ * Adds the given \p protocol to a Unix domain socket at the given \p path.
+ * The class takes ownership of \p protocol.
+ *
+ * @param protocol A pointer to the allocated protocol.
+ * @param path     The path of the socket.
+ */
+void PelicanServer::addLocalProtocol(AbstractProtocol* protocol,
+        const QString& path)
+{
+    if ( _protocolPathMap.contains(path) ) {
+        delete protocol;
+        throw QString("Cannot map multiple protocols to socket %1").arg(path);
+    }
+    _protocolPathMap[path] = protocol;
+}
+
 /**
  * @details
  * Adds a stream chunker of the given \p type and \p name.
@@ -103,28 +125,88 @@ void PelicanServer::addServiceChunker(QString type, QString name)
  *
  * Sets up the data manager which handles stream and service data buffers
  * which are set up on request of the chunkers.
+ *
+ * The placement of the server's threads is read from the \c threads tag
+ * of the server section (see ThreadPlacement) before any are started.
  */
 void PelicanServer::run()
 {
     try {
         QVector<boost::shared_ptr<PelicanPortServer> > servers;
 
+        // Place the server's threads.
+        Config::TreeAddress address;
+        address << Config::NodeId("server", "");
+        ConfigNode serverConfig = _config->get(address);
+        ThreadPlacement::configure(serverConfig);
+        ThreadPlacement::place("PelicanServer");
+
         // Set up the data manager.
         DataManager dataManager(_config);
         dataManager.setVerbosity(_verboseLevel);
+        QString recording = serverConfig.getOption("record", "file");
+        if (!recording.isEmpty()) {
+            dataManager.setRecording(recording);
+            verbose( QString("PelicanServer: recording stream data to %1")
+                    .arg(recording), 1 );
+        }
         _chunkerManager->init(dataManager);
 
+        // Read the session options.
+        bool keepAlive = serverConfig.getOption("sessions", "keepAlive",
+                "false").toLower() == "true";
+        int threads = serverConfig.getOption("sessions", "threads", "0").toInt();
+        dataManager.setScheduling(serverConfig.getOption("sessions",
+                "loadBalance", "false").toLower() == "true");
+        bool zeroCopy = serverConfig.getOption("sessions", "zeroCopy",
+                "false").toLower() == "true";
+        foreach (AbstractProtocol* protocol, _protocolPortMap) {
+            if (PelicanProtocol* p = dynamic_cast<PelicanProtocol*>(protocol))
+                p->setZeroCopy(zeroCopy);
+        }
+        foreach (AbstractProtocol* protocol, _protocolPathMap) {
+            if (PelicanProtocol* p = dynamic_cast<PelicanProtocol*>(protocol))
+                p->setZeroCopy(zeroCopy);
+        }
+
         // Set up listening servers.
         QList<quint16> ports = _protocolPortMap.keys();
         for (int i = 0; i < ports.size(); ++i) {
             boost::shared_ptr<PelicanPortServer> server(
                     new PelicanPortServer(_protocolPortMap[ports[i]], &dataManager) );
             server->setVerbosity(_verboseLevel);
+            server->setKeepAlive(keepAlive);
+            if (keepAlive)
+                server->setWorkerThreads(threads);
             servers.append(server);
             if ( !server->listen(QHostAddress::Any, ports[i]) )
                 throw QString("Cannot run PelicanServer on port %1").arg(ports[i]);
             verbose( QString("PelicanServer: listening on port %1").arg(ports[i]), 1 );
         }
+        QList<QString> paths = _protocolPathMap.keys();
+        for (int i = 0; i < paths.size(); ++i) {
+            boost::shared_ptr<PelicanPortServer> server(
+                    new PelicanPortServer(_protocolPathMap[paths[i]], &dataManager) );
+            server->setVerbosity(_verboseLevel);
+            server->setKeepAlive(true);
+            server->setWorkerThreads(threads);
+            servers.append(server);
+            if ( !server->listenLocal(paths[i]) )
+                throw QString("Cannot run PelicanServer on socket %1").arg(paths[i]);
+            verbose( QString("PelicanServer: listening on socket %1").arg(paths[i]), 1 );
+        }
+
+        // Serve the metrics over HTTP, if asked to.
+        boost::shared_ptr<MetricsServer> metricsServer;
+        quint16 metricsPort = serverConfig.getOption("metrics", "port", "0").toUShort();
+        if (metricsPort > 0) {
+            QHostAddress host(serverConfig.getOption("metrics", "host",
+                    "127.0.0.1"));
+            metricsServer.reset(new MetricsServer(&dataManager));
+            if ( !metricsServer->listen(host, metricsPort) )
+                throw QString("Cannot serve metrics on port %1").arg(metricsPort);
+            verbose( QString("PelicanServer: metrics on port %1").arg(metricsPort), 1 );
+        }
 
         // Set ready flag.
         _mutex.lock();
@@ -133,6 +215,11 @@ void PelicanServer::run()
 
         // Enter the server's event loop.
         exec();
+
+        // Stop the port servers (and their sessions) before the data manager
+        // goes out of scope.
+        servers.clear();
+        metricsServer.reset();
     }
     catch( QString& e ) {
         std::cerr << "PelicanServer caught an error: " << e.toStdString() << std::endl;
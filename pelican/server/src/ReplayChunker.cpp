@@ -0,0 +1,120 @@
+#include "pelican/server/ReplayChunker.h"
+#include "pelican/server/StreamRecorder.h"
+#include "pelican/server/StreamRecording.h"
+#include "pelican/utility/ConfigNode.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QSet>
+#include <cstring>
+#include <time.h>
+
+namespace pelican {
+
+
+/**
+ * @details Constructs a ReplayChunker object.
+ */
+ReplayChunker::ReplayChunker(const ConfigNode& config)
+    : AbstractChunker(config), _recording(0), _replayed(0), _dropped(0)
+{
+    _fileName = config.getAttribute("file");
+    if( _fileName == "" )
+        throw( QString("ReplayChunker: no \"file\" attribute specified" ));
+    QString speed = config.getAttribute("speed");
+    bool ok = true;
+    _speed = speed.isEmpty() ? 1.0 : speed.toDouble(&ok);
+    if( ! ok || _speed < 0 )
+        throw( QString("ReplayChunker: invalid speed \"%1\"").arg(speed) );
+    QString loops = config.getAttribute("loops");
+    _loops = loops.isEmpty() ? 1 : loops.toInt();
+}
+
+/**
+ * @details Destroys the ReplayChunker object.
+ */
+ReplayChunker::~ReplayChunker()
+{
+    delete _recording;
+}
+
+/**
+ * @details
+ * Opens the recording. The device returned is the recording file, which
+ * has data available, so that next() is called (once) when the chunker
+ * starts.
+ */
+QIODevice* ReplayChunker::newDevice()
+{
+    delete _recording;
+    _recording = 0;
+    _recording = new StreamRecording(_fileName);
+    QFile* device = new QFile(_fileName);
+    if( ! device->open(QIODevice::ReadOnly) ) {
+        delete device;
+        throw(QString("ReplayChunker: unable to open file:%1").arg(_fileName));
+    }
+    return device;
+}
+
+/**
+ * @details
+ * Replays the recording, returning when it has been played the configured
+ * number of times or the chunker is stopped.
+ */
+void ReplayChunker::next(QIODevice*)
+{
+    if( ! _recording || _recording->count() == 0 ) return;
+
+    QSet<QString> streams = QSet<QString>::fromList(chunkTypes());
+    qint64 first = _recording->time(0);
+    // Space the loops as if the chunk after the last was the first.
+    int count = _recording->count();
+    qint64 length = _recording->time(count - 1) - first;
+    if( count > 1 ) length += length / (count - 1);
+    qint64 start = StreamRecorder::now();
+
+    for( int loop = 0; (_loops <= 0 || loop < _loops) && isActive(); ++loop ) {
+        for( int i = 0; i < _recording->count() && isActive(); ++i ) {
+            StreamRecording::Record r = _recording->record(i);
+            if( ! streams.contains(r.stream) ) continue;
+
+            if( _speed > 0 ) {
+                // Each loop starts where the last one ended.
+                double offset = (double)(r.time - first) + (double)loop * length;
+                if( ! _waitUntil(start + (qint64)(offset / _speed)) ) return;
+            }
+
+            WritableData writableData = getDataStorage( r.size, r.stream );
+            if( writableData.isValid() ) {
+                memcpy( writableData.ptr(), r.data, r.size );
+                ++_replayed;
+            }
+            else {
+                ++_dropped;
+            }
+        }
+    }
+}
+
+/**
+ * @details
+ * Sleeps until the given wall clock time, waking at least every 100 ms to
+ * check that the chunker is still active.
+ */
+bool ReplayChunker::_waitUntil(qint64 time) const
+{
+    while( isActive() ) {
+        qint64 remaining = time - StreamRecorder::now();
+        if( remaining <= 0 ) return true;
+        if( remaining > 100000000LL ) remaining = 100000000LL;
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)remaining;
+        nanosleep(&ts, 0);
+    }
+    return false;
+}
+
+PELICAN_DECLARE(AbstractChunker, ReplayChunker)
+
+} // namespace pelican
@@ -3,6 +3,7 @@
 #include "pelican/server/LockedData.h"
 #include "pelican/server/WritableData.h"
 #include "pelican/server/LockableServiceData.h"
+#include "pelican/comms/MetricsResponse.h"
 
 #include <QtCore/QDebug>
 #include <QtCore/QMutexLocker>
@@ -17,11 +18,13 @@ namespace pelican {
  * @param type         A string containing the type of data held in the buffer.
  * @param max          The maximum size of the buffer in bytes.
  * @param maxChunkSize The maximum chunk size in bytes.
+ * @param memory       How the memory is allocated (pages, locking and
+ *                     NUMA node).
  * @param parent       (Optional.) Pointer to the object's parent.
  */
 ServiceDataBuffer::ServiceDataBuffer(const QString& type, const size_t max,
-        const size_t maxChunkSize, QObject* parent)
-: AbstractDataBuffer(type, parent)
+        const size_t maxChunkSize, const BufferMemory& memory, QObject* parent)
+: AbstractDataBuffer(type, parent), _memory(memory)
 {
     _max = max;
     _maxChunkSize = maxChunkSize;
@@ -41,7 +44,7 @@ ServiceDataBuffer::~ServiceDataBuffer()
 {
     delete _newData;
     foreach (LockableServiceData* data, _data) {
-        free(data->data()->data());
+        BufferMemory::release(data->data()->data());
         delete data;
     }
 }
@@ -57,6 +60,7 @@ ServiceDataBuffer::~ServiceDataBuffer()
 void ServiceDataBuffer::getData(LockedData& lockedData, const QString& version)
 {
     QMutexLocker lock(&_mutex);
+    _served(_data.value(version));
     lockedData.setData(_data.value(version));
 }
 
@@ -70,6 +74,7 @@ void ServiceDataBuffer::getData(LockedData& lockedData, const QString& version)
 void ServiceDataBuffer::getCurrent(LockedData& lockedData)
 {
     QMutexLocker lock(&_mutex);
+    _served(_data.value(_current));
     lockedData.setData(_data.value(_current));
 }
 
@@ -104,7 +109,7 @@ WritableData ServiceDataBuffer::getWritable(size_t size)
         // Create a new data object if we have enough space.
         if (size <= _space && size <= _maxChunkSize)
         {
-            void* memory = calloc(size, sizeof(char)); // Released in destructor.
+            void* memory = _memory.allocate(size); // Released in destructor.
             if (memory)
             {
                 _space -= size;
@@ -193,7 +198,39 @@ void ServiceDataBuffer::activateData(LockableServiceData* data)
 
         // Set the current pointer to this one.
         _current = id;
+        _chunksWritten.add();
+        _bytesWritten.add(data->size());
     }
 }
 
+/**
+ * @details
+ * Counts the data (if not 0) as served.
+ */
+void ServiceDataBuffer::_served(LockableServiceData* data)
+{
+    if (data) {
+        _chunksServed.add();
+        _bytesServed.add(data->size());
+    }
+}
+
+/**
+ * @details
+ * Adds the number of versions and bytes written and served to the map,
+ * labelled with the service data name.
+ */
+void ServiceDataBuffer::metrics(QMap<QString, double>& values) const
+{
+    const QString label("service");
+    values.insert(MetricsResponse::name("pelican_service_chunks_written_total",
+            label, _type), _chunksWritten.value());
+    values.insert(MetricsResponse::name("pelican_service_bytes_written_total",
+            label, _type), _bytesWritten.value());
+    values.insert(MetricsResponse::name("pelican_service_chunks_served_total",
+            label, _type), _chunksServed.value());
+    values.insert(MetricsResponse::name("pelican_service_bytes_served_total",
+            label, _type), _bytesServed.value());
+}
+
 } // namespace pelican
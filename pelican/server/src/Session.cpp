@@ -2,14 +2,25 @@
 
 #include "pelican/comms/AbstractProtocol.h"
 #include "pelican/server/DataManager.h"
+#include "pelican/server/ChunkScheduler.h"
 #include "pelican/server/LockedData.h"
 #include "pelican/server/LockableStreamData.h"
 #include "pelican/server/LockableServiceData.h"
 #include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataChunk.h"
 #include "pelican/comms/DataSupportResponse.h"
 #include "pelican/comms/ServerRequest.h"
 #include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/comms/ConsumerRequest.h"
 #include "pelican/comms/ServiceDataRequest.h"
+#include "pelican/comms/MetricsResponse.h"
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/utility/LatencyMonitor.h"
+#include "pelican/utility/ThreadPlacement.h"
 
 #include <QtNetwork/QTcpSocket>
 #include <QtNetwork/QHostAddress>
@@ -35,7 +46,8 @@ namespace pelican {
  */
 Session::Session(int socketDescriptor, AbstractProtocol* proto,
         DataManager* data, QObject* parent)
-: QThread(parent), _dataManager(data), _verboseLevel(0)
+: QThread(parent), _dataManager(data), _verboseLevel(0), _keepAlive(false),
+  _stopping(false), _credits(0), _scheduler(0), _schedulerHandle(0)
 {
     _protocol = proto;
     _socketDescriptor = socketDescriptor;
@@ -44,7 +56,10 @@ Session::Session(int socketDescriptor, AbstractProtocol* proto,
 
 Session::~Session()
 {
+    _stopping = true;
     wait();
+    if (_scheduler)
+        _scheduler->remove(_schedulerHandle);
 }
 
 void Session::setVerbosity(int level)
@@ -62,21 +77,71 @@ void Session::verbose( const QString& msg, int verboseLevel )
 
 /**
  * @details
+ * Sets the client information string used to prefix verbose messages.
+ */
+void Session::setClientInfo(const QString& info)
+{
+    _clientName = info;
+    _clientInfo = "Session: " + info.toStdString() + ": ";
+}
+
+/**
+ * @details
+ * Handles a single request and closes the connection or, in keep-alive
+ * mode, handles requests until the client closes the connection.
+ *
+ * A connection that subscribes to stream data, or names a broadcast
+ * consumer, is always kept alive. While
+ * the client has credits the session pushes data as it is activated,
+ * checking for incoming requests (e.g. more credits) between chunks.
  */
 void Session::run()
 {
+    ThreadPlacement::place("Session");
     QTcpSocket socket;
     if (!socket.setSocketDescriptor(_socketDescriptor)) {
         emit error(socket.error());
         return;
     }
-    _clientInfo = "Session: " + socket.peerAddress().toString().toStdString() + ": ";
+    setClientInfo(socket.peerAddress().toString());
+
+    if (!_keepAlive) {
+        boost::shared_ptr<ServerRequest> req = _protocol->request(socket);
+        processRequest(*req, socket);
+        if (_subscription || !_held.isEmpty() || !_consumer.isEmpty())
+            _keepAlive = true;
+    }
+    if (!_keepAlive) {
+        socket.disconnectFromHost();
+        if (socket.state() != QAbstractSocket::UnconnectedState)
+            socket.waitForDisconnected();
+        return;
+    }
 
-    boost::shared_ptr<ServerRequest> req = _protocol->request(socket);
-    processRequest(*req, socket);
-    socket.disconnectFromHost();
-    if (socket.state() != QAbstractSocket::UnconnectedState)
-        socket.waitForDisconnected();
+    while (!_stopping && socket.state() == QAbstractSocket::ConnectedState) {
+        int wait = maxWaitInterval;
+        if (credits() > 0) {
+            // Take the key before looking, so that data activated
+            // while we look is not missed.
+            EventCount::Key key = _dataManager->prepareStreamDataWait();
+            if (pushStreamData(socket)) {
+                _dataManager->cancelStreamDataWait();
+                while (socket.bytesToWrite() > 0 && socket.waitForBytesWritten(-1)) {}
+            }
+            else {
+                _dataManager->waitForStreamData(key, maxWaitInterval);
+            }
+            wait = 0;
+        }
+        // Wait for the next request (waitForReadyRead() returns false
+        // straight away if the client has gone).
+        if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(wait))
+            continue;
+        boost::shared_ptr<ServerRequest> req = _protocol->request(socket);
+        processRequest(*req, socket);
+        while (socket.bytesToWrite() > 0 && socket.waitForBytesWritten(-1)) {}
+    }
+    verbose("connection closed");
 }
 
 
@@ -84,10 +149,14 @@ void Session::run()
  * @details
  * Processes a general ServerRequest, calling the appropriate working and then
  * passes this on to the protocol to be returned to the client.
+ *
+ * The time taken (including any wait for stream data) is reported to the
+ * data manager for the server metrics.
  */
 void Session::processRequest(const ServerRequest& req, QIODevice& out,
         const unsigned timeout)
 {
+    quint64 start = AtomicCounter::now();
     try {
         switch(req.type())
         {
@@ -107,21 +176,57 @@ void Session::processRequest(const ServerRequest& req, QIODevice& out,
             }
             case ServerRequest::StreamData:
             {
+                _completed();
                 QList<LockedData> dataList = processStreamDataRequest(static_cast<const StreamDataRequest&>(req), timeout);
-                if (dataList.size() > 0) {
-                    AbstractProtocol::StreamData_t data;
-                    for (int i=0; i < dataList.size(); ++i) {
-                        LockableStreamData* lockedData =
-                                static_cast<LockableStreamData*>(dataList[i].object());
-                        data.append(static_cast<StreamData*>(lockedData->streamData()));
-                    }
-                    _protocol->send(out, data);
+                _sendStreamData(dataList, out);
+                break;
+            }
 
-                    // Mark as data as being served so it can be de-activated.
-                    foreach (LockedData d, dataList) {
-                        static_cast<LockableStreamData*>(d.object())->served() = true;
-                    }
-                }
+            case ServerRequest::StreamSubscription:
+            {
+                const StreamSubscriptionRequest& sub =
+                        static_cast<const StreamSubscriptionRequest&>(req);
+                if (sub.isEmpty())
+                    throw QString("Session: Stream subscription is empty");
+                _subscription.reset(new StreamSubscriptionRequest(sub));
+                _credits = sub.credits();
+                _completed();
+                _serviceVersionsSent.clear();
+                verbose(QString("subscribed with %1 credits").arg(_credits));
+                break;
+            }
+
+            case ServerRequest::Credit:
+            {
+                if (!_subscription)
+                    throw QString("Session: Credit sent without a subscription");
+                quint32 credits = static_cast<const CreditRequest&>(req).credits();
+                _credits += credits;
+                _completed(credits);
+                break;
+            }
+
+            case ServerRequest::Release:
+            {
+                quint32 count = static_cast<const ReleaseRequest&>(req).count();
+                for (quint32 i = 0; i < count && !_held.isEmpty(); ++i)
+                    _held.removeFirst();
+                break;
+            }
+
+            case ServerRequest::Consumer:
+            {
+                _consumer = static_cast<const ConsumerRequest&>(req).name();
+                verbose("consumer \"" + _consumer + "\"");
+                break;
+            }
+
+            case ServerRequest::ProtocolVersion:
+            {
+                quint16 version =
+                        static_cast<const ProtocolVersionRequest&>(req).version();
+                verbose(QString("protocol version %1 requested").arg(version));
+                _protocol->sendVersion(out, version);
                 break;
             }
 
@@ -142,6 +247,13 @@ void Session::processRequest(const ServerRequest& req, QIODevice& out,
                 }
                 break;
             }
+
+            case ServerRequest::Metrics:
+            {
+                _protocol->send(out, MetricsResponse(_dataManager->metrics()));
+                break;
+            }
+
             default:
                 verbose("protocol error: " + req.message());
                 _protocol->sendError(out, req.message());
@@ -152,6 +264,160 @@ void Session::processRequest(const ServerRequest& req, QIODevice& out,
         verbose("caught error: " + e );
         _protocol->sendError(out, e);
     }
+    _dataManager->requestCompleted(req.type(), AtomicCounter::now() - start);
+}
+
+
+/**
+ * @details
+ * Processes a ServerRequest only if it can be done without blocking, i.e.
+ * returns false without sending anything if it is a StreamData request that
+ * can not be satisfied yet.
+ */
+bool Session::tryProcessRequest(const ServerRequest& req, QIODevice& out)
+{
+    if (req.type() != ServerRequest::StreamData) {
+        processRequest(req, out);
+        return true;
+    }
+
+    quint64 start = AtomicCounter::now();
+    try {
+        const StreamDataRequest& streamReq =
+                static_cast<const StreamDataRequest&>(req);
+        _completed();
+        QList<LockedData> dataList = _streamDataAvailable(streamReq);
+        if (dataList.isEmpty() && !streamReq.isEmpty())
+            return false;
+        _sendStreamData(dataList, out);
+    }
+    catch (const QString& e)
+    {
+        verbose("caught error: " + e );
+        _protocol->sendError(out, e);
+    }
+    _dataManager->requestCompleted(req.type(), AtomicCounter::now() - start);
+    return true;
+}
+
+
+/**
+ * @details
+ * Sends the next stream data matching the connection's subscription if it
+ * is available and the client has credit for it, preceded by any of its
+ * associated service data that has not already been sent on this
+ * connection (or has changed version since).
+ *
+ * Returns false if nothing was sent. If the data can not be sent the
+ * error is reported to the client and the subscription is cancelled.
+ */
+bool Session::pushStreamData(QIODevice& out)
+{
+    if (credits() == 0)
+        return false;
+
+    try {
+        QList<LockedData> dataList = _streamDataAvailable(*_subscription);
+        if (dataList.isEmpty())
+            return false;
+
+        AbstractProtocol::ServiceData_t service;
+        foreach (const LockedData& d, dataList) {
+            LockableStreamData* stream =
+                    static_cast<LockableStreamData*>(d.object());
+            foreach (const LockedData& a, stream->associateData()) {
+                DataChunk* chunk =
+                        static_cast<LockableServiceData*>(a.object())->data().get();
+                if (_serviceVersionsSent.value(chunk->name()) != chunk->id()) {
+                    _serviceVersionsSent.insert(chunk->name(), chunk->id());
+                    service.append(chunk);
+                }
+            }
+        }
+        if (service.size() > 0)
+            _protocol->send(out, service);
+        _sendStreamData(dataList, out);
+        --_credits;
+    }
+    catch (const QString& e)
+    {
+        verbose("caught error: " + e );
+        _protocol->sendError(out, e);
+        _subscription.reset();
+        _cancelWait();
+    }
+    return true;
+}
+
+
+/**
+ * @details
+ * Sends the stream data and marks it as served, recording the latency of
+ * the serve stage. Data sent by reference is held until the client
+ * releases it.
+ */
+void Session::_sendStreamData(const QList<LockedData>& dataList, QIODevice& out)
+{
+    if (dataList.size() > 0) {
+        AbstractProtocol::StreamData_t data;
+        for (int i=0; i < dataList.size(); ++i) {
+            LockableStreamData* lockedData =
+                    static_cast<LockableStreamData*>(dataList[i].object());
+            data.append(static_cast<StreamData*>(lockedData->streamData()));
+        }
+        quint64 served = LatencyTrace::now();
+        _protocol->send(out, data);
+        foreach (const StreamData* sd, data) {
+            const LatencyTrace& trace = sd->latencyTrace();
+            if (trace.isValid() && served >= trace.time(LatencyTrace::Ingest))
+                LatencyMonitor::instance()->record(trace.stream(),
+                        LatencyTrace::Serve,
+                        served - trace.time(LatencyTrace::Ingest));
+        }
+
+        // Mark as data as being served so it can be de-activated.
+        quint64 bytes = 0;
+        foreach (LockedData d, dataList) {
+            LockableStreamData* stream = static_cast<LockableStreamData*>(d.object());
+            stream->served() = true;
+            bytes += stream->streamData()->size();
+        }
+        if (_scheduler)
+            _scheduler->served(_schedulerHandle, bytes);
+        if (_protocol->sendsReferences())
+            _held.append(dataList);
+    }
+}
+
+
+/**
+ * @details
+ * Returns the data for the first of the request's data options that can be
+ * satisfied now, or an empty list. With a scheduler, the list is also empty
+ * unless the scheduler chooses this session to take the next chunk.
+ */
+QList<LockedData> Session::_streamDataAvailable(const StreamDataRequest& req)
+{
+    QList<LockedData> dataList;
+    ChunkScheduler* scheduler = _dataManager->scheduler();
+    if (scheduler) {
+        if (!_scheduler) {
+            _scheduler = scheduler;
+            _schedulerHandle = scheduler->add(
+                    _consumer.isEmpty() ? _clientName : _consumer);
+        }
+        QSet<QString> streams;
+        for (DataSpecIterator it = req.begin(); it != req.end(); ++it)
+            streams.unite(it->streamData());
+        if (!scheduler->mayTake(_schedulerHandle, streams))
+            return dataList;
+    }
+    DataSpecIterator it = req.begin();
+    while(it != req.end() && dataList.size() == 0) {
+        dataList = _dataManager->getDataRequirements(*it, _consumer);
+        ++it;
+    }
+    return dataList;
 }
 
 
@@ -168,6 +434,11 @@ void Session::processRequest(const ServerRequest& req, QIODevice& out,
  * WARNING: This function will block until valid data matching the request can
  * made.
  *
+ * While no request can be satisfied the session thread sleeps on the data
+ * manager until a stream chunk is activated. Chunks returned unserved by
+ * other sessions do not wake it, so each wait is also limited to
+ * maxWaitInterval ms.
+ *
  * The data will be returned as a locked container to ensure access by other
  * threads will be blocked. This is achieved by a signal emitted when the
  * LockedData object goes out of scope.
@@ -195,26 +466,68 @@ QList<LockedData> Session::processStreamDataRequest(const StreamDataRequest& req
     time.start();
 
     verbose("processing StreamData request");
-    // Iterate until the data requirements can be satisfied.
-    // keep spinning until we either get data or time out.
-    while (dataList.size() == 0)
+    // Iterate until the data requirements can be satisfied,
+    // sleeping until new data arrives or we time out.
+    forever
     {
-        if ((unsigned int)time.elapsed() > timeout && timeout > 0) {
-            throw QString("Session::processStreamDataRequest():"
-            " Request timed out after %1 ms.").arg(time.elapsed());
+        // Take the key before looking, so that data activated
+        // while we look is not missed.
+        EventCount::Key key = _dataManager->prepareStreamDataWait();
+        try {
+            dataList = _streamDataAvailable(req);
         }
-        DataSpecIterator it = req.begin();
-        while(it != req.end() && dataList.size() == 0) {
-            dataList = _dataManager->getDataRequirements(*it);
-            ++it;
+        catch (...) {
+            _dataManager->cancelStreamDataWait();
+            _cancelWait();
+            throw;
+        }
+        if (dataList.size() > 0) {
+            _dataManager->cancelStreamDataWait();
+            break;
+        }
+
+        int wait = maxWaitInterval;
+        if (timeout > 0) {
+            int remaining = (int)timeout - time.elapsed();
+            if (remaining <= 0) {
+                _dataManager->cancelStreamDataWait();
+                _cancelWait();
+                throw QString("Session::processStreamDataRequest():"
+                " Request timed out after %1 ms.").arg(time.elapsed());
+            }
+            if (remaining < wait) wait = remaining;
         }
-        usleep(1);
+        _dataManager->waitForStreamData(key, wait);
     }
     verbose("finished processing StreamData request");
     return dataList;
 }
 
 
+/**
+ * @details
+ * Tells the scheduler, if the session is registered with one, that the
+ * session is no longer waiting for stream data.
+ */
+void Session::_cancelWait()
+{
+    if (_scheduler)
+        _scheduler->cancel(_schedulerHandle);
+}
+
+
+/**
+ * @details
+ * Tells the scheduler, if the session is registered with one, that the
+ * client has finished with the given number of chunks (all if < 0).
+ */
+void Session::_completed(int chunks)
+{
+    if (_scheduler)
+        _scheduler->completed(_schedulerHandle, chunks);
+}
+
+
 /**
  * @details
  * Returns all the data sets mentioned in the list (or throws if any one is missing).
@@ -0,0 +1,306 @@
+#include "pelican/server/SessionWorker.h"
+
+#include "pelican/server/Session.h"
+#include "pelican/server/DataManager.h"
+#include "pelican/comms/AbstractProtocol.h"
+#include "pelican/comms/ServerRequest.h"
+#include "pelican/utility/ThreadPlacement.h"
+
+#include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QHostAddress>
+#include <QtCore/QMutexLocker>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <iostream>
+
+namespace pelican {
+
+/**
+ * @details
+ * Constructs the session worker. The worker's eventfd is used both to hand
+ * it new connections and to wake it on stream data activation.
+ */
+SessionWorker::SessionWorker(AbstractProtocol* proto, DataManager* data,
+        QObject* parent)
+    : QThread(parent), _protocol(proto), _dataManager(data), _epollFd(-1),
+      _wakeupHandle(-1), _pendingCount(0), _subscribedCount(0), _stopping(false), _verboseLevel(0)
+{
+    _eventFd = eventfd(0, EFD_NONBLOCK);
+    if (_eventFd < 0)
+        throw QString("SessionWorker: Unable to create eventfd.");
+}
+
+
+/**
+ * @details
+ * Stops the worker thread. Connections still open are closed.
+ */
+SessionWorker::~SessionWorker()
+{
+    _stopping = true;
+    _wake();
+    wait();
+    ::close(_eventFd);
+    foreach (int fd, _incoming) ::close(fd);
+}
+
+
+/**
+ * @details
+ * Queues the socket descriptor to be adopted by the worker thread (the
+ * QTcpSocket must be created in the thread that uses it).
+ */
+void SessionWorker::addConnection(int socketDescriptor)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _incoming.append(socketDescriptor);
+    }
+    _wake();
+}
+
+
+void SessionWorker::_wake()
+{
+    quint64 one = 1;
+    if (::write(_eventFd, &one, sizeof(one)) < 0) {
+        // Counter saturated: the worker is already due to wake up.
+    }
+}
+
+
+/**
+ * @details
+ * The epoll loop. Parked stream data requests are retried (and data pushed
+ * to subscribers) after arming the DataManager wakeup, so that data
+ * activated (or handed back unserved) after the retry still wakes the loop.
+ * As chunks held for ordering are only released by consumers asking for
+ * data, the wait is limited to 100 ms while any connection is waiting.
+ */
+void SessionWorker::run()
+{
+    ThreadPlacement::place("Session");
+    _epollFd = epoll_create(64);
+    if (_epollFd < 0) {
+        std::cerr << "SessionWorker: Unable to create epoll descriptor."
+                  << std::endl;
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = _eventFd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, _eventFd, &ev);
+    _wakeupHandle = _dataManager->addWakeupDescriptor(_eventFd);
+
+    const int maxEvents = 64;
+    struct epoll_event events[maxEvents];
+    while (!_stopping) {
+        bool waiting = false;
+        if (_pendingCount > 0 || _subscribedCount > 0) {
+            _dataManager->armWakeupDescriptor(_wakeupHandle);
+            waiting = _retryPending();
+        }
+        int n = epoll_wait(_epollFd, events, maxEvents, waiting ? 100 : -1);
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == _eventFd) {
+                quint64 count;
+                if (::read(_eventFd, &count, sizeof(count)) < 0) {
+                    // Nothing to read: spurious wake up.
+                }
+                _adoptConnections();
+                continue;
+            }
+            Connection* c = _connections.value(fd, 0);
+            if (!c) continue;
+            quint32 happened = events[i].events;
+            if ((c->pending && (happened & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+                    || (c->socket->bytesToWrite() > 0
+                        && (happened & (EPOLLHUP | EPOLLERR)))) {
+                _close(c);
+                continue;
+            }
+            // Send what the socket could not take before.
+            if (happened & EPOLLOUT)
+                _flush(c);
+            // Pull the data into the socket's buffer and handle it.
+            if (happened & EPOLLIN)
+                c->socket->waitForReadyRead(0);
+            _process(c);
+        }
+    }
+
+    _dataManager->removeWakeupDescriptor(_wakeupHandle);
+    foreach (Connection* c, _connections) _close(c);
+    ::close(_epollFd);
+}
+
+
+/**
+ * @details
+ * Creates sockets and sessions for the queued descriptors.
+ */
+void SessionWorker::_adoptConnections()
+{
+    QList<int> incoming;
+    {
+        QMutexLocker locker(&_mutex);
+        incoming.swap(_incoming);
+    }
+    foreach (int fd, incoming) {
+        Connection* c = new Connection;
+        c->fd = fd;
+        c->socket = new QTcpSocket;
+        c->subscribed = false;
+        c->events = EPOLLIN | EPOLLRDHUP;
+        if (!c->socket->setSocketDescriptor(fd)) {
+            ::close(fd);
+            delete c->socket;
+            delete c;
+            continue;
+        }
+        c->session = new Session(fd, _protocol, _dataManager);
+        c->session->setVerbosity(_verboseLevel);
+        c->session->setClientInfo(c->socket->peerAddress().toString());
+        // Replies are queued on the socket and flushed as it drains.
+        c->socket->setProperty(AbstractProtocol::deferredWritesProperty(), true);
+        _connections.insert(fd, c);
+
+        struct epoll_event ev;
+        ev.events = c->events;
+        ev.data.fd = fd;
+        epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+        // Data may already have arrived with the connection.
+        _process(c);
+    }
+}
+
+
+/**
+ * @details
+ * Handles the requests buffered on the connection until one has to wait
+ * for stream data, the reply to one can not be sent straight away, or no
+ * whole request is left in the buffer (the rest of a request is waited for
+ * by epoll, not by the protocol). Closes the connection if the client has
+ * gone.
+ */
+void SessionWorker::_process(Connection* c)
+{
+    QTcpSocket* socket = c->socket;
+    while (!c->pending && socket->bytesToWrite() == 0
+            && socket->bytesAvailable() > 0
+            && _protocol->requestComplete(*socket)) {
+        boost::shared_ptr<ServerRequest> req = _protocol->request(*socket);
+        if (!c->session->tryProcessRequest(*req, *socket)) {
+            c->pending = req;
+            ++_pendingCount;
+        }
+        _flush(c);
+    }
+    _updateSubscription(c);
+    if (socket->state() != QAbstractSocket::ConnectedState)
+        _close(c);
+    else
+        _watch(c);
+}
+
+
+/**
+ * @details
+ * Keeps count of the connections with a stream subscription.
+ */
+void SessionWorker::_updateSubscription(Connection* c)
+{
+    bool subscribed = c->session->hasSubscription();
+    if (subscribed != c->subscribed) {
+        c->subscribed = subscribed;
+        _subscribedCount += subscribed ? 1 : -1;
+    }
+}
+
+
+/**
+ * @details
+ * Pushes data to the subscribed connections and retries the parked stream
+ * data requests. Returns true if any connection is still waiting for data.
+ */
+bool SessionWorker::_retryPending()
+{
+    bool waiting = false;
+    foreach (Connection* c, _connections) {
+        if (c->subscribed) {
+            // Push no more than the socket can take without waiting.
+            while (c->socket->bytesToWrite() == 0
+                    && c->session->pushStreamData(*c->socket))
+                _flush(c);
+            _updateSubscription(c);
+            _watch(c);
+            if (c->session->credits() > 0) waiting = true;
+        }
+        if (!c->pending) continue;
+        if (c->session->tryProcessRequest(*c->pending, *c->socket)) {
+            c->pending.reset();
+            --_pendingCount;
+            _flush(c);
+            _process(c);
+        }
+        else {
+            waiting = true;
+        }
+    }
+    return waiting;
+}
+
+
+/**
+ * @details
+ * Writes as much of the data queued on the connection's socket as the
+ * kernel will take without blocking.
+ */
+void SessionWorker::_flush(Connection* c)
+{
+    while (c->socket->bytesToWrite() > 0 && c->socket->flush()) {}
+}
+
+
+/**
+ * @details
+ * Watches the connection for the socket draining while it has unsent
+ * data, and otherwise for incoming requests unless one is parked. The
+ * client hanging up is always watched for.
+ */
+void SessionWorker::_watch(Connection* c)
+{
+    bool writing = c->socket->bytesToWrite() > 0;
+    quint32 events = EPOLLRDHUP;
+    if (writing)
+        events |= EPOLLOUT;
+    else if (!c->pending)
+        events |= EPOLLIN;
+    if (events == c->events)
+        return;
+    c->events = events;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = c->fd;
+    epoll_ctl(_epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+
+void SessionWorker::_close(Connection* c)
+{
+    struct epoll_event ev; // Ignored, but must not be null on old kernels.
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, c->fd, &ev);
+    _connections.remove(c->fd);
+    if (c->pending) --_pendingCount;
+    if (c->subscribed) --_subscribedCount;
+    c->socket->abort();
+    delete c->socket;
+    delete c->session;
+    delete c;
+}
+
+} // namespace pelican
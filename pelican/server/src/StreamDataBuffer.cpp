@@ -4,9 +4,16 @@
 #include "pelican/server/LockedData.h"
 #include "pelican/server/WritableData.h"
 #include "pelican/comms/StreamData.h"
+#include "pelican/comms/MetricsResponse.h"
+#include "pelican/server/StreamSpillFile.h"
+#include "pelican/server/StreamRecorder.h"
+#include "pelican/utility/SharedMemorySegment.h"
 
 #include <QtCore/QMutexLocker>
+#include <QtCore/QTime>
+#include <cstring>
 #include <stdlib.h>
+#include <unistd.h>
 
 namespace pelican {
 
@@ -22,6 +29,72 @@ namespace pelican {
 StreamDataBuffer::StreamDataBuffer(const QString& type,
         const size_t max, const size_t maxChunkSize, QObject* parent) :
         AbstractDataBuffer(type, parent)
+{
+    _allocation = Dynamic;
+    _init(max, maxChunkSize);
+}
+
+
+/**
+ * @details
+ * Constructs the stream data buffer with the given allocation scheme.
+ *
+ * If \p allocation is Slab (or Shared), the memory for the whole buffer is
+ * reserved and pre-faulted here, and divided into maxSize / maxChunkSize
+ * slots.
+ *
+ * @param type         A string containing the type of data held in the buffer.
+ * @param max          The maximum size of the buffer in bytes.
+ * @param maxChunkSize The maximum chunk size in bytes.
+ * @param allocation   The allocation scheme to use.
+ * @param serveQueue   The serve queue to use (LockFree requires Slab or
+ *                     Shared allocation).
+ * @param memory       How the memory is allocated (pages, locking and
+ *                     NUMA node).
+ * @param parent       (Optional.) Pointer to the object's parent.
+ */
+StreamDataBuffer::StreamDataBuffer(const QString& type,
+        const size_t max, const size_t maxChunkSize, Allocation allocation,
+        ServeQueue serveQueue, const BufferMemory& memory, QObject* parent) :
+        AbstractDataBuffer(type, parent), _memory(memory)
+{
+    _allocation = allocation;
+    _init(max, maxChunkSize);
+    _serveQueueType = serveQueue;
+    if (_serveQueueType == LockFree && _allocation == Dynamic)
+        throw QString("StreamDataBuffer: Lock-free serve queue for buffer "
+                "\"%1\" requires slab allocation.").arg(_type);
+    if (_allocation != Dynamic)
+        _allocateSlab();
+}
+
+
+/**
+ * @details
+ * Destroys the stream data buffer, freeing the memory held by it.
+ */
+StreamDataBuffer::~StreamDataBuffer()
+{
+    foreach (LockableStreamData* data, _data) {
+        void* memory = data->data()->data();
+        if (!_slab && !(_spill && _spill->slotOf(memory) >= 0))
+            BufferMemory::release(memory);
+        delete data;
+    }
+    delete _spill;
+    if (_segment) delete _segment;
+    else BufferMemory::release(_slab);
+    delete _lockFreeServeQueue;
+    delete _lockFreeSlots;
+    delete _lockFreeRetry;
+}
+
+
+/**
+ * @details
+ * Initialises the buffer members.
+ */
+void StreamDataBuffer::_init(const size_t max, const size_t maxChunkSize)
 {
     _max = max;
     _maxChunkSize = maxChunkSize;
@@ -30,19 +103,104 @@ StreamDataBuffer::StreamDataBuffer(const QString& type,
     }
     _space = _max; // Buffer initially empty so space = max size.
     _manager = 0;
+    _slab = 0;
+    _segment = 0;
+    _freeHead = 0;
+    _freeCount = 0;
+    _serveQueueType = Locking;
+    _lockFreeServeQueue = 0;
+    _lockFreeSlots = 0;
+    _lockFreeRetry = 0;
+    _broadcast = false;
+    _lagPolicy = DropOldest;
+    _maxLag = 0;
+    _logStart = 0;
+    _spill = 0;
+    _recorder = 0;
+    _orderWindow = 0;
+    _orderTimeout = 0;
+    _orderStarted = false;
+    _lastSequence = 0;
+    _nextSequence = 0;
+    _highestSequence = 0;
 }
 
 
 /**
  * @details
- * Destroys the stream data buffer, freeing the memory held by it.
+ * Returns the name of the shared memory segment holding the buffer, or an
+ * empty string if it is not in shared memory.
  */
-StreamDataBuffer::~StreamDataBuffer()
+QString StreamDataBuffer::sharedMemoryName() const
 {
-    foreach (LockableStreamData* data, _data) {
-        free(data->data()->data());
-        delete data;
+    return _segment ? _segment->name() : QString();
+}
+
+
+/**
+ * @details
+ * Reserves a single contiguous block of memory for the buffer and creates
+ * a chunk for each slot of maxChunkSize bytes. The memory is written to
+ * so that the pages are faulted in before any data arrives.
+ *
+ * For Shared allocation the block is a new shared memory segment named
+ * after the process and the data type.
+ */
+void StreamDataBuffer::_allocateSlab()
+{
+    int slots = (int)(_max / _maxChunkSize);
+    if (slots < 1)
+        throw QString("StreamDataBuffer: Slab buffer \"%1\" is smaller than "
+                "its maximum chunk size.").arg(_type);
+
+    size_t bytes = slots * _maxChunkSize;
+    if (_allocation == Shared) {
+        _segment = new SharedMemorySegment(QString("/pelican.%1.%2")
+                .arg(getpid()).arg(_type), bytes); // Released in destructor.
+        _slab = _segment->data();
+        _memory.place(_slab, bytes);
+    }
+    else {
+        _slab = (char*) _memory.allocate(bytes); // Released in destructor.
+    }
+    if (!_slab)
+        throw QString("StreamDataBuffer: Unable to allocate %1 bytes for "
+                "slab buffer \"%2\".").arg(bytes).arg(_type);
+    memset(_slab, 0, bytes); // Pre-fault the pages.
+    _space = _max - bytes;
+
+    if (_serveQueueType == LockFree) {
+        _lockFreeServeQueue = new LockFreeQueue<LockableStreamData*>(slots);
+        _lockFreeSlots = new LockFreeQueue<LockableStreamData*>(slots);
+        _lockFreeRetry = new LockFreeQueue<LockableStreamData*>(slots);
+    }
+    else {
+        _freeSlots.resize(slots);
     }
+    for (int i = 0; i < slots; ++i) {
+        _release(_newChunk(_slab + i * _maxChunkSize, _maxChunkSize));
+    }
+    _chunksInUse.set(0);
+}
+
+
+/**
+ * @details
+ * Creates a new chunk wrapping the given memory, and connects its lock
+ * signals to the buffer.
+ *
+ * With the lock-free serve queue the signals are delivered directly in
+ * the unlocking thread, rather than queued to the buffer's thread.
+ */
+LockableStreamData* StreamDataBuffer::_newChunk(void* memory, size_t size)
+{
+    LockableStreamData* lockableData = new LockableStreamData(_type, memory, size);
+    _data.append(lockableData); // Add to the list of known data.
+    Qt::ConnectionType connection = (_serveQueueType == LockFree) ?
+            Qt::DirectConnection : Qt::AutoConnection;
+    connect(lockableData, SIGNAL(unlockedWrite()), SLOT(activateData()), connection);
+    connect(lockableData, SIGNAL(unlocked()), SLOT(deactivateData()), connection);
+    return lockableData;
 }
 
 
@@ -52,16 +210,99 @@ StreamDataBuffer::~StreamDataBuffer()
  */
 void StreamDataBuffer::getNext(LockedData& lockedData)
 {
-    QMutexLocker locker(&_mutex);
+    // Returns an invalid data block if the serve queue is empty.
+    getNext(lockedData, QString(), 0);
+}
 
-    // Check if the serve queue is empty.
-    if (_serveQueue.isEmpty()) {
-        lockedData.setData(0); // Return an invalid data block.
-        return;
+
+/**
+ * @details
+ * Gets the next block of data to serve, blocking for up to \p timeout ms
+ * until one is available. The LockedData is invalid on timeout.
+ */
+void StreamDataBuffer::getNext(LockedData& lockedData, int timeout)
+{
+    getNext(lockedData, QString(), timeout);
+}
+
+
+/**
+ * @details
+ * Gets the next block of data to serve to the named consumer, blocking for
+ * up to \p timeout ms until one is available. The LockedData is invalid on
+ * timeout.
+ *
+ * The consumer is only used in broadcast mode, where a consumer that has
+ * not been seen before is registered, and is served the chunks activated
+ * from then on.
+ */
+void StreamDataBuffer::getNext(LockedData& lockedData,
+        const QString& consumer, int timeout)
+{
+    if (_orderWindow > 0)
+        _releaseExpired();
+    LockableStreamData* data = _dequeueServe(consumer);
+    if (!data && timeout != 0) {
+        QTime timer;
+        timer.start();
+        while ( !(data = _dequeueServe(consumer)) ) {
+            EventCount::Key key = _activated.prepareWait();
+            if ( (data = _dequeueServe(consumer)) ) {
+                _activated.cancelWait();
+                break;
+            }
+            int remaining = -1;
+            if (timeout >= 0) {
+                remaining = timeout - timer.elapsed();
+                if (remaining <= 0) {
+                    _activated.cancelWait();
+                    break;
+                }
+            }
+            // Wake in time to serve chunks held too long for ordering.
+            if (_orderWindow > 0 && (remaining < 0 || remaining > _orderTimeout))
+                remaining = _orderTimeout;
+            _activated.wait(key, remaining);
+            if (_orderWindow > 0)
+                _releaseExpired();
+        }
+    }
+    lockedData.setData(data);
+    if (data) {
+        _chunksServed.add();
+        _bytesServed.add(data->streamData()->size());
+    }
+    // A broadcast chunk counts this consumer as a reader until it is
+    // locked, so that it can not be recycled in the meantime.
+    if (data && _broadcast) {
+        QMutexLocker locker(&_mutex);
+        --data->readers();
     }
+}
+
 
-    // Remove the data from the serve queue.
-    lockedData.setData(_serveQueue.dequeue());
+/**
+ * @details
+ * Removes the chunk at the head of the serve queue, returning 0 if the
+ * queue is empty. In broadcast mode returns the consumer's next chunk
+ * instead, leaving it on the queue. With the lock-free queue, the chunks
+ * handed back unserved (which were activated before those on the queue)
+ * come first.
+ */
+LockableStreamData* StreamDataBuffer::_dequeueServe(const QString& consumer)
+{
+    if (_broadcast)
+        return _nextBroadcast(consumer);
+    if (_serveQueueType == LockFree) {
+        LockableStreamData* data = 0;
+        if (!_lockFreeRetry->dequeue(data))
+            _lockFreeServeQueue->dequeue(data);
+        return data;
+    }
+    QMutexLocker locker(&_mutex);
+    if (_serveQueue.isEmpty())
+        return 0;
+    return _serveQueue.dequeue();
 }
 
 
@@ -73,8 +314,11 @@ void StreamDataBuffer::getNext(LockedData& lockedData)
  */
 WritableData StreamDataBuffer::getWritable(size_t size)
 {
+    quint64 start = AtomicCounter::now();
     QMutexLocker locker(&_writeMutex);
     LockableStreamData* lockableStreamData = _getWritable(size);
+    if (!lockableStreamData)
+        _chunksRejected.add();
 
     // Prepare the object for use by adding Service Data info.
     if (lockableStreamData) {
@@ -84,6 +328,10 @@ WritableData StreamDataBuffer::getWritable(size_t size)
         _manager->associateServiceData(lockableStreamData);
     }
 
+    quint64 elapsed = AtomicCounter::now() - start;
+    _writableCalls.add();
+    _writableTime.add(elapsed);
+    _writableMaxTime.max(elapsed);
     return WritableData(lockableStreamData);
 }
 
@@ -98,6 +346,22 @@ WritableData StreamDataBuffer::getWritable(size_t size)
  */
 LockableStreamData* StreamDataBuffer::_getWritable(size_t size)
 {
+    if (_allocation != Dynamic) {
+        // Every slot has the same size, so the next free slot (or failing
+        // that, the oldest waiting chunk) will do.
+        if (size > _maxChunkSize)
+            return 0;
+        LockableStreamData* data = _popFreeSlot();
+        if (!data)
+            data = _spillChunk(size);
+        if (data)
+            return _taken(data);
+        data = _broadcast ? _dropOldest(size) : _dequeueServe();
+        if (data)
+            _chunksDropped.add();
+        return data;
+    }
+
     // Return a pre-allocated block from the empty queue, if one exists.
     for (int i = 0; i < _emptyQueue.size(); ++i) {
         LockableStreamData* lockableData = _emptyQueue[i];
@@ -105,7 +369,7 @@ LockableStreamData* StreamDataBuffer::_getWritable(size_t size)
         if( lockableData->maxSize() >= size ) {
             // We found one, so our work is done.
             _emptyQueue.removeAt(i);
-            return lockableData;
+            return _taken(lockableData);
         }
     }
 
@@ -113,17 +377,25 @@ LockableStreamData* StreamDataBuffer::_getWritable(size_t size)
     // create a new data object if we have enough space.
     if (size <= _space && size <= _maxChunkSize)
     {
-        void* memory = calloc(size, sizeof(char)); // Released in destructor.
+        void* memory = _memory.allocate(size); // Released in destructor.
         if (memory) {
             _space -= size;
-            LockableStreamData* lockableData = new LockableStreamData(_type, memory, size);
-            _data.append(lockableData); // Add to the list of known data.
-            connect(lockableData, SIGNAL(unlockedWrite()), SLOT(activateData()));
-            connect(lockableData, SIGNAL(unlocked()), SLOT(deactivateData()));
-            return lockableData;
+            return _taken(_newChunk(memory, size));
         }
     }
 
+    // Write to the spill file rather than lose waiting data.
+    if (LockableStreamData* spilled = _spillChunk(size))
+        return _taken(spilled);
+
+    // Broadcast chunks can only be taken from the head of the queue.
+    if (_broadcast) {
+        LockableStreamData* data = _dropOldest(size);
+        if (data)
+            _chunksDropped.add();
+        return data;
+    }
+
     // No free containers and no space left, so remove the oldest waiting data
     // that fits the size requirements
     {
@@ -133,6 +405,7 @@ LockableStreamData* StreamDataBuffer::_getWritable(size_t size)
             LockableStreamData* d = _serveQueue[i];
             if( d->maxSize() >= size ) {
                 _serveQueue.removeAt(i);
+                _chunksDropped.add();
                 return d;
             }
         }
@@ -143,6 +416,95 @@ LockableStreamData* StreamDataBuffer::_getWritable(size_t size)
 }
 
 
+/**
+ * @details
+ * Counts the chunk (if not 0) as taken from the free pool, updating the
+ * high-water mark, and returns it.
+ */
+LockableStreamData* StreamDataBuffer::_taken(LockableStreamData* data)
+{
+    if (data) {
+        _chunksInUse.add();
+        _highWater.max(_chunksInUse.value());
+    }
+    return data;
+}
+
+
+/**
+ * @details
+ * Takes the next free slot of the spill file for a chunk of the given
+ * size, creating the chunk for the slot on first use. Returns 0 if there
+ * is no spill file or it is full.
+ * The write mutex must be held by the caller.
+ */
+LockableStreamData* StreamDataBuffer::_spillChunk(size_t size)
+{
+    if (!_spill)
+        return 0;
+    int slot = _spill->take(size);
+    if (slot < 0)
+        return 0;
+    if (!_spillChunks[slot])
+        _spillChunks[slot] = _newChunk(_spill->slot(slot), _spill->slotSize());
+    verbose(QString("spilling chunk to \"%1\"").arg(_spill->path()), 2);
+    return _spillChunks[slot];
+}
+
+
+/**
+ * @details
+ * Takes the chunk at the head of the free slot ring, returning 0 if there
+ * are no free slots.
+ * The write mutex must be held by the caller.
+ */
+LockableStreamData* StreamDataBuffer::_popFreeSlot()
+{
+    if (_serveQueueType == LockFree) {
+        LockableStreamData* data = 0;
+        _lockFreeSlots->dequeue(data);
+        return data;
+    }
+    if (_freeCount == 0)
+        return 0;
+    LockableStreamData* data = _freeSlots[_freeHead];
+    _freeHead = (_freeHead + 1) % _freeSlots.size();
+    --_freeCount;
+    return data;
+}
+
+
+/**
+ * @details
+ * Returns the chunk to the pool of free chunks; the tail of the free slot
+ * ring for Slab (or Shared) allocation, or the empty queue otherwise.
+ * The write mutex must be held by the caller, except with the lock-free
+ * serve queue.
+ */
+void StreamDataBuffer::_release(LockableStreamData* data)
+{
+    _chunksInUse.sub();
+    if (_spill) {
+        int slot = _spill->slotOf(data->data()->data());
+        if (slot >= 0) {
+            _spill->release(slot);
+            return;
+        }
+    }
+    if (_serveQueueType == LockFree) {
+        // Can not fail: the queue has room for every slot.
+        _lockFreeSlots->enqueue(data);
+    }
+    else if (_allocation != Dynamic) {
+        _freeSlots[(_freeHead + _freeCount) % _freeSlots.size()] = data;
+        ++_freeCount;
+    }
+    else {
+        _emptyQueue.push_back(data);
+    }
+}
+
+
 /**
  * @details
  * This protected slot is called when the lockable data object
@@ -174,6 +536,35 @@ void StreamDataBuffer::deactivateData()
  */
 void StreamDataBuffer::deactivateData(LockableStreamData* data)
 {
+    if (_broadcast) {
+        // The chunk stays queued until every consumer has finished with it.
+        QList<LockableStreamData*> done;
+        bool empty;
+        {
+            QMutexLocker locker(&_mutex);
+            done = _trim();
+            empty = _serveQueue.empty();
+        }
+        _recycle(done);
+        if (empty) _manager->emptiedBuffer(this);
+        return;
+    }
+
+    if (_serveQueueType == LockFree) {
+        if (!data->served()) {
+            // Can not fail: the queue has room for every slot.
+            _lockFreeRetry->enqueue(data);
+            _activated.notifyAll();
+            _manager->streamDataActivated();
+            return;
+        }
+        data->reset(0);
+        if( numberOfActiveChunks() == 0 )  {  _manager->emptiedBuffer(this); }
+        _release(data);
+        return;
+    }
+
+    bool requeued = false;
     {
         // server queue mutex context - be sure to release
         // before attempting to get writeMutex
@@ -181,37 +572,527 @@ void StreamDataBuffer::deactivateData(LockableStreamData* data)
         QMutexLocker locker(&_mutex);
         if (!data->served()) {
             _serveQueue.prepend(data);
-            return;
+            requeued = true;
         }
-        data->reset(0);
-        if( _serveQueue.empty() )  {  _manager->emptiedBuffer(this); }
+        else {
+            data->reset(0);
+            if( _serveQueue.empty() )  {  _manager->emptiedBuffer(this); }
+        }
+    }
+    if (requeued) {
+        // Wake the consumers waiting on the data manager, as for new data.
+        _activated.notifyAll();
+        _manager->streamDataActivated();
+        return;
     }
 
     QMutexLocker writeLocker(&_writeMutex);
-    _emptyQueue.push_back(data);
+    _release(data);
 }
 
 
 /**
  * @details
- * Puts the specified chunk of data on the queue ready to be served.
+ * Puts the specified chunk of data on the queue ready to be served,
+ * stamping its ingest time (see LatencyTrace).
  */
 void StreamDataBuffer::activateData(LockableStreamData* data)
 {
     if (data->isValid()) {
         verbose("activating data", 2);
-        QMutexLocker locker(&_mutex);
-        _serveQueue.enqueue(data);
+        LatencyTrace& trace = data->streamData()->latencyTrace();
+        trace.clear();
+        trace.setStream(_type);
+        trace.stamp(LatencyTrace::Ingest);
+        _chunksWritten.add();
+        _bytesWritten.add(data->streamData()->size());
+        const PacketStats& packets = data->streamData()->packetStats();
+        _packetsLost.add(packets.lost());
+        _packetsReordered.add(packets.reordered());
+        if (_orderWindow > 0 && packets.packets() > 0)
+            _order(data);
+        else
+            _serve(data);
     }
     else {
         verbose("not activating data - invalid", 2);
-        QMutexLocker writeLocker(&_writeMutex);
-        _emptyQueue.push_back(data);
+        if (_serveQueueType == LockFree) {
+            _release(data);
+        }
+        else {
+            QMutexLocker writeLocker(&_writeMutex);
+            _release(data);
+        }
     }
 }
 
+/**
+ * @details
+ * Puts an activated chunk on the serve queue (recording it first, if
+ * recording) and wakes the consumers waiting for data.
+ */
+void StreamDataBuffer::_serve(LockableStreamData* data)
+{
+    if (_recorder)
+        _recorder->record(_type, data->streamData());
+    if (_serveQueueType == LockFree) {
+        _lockFreeServeQueue->enqueue(data);
+    }
+    else if (_broadcast) {
+        QList<LockableStreamData*> done;
+        {
+            QMutexLocker locker(&_mutex);
+            data->readers() = _cursors.size();
+            _serveQueue.enqueue(data);
+            if (_maxLag > 0) {
+                qint64 oldest = _logStart + _serveQueue.size() - _maxLag;
+                QMutableHashIterator<QString, qint64> it(_cursors);
+                while (it.hasNext()) {
+                    it.next();
+                    if (it.value() < oldest) {
+                        verbose(QString("consumer \"%1\" skipped %2 chunks")
+                                .arg(it.key()).arg(oldest - it.value()), 2);
+                        _advance(it.value(), oldest);
+                    }
+                }
+            }
+            done = _trim();
+        }
+        _recycle(done);
+    }
+    else {
+        QMutexLocker locker(&_mutex);
+        _serveQueue.enqueue(data);
+    }
+    _activated.notifyAll();
+    if (_manager)
+        _manager->streamDataActivated();
+}
+
+
+/**
+ * @details
+ * Holds an activated chunk until it is next in sequence order, serving the
+ * held chunks that are ready. A chunk whose sequence number is below that
+ * of the last chunk served is late, and is served at once.
+ */
+void StreamDataBuffer::_order(LockableStreamData* data)
+{
+    QMutexLocker locker(&_orderMutex);
+    quint64 sequence = data->streamData()->packetStats().sequence();
+    if (sequence < _highestSequence)
+        _chunksReordered.add();
+    _highestSequence = qMax(_highestSequence, sequence);
+    if (_orderStarted && sequence < _lastSequence) {
+        _chunksLate.add();
+        _serve(data);
+        return;
+    }
+    HeldChunk held;
+    held.data = data;
+    held.since = AtomicCounter::now();
+    _held.insertMulti(sequence, held);
+    _releaseHeld(false);
+}
+
+
+/**
+ * @details
+ * Serves held chunks, lowest sequence number first, while the first is
+ * the one expected next (following on from the last chunk served), more
+ * than the window are held, or a chunk has been held longer than the
+ * timeout (serving every chunk before it as well).
+ *
+ * Must be called with the order mutex locked.
+ */
+void StreamDataBuffer::_releaseHeld(bool flush)
+{
+    bool expired = false;
+    quint64 expiredSequence = 0;
+    quint64 now = AtomicCounter::now();
+    QMap<quint64, HeldChunk>::const_iterator i;
+    for (i = _held.constBegin(); i != _held.constEnd(); ++i) {
+        if (now - i.value().since >= (quint64)_orderTimeout * 1000000) {
+            expired = true;
+            expiredSequence = i.key();
+        }
+    }
+
+    while (!_held.isEmpty()) {
+        QMap<quint64, HeldChunk>::iterator first = _held.begin();
+        quint64 sequence = first.key();
+        bool ready = flush || (_orderStarted && sequence <= _nextSequence)
+                || _held.size() > _orderWindow
+                || (expired && sequence <= expiredSequence);
+        if (!ready)
+            break;
+        LockableStreamData* data = first.value().data;
+        _held.erase(first);
+        quint64 end = sequence + data->streamData()->packetStats().packets();
+        _nextSequence = _orderStarted ? qMax(_nextSequence, end) : end;
+        _lastSequence = sequence;
+        _orderStarted = true;
+        _serve(data);
+    }
+}
+
+
+/**
+ * @details
+ * Serves the held chunks that have waited too long, so that a chunk whose
+ * predecessor never arrives is not held while the stream is idle. Called
+ * by consumers, which skip it if the order mutex is busy rather than wait.
+ */
+void StreamDataBuffer::_releaseExpired()
+{
+    if (!_orderMutex.tryLock())
+        return;
+    if (!_held.isEmpty())
+        _releaseHeld(false);
+    _orderMutex.unlock();
+}
+
 int StreamDataBuffer::numberOfActiveChunks() const
 {
+    if (_serveQueueType == LockFree)
+        return _lockFreeRetry->size() + _lockFreeServeQueue->size();
     return _serveQueue.size();
 }
+
+
+/**
+ * @details
+ * Serves the chunks that carry sequence numbers (PacketStats::packets()
+ * set) in the order of PacketStats::sequence(), for chunks written
+ * concurrently by several receivers of one stream. Up to \p window
+ * activated chunks are held back for the chunks before them, and none for
+ * longer than \p timeout ms. A chunk whose sequence number follows on from
+ * the chunks already served is served at once; a chunk that arrives after
+ * a later one was served is served at once, and counted as late.
+ *
+ * Chunks without sequence numbers are served as they are activated. A
+ * window of 0 serves every held chunk, and turns ordering off.
+ */
+void StreamDataBuffer::setOrdered(int window, int timeout)
+{
+    if (window < 0 || timeout < 0)
+        throw QString("StreamDataBuffer: Invalid ordering window %1 or "
+                "timeout %2 for buffer \"%3\".").arg(window).arg(timeout)
+                .arg(_type);
+    QMutexLocker locker(&_orderMutex);
+    _orderWindow = window;
+    _orderTimeout = timeout;
+    if (_orderWindow == 0)
+        _releaseHeld(true);
+}
+
+
+/**
+ * @details
+ * Puts the buffer in broadcast mode, so that every chunk is served to
+ * every consumer. Should be called before any data is written.
+ *
+ * @param policy  What to do when the buffer is full of chunks that a
+ *                consumer has not read: DropOldest recycles the oldest
+ *                of them (the consumer skips it), Wait leaves them, so
+ *                that no new data can be written.
+ * @param maxLag  The number of chunks a consumer may fall behind before
+ *                it is moved forward, whatever the policy (0 = no limit).
+ */
+void StreamDataBuffer::setBroadcast(LagPolicy policy, int maxLag)
+{
+    if (_serveQueueType == LockFree)
+        throw QString("StreamDataBuffer: Broadcast buffer \"%1\" requires "
+                "the locking serve queue.").arg(_type);
+    QMutexLocker locker(&_mutex);
+    _broadcast = true;
+    _lagPolicy = policy;
+    _maxLag = maxLag < 0 ? 0 : maxLag;
+}
+
+
+/**
+ * @details
+ * Registers a broadcast consumer, which will be served every chunk
+ * activated from now on. Chunks are kept for a registered consumer even
+ * before it first asks for data.
+ */
+void StreamDataBuffer::addConsumer(const QString& name)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_cursors.contains(name))
+        _cursors.insert(name, _logStart + _serveQueue.size());
+}
+
+
+/**
+ * @details
+ * Removes a broadcast consumer, recycling any chunks that were only being
+ * kept for it.
+ */
+void StreamDataBuffer::removeConsumer(const QString& name)
+{
+    QList<LockableStreamData*> done;
+    {
+        QMutexLocker locker(&_mutex);
+        if (!_cursors.contains(name))
+            return;
+        _advance(_cursors[name], _logStart + _serveQueue.size());
+        _cursors.remove(name);
+        foreach (qint64 sequence, _unread.take(name))
+            --_serveQueue[(int)(sequence - _logStart)]->readers();
+        done = _trim();
+    }
+    _recycle(done);
+}
+
+
+/**
+ * @details
+ * Returns the names of the registered broadcast consumers.
+ */
+QStringList StreamDataBuffer::consumers()
+{
+    QMutexLocker locker(&_mutex);
+    return _cursors.keys();
+}
+
+
+/**
+ * @details
+ * Returns the number of chunks on the serve queue that the broadcast
+ * consumer has still to read (including those it gave back).
+ */
+int StreamDataBuffer::backlog(const QString& consumer)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_cursors.contains(consumer))
+        return 0;
+    return (int)(_logStart + _serveQueue.size() - _cursors.value(consumer))
+            + _unread.value(consumer).size();
+}
+
+
+/**
+ * @details
+ * Adds a spill file to the buffer, which takes chunks that would
+ * otherwise evict waiting data (or be discarded) when the buffer's memory
+ * is full. The file is divided into slots of the maximum chunk size, and
+ * is removed when the buffer is destroyed. Should be called before any
+ * data is written.
+ *
+ * @param path     The file to create (any existing file is replaced).
+ * @param maxSize  The maximum size of the file in bytes.
+ */
+void StreamDataBuffer::setSpillFile(const QString& path, size_t maxSize)
+{
+    if (_serveQueueType == LockFree)
+        throw QString("StreamDataBuffer: Spill file for buffer \"%1\" "
+                "requires the locking serve queue.").arg(_type);
+    QMutexLocker writeLocker(&_writeMutex);
+    if (_spill)
+        throw QString("StreamDataBuffer: Buffer \"%1\" already has a spill "
+                "file.").arg(_type);
+    _spill = new StreamSpillFile(path, maxSize, _maxChunkSize); // Deleted in destructor.
+    _spillChunks.fill(0, _spill->slots());
+}
+
+
+/**
+ * @details
+ * Gives a chunk taken by a broadcast consumer back without serving it, so
+ * that it is served to the consumer again, before the chunks after its
+ * cursor. The chunk counts the consumer as a reader again, so that it is
+ * kept until then. The chunk must still be locked by the caller.
+ *
+ * Does nothing unless in broadcast mode: other chunks are put back on the
+ * serve queue when they are unlocked unserved.
+ */
+void StreamDataBuffer::unread(LockableStreamData* data, const QString& consumer)
+{
+    if (!_broadcast)
+        return;
+    QMutexLocker locker(&_mutex);
+    if (!_cursors.contains(consumer))
+        return;
+    int index = _serveQueue.indexOf(data);
+    if (index < 0)
+        return;
+    ++data->readers();
+    _unread[consumer].append(_logStart + index);
+}
+
+
+/**
+ * @details
+ * Returns the next chunk for the broadcast consumer, or 0 if it has read
+ * every chunk on the queue, and moves its cursor on. Chunks given back
+ * with unread() come first. The caller must lock the chunk and then count
+ * the consumer off its readers.
+ */
+LockableStreamData* StreamDataBuffer::_nextBroadcast(const QString& consumer)
+{
+    QMutexLocker locker(&_mutex);
+    QHash<QString, qint64>::iterator it = _cursors.find(consumer);
+    if (it == _cursors.end()) {
+        _cursors.insert(consumer, _logStart + _serveQueue.size());
+        return 0;
+    }
+    QHash<QString, QList<qint64> >::iterator unread = _unread.find(consumer);
+    if (unread != _unread.end()) {
+        // Kept on the queue by the reader counted in unread().
+        LockableStreamData* data = _serveQueue[(int)(unread->takeFirst() - _logStart)];
+        if (unread->isEmpty())
+            _unread.erase(unread);
+        return data;
+    }
+    int index = (int)(it.value() - _logStart);
+    if (index >= _serveQueue.size())
+        return 0;
+    ++it.value();
+    return _serveQueue[index];
+}
+
+
+/**
+ * @details
+ * Moves a broadcast cursor forward to the given sequence number, counting
+ * the chunks skipped as read.
+ * The serve queue mutex must be held by the caller.
+ */
+void StreamDataBuffer::_advance(qint64& cursor, qint64 to)
+{
+    for (; cursor < to; ++cursor) {
+        int index = (int)(cursor - _logStart);
+        if (index >= 0 && index < _serveQueue.size())
+            --_serveQueue[index]->readers();
+    }
+}
+
+
+/**
+ * @details
+ * Removes the chunks at the head of the serve queue that every broadcast
+ * consumer has read and unlocked, returning them for recycling.
+ * The serve queue mutex must be held by the caller.
+ */
+QList<LockableStreamData*> StreamDataBuffer::_trim()
+{
+    QList<LockableStreamData*> done;
+    while (!_serveQueue.isEmpty() && _serveQueue.head()->readers() <= 0
+            && !_serveQueue.head()->isLocked()) {
+        done.append(_serveQueue.dequeue());
+        ++_logStart;
+    }
+    return done;
+}
+
+
+/**
+ * @details
+ * Takes the chunk at the head of the broadcast serve queue for writing, if
+ * the lag policy is DropOldest and no consumer has it (or is about to lock
+ * it). Consumers that had not read it skip it.
+ */
+LockableStreamData* StreamDataBuffer::_dropOldest(size_t size)
+{
+    QMutexLocker locker(&_mutex);
+    if (_lagPolicy != DropOldest || _serveQueue.isEmpty())
+        return 0;
+    LockableStreamData* data = _serveQueue.head();
+    int unread = 0;
+    foreach (qint64 cursor, _cursors) {
+        if (cursor <= _logStart) ++unread;
+    }
+    if (data->isLocked() || data->readers() > unread || data->maxSize() < size)
+        return 0;
+    _serveQueue.dequeue();
+    ++_logStart;
+    QMutableHashIterator<QString, qint64> it(_cursors);
+    while (it.hasNext()) {
+        if (it.next().value() < _logStart) {
+            verbose(QString("consumer \"%1\" skipped a chunk").arg(it.key()), 2);
+            it.setValue(_logStart);
+        }
+    }
+    data->readers() = 0;
+    return data;
+}
+
+
+/**
+ * @details
+ * Resets the chunks and returns them to the pool of free chunks.
+ */
+void StreamDataBuffer::_recycle(const QList<LockableStreamData*>& chunks)
+{
+    if (chunks.isEmpty())
+        return;
+    QMutexLocker writeLocker(&_writeMutex);
+    foreach (LockableStreamData* data, chunks) {
+        data->reset(0);
+        _release(data);
+    }
+}
+
+/**
+ * @details
+ * Adds the buffer's counters to the map, labelled with the stream name:
+ * chunks and bytes written (activated) and served, chunks dropped (waiting
+ * chunks overwritten by new data) and rejected (no room for new data),
+ * chunks in use and the high-water mark, chunks waiting to be served, and
+ * the number of getWritable() calls with the total and longest time spent
+ * in them (seconds), the packets lost and reordered in the chunks
+ * written (see PacketStats), and the chunks activated out of sequence
+ * order and too late to be put back in order (see setOrdered()). The
+ * spill file counters are added if there
+ * is one.
+ */
+void StreamDataBuffer::metrics(QMap<QString, double>& values) const
+{
+    const QString label("stream");
+    values.insert(MetricsResponse::name("pelican_stream_chunks_written_total",
+            label, _type), _chunksWritten.value());
+    values.insert(MetricsResponse::name("pelican_stream_bytes_written_total",
+            label, _type), _bytesWritten.value());
+    values.insert(MetricsResponse::name("pelican_stream_chunks_served_total",
+            label, _type), _chunksServed.value());
+    values.insert(MetricsResponse::name("pelican_stream_bytes_served_total",
+            label, _type), _bytesServed.value());
+    values.insert(MetricsResponse::name("pelican_stream_chunks_dropped_total",
+            label, _type), _chunksDropped.value());
+    values.insert(MetricsResponse::name("pelican_stream_chunks_rejected_total",
+            label, _type), _chunksRejected.value());
+    values.insert(MetricsResponse::name("pelican_stream_buffer_chunks_in_use",
+            label, _type), (qint64)_chunksInUse.value());
+    values.insert(MetricsResponse::name("pelican_stream_buffer_chunks_high_water",
+            label, _type), _highWater.value());
+    values.insert(MetricsResponse::name("pelican_stream_buffer_chunks_waiting",
+            label, _type), numberOfActiveChunks());
+    values.insert(MetricsResponse::name("pelican_stream_buffer_capacity_bytes",
+            label, _type), _max);
+    values.insert(MetricsResponse::name("pelican_stream_writable_calls_total",
+            label, _type), _writableCalls.value());
+    values.insert(MetricsResponse::name("pelican_stream_writable_seconds_total",
+            label, _type), _writableTime.value() * 1e-9);
+    values.insert(MetricsResponse::name("pelican_stream_writable_seconds_max",
+            label, _type), _writableMaxTime.value() * 1e-9);
+    values.insert(MetricsResponse::name("pelican_stream_packets_lost_total",
+            label, _type), _packetsLost.value());
+    values.insert(MetricsResponse::name("pelican_stream_packets_reordered_total",
+            label, _type), _packetsReordered.value());
+    values.insert(MetricsResponse::name("pelican_stream_chunks_reordered_total",
+            label, _type), _chunksReordered.value());
+    values.insert(MetricsResponse::name("pelican_stream_chunks_late_total",
+            label, _type), _chunksLate.value());
+    if (_spill) {
+        values.insert(MetricsResponse::name("pelican_stream_spilled_chunks_total",
+                label, _type), _spill->spilled());
+        values.insert(MetricsResponse::name("pelican_stream_spilled_bytes_total",
+                label, _type), _spill->spilledBytes());
+        values.insert(MetricsResponse::name("pelican_stream_spill_chunks_in_use",
+                label, _type), _spill->inUse());
+    }
+}
+
 } // namespace pelican
@@ -0,0 +1,118 @@
+#include "pelican/server/StreamRecorder.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/comms/DataChunk.h"
+
+#include <QtCore/QMutexLocker>
+#include <time.h>
+
+namespace pelican {
+
+/**
+ * @details
+ * Creates the recording file and writes its header.
+ *
+ * The file starts with the magic number and format version, followed by a
+ * record for each chunk:
+ * - the stream name (QString),
+ * - the activation time in ns (qint64),
+ * - the service data versions (QHash<QString, QString>),
+ * - the payload size (quint64) and the raw payload.
+ *
+ * On close() the index (the number of records, then the offset and time of
+ * each) is appended, followed by its offset (quint64) and the magic number.
+ */
+StreamRecorder::StreamRecorder(const QString& path)
+    : _path(path), _file(path), _bytes(0)
+{
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw QString("StreamRecorder: Unable to create \"%1\": %2")
+                .arg(_path).arg(_file.errorString());
+    _out.setDevice(&_file);
+    _out.setVersion(QDataStream::Qt_4_0);
+    _out << magic << version;
+}
+
+
+StreamRecorder::~StreamRecorder()
+{
+    close();
+}
+
+
+/**
+ * @details
+ * Records the chunk, with the versions of the service data associated with
+ * it, at the current time.
+ */
+void StreamRecorder::record(const QString& stream, const StreamData* data)
+{
+    QHash<QString, QString> versions;
+    foreach (const boost::shared_ptr<DataChunk>& d, data->associateData())
+        versions.insert(d->name(), d->id());
+    record(stream, now(), versions, static_cast<const char*>(data->ptr()),
+            data->size());
+}
+
+
+/**
+ * @details
+ * Appends a record to the file. Does nothing once the recorder is closed.
+ */
+void StreamRecorder::record(const QString& stream, qint64 time,
+        const QHash<QString, QString>& versions, const char* data,
+        quint64 size)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_file.isOpen())
+        return;
+    _index.append(qMakePair((quint64)_file.pos(), time));
+    _out << stream << time << versions << size;
+    _out.writeRawData(data, (int)size);
+    _bytes += size;
+}
+
+
+/**
+ * @details
+ * Appends the index to the file and closes it.
+ */
+void StreamRecorder::close()
+{
+    QMutexLocker locker(&_mutex);
+    if (!_file.isOpen())
+        return;
+    quint64 indexOffset = _file.pos();
+    _out << (quint32)_index.size();
+    for (int i = 0; i < _index.size(); ++i)
+        _out << _index[i].first << _index[i].second;
+    _out << indexOffset << magic;
+    _file.close();
+}
+
+
+quint64 StreamRecorder::count()
+{
+    QMutexLocker locker(&_mutex);
+    return _index.size();
+}
+
+
+quint64 StreamRecorder::bytes()
+{
+    QMutexLocker locker(&_mutex);
+    return _bytes;
+}
+
+
+/**
+ * @details
+ * Returns the wall clock time in nanoseconds since the epoch.
+ */
+qint64 StreamRecorder::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (qint64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+} // namespace pelican
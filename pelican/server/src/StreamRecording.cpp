@@ -0,0 +1,126 @@
+#include "pelican/server/StreamRecording.h"
+#include "pelican/server/StreamRecorder.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDataStream>
+
+namespace pelican {
+
+// Bytes in the file header (magic number and version).
+static const quint64 headerSize = 8;
+
+// Bytes in the file trailer (index offset and magic number).
+static const quint64 trailerSize = 12;
+
+/**
+ * @details
+ * Opens and maps the recording, and finds its records.
+ */
+StreamRecording::StreamRecording(const QString& path)
+    : _file(path), _data(0), _size(0)
+{
+    if (!_file.open(QIODevice::ReadOnly))
+        throw QString("StreamRecording: Unable to open \"%1\": %2")
+                .arg(path).arg(_file.errorString());
+    _size = _file.size();
+    if (_size >= headerSize)
+        _data = reinterpret_cast<const char*>(_file.map(0, _size));
+    if (!_data)
+        throw QString("StreamRecording: Unable to map \"%1\".").arg(path);
+
+    QDataStream in(QByteArray::fromRawData(_data, headerSize));
+    in.setVersion(QDataStream::Qt_4_0);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != StreamRecorder::magic)
+        throw QString("StreamRecording: \"%1\" is not a recording.").arg(path);
+    if (version != StreamRecorder::version)
+        throw QString("StreamRecording: \"%1\" has unknown version %2.")
+                .arg(path).arg(version);
+
+    if (!_readIndex())
+        _scan();
+}
+
+
+StreamRecording::~StreamRecording()
+{
+    _file.unmap(const_cast<uchar*>(reinterpret_cast<const uchar*>(_data)));
+}
+
+
+/**
+ * @details
+ * Returns the record at the given index, with its payload in the mapped
+ * file (valid for the lifetime of the StreamRecording).
+ */
+StreamRecording::Record StreamRecording::record(int index) const
+{
+    Record r;
+    if (index < 0 || index >= _offsets.size() || !_read(_offsets[index], r))
+        throw QString("StreamRecording: No record %1 in \"%2\".")
+                .arg(index).arg(path());
+    return r;
+}
+
+
+bool StreamRecording::_readIndex()
+{
+    if (_size < headerSize + trailerSize)
+        return false;
+    QDataStream trailer(QByteArray::fromRawData(_data + _size - trailerSize,
+            trailerSize));
+    trailer.setVersion(QDataStream::Qt_4_0);
+    quint64 indexOffset;
+    quint32 magic;
+    trailer >> indexOffset >> magic;
+    if (magic != StreamRecorder::magic || indexOffset < headerSize
+            || indexOffset > _size - trailerSize)
+        return false;
+
+    QDataStream in(QByteArray::fromRawData(_data + indexOffset,
+            _size - trailerSize - indexOffset));
+    in.setVersion(QDataStream::Qt_4_0);
+    quint32 count;
+    in >> count;
+    if (in.status() != QDataStream::Ok
+            || count * 16ULL != _size - trailerSize - indexOffset - 4)
+        return false;
+    _offsets.resize(count);
+    _times.resize(count);
+    for (quint32 i = 0; i < count; ++i)
+        in >> _offsets[i] >> _times[i];
+    return true;
+}
+
+
+void StreamRecording::_scan()
+{
+    quint64 offset = headerSize, next;
+    Record r;
+    while (_read(offset, r, &next)) {
+        _offsets.append(offset);
+        _times.append(r.time);
+        offset = next;
+    }
+}
+
+
+bool StreamRecording::_read(quint64 offset, Record& record, quint64* end) const
+{
+    if (offset >= _size)
+        return false;
+    QDataStream in(QByteArray::fromRawData(_data + offset, _size - offset));
+    in.setVersion(QDataStream::Qt_4_0);
+    in >> record.stream >> record.time >> record.versions >> record.size;
+    if (in.status() != QDataStream::Ok)
+        return false;
+    quint64 start = offset + in.device()->pos();
+    if (record.size > _size - start)
+        return false;
+    record.data = _data + start;
+    if (end) *end = start + record.size;
+    return true;
+}
+
+} // namespace pelican
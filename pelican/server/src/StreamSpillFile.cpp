@@ -0,0 +1,108 @@
+#include "pelican/server/StreamSpillFile.h"
+
+#include <QtCore/QFile>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace pelican {
+
+/**
+ * @details
+ * Creates the file, sizes it to hold as many slots of \p slotSize bytes
+ * as fit in \p size bytes, and maps it read-write.
+ */
+StreamSpillFile::StreamSpillFile(const QString& path, size_t size,
+        size_t slotSize)
+    : _path(path), _data(0), _slotSize(slotSize), _slots(0),
+      _freeHead(0), _freeCount(0), _spilled(0), _spilledBytes(0),
+      _rejected(0), _highWater(0)
+{
+    if (_slotSize > 0)
+        _slots = (int)(size / _slotSize);
+    if (_slots < 1)
+        throw QString("StreamSpillFile: \"%1\" is smaller than a chunk.")
+                .arg(_path);
+
+    QByteArray name = QFile::encodeName(_path);
+    int fd = ::open(name.constData(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        throw QString("StreamSpillFile: Unable to create \"%1\": %2")
+                .arg(_path).arg(strerror(errno));
+    if (ftruncate(fd, this->size()) != 0) {
+        int e = errno;
+        ::close(fd);
+        ::unlink(name.constData());
+        throw QString("StreamSpillFile: Unable to size \"%1\": %2")
+                .arg(_path).arg(strerror(e));
+    }
+    void* p = mmap(0, this->size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int e = errno;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        ::unlink(name.constData());
+        throw QString("StreamSpillFile: Unable to map \"%1\": %2")
+                .arg(_path).arg(strerror(e));
+    }
+    _data = static_cast<char*>(p);
+
+    _free.resize(_slots);
+    for (int i = 0; i < _slots; ++i)
+        _free[i] = i;
+    _freeCount = _slots;
+}
+
+
+StreamSpillFile::~StreamSpillFile()
+{
+    munmap(_data, size());
+    ::unlink(QFile::encodeName(_path).constData());
+}
+
+
+int StreamSpillFile::slotOf(const void* ptr) const
+{
+    const char* p = static_cast<const char*>(ptr);
+    if (p < _data || p >= _data + size())
+        return -1;
+    return (int)((p - _data) / _slotSize);
+}
+
+
+/**
+ * @details
+ * Takes the slot at the head of the free ring and counts the chunk as
+ * spilled, or counts it as rejected if the chunk is too large or the file
+ * is full.
+ */
+int StreamSpillFile::take(size_t size)
+{
+    if (size > _slotSize || _freeCount == 0) {
+        ++_rejected;
+        return -1;
+    }
+    int index = _free[_freeHead];
+    _freeHead = (_freeHead + 1) % _slots;
+    --_freeCount;
+    ++_spilled;
+    _spilledBytes += size;
+    if (inUse() > _highWater)
+        _highWater = inUse();
+    return index;
+}
+
+
+/**
+ * @details
+ * Puts the slot at the tail of the free ring.
+ */
+void StreamSpillFile::release(int index)
+{
+    _free[(_freeHead + _freeCount) % _slots] = index;
+    ++_freeCount;
+}
+
+} // namespace pelican
@@ -0,0 +1,51 @@
+#ifndef ABSTRACTUDPCHUNKERTEST_H
+#define ABSTRACTUDPCHUNKERTEST_H
+
+/**
+ * @file AbstractUdpChunkerTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+class QCoreApplication;
+
+namespace pelican {
+
+/**
+ * @ingroup t_server
+ *
+ * @class AbstractUdpChunkerTest
+ *
+ * @brief
+ *    unit test for the AbstractUdpChunker
+ * @details
+ *
+ */
+class AbstractUdpChunkerTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( AbstractUdpChunkerTest );
+        CPPUNIT_TEST( test_receive );
+        CPPUNIT_TEST( test_threads );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_receive();
+        void test_threads();
+
+    public:
+        /// AbstractUdpChunkerTest constructor.
+        AbstractUdpChunkerTest();
+
+        /// AbstractUdpChunkerTest destructor.
+        ~AbstractUdpChunkerTest();
+
+    private:
+        QCoreApplication* _app;
+};
+
+} // namespace pelican
+#endif // ABSTRACTUDPCHUNKERTEST_H
@@ -0,0 +1,45 @@
+#ifndef CHUNKSCHEDULERTEST_H
+#define CHUNKSCHEDULERTEST_H
+
+/**
+ * @file ChunkSchedulerTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace pelican {
+
+/**
+ * @ingroup t_server
+ *
+ * @class ChunkSchedulerTest
+ *
+ * @brief
+ * Unit test for the ChunkScheduler class
+ *
+ * @details
+ */
+
+class ChunkSchedulerTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( ChunkSchedulerTest );
+        CPPUNIT_TEST( test_mayTake );
+        CPPUNIT_TEST( test_stats );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_mayTake();
+        void test_stats();
+
+    public:
+        ChunkSchedulerTest();
+        ~ChunkSchedulerTest();
+};
+
+} // namespace pelican
+#endif // CHUNKSCHEDULERTEST_H
@@ -63,12 +63,16 @@ class ChunkerTester
         /// return pointer to the chunker created in the tester
         AbstractChunker* chunker() const;
 
+        /// return the chunker and the copies run for its further threads
+        QList<AbstractChunker*> chunkers() const;
+
         /// return pointer to the current device associated with the chunker
         QIODevice* getCurrentDevice() const;
 
     private:
         QList<QString>   _streams; // name of the test stream
         ChunkerManager*  _chunkManager;
+        AbstractChunker* _chunker;
         DataManager*     _dataManager;
         Config           _config;
 };
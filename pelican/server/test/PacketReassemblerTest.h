@@ -0,0 +1,54 @@
+#ifndef PACKETREASSEMBLERTEST_H
+#define PACKETREASSEMBLERTEST_H
+
+/**
+ * @file PacketReassemblerTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+class QCoreApplication;
+
+namespace pelican {
+
+class DataManager;
+
+/**
+ * @ingroup t_server
+ *
+ * @class PacketReassemblerTest
+ *
+ * @brief
+ *    unit test for the PacketReassembler
+ * @details
+ *
+ */
+class PacketReassemblerTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( PacketReassemblerTest );
+        CPPUNIT_TEST( test_reorder );
+        CPPUNIT_TEST( test_flagGaps );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_reorder();
+        void test_flagGaps();
+
+    public:
+        /// PacketReassemblerTest constructor.
+        PacketReassemblerTest();
+
+        /// PacketReassemblerTest destructor.
+        ~PacketReassemblerTest();
+
+    private:
+        QCoreApplication* _app;
+        DataManager* _dataManager;
+};
+
+} // namespace pelican
+#endif // PACKETREASSEMBLERTEST_H
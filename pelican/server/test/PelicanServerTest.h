@@ -27,6 +27,9 @@ class PelicanServerTest : public CppUnit::TestFixture
         CPPUNIT_TEST( test_singleProtocolAcknowledge );
         CPPUNIT_TEST( test_singleProtocolStream );
         CPPUNIT_TEST( test_multiProtocol );
+        CPPUNIT_TEST( test_keepAlive );
+        CPPUNIT_TEST( test_stalledClient );
+        CPPUNIT_TEST( test_splitRequest );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -37,6 +40,9 @@ class PelicanServerTest : public CppUnit::TestFixture
         void test_singleProtocolAcknowledge();
         void test_singleProtocolStream();
         void test_multiProtocol();
+        void test_keepAlive();
+        void test_stalledClient();
+        void test_splitRequest();
 
     public:
         PelicanServerTest();
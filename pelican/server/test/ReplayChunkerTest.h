@@ -0,0 +1,51 @@
+#ifndef REPLAYCHUNKERTEST_H
+#define REPLAYCHUNKERTEST_H
+
+/**
+ * @file ReplayChunkerTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <QtCore/QString>
+class QCoreApplication;
+
+namespace pelican {
+
+/**
+ * @ingroup t_server
+ *
+ * @class ReplayChunkerTest
+ *
+ * @brief
+ *    unit test for the ReplayChunker
+ * @details
+ *
+ */
+class ReplayChunkerTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( ReplayChunkerTest );
+        CPPUNIT_TEST( test_replay );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_replay();
+
+    public:
+        /// ReplayChunkerTest constructor.
+        ReplayChunkerTest();
+
+        /// ReplayChunkerTest destructor.
+        ~ReplayChunkerTest();
+
+    private:
+        QCoreApplication* _app;
+        QString _path;
+};
+
+} // namespace pelican
+#endif // REPLAYCHUNKERTEST_H
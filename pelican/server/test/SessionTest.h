@@ -43,6 +43,9 @@ class SessionTest : public CppUnit::TestFixture
         CPPUNIT_TEST( test_serviceData );
         CPPUNIT_TEST( test_streamData );
         CPPUNIT_TEST( test_streamDataBufferFull );
+        CPPUNIT_TEST( test_streamDataWakeup );
+        CPPUNIT_TEST( test_subscription );
+        CPPUNIT_TEST( test_release );
         CPPUNIT_TEST( test_processRequest );
         CPPUNIT_TEST_SUITE_END();
 
@@ -54,6 +57,9 @@ class SessionTest : public CppUnit::TestFixture
         void test_processRequest();
         void test_streamData();
         void test_streamDataBufferFull();
+        void test_streamDataWakeup();
+        void test_subscription();
+        void test_release();
         void test_processServiceDataRequest();
         void test_serviceData();
         void test_dataReport();
@@ -30,6 +30,13 @@ class StreamDataBufferTest : public CppUnit::TestFixture
         //CPPUNIT_TEST( test_getNext );
         //CPPUNIT_TEST( test_getWritable );
         CPPUNIT_TEST( test_getWritableStreams );
+        CPPUNIT_TEST( test_slabAllocation );
+        CPPUNIT_TEST( test_lockFreeServeQueue );
+        CPPUNIT_TEST( test_broadcast );
+        CPPUNIT_TEST( test_broadcastUnread );
+        CPPUNIT_TEST( test_spill );
+        CPPUNIT_TEST( test_metrics );
+        CPPUNIT_TEST( test_ordered );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -40,6 +47,13 @@ class StreamDataBufferTest : public CppUnit::TestFixture
         void test_getNext();
         void test_getWritable();
         void test_getWritableStreams();
+        void test_slabAllocation();
+        void test_lockFreeServeQueue();
+        void test_broadcast();
+        void test_broadcastUnread();
+        void test_spill();
+        void test_metrics();
+        void test_ordered();
 
     public:
         StreamDataBufferTest();
@@ -0,0 +1,49 @@
+#ifndef STREAMRECORDERTEST_H
+#define STREAMRECORDERTEST_H
+
+/**
+ * @file StreamRecorderTest.h
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <QtCore/QString>
+
+namespace pelican {
+
+/**
+ * @ingroup t_server
+ *
+ * @class StreamRecorderTest
+ *
+ * @brief
+ * Unit test for the StreamRecorder and StreamRecording classes
+ *
+ * @details
+ */
+
+class StreamRecorderTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( StreamRecorderTest );
+        CPPUNIT_TEST( test_record );
+        CPPUNIT_TEST( test_unclosed );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_record();
+        void test_unclosed();
+
+    public:
+        StreamRecorderTest();
+        ~StreamRecorderTest();
+
+    private:
+        QString _path;
+};
+
+} // namespace pelican
+#endif // STREAMRECORDERTEST_H
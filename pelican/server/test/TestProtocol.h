@@ -40,6 +40,10 @@ class TestProtocol : public AbstractProtocol
         virtual void send(QIODevice& , const DataSupportResponse&) {};
         virtual void send(QIODevice& , const QString& /*dataName*/, const DataBlob&)  {};
         virtual void sendError( QIODevice& device, const QString&);
+        virtual bool sendsReferences() const { return _sendsReferences; }
+
+        /// Makes the session hold stream data until it is released.
+        void setSendsReferences(bool references) { _sendsReferences = references; }
 
         QByteArray& lastBlock();
         AbstractProtocol::StreamData_t lastStreamData() const { return _lastStreamData; };
@@ -49,6 +53,7 @@ class TestProtocol : public AbstractProtocol
         QByteArray _last;
         QString _id;
         ServerRequest::Request _request;
+        bool _sendsReferences;
 
     protected:
         void _clearLast();
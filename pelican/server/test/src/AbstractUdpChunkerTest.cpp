@@ -0,0 +1,206 @@
+#include "AbstractUdpChunkerTest.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QUdpSocket>
+#include "AbstractUdpChunker.h"
+#include "pelican/server/LockedData.h"
+#include "pelican/server/LockableStreamData.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/server/ChunkerManager.h"
+#include "pelican/server/test/ChunkerTester.h"
+#include "pelican/server/test/TestChunker.h"
+#include "pelican/utility/Config.h"
+
+#include <cstring>
+#include <unistd.h>
+
+namespace pelican {
+
+using test::ChunkerTester;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( AbstractUdpChunkerTest );
+
+/**
+ * @details
+ * Accepts the packets that start with 'P'.
+ */
+class AbstractUdpChunkerTestChunker : public AbstractUdpChunker
+{
+    public:
+        AbstractUdpChunkerTestChunker(const ConfigNode& config)
+            : AbstractUdpChunker(config) {}
+
+    protected:
+        bool parseHeader(const char* packet, int) { return packet[0] == 'P'; }
+};
+PELICAN_DECLARE_CHUNKER(AbstractUdpChunkerTestChunker)
+
+/**
+ * @details
+ * Accepts the packets that start with 'P', numbered by the seven digits
+ * that follow.
+ */
+class AbstractUdpChunkerTestSequenceChunker : public AbstractUdpChunker
+{
+    public:
+        AbstractUdpChunkerTestSequenceChunker(const ConfigNode& config)
+            : AbstractUdpChunker(config) {}
+
+    protected:
+        bool parseHeader(const char* packet, int) { return packet[0] == 'P'; }
+        bool sequence(const char* packet, quint64* sequence) {
+            *sequence = QByteArray(packet + 1, 7).toULongLong();
+            return true;
+        }
+};
+PELICAN_DECLARE_CHUNKER(AbstractUdpChunkerTestSequenceChunker)
+
+/**
+ * @details Constructs a AbstractUdpChunkerTest object.
+ */
+AbstractUdpChunkerTest::AbstractUdpChunkerTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ * @details Destroys the AbstractUdpChunkerTest object.
+ */
+AbstractUdpChunkerTest::~AbstractUdpChunkerTest()
+{
+}
+
+void AbstractUdpChunkerTest::setUp()
+{
+    int argc = 1;
+    char *argv[] = {(char*)"pelican"};
+    _app = new QCoreApplication(argc,argv);
+}
+
+void AbstractUdpChunkerTest::tearDown()
+{
+    delete _app;
+}
+
+void AbstractUdpChunkerTest::test_receive()
+{
+    try {
+    // Use case:
+    // Packets of the right size and header, mixed with a packet with a bad
+    // header and one of the wrong size.
+    // Expect:
+    // The good packets written in order, four to a chunk, and the others
+    // rejected.
+    quint16 port = 2021;
+    ChunkerTester tester("AbstractUdpChunkerTestChunker", 1024,
+            QString("<AbstractUdpChunkerTestChunker>"
+                    "<connection host=\"127.0.0.1\" port=\"%1\"/>"
+                    "<data type=\"test\" chunkSize=\"32\"/>"
+                    "<packet size=\"8\" batch=\"3\"/>"
+                    "<socket receiveBuffer=\"1048576\"/>"
+                    "</AbstractUdpChunkerTestChunker>").arg(port));
+    AbstractUdpChunker* chunker =
+            static_cast<AbstractUdpChunker*>(tester.chunker());
+
+    QUdpSocket socket;
+    QHostAddress host("127.0.0.1");
+    for (int i = 0; i < 8; ++i) {
+        if (i == 2) socket.writeDatagram("Xbadhead", 8, host, port);
+        if (i == 5) socket.writeDatagram("Pshort", 6, host, port);
+        QByteArray packet = QString("Packet%1.").arg(i).toAscii();
+        socket.writeDatagram(packet, host, port);
+    }
+    for (int i = 0; i < 100 && chunker->received() < 8; ++i)
+        usleep(10000);
+
+    CPPUNIT_ASSERT_EQUAL( quint64(8), chunker->received() );
+    CPPUNIT_ASSERT_EQUAL( quint64(2), chunker->rejected() );
+    CPPUNIT_ASSERT_EQUAL( quint64(0), chunker->discarded() );
+    CPPUNIT_ASSERT_EQUAL( quint64(0), chunker->kernelDrops() );
+    const char* expected[] = { "Packet0.Packet1.Packet2.Packet3.",
+                               "Packet4.Packet5.Packet6.Packet7." };
+    for (int i = 0; i < 2; ++i) {
+        LockedData ldata = tester.getData();
+        CPPUNIT_ASSERT( ldata.isValid() );
+        LockableStreamData* chunk = static_cast<LockableStreamData*>(ldata.object());
+        chunk->served() = true;
+        StreamData* data = chunk->streamData();
+        CPPUNIT_ASSERT_EQUAL( size_t(32), data->size() );
+        CPPUNIT_ASSERT( memcmp(data->ptr(), expected[i], data->size()) == 0 );
+    }
+    }
+    catch( const QString& msg)
+    {
+        CPPUNIT_FAIL( msg.toStdString() );
+    }
+}
+
+void AbstractUdpChunkerTest::test_threads()
+{
+    try {
+    // Use case:
+    // A chunker with two threads, and numbered packets sent four to a
+    // chunk, alternating between two senders so that the kernel can
+    // spread the chunks over both sockets.
+    // Expect:
+    // Two chunkers bound to the same port, between them receiving every
+    // packet, and the chunks served in sequence order.
+    quint16 port = 2022;
+    ChunkerTester tester("AbstractUdpChunkerTestSequenceChunker", 1024,
+            QString("<AbstractUdpChunkerTestSequenceChunker>"
+                    "<connection host=\"127.0.0.1\" port=\"%1\" threads=\"2\"/>"
+                    "<data type=\"test\" chunkSize=\"32\"/>"
+                    "<packet size=\"8\"/>"
+                    "<socket receiveBuffer=\"1048576\"/>"
+                    "</AbstractUdpChunkerTestSequenceChunker>").arg(port));
+    QList<AbstractChunker*> chunkers = tester.chunkers();
+    CPPUNIT_ASSERT_EQUAL( 2, chunkers.size() );
+
+    QUdpSocket senders[2];
+    QHostAddress host("127.0.0.1");
+    for (int i = 0; i < 16; ++i) {
+        QByteArray packet = QString("P%1").arg(i, 7, 10, QChar('0')).toAscii();
+        senders[(i / 4) % 2].writeDatagram(packet, host, port);
+    }
+    quint64 received = 0;
+    for (int i = 0; i < 100 && received < 16; ++i) {
+        usleep(10000);
+        received = 0;
+        foreach (AbstractChunker* chunker, chunkers)
+            received += static_cast<AbstractUdpChunker*>(chunker)->received();
+    }
+    CPPUNIT_ASSERT_EQUAL( quint64(16), received );
+    usleep(200000); // Past the time a chunk may be held for ordering.
+
+    for (int i = 0; i < 4; ++i) {
+        LockedData ldata = tester.getData();
+        CPPUNIT_ASSERT( ldata.isValid() );
+        LockableStreamData* chunk = static_cast<LockableStreamData*>(ldata.object());
+        chunk->served() = true;
+        StreamData* data = chunk->streamData();
+        CPPUNIT_ASSERT_EQUAL( size_t(32), data->size() );
+        CPPUNIT_ASSERT_EQUAL( quint64(4 * i), data->packetStats().sequence() );
+        CPPUNIT_ASSERT_EQUAL( quint32(4), data->packetStats().packets() );
+    }
+
+    // Use case:
+    // A chunker that is not an AbstractUdpChunker with two threads.
+    // Expect:
+    // The chunker to be refused, as its copies could not share the port.
+    Config config;
+    config.setXML("<root><chunkers>"
+            "<TestChunker><connection threads=\"2\"/></TestChunker>"
+            "</chunkers></root>");
+    Config::TreeAddress base;
+    base << Config::NodeId("root", "");
+    ChunkerManager manager(&config, base);
+    CPPUNIT_ASSERT_THROW( manager.addStreamChunker("TestChunker"), QString );
+    }
+    catch( const QString& msg)
+    {
+        CPPUNIT_FAIL( msg.toStdString() );
+    }
+}
+
+} // namespace pelican
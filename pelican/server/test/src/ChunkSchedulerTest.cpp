@@ -0,0 +1,146 @@
+#include "pelican/server/test/ChunkSchedulerTest.h"
+#include "pelican/server/ChunkScheduler.h"
+
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ChunkSchedulerTest );
+// class ChunkSchedulerTest
+ChunkSchedulerTest::ChunkSchedulerTest()
+    : CppUnit::TestFixture()
+{
+}
+
+ChunkSchedulerTest::~ChunkSchedulerTest()
+{
+}
+
+void ChunkSchedulerTest::setUp()
+{
+}
+
+void ChunkSchedulerTest::tearDown()
+{
+}
+
+void ChunkSchedulerTest::test_mayTake()
+{
+    QSet<QString> stream;
+    stream << "stream";
+    QSet<QString> other;
+    other << "other";
+    {
+        // Use Case:
+        // Two idle sessions waiting for the same stream.
+        // Expect: the one that waited first is chosen, then the other.
+        ChunkScheduler scheduler;
+        int a = scheduler.add("a");
+        int b = scheduler.add("b");
+        CPPUNIT_ASSERT( scheduler.mayTake(a, stream) );
+        CPPUNIT_ASSERT( ! scheduler.mayTake(b, stream) );
+        CPPUNIT_ASSERT( scheduler.mayTake(a, stream) );
+        scheduler.served(a, 100);
+        CPPUNIT_ASSERT( scheduler.mayTake(b, stream) );
+    }
+    {
+        // Use Case:
+        // A session with outstanding work waiting longer than an idle one.
+        // Expect: the idle session is chosen until the work is completed.
+        ChunkScheduler scheduler;
+        int slow = scheduler.add("slow");
+        int fast = scheduler.add("fast");
+        scheduler.mayTake(slow, stream);
+        scheduler.served(slow, 100);
+        CPPUNIT_ASSERT( scheduler.mayTake(slow, stream) );
+        CPPUNIT_ASSERT( scheduler.mayTake(fast, stream) );
+        CPPUNIT_ASSERT( ! scheduler.mayTake(slow, stream) );
+        scheduler.served(fast, 100);
+        scheduler.completed(fast);
+        CPPUNIT_ASSERT( scheduler.mayTake(fast, stream) );
+        CPPUNIT_ASSERT( ! scheduler.mayTake(slow, stream) );
+
+        // Use Case:
+        // The preferred session stops waiting.
+        // Expect: the other is chosen.
+        scheduler.cancel(fast);
+        CPPUNIT_ASSERT( scheduler.mayTake(slow, stream) );
+    }
+    {
+        // Use Case:
+        // Sessions waiting for different streams.
+        // Expect: both chosen.
+        ChunkScheduler scheduler;
+        int a = scheduler.add("a");
+        int b = scheduler.add("b");
+        CPPUNIT_ASSERT( scheduler.mayTake(a, stream) );
+        CPPUNIT_ASSERT( scheduler.mayTake(b, other) );
+
+        // Use Case:
+        // The chosen session is removed.
+        // Expect: the next in line is chosen.
+        int c = scheduler.add("c");
+        CPPUNIT_ASSERT( ! scheduler.mayTake(c, stream) );
+        scheduler.remove(a);
+        CPPUNIT_ASSERT( scheduler.mayTake(c, stream) );
+    }
+}
+
+void ChunkSchedulerTest::test_stats()
+{
+    // Use Case:
+    // Chunks served to two sessions of one client and one of another.
+    // Expect: totals and queue depth by client.
+    QSet<QString> stream;
+    stream << "stream";
+    ChunkScheduler scheduler;
+    int a1 = scheduler.add("a");
+    int a2 = scheduler.add("a");
+    int b = scheduler.add("b");
+    scheduler.mayTake(a1, stream);
+    scheduler.served(a1, 100);
+    scheduler.mayTake(a2, stream);
+    scheduler.served(a2, 50);
+    scheduler.mayTake(a2, stream);
+    scheduler.served(a2, 50);
+    scheduler.completed(a2, 1);
+    scheduler.mayTake(b, stream);
+
+    QList<ChunkScheduler::ClientStats> stats = scheduler.stats();
+    CPPUNIT_ASSERT_EQUAL(2, stats.size());
+    foreach (const ChunkScheduler::ClientStats& s, stats) {
+        if (s.name == "a") {
+            CPPUNIT_ASSERT_EQUAL(2, s.sessions);
+            CPPUNIT_ASSERT_EQUAL((quint64)3, s.chunks);
+            CPPUNIT_ASSERT_EQUAL((quint64)200, s.bytes);
+            CPPUNIT_ASSERT_EQUAL(2, s.outstanding);
+            CPPUNIT_ASSERT_EQUAL(0, s.waiting);
+            CPPUNIT_ASSERT( s.chunkRate > 0.0 );
+            CPPUNIT_ASSERT( s.byteRate > s.chunkRate );
+        }
+        else {
+            CPPUNIT_ASSERT_EQUAL(QString("b"), s.name);
+            CPPUNIT_ASSERT_EQUAL((quint64)0, s.chunks);
+            CPPUNIT_ASSERT_EQUAL(0, s.outstanding);
+            CPPUNIT_ASSERT_EQUAL(1, s.waiting);
+        }
+    }
+
+    // Use Case:
+    // Sessions removed.
+    // Expect: the client's statistics are kept.
+    scheduler.remove(a1);
+    scheduler.remove(a2);
+    stats = scheduler.stats();
+    CPPUNIT_ASSERT_EQUAL(2, stats.size());
+    foreach (const ChunkScheduler::ClientStats& s, stats) {
+        if (s.name == "a") {
+            CPPUNIT_ASSERT_EQUAL(0, s.sessions);
+            CPPUNIT_ASSERT_EQUAL((quint64)3, s.chunks);
+            CPPUNIT_ASSERT_EQUAL(0, s.outstanding);
+        }
+    }
+}
+
+} // namespace pelican
@@ -16,7 +16,7 @@ namespace test {
  */
 ChunkerTester::ChunkerTester(const QString& chunkerType,
         unsigned long bufferSize, const QString& XML_Config, int verbose )
-: _chunkManager(0), _dataManager(0)
+: _chunkManager(0), _chunker(0), _dataManager(0)
 {
     // Setup the XML configuration.
     Config::TreeAddress dataAddress, chunkerBase;
@@ -35,6 +35,7 @@ ChunkerTester::ChunkerTester(const QString& chunkerType,
 
     _chunkManager = new ChunkerManager(&_config, chunkerBase);
     AbstractChunker* chunker = _chunkManager->addStreamChunker(chunkerType);
+    _chunker = chunker;
 
     // setup the data manager
     _dataManager = new DataManager(&_config , dataAddress);
@@ -74,10 +75,13 @@ ChunkerTester::~ChunkerTester()
 
 AbstractChunker* ChunkerTester::chunker() const
 {
-    QList<AbstractChunker* > chunkers = _chunkManager->chunkers().values();
-    Q_ASSERT(chunkers.size() == 1);
-    Q_ASSERT(chunkers.first() != 0);
-    return chunkers.first();
+    Q_ASSERT(_chunker != 0);
+    return _chunker;
+}
+
+QList<AbstractChunker*> ChunkerTester::chunkers() const
+{
+    return _chunkManager->chunkers().values();
 }
 
 QIODevice* ChunkerTester::getCurrentDevice() const {
@@ -0,0 +1,221 @@
+#include "PacketReassemblerTest.h"
+
+#include "pelican/server/PacketReassembler.h"
+#include "pelican/server/AbstractChunker.h"
+#include "pelican/server/DataManager.h"
+#include "pelican/server/LockedData.h"
+#include "pelican/server/LockableStreamData.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/utility/Config.h"
+#include "pelican/utility/ConfigNode.h"
+
+#include <QtCore/QCoreApplication>
+#include <cstring>
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( PacketReassemblerTest );
+
+/**
+ * @details
+ * A chunker that only hands out storage for the stream "test".
+ */
+class PacketReassemblerTestChunker : public AbstractChunker
+{
+    public:
+        PacketReassemblerTestChunker() {
+            setChunkTypes(QList<QString>() << "test");
+        }
+        QIODevice* newDevice() { return 0; }
+        void next(QIODevice*) {}
+};
+
+/**
+ * @details
+ * Reads the sequence number from the first four bytes of the packet and
+ * the timestamp from the next four, rejecting sequence numbers of zero.
+ */
+class PacketReassemblerTestHeader : public PacketReassembler::Header
+{
+    public:
+        bool operator()(const char* packet, int, quint64* sequence,
+                quint64* timestamp) const {
+            quint32 value;
+            memcpy(&value, packet, 4);
+            *sequence = value;
+            memcpy(&value, packet + 4, 4);
+            *timestamp = value;
+            return *sequence != 0;
+        }
+};
+
+/**
+ * @details
+ * Makes a packet with an 8 byte header and a payload holding the sequence
+ * number.
+ */
+static QByteArray packet(quint32 sequence)
+{
+    QByteArray packet(12, 0);
+    quint32 timestamp = sequence * 10;
+    memcpy(packet.data(), &sequence, 4);
+    memcpy(packet.data() + 4, &timestamp, 4);
+    memcpy(packet.data() + 8, &sequence, 4);
+    return packet;
+}
+
+/**
+ * @details
+ * Takes the next chunk of the test stream, returning its payloads.
+ */
+static QList<quint32> payloads(DataManager* dataManager, PacketStats* stats)
+{
+    QList<quint32> values;
+    LockedData data = dataManager->getNext("test");
+    if( ! data.isValid() ) return values;
+    LockableStreamData* lockable = static_cast<LockableStreamData*>(data.object());
+    StreamData* streamData = lockable->streamData();
+    const quint32* ptr = (const quint32*)streamData->ptr();
+    for( size_t i = 0; i < streamData->size() / 4; ++i )
+        values.append(ptr[i]);
+    *stats = streamData->packetStats();
+    lockable->served() = true;
+    return values;
+}
+
+/**
+ * @details Constructs a PacketReassemblerTest object.
+ */
+PacketReassemblerTest::PacketReassemblerTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ * @details Destroys the PacketReassemblerTest object.
+ */
+PacketReassemblerTest::~PacketReassemblerTest()
+{
+}
+
+void PacketReassemblerTest::setUp()
+{
+    int argc = 1;
+    char *argv[] = {(char*)"pelican"};
+    _app = new QCoreApplication(argc,argv);
+    Config config;
+    _dataManager = new DataManager(&config);
+    _dataManager->setMaxBufferSize("test", 1024);
+    _dataManager->setMaxChunkSize("test", 1024);
+    _dataManager->getStreamBuffer("test");
+}
+
+void PacketReassemblerTest::tearDown()
+{
+    delete _dataManager;
+    delete _app;
+}
+
+void PacketReassemblerTest::test_reorder()
+{
+    // Use case:
+    // Chunks of four packets, with a window of two. Packets arrive out of
+    // order within a chunk and across a chunk boundary, one is lost, one
+    // arrives after its chunk was released and one is repeated.
+    // Expect:
+    // Chunks served in order with the packets in place, the lost packet
+    // zero-filled, and the losses counted in the chunks' statistics.
+    PacketReassemblerTestChunker chunker;
+    chunker.setDataManager(_dataManager);
+    PacketReassemblerTestHeader header;
+    {
+        PacketReassembler reassembler(&chunker, &header, 8, 4, 4, 2);
+        CPPUNIT_ASSERT_EQUAL(size_t(16), reassembler.chunkSize());
+        quint32 order[] = { 100, 102, 101, 103, 104, 106, 107, 108, 105,
+                109, 109, 111, 112, 114, 110 };
+        for( unsigned i = 0; i < sizeof(order) / sizeof(quint32); ++i ) {
+            QByteArray p = packet(order[i]);
+            reassembler.add(p.constData(), p.size());
+        }
+        QByteArray bad = packet(0);
+        reassembler.add(bad.constData(), bad.size());
+        reassembler.add(bad.constData(), 4);
+
+        CPPUNIT_ASSERT_EQUAL(quint64(13), reassembler.received());
+        CPPUNIT_ASSERT_EQUAL(quint64(2), reassembler.reordered());
+        CPPUNIT_ASSERT_EQUAL(quint64(1), reassembler.late());
+        CPPUNIT_ASSERT_EQUAL(quint64(1), reassembler.duplicates());
+        CPPUNIT_ASSERT_EQUAL(quint64(2), reassembler.rejected());
+        CPPUNIT_ASSERT_EQUAL(quint64(1), reassembler.lost());
+    }
+
+    PacketStats stats;
+    QList<quint32> values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT( values == QList<quint32>() << 100 << 101 << 102 << 103 );
+    CPPUNIT_ASSERT_EQUAL(quint64(100), stats.sequence());
+    CPPUNIT_ASSERT_EQUAL(quint64(1000), stats.timestamp());
+    CPPUNIT_ASSERT_EQUAL(quint32(4), stats.packets());
+    CPPUNIT_ASSERT_EQUAL(quint32(0), stats.lost());
+    CPPUNIT_ASSERT_EQUAL(quint32(1), stats.reordered());
+
+    values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT( values == QList<quint32>() << 104 << 105 << 106 << 107 );
+    CPPUNIT_ASSERT_EQUAL(quint32(0), stats.lost());
+    CPPUNIT_ASSERT_EQUAL(quint32(1), stats.reordered());
+
+    values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT( values == QList<quint32>() << 108 << 109 << 0 << 111 );
+    CPPUNIT_ASSERT_EQUAL(quint64(108), stats.sequence());
+    CPPUNIT_ASSERT_EQUAL(quint32(1), stats.lost());
+    CPPUNIT_ASSERT( stats.gaps().isEmpty() );
+
+    // The last chunk is released by the destructor, with two packets lost.
+    values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT( values == QList<quint32>() << 112 << 0 << 114 << 0 );
+    CPPUNIT_ASSERT_EQUAL(quint32(2), stats.lost());
+
+    CPPUNIT_ASSERT( payloads(_dataManager, &stats).isEmpty() );
+}
+
+void PacketReassemblerTest::test_flagGaps()
+{
+    // Use case:
+    // Configured to flag gaps, with packets lost inside a chunk and a whole
+    // chunk lost.
+    // Expect:
+    // The gaps listed in the statistics and the empty chunk not served.
+    PacketReassemblerTestChunker chunker;
+    chunker.setDataManager(_dataManager);
+    PacketReassemblerTestHeader header;
+    ConfigNode config("<Chunker>"
+            "<reassembly header=\"8\" payload=\"4\" packets=\"4\" window=\"0\""
+            " gaps=\"flag\"/>"
+            "</Chunker>");
+    PacketReassembler reassembler(&chunker, &header, config);
+    quint32 order[] = { 1, 4, 13 };
+    for( unsigned i = 0; i < sizeof(order) / sizeof(quint32); ++i ) {
+        QByteArray p = packet(order[i]);
+        reassembler.add(p.constData(), p.size());
+    }
+    CPPUNIT_ASSERT_EQUAL(quint64(10), reassembler.lost());
+
+    PacketStats stats;
+    QList<quint32> values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT_EQUAL(4, values.size());
+    CPPUNIT_ASSERT_EQUAL(quint32(1), values[0]);
+    CPPUNIT_ASSERT_EQUAL(quint32(4), values[3]);
+    CPPUNIT_ASSERT_EQUAL(quint32(2), stats.lost());
+    CPPUNIT_ASSERT_EQUAL(1, stats.gaps().size());
+    CPPUNIT_ASSERT_EQUAL(quint32(1), stats.gaps()[0].first);
+    CPPUNIT_ASSERT_EQUAL(quint32(2), stats.gaps()[0].second);
+
+    // The chunks from 5 and 9 were skipped: only the chunk from 13 remains.
+    reassembler.flush();
+    values = payloads(_dataManager, &stats);
+    CPPUNIT_ASSERT_EQUAL(quint64(13), stats.sequence());
+    CPPUNIT_ASSERT_EQUAL(quint32(13), values[0]);
+    CPPUNIT_ASSERT_EQUAL(quint32(3), stats.lost());
+    CPPUNIT_ASSERT( payloads(_dataManager, &stats).isEmpty() );
+}
+
+} // namespace pelican
@@ -5,12 +5,20 @@
 #include "pelican/server/test/TestProtocol.h"
 #include "pelican/server/DataManager.h"
 #include "pelican/server/test/TestChunker.h"
+#include "pelican/comms/PelicanProtocol.h"
+#include "pelican/comms/PelicanClientProtocol.h"
+#include "pelican/comms/DataSupportRequest.h"
+#include "pelican/comms/ProtocolVersionRequest.h"
+#include "pelican/comms/ServerResponse.h"
 #include "pelican/data/DataRequirements.h"
 #include "pelican/utility/Config.h"
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <QtNetwork/QTcpSocket>
 #include <iostream>
+#include <unistd.h>
 
 namespace pelican {
 
@@ -138,4 +146,152 @@ void PelicanServerTest::test_multiProtocol()
     }
 }
 
+void PelicanServerTest::test_keepAlive()
+{
+    // Use Case:
+    // Server configured for keep-alive sessions, with a thread per
+    // connection and with a pool of worker threads.
+    // Expect several requests to be answered on the same connection.
+    QStringList sessions;
+    sessions << "<sessions keepAlive=\"true\"/>"
+             << "<sessions keepAlive=\"true\" threads=\"2\"/>";
+    foreach (const QString& sessionXml, sessions) {
+        try {
+            Config config;
+            config.setFromString("", sessionXml);
+            PelicanServer server(&config);
+            quint16 port = 2000;
+            server.addProtocol(new PelicanProtocol, port);
+            server.start();
+            while (!server.isReady()) {}
+
+            PelicanClientProtocol protocol;
+            QTcpSocket socket;
+            socket.connectToHost("127.0.0.1", port);
+            CPPUNIT_ASSERT( socket.waitForConnected(5000) );
+            for (int i = 0; i < 3; ++i) {
+                socket.write(protocol.serialise(DataSupportRequest()));
+                socket.flush();
+                CPPUNIT_ASSERT( socket.waitForReadyRead(5000) );
+                boost::shared_ptr<ServerResponse> r = protocol.receive(socket);
+                CPPUNIT_ASSERT_EQUAL( ServerResponse::DataSupport, r->type() );
+                CPPUNIT_ASSERT( socket.state() == QAbstractSocket::ConnectedState );
+            }
+            socket.disconnectFromHost();
+        }
+        catch (const QString& e) {
+            CPPUNIT_FAIL("Unexpected exception: " +  e.toStdString());
+        }
+    }
+}
+
+void PelicanServerTest::test_stalledClient()
+{
+    // Use Case:
+    // Keep-alive sessions on a single worker thread. One client sends a
+    // flood of requests and never reads the replies, until they back up
+    // into the server; a second client then makes a request.
+    // Expect the second client to be answered.
+    try {
+        Config config;
+        config.setFromString("", "<sessions keepAlive=\"true\" threads=\"1\"/>");
+        PelicanServer server(&config);
+        quint16 port = 2000;
+        server.addProtocol(new PelicanProtocol, port);
+        server.start();
+        while (!server.isReady()) {}
+
+        PelicanClientProtocol protocol;
+        QByteArray request = protocol.serialise(DataSupportRequest());
+        QTcpSocket stalled;
+        stalled.connectToHost("127.0.0.1", port);
+        CPPUNIT_ASSERT( stalled.waitForConnected(5000) );
+        QByteArray flood;
+        for (int i = 0; i < 2000000; ++i)
+            flood.append(request);
+        stalled.write(flood);
+        // Send until the server stops taking the requests.
+        qint64 left = stalled.bytesToWrite();
+        for (int i = 0; i < 50; ++i) {
+            stalled.waitForBytesWritten(100);
+            if (stalled.bytesToWrite() == left) break;
+            left = stalled.bytesToWrite();
+        }
+
+        QTcpSocket socket;
+        socket.connectToHost("127.0.0.1", port);
+        CPPUNIT_ASSERT( socket.waitForConnected(5000) );
+        socket.write(request);
+        socket.flush();
+        CPPUNIT_ASSERT( socket.waitForReadyRead(5000) );
+        boost::shared_ptr<ServerResponse> r = protocol.receive(socket);
+        CPPUNIT_ASSERT_EQUAL( ServerResponse::DataSupport, r->type() );
+        socket.disconnectFromHost();
+        stalled.abort();
+    }
+    catch (const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " +  e.toStdString());
+    }
+}
+
+void PelicanServerTest::test_splitRequest()
+{
+    // Use Case:
+    // Keep-alive sessions on a single worker thread. One client sends the
+    // first half of a request; a second client then makes a request.
+    // Expect the second client to be answered without waiting for the
+    // first, and the first to be answered once the rest of its request
+    // arrives.
+    try {
+        Config config;
+        config.setFromString("", "<sessions keepAlive=\"true\" threads=\"1\"/>");
+        PelicanServer server(&config);
+        quint16 port = 2000;
+        server.addProtocol(new PelicanProtocol, port);
+        server.start();
+        while (!server.isReady()) {}
+
+        // Agree version 2, whose requests start with an 8 byte header.
+        PelicanClientProtocol protocol2;
+        QTcpSocket split;
+        split.connectToHost("127.0.0.1", port);
+        CPPUNIT_ASSERT( split.waitForConnected(5000) );
+        split.write(protocol2.serialise(ProtocolVersionRequest(2)));
+        split.flush();
+        CPPUNIT_ASSERT( split.waitForReadyRead(5000) );
+        CPPUNIT_ASSERT_EQUAL( ServerResponse::ProtocolVersion,
+                protocol2.receive(split)->type() );
+        protocol2.setVersion(2);
+
+        QByteArray request = protocol2.serialise(DataSupportRequest());
+        split.write(request.left(4));
+        split.flush();
+        usleep(100000); // Let the worker see the first half.
+
+        PelicanClientProtocol protocol;
+        QTcpSocket socket;
+        socket.connectToHost("127.0.0.1", port);
+        CPPUNIT_ASSERT( socket.waitForConnected(5000) );
+        QTime timer;
+        timer.start();
+        socket.write(protocol.serialise(DataSupportRequest()));
+        socket.flush();
+        CPPUNIT_ASSERT( socket.waitForReadyRead(5000) );
+        CPPUNIT_ASSERT( timer.elapsed() < 500 );
+        CPPUNIT_ASSERT_EQUAL( ServerResponse::DataSupport,
+                protocol.receive(socket)->type() );
+
+        split.write(request.mid(4));
+        split.flush();
+        CPPUNIT_ASSERT( split.waitForReadyRead(5000) );
+        CPPUNIT_ASSERT_EQUAL( ServerResponse::DataSupport,
+                protocol2.receive(split)->type() );
+        socket.disconnectFromHost();
+        split.disconnectFromHost();
+    }
+    catch (const QString& e) {
+        CPPUNIT_FAIL("Unexpected exception: " +  e.toStdString());
+    }
+}
+
 } // namespace pelican
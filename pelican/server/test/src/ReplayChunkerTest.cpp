@@ -0,0 +1,89 @@
+#include "ReplayChunkerTest.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include "ReplayChunker.h"
+#include "StreamRecorder.h"
+#include "pelican/server/LockedData.h"
+#include "pelican/server/LockableStreamData.h"
+#include "pelican/comms/StreamData.h"
+#include "pelican/server/test/ChunkerTester.h"
+
+#include <cstring>
+
+namespace pelican {
+
+using test::ChunkerTester;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ReplayChunkerTest );
+
+/**
+ * @details Constructs a ReplayChunkerTest object.
+ */
+ReplayChunkerTest::ReplayChunkerTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ * @details Destroys the ReplayChunkerTest object.
+ */
+ReplayChunkerTest::~ReplayChunkerTest()
+{
+}
+
+void ReplayChunkerTest::setUp()
+{
+    int argc = 1;
+    char *argv[] = {(char*)"pelican"};
+    _app = new QCoreApplication(argc,argv);
+
+    // Record two chunks of the test stream and one of another.
+    _path = QDir::tempPath() + "/ReplayChunkerTest.rec";
+    StreamRecorder recorder(_path);
+    QHash<QString, QString> versions;
+    recorder.record("test", 1000, versions, "first", 5);
+    recorder.record("other", 2000, versions, "ignored", 7);
+    recorder.record("test", 3000, versions, "second", 6);
+}
+
+void ReplayChunkerTest::tearDown()
+{
+    QFile::remove(_path);
+    delete _app;
+}
+
+void ReplayChunkerTest::test_replay()
+{
+    try {
+    // Use case:
+    // Replay a recording as fast as possible.
+    // Expect:
+    // The chunks of the configured stream written in order, unchanged.
+    ChunkerTester tester("ReplayChunker", 1024,
+            QString("<ReplayChunker file=\"%1\" speed=\"0\">"
+                    "<data type=\"test\"/></ReplayChunker>").arg(_path));
+
+    CPPUNIT_ASSERT_EQUAL( 2, tester.writeRequestCount() );
+    const char* expected[] = { "first", "second" };
+    for (int i = 0; i < 2; ++i) {
+        LockedData ldata = tester.getData();
+        CPPUNIT_ASSERT( ldata.isValid() );
+        LockableStreamData* chunk = static_cast<LockableStreamData*>(ldata.object());
+        chunk->served() = true;
+        StreamData* data = chunk->streamData();
+        CPPUNIT_ASSERT_EQUAL( strlen(expected[i]), data->size() );
+        CPPUNIT_ASSERT( memcmp(data->ptr(), expected[i], data->size()) == 0 );
+    }
+    ReplayChunker* chunker = static_cast<ReplayChunker*>(tester.chunker());
+    CPPUNIT_ASSERT_EQUAL( quint64(2), chunker->replayed() );
+    CPPUNIT_ASSERT_EQUAL( quint64(0), chunker->dropped() );
+    }
+    catch( const QString& msg)
+    {
+        CPPUNIT_FAIL( msg.toStdString() );
+    }
+}
+
+} // namespace pelican
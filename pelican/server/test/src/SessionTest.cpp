@@ -11,6 +11,10 @@
 #include "pelican/comms/ServerRequest.h"
 #include "pelican/comms/ServiceDataRequest.h"
 #include "pelican/comms/StreamDataRequest.h"
+#include "pelican/comms/StreamSubscriptionRequest.h"
+#include "pelican/comms/CreditRequest.h"
+#include "pelican/comms/ReleaseRequest.h"
+#include "pelican/utility/SharedMemorySegment.h"
 #include "pelican/server/test/TestProtocol.h"
 #include "pelican/utility/pelicanTimer.h"
 #include "pelican/utility/Config.h"
@@ -20,12 +24,33 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QDataStream>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QThread>
 #include <iostream>
 
 namespace pelican {
 
 using test::TestProtocol;
 
+/**
+ * @details
+ * Writes a single chunk to a stream buffer after a delay.
+ */
+class SessionTestWriter : public QThread
+{
+    public:
+        SessionTestWriter(StreamDataBuffer* buffer) : _buffer(buffer) {}
+
+    protected:
+        void run() {
+            msleep(50);
+            WritableData writableData = _buffer->getWritable(10);
+            writableData.data()->setId("delayed");
+        }
+
+    private:
+        StreamDataBuffer* _buffer;
+};
+
 CPPUNIT_TEST_SUITE_REGISTRATION( SessionTest );
 // class SessionTest
 SessionTest::SessionTest()
@@ -357,6 +382,126 @@ void SessionTest::test_streamDataBufferFull()
     // TODO finish test for when stream data buffer is full.
 }
 
+/**
+ * @details
+ * Use case:
+ * Request StreamData for a stream with no data, with data written by
+ * another thread while the session waits.
+ *
+ * Expect:
+ * The session to wake and return the data well before the timeout.
+ */
+void SessionTest::test_streamDataWakeup()
+{
+    // The lock-free buffer activates data in the writing thread, so no
+    // event loop is needed here.
+    QString stream1("stream1");
+    StreamDataBuffer* streamBuffer = new StreamDataBuffer(stream1, 1024, 64,
+            StreamDataBuffer::Slab, StreamDataBuffer::LockFree);
+    _dataManager->setStreamDataBuffer(stream1, streamBuffer);
+
+    DataSpec requirements;
+    requirements.addStreamData(stream1);
+    StreamDataRequest request;
+    request.addDataOption(requirements);
+
+    SessionTestWriter writer(streamBuffer);
+    QTime timer;
+    timer.start();
+    writer.start();
+    QList<LockedData> dataList;
+    CPPUNIT_ASSERT_NO_THROW(dataList = _session->processStreamDataRequest(request, 5000));
+    CPPUNIT_ASSERT( timer.elapsed() < 2000 );
+    writer.wait();
+    CPPUNIT_ASSERT_EQUAL(1, dataList.size());
+    CPPUNIT_ASSERT( dataList[0].isValid() );
+    CPPUNIT_ASSERT_EQUAL(QString("delayed"),
+            static_cast<LockableStreamData*>(dataList[0].object())->data()->id());
+}
+
+void SessionTest::test_subscription()
+{
+    QString stream1("stream1");
+    StreamDataBuffer* streambuffer = new StreamDataBuffer(stream1);
+    _dataManager->setStreamDataBuffer( stream1, streambuffer );
+    _injectData(streambuffer, "version1");
+    _injectData(streambuffer, "version2");
+
+    DataSpec requirements;
+    requirements.addStreamData(stream1);
+    StreamSubscriptionRequest request(1);
+    request.addDataOption(requirements);
+
+    // Nothing is pushed before subscribing, or in reply to it.
+    CPPUNIT_ASSERT( ! _session->pushStreamData(*_device) );
+    _session->processRequest(request, *_device);
+    CPPUNIT_ASSERT( _session->hasSubscription() );
+    CPPUNIT_ASSERT_EQUAL( (quint32)1, _session->credits() );
+    CPPUNIT_ASSERT_EQUAL( 0, _proto->lastStreamData().size() );
+
+    // Pushes one chunk per credit.
+    CPPUNIT_ASSERT( _session->pushStreamData(*_device) );
+    CPPUNIT_ASSERT_EQUAL( 1, _proto->lastStreamData().size() );
+    CPPUNIT_ASSERT_EQUAL( (quint32)0, _session->credits() );
+    CPPUNIT_ASSERT( ! _session->pushStreamData(*_device) );
+    _app->processEvents();
+
+    _session->processRequest(CreditRequest(2), *_device);
+    CPPUNIT_ASSERT_EQUAL( (quint32)2, _session->credits() );
+    CPPUNIT_ASSERT( _session->pushStreamData(*_device) );
+    _app->processEvents();
+    CPPUNIT_ASSERT_EQUAL( (quint32)1, _session->credits() );
+
+    // No more data to push.
+    CPPUNIT_ASSERT( ! _session->pushStreamData(*_device) );
+    CPPUNIT_ASSERT_EQUAL( (quint32)1, _session->credits() );
+}
+
+void SessionTest::test_release()
+{
+    // Use Case:
+    // Stream data sent by reference from a shared memory buffer of two slots
+    // Expect the data to stay locked until the client releases it
+    QString stream1("stream1");
+    StreamDataBuffer* streambuffer = new StreamDataBuffer(stream1, 20, 10,
+            StreamDataBuffer::Shared);
+    _dataManager->setStreamDataBuffer( stream1, streambuffer );
+    CPPUNIT_ASSERT( ! streambuffer->sharedMemoryName().isEmpty() );
+    _injectData(streambuffer, "version1");
+    _injectData(streambuffer, "version2");
+    _proto->setSendsReferences(true);
+
+    DataSpec requirements;
+    requirements.addStreamData(stream1);
+    StreamDataRequest request;
+    request.addDataOption(requirements);
+    for (int i = 1; i <= 2; ++i) {
+        _session->processRequest(request, *_device);
+        _app->processEvents();
+        CPPUNIT_ASSERT_EQUAL( i, _session->held() );
+    }
+    StreamData* sd = _proto->lastStreamData()[0];
+    SharedMemorySegment* segment = SharedMemorySegment::find(sd->ptr());
+    CPPUNIT_ASSERT( segment != 0 );
+    CPPUNIT_ASSERT( segment->name() == streambuffer->sharedMemoryName() );
+    {
+        // Both slots are held, so nothing can be written.
+        WritableData data = streambuffer->getWritable(10);
+        CPPUNIT_ASSERT( ! data.isValid() );
+    }
+
+    _session->processRequest(ReleaseRequest(1), *_device);
+    _app->processEvents();
+    CPPUNIT_ASSERT_EQUAL( 1, _session->held() );
+    {
+        WritableData data = streambuffer->getWritable(10);
+        CPPUNIT_ASSERT( data.isValid() );
+    }
+    _session->processRequest(ReleaseRequest(5), *_device);
+    CPPUNIT_ASSERT_EQUAL( 0, _session->held() );
+    _app->processEvents();
+}
+
 /**
  * @details
  * Injects the specified amount of data with the given ID into the
@@ -6,9 +6,14 @@
 #include "pelican/server/WritableData.h"
 #include "pelican/server/LockedData.h"
 #include "pelican/server/LockableStreamData.h"
+#include "pelican/server/StreamSpillFile.h"
+#include "pelican/data/DataSpec.h"
 #include "pelican/utility/Config.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
 
 namespace pelican {
 
@@ -191,4 +196,500 @@ void StreamDataBufferTest::test_getWritableStreams()
     std::cout << "#############################################" << std::endl;
 }
 
+
+void StreamDataBufferTest::test_slabAllocation()
+{
+    {
+        // Use case:
+        // Slab buffer smaller than a single chunk.
+        // Expect: construction to throw.
+        CPPUNIT_ASSERT_THROW(StreamDataBuffer("test", 8, 16,
+                StreamDataBuffer::Slab), QString);
+    }
+    {
+        // Use case:
+        // Slab buffer with room for three chunks.
+        // Expect: all slots pre-allocated, contiguous and recycled in order,
+        // with the oldest waiting chunk reused once the slots run out.
+        size_t chunkSize = 16;
+        StreamDataBuffer buffer("test", 3 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        CPPUNIT_ASSERT_EQUAL(StreamDataBuffer::Slab, buffer.allocation());
+        CPPUNIT_ASSERT_EQUAL(3, buffer._data.size());
+        CPPUNIT_ASSERT_EQUAL(3, buffer._freeCount);
+
+        // Chunks larger than a slot can not be served.
+        CPPUNIT_ASSERT( ! buffer.getWritable(chunkSize + 1).isValid() );
+
+        char* ptrs[3];
+        for (int i = 0; i < 3; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize / 2);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            ptrs[i] = (char*)dataChunk.data()->data()->ptr();
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT(ptrs[1] == ptrs[0] + chunkSize);
+        CPPUNIT_ASSERT(ptrs[2] == ptrs[1] + chunkSize);
+        CPPUNIT_ASSERT_EQUAL(3, buffer._serveQueue.size());
+        CPPUNIT_ASSERT_EQUAL(0, buffer._freeCount);
+
+        // Buffer full: the oldest waiting chunk is overwritten.
+        {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            CPPUNIT_ASSERT(dataChunk.data()->data()->ptr() == ptrs[0]);
+            CPPUNIT_ASSERT_EQUAL(2, buffer._serveQueue.size());
+        }
+        CPPUNIT_ASSERT_EQUAL(3, buffer._serveQueue.size());
+
+        // Served chunks return to the free ring.
+        {
+            LockedData data("test");
+            buffer.getNext(data);
+            CPPUNIT_ASSERT( data.isValid() );
+            static_cast<LockableStreamData*>(data.object())->served() = true;
+        }
+        CPPUNIT_ASSERT_EQUAL(2, buffer._serveQueue.size());
+        CPPUNIT_ASSERT_EQUAL(1, buffer._freeCount);
+        CPPUNIT_ASSERT_EQUAL(0, buffer._emptyQueue.size());
+        {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT(dataChunk.data()->data()->ptr() == ptrs[1]);
+        }
+        CPPUNIT_ASSERT_EQUAL(0, buffer._freeCount);
+    }
+}
+
+
+void StreamDataBufferTest::test_lockFreeServeQueue()
+{
+    {
+        // Use case:
+        // Lock-free serve queue requested with dynamic allocation.
+        // Expect: construction to throw.
+        CPPUNIT_ASSERT_THROW(StreamDataBuffer("test", 64, 16,
+                StreamDataBuffer::Dynamic, StreamDataBuffer::LockFree), QString);
+    }
+    {
+        // Use case:
+        // Chunks written to and served from a lock-free buffer.
+        // Expect: chunks served in order, unserved chunks served again
+        // first, and served chunks returned to the free slots.
+        size_t chunkSize = 16;
+        StreamDataBuffer buffer("test", 3 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab, StreamDataBuffer::LockFree);
+        buffer.setDataManager(_dataManager);
+        CPPUNIT_ASSERT_EQUAL(StreamDataBuffer::LockFree, buffer.serveQueue());
+
+        void* ptrs[2];
+        for (int i = 0; i < 2; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            ptrs[i] = dataChunk.data()->data()->ptr();
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        {
+            // Not served: served again before the next chunk.
+            LockedData data("test");
+            buffer.getNext(data);
+            CPPUNIT_ASSERT( data.isValid() );
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[0] );
+        }
+        CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        for (int i = 0; i < 2; ++i) {
+            LockedData data("test");
+            buffer.getNext(data);
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[i] );
+            static_cast<LockableStreamData*>(data.object())->served() = true;
+        }
+        CPPUNIT_ASSERT_EQUAL(0, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(3, buffer._lockFreeSlots->size());
+
+        // Use case:
+        // Blocking getNext() on an empty buffer.
+        // Expect: an invalid object after the timeout.
+        QTime timer;
+        timer.start();
+        LockedData data("test");
+        buffer.getNext(data, 20);
+        CPPUNIT_ASSERT( ! data.isValid() );
+        CPPUNIT_ASSERT( timer.elapsed() >= 15 );
+    }
+}
+
+
+void StreamDataBufferTest::test_broadcast()
+{
+    size_t chunkSize = 16;
+    {
+        // Use case:
+        // Broadcast requested with the lock-free serve queue.
+        // Expect: to throw.
+        StreamDataBuffer buffer("test", 3 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab, StreamDataBuffer::LockFree);
+        CPPUNIT_ASSERT_THROW(buffer.setBroadcast(), QString);
+    }
+    {
+        // Use case:
+        // Two consumers reading from a broadcast buffer.
+        // Expect: each consumer served every chunk, and chunks recycled
+        // only once both have read them.
+        StreamDataBuffer buffer("test", 3 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setBroadcast(StreamDataBuffer::DropOldest);
+        buffer.addConsumer("science");
+        buffer.addConsumer("monitor");
+        CPPUNIT_ASSERT_EQUAL(2, buffer.consumers().size());
+
+        void* ptrs[3];
+        for (int i = 0; i < 2; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            ptrs[i] = dataChunk.data()->data()->ptr();
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        for (int i = 0; i < 2; ++i) {
+            LockedData data("test");
+            buffer.getNext(data, "science");
+            CPPUNIT_ASSERT( data.isValid() );
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[i] );
+        }
+        {
+            LockedData data("test");
+            buffer.getNext(data, "science");
+            CPPUNIT_ASSERT( ! data.isValid() );
+        }
+        CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(0, buffer.backlog("science"));
+        CPPUNIT_ASSERT_EQUAL(2, buffer.backlog("monitor"));
+        {
+            LockedData data("test");
+            buffer.getNext(data, "monitor");
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[0] );
+
+            // Still locked by the monitor.
+            CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        }
+        CPPUNIT_ASSERT_EQUAL(1, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(2, buffer._freeCount);
+
+        // Use case:
+        // Buffer full of chunks the monitor has not read.
+        // Expect: the oldest is recycled, and skipped by the monitor.
+        for (int i = 0; i < 3; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            ptrs[i] = dataChunk.data()->data()->ptr();
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT_EQUAL(3, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(3, buffer.backlog("science"));
+        CPPUNIT_ASSERT_EQUAL(3, buffer.backlog("monitor"));
+        {
+            LockedData data("test");
+            buffer.getNext(data, "monitor");
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[0] );
+        }
+
+        // Use case:
+        // Consumer removed.
+        // Expect: chunks only kept for it are recycled.
+        buffer.removeConsumer("science");
+        CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(1, buffer._freeCount);
+
+        // Use case:
+        // A new consumer asks for data.
+        // Expect: served only the chunks activated after it first asked.
+        {
+            LockedData data("test");
+            buffer.getNext(data, "late");
+            CPPUNIT_ASSERT( ! data.isValid() );
+        }
+        {
+            int i = 3;
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            ptrs[0] = dataChunk.data()->data()->ptr();
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        {
+            LockedData data("test");
+            buffer.getNext(data, "late");
+            CPPUNIT_ASSERT( static_cast<LockableStreamData*>(data.object())->data()->ptr() == ptrs[0] );
+        }
+    }
+    {
+        // Use case:
+        // Wait policy with the buffer full of unread chunks.
+        // Expect: no writable data until the consumer has read a chunk.
+        StreamDataBuffer buffer("test", 2 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setBroadcast(StreamDataBuffer::Wait);
+        buffer.addConsumer("science");
+        for (int i = 0; i < 2; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT( ! buffer.getWritable(chunkSize).isValid() );
+        {
+            LockedData data("test");
+            buffer.getNext(data, "science");
+            CPPUNIT_ASSERT( data.isValid() );
+        }
+        CPPUNIT_ASSERT( buffer.getWritable(chunkSize).isValid() );
+    }
+    {
+        // Use case:
+        // Consumer further behind than the maximum lag.
+        // Expect: moved forward as new chunks arrive.
+        StreamDataBuffer buffer("test", 4 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setBroadcast(StreamDataBuffer::Wait, 2);
+        buffer.addConsumer("science");
+        for (int i = 0; i < 4; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT_EQUAL(2, buffer.backlog("science"));
+        CPPUNIT_ASSERT_EQUAL(2, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(2, buffer._freeCount);
+    }
+}
+
+void StreamDataBufferTest::test_broadcastUnread()
+{
+    size_t chunkSize = 16;
+    StreamDataBuffer* a = new StreamDataBuffer("a", 2 * chunkSize, chunkSize,
+            StreamDataBuffer::Slab);
+    StreamDataBuffer* b = new StreamDataBuffer("b", 2 * chunkSize, chunkSize,
+            StreamDataBuffer::Slab);
+    a->setBroadcast();
+    b->setBroadcast();
+    a->addConsumer("science");
+    b->addConsumer("science");
+    _dataManager->setStreamDataBuffer("a", a); // Deleted by the manager.
+    _dataManager->setStreamDataBuffer("b", b);
+
+    void* ptr = 0;
+    {
+        WritableData dataChunk = a->getWritable(chunkSize);
+        CPPUNIT_ASSERT( dataChunk.isValid() );
+        ptr = dataChunk.data()->data()->ptr();
+    }
+    {
+        // Use case:
+        // A request for streams a and b, with only a chunk of a available.
+        // Expect: the request to fail, and the chunk of a kept for the
+        // consumer.
+        DataSpec req;
+        req.addStreamData("a");
+        req.addStreamData("b");
+        CPPUNIT_ASSERT( _dataManager->getDataRequirements(req, "science").isEmpty() );
+        CPPUNIT_ASSERT_EQUAL(1, a->backlog("science"));
+        CPPUNIT_ASSERT_EQUAL(1, a->numberOfActiveChunks());
+
+        // Use case:
+        // A request for stream a with service data the chunk does not have.
+        // Expect: no data, and the chunk kept for the consumer.
+        QSet<QString> service;
+        service.insert("service");
+        CPPUNIT_ASSERT( ! _dataManager->getNext("a", service, "science").isValid() );
+        CPPUNIT_ASSERT_EQUAL(1, a->backlog("science"));
+
+        // Use case:
+        // The same request once a chunk of b is available.
+        // Expect: the chunk of a served with it.
+        {
+            WritableData dataChunk = b->getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+        }
+        QList<LockedData> data = _dataManager->getDataRequirements(req, "science");
+        CPPUNIT_ASSERT_EQUAL(2, data.size());
+        foreach (const LockedData& d, data) {
+            if (d.name() == "a")
+                CPPUNIT_ASSERT( static_cast<LockableStreamData*>(
+                        d.object())->data()->ptr() == ptr );
+        }
+        CPPUNIT_ASSERT_EQUAL(0, a->backlog("science"));
+        CPPUNIT_ASSERT_EQUAL(0, b->backlog("science"));
+    }
+    // Read by the only consumer, so recycled.
+    CPPUNIT_ASSERT_EQUAL(0, a->numberOfActiveChunks());
+    CPPUNIT_ASSERT_EQUAL(0, b->numberOfActiveChunks());
+}
+
+void StreamDataBufferTest::test_spill()
+{
+    size_t chunkSize = 16;
+    QString path = QDir::tempPath() + "/StreamDataBufferTest.spill";
+    {
+        // Use case:
+        // Spill file requested with the lock-free serve queue.
+        // Expect: to throw.
+        StreamDataBuffer buffer("test", 2 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab, StreamDataBuffer::LockFree);
+        CPPUNIT_ASSERT_THROW(buffer.setSpillFile(path, 2 * chunkSize), QString);
+    }
+    {
+        // Use case:
+        // More chunks written than fit in the slab.
+        // Expect: the overflow to go to the spill file, and every chunk
+        // to be served in the order written.
+        StreamDataBuffer buffer("test", 2 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setSpillFile(path, 3 * chunkSize);
+        const StreamSpillFile* spill = buffer.spillFile();
+        CPPUNIT_ASSERT( QFile::exists(path) );
+        CPPUNIT_ASSERT_EQUAL(3, spill->slots());
+
+        for (int i = 0; i < 6; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            dataChunk.write(&i, sizeof(int), 0);
+        }
+        CPPUNIT_ASSERT_EQUAL(5, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(quint64(3), spill->spilled());
+        CPPUNIT_ASSERT_EQUAL(quint64(3 * chunkSize), spill->spilledBytes());
+        CPPUNIT_ASSERT_EQUAL(quint64(1), spill->rejected());
+        CPPUNIT_ASSERT_EQUAL(3, spill->inUse());
+
+        // The oldest chunk (0) was evicted when both tiers were full.
+        for (int i = 1; i < 6; ++i) {
+            LockedData data("test");
+            buffer.getNext(data);
+            CPPUNIT_ASSERT( data.isValid() );
+            LockableStreamData* d = static_cast<LockableStreamData*>(data.object());
+            d->served() = true;
+            CPPUNIT_ASSERT_EQUAL(i, *reinterpret_cast<int*>(d->data()->ptr()));
+        }
+        CPPUNIT_ASSERT_EQUAL(0, buffer.numberOfActiveChunks());
+        CPPUNIT_ASSERT_EQUAL(0, spill->inUse());
+        CPPUNIT_ASSERT_EQUAL(3, spill->highWater());
+        CPPUNIT_ASSERT_EQUAL(2, buffer._freeCount);
+    }
+    CPPUNIT_ASSERT( ! QFile::exists(path) );
+}
+
+void StreamDataBufferTest::test_metrics()
+{
+    // Use case:
+    // Three chunks written to a slab of two, and two served.
+    // Expect: the oldest chunk to be counted as dropped, and the chunks
+    // in use to return to zero once served.
+    size_t chunkSize = 16;
+    StreamDataBuffer buffer("test", 2 * chunkSize, chunkSize,
+            StreamDataBuffer::Slab);
+    buffer.setDataManager(_dataManager);
+    for (int i = 0; i < 3; ++i) {
+        WritableData dataChunk = buffer.getWritable(chunkSize);
+        CPPUNIT_ASSERT( dataChunk.isValid() );
+        dataChunk.write(&i, sizeof(int), 0);
+    }
+
+    QMap<QString, double> values;
+    buffer.metrics(values);
+    QString label("{stream=\"test\"}");
+    CPPUNIT_ASSERT_EQUAL(3.0, values["pelican_stream_chunks_written_total" + label]);
+    CPPUNIT_ASSERT_EQUAL(48.0, values["pelican_stream_bytes_written_total" + label]);
+    CPPUNIT_ASSERT_EQUAL(1.0, values["pelican_stream_chunks_dropped_total" + label]);
+    CPPUNIT_ASSERT_EQUAL(2.0, values["pelican_stream_buffer_chunks_in_use" + label]);
+    CPPUNIT_ASSERT_EQUAL(2.0, values["pelican_stream_buffer_chunks_waiting" + label]);
+    CPPUNIT_ASSERT_EQUAL(3.0, values["pelican_stream_writable_calls_total" + label]);
+
+    for (int i = 0; i < 2; ++i) {
+        LockedData data("test");
+        buffer.getNext(data);
+        CPPUNIT_ASSERT( data.isValid() );
+        static_cast<LockableStreamData*>(data.object())->served() = true;
+    }
+    values.clear();
+    buffer.metrics(values);
+    CPPUNIT_ASSERT_EQUAL(2.0, values["pelican_stream_chunks_served_total" + label]);
+    CPPUNIT_ASSERT_EQUAL(32.0, values["pelican_stream_bytes_served_total" + label]);
+    CPPUNIT_ASSERT_EQUAL(0.0, values["pelican_stream_buffer_chunks_in_use" + label]);
+    CPPUNIT_ASSERT_EQUAL(2.0, values["pelican_stream_buffer_chunks_high_water" + label]);
+}
+
+void StreamDataBufferTest::test_ordered()
+{
+    size_t chunkSize = 16;
+    QString label("{stream=\"test\"}");
+    {
+        // Use case:
+        // Chunks of four packets activated out of sequence order, with a
+        // window of two, then a chunk after later ones were served, and
+        // one without a sequence number.
+        // Expect: the chunks to be held until the window is full or they
+        // follow on from those served, and then served in order; the
+        // late and unnumbered chunks to be served at once.
+        StreamDataBuffer buffer("test", 8 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setOrdered(2, 10000);
+        CPPUNIT_ASSERT_EQUAL(2, buffer.orderWindow());
+
+        int sequences[] = { 4, 0, 12, 8, 2, -1 };
+        int waiting[] = { 0, 0, 2, 4, 5, 6 };
+        for (int i = 0; i < 6; ++i) {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            dataChunk.write(&sequences[i], sizeof(int), 0);
+            if (sequences[i] >= 0) {
+                PacketStats& stats = static_cast<LockableStreamData*>(
+                        dataChunk.data())->streamData()->packetStats();
+                stats.setSequence(sequences[i]);
+                stats.setPackets(4);
+            }
+            if (i > 0)
+                CPPUNIT_ASSERT_EQUAL(waiting[i - 1], buffer.numberOfActiveChunks());
+        }
+        CPPUNIT_ASSERT_EQUAL(waiting[5], buffer.numberOfActiveChunks());
+
+        int expected[] = { 0, 4, 8, 12, 2, -1 };
+        for (int i = 0; i < 6; ++i) {
+            LockedData data("test");
+            buffer.getNext(data);
+            CPPUNIT_ASSERT( data.isValid() );
+            LockableStreamData* d = static_cast<LockableStreamData*>(data.object());
+            d->served() = true;
+            CPPUNIT_ASSERT_EQUAL(expected[i], *reinterpret_cast<int*>(d->data()->ptr()));
+        }
+
+        QMap<QString, double> values;
+        buffer.metrics(values);
+        CPPUNIT_ASSERT_EQUAL(3.0, values["pelican_stream_chunks_reordered_total" + label]);
+        CPPUNIT_ASSERT_EQUAL(1.0, values["pelican_stream_chunks_late_total" + label]);
+    }
+    {
+        // Use case:
+        // A chunk held waiting for the chunks before it, which never come.
+        // Expect: the chunk to be served once it has been held for longer
+        // than the timeout.
+        StreamDataBuffer buffer("test", 4 * chunkSize, chunkSize,
+                StreamDataBuffer::Slab);
+        buffer.setDataManager(_dataManager);
+        buffer.setOrdered(4, 50);
+        {
+            WritableData dataChunk = buffer.getWritable(chunkSize);
+            CPPUNIT_ASSERT( dataChunk.isValid() );
+            static_cast<LockableStreamData*>(dataChunk.data())->streamData()
+                    ->packetStats().setPackets(4);
+        }
+        LockedData data("test");
+        buffer.getNext(data);
+        CPPUNIT_ASSERT( ! data.isValid() );
+        QTime timer;
+        timer.start();
+        buffer.getNext(data, 1000);
+        CPPUNIT_ASSERT( data.isValid() );
+        CPPUNIT_ASSERT( timer.elapsed() < 1000 );
+        static_cast<LockableStreamData*>(data.object())->served() = true;
+    }
+}
+
 } // namespace pelican
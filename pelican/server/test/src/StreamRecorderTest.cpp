@@ -0,0 +1,89 @@
+#include "pelican/server/test/StreamRecorderTest.h"
+#include "pelican/server/StreamRecorder.h"
+#include "pelican/server/StreamRecording.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <cstring>
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( StreamRecorderTest );
+// class StreamRecorderTest
+StreamRecorderTest::StreamRecorderTest()
+    : CppUnit::TestFixture()
+{
+}
+
+StreamRecorderTest::~StreamRecorderTest()
+{
+}
+
+void StreamRecorderTest::setUp()
+{
+    _path = QDir::tempPath() + "/StreamRecorderTest.rec";
+}
+
+void StreamRecorderTest::tearDown()
+{
+    QFile::remove(_path);
+}
+
+void StreamRecorderTest::test_record()
+{
+    // Use Case:
+    // Chunks of two streams recorded and the recording closed.
+    // Expect: every record read back through the index, unchanged.
+    QHash<QString, QString> versions;
+    versions.insert("calibration", "3");
+    {
+        StreamRecorder recorder(_path);
+        recorder.record("a", 1000, versions, "hello", 5);
+        recorder.record("b", 2500, QHash<QString, QString>(), "", 0);
+        recorder.record("a", 4000, versions, "world!", 6);
+        CPPUNIT_ASSERT_EQUAL(quint64(3), recorder.count());
+        CPPUNIT_ASSERT_EQUAL(quint64(11), recorder.bytes());
+    }
+    StreamRecording recording(_path);
+    CPPUNIT_ASSERT_EQUAL(3, recording.count());
+
+    StreamRecording::Record r = recording.record(0);
+    CPPUNIT_ASSERT_EQUAL(QString("a"), r.stream);
+    CPPUNIT_ASSERT_EQUAL(qint64(1000), r.time);
+    CPPUNIT_ASSERT_EQUAL(QString("3"), r.versions.value("calibration"));
+    CPPUNIT_ASSERT_EQUAL(quint64(5), r.size);
+    CPPUNIT_ASSERT( memcmp(r.data, "hello", 5) == 0 );
+
+    r = recording.record(1);
+    CPPUNIT_ASSERT_EQUAL(QString("b"), r.stream);
+    CPPUNIT_ASSERT_EQUAL(quint64(0), r.size);
+    CPPUNIT_ASSERT( r.versions.isEmpty() );
+
+    r = recording.record(2);
+    CPPUNIT_ASSERT_EQUAL(qint64(4000), recording.time(2));
+    CPPUNIT_ASSERT( memcmp(r.data, "world!", 6) == 0 );
+    CPPUNIT_ASSERT_THROW(recording.record(3), QString);
+}
+
+void StreamRecorderTest::test_unclosed()
+{
+    // Use Case:
+    // Recording cut short in the middle of a record (e.g. server killed).
+    // Expect: the complete records found without the index.
+    {
+        StreamRecorder recorder(_path);
+        recorder.record("a", 1000, QHash<QString, QString>(), "hello", 5);
+        recorder.record("a", 2000, QHash<QString, QString>(), "world", 5);
+    }
+    QFile file(_path);
+    CPPUNIT_ASSERT( file.open(QIODevice::ReadWrite) );
+    qint64 end = file.size();
+    CPPUNIT_ASSERT( file.resize(end - 12 - 4 - 2 * 16 - 2) );
+    file.close();
+
+    StreamRecording recording(_path);
+    CPPUNIT_ASSERT_EQUAL(1, recording.count());
+    CPPUNIT_ASSERT_EQUAL(qint64(1000), recording.time(0));
+}
+
+} // namespace pelican
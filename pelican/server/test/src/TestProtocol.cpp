@@ -11,7 +11,7 @@ namespace test {
 
 // class TestProtocol
 TestProtocol::TestProtocol(const QString& id, ServerRequest::Request request)
-    : AbstractProtocol(), _id(id), _request(request)
+    : AbstractProtocol(), _id(id), _request(request), _sendsReferences(false)
 {
 }
 
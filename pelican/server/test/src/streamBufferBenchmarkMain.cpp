@@ -0,0 +1,152 @@
+#include "pelican/server/StreamDataBuffer.h"
+#include "pelican/server/DataManager.h"
+#include "pelican/server/LockableStreamData.h"
+#include "pelican/server/LockedData.h"
+#include "pelican/server/WritableData.h"
+#include "pelican/utility/Config.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <QtCore/QList>
+#include <iostream>
+#include <cstdlib>
+
+using namespace pelican;
+
+/*
+ * Contention benchmark for the StreamDataBuffer serve queues.
+ *
+ * A number of producer threads (chunkers) write chunks into a single
+ * buffer while a number of consumer threads (sessions) take them off the
+ * serve queue: with dynamic allocation and the mutex protected queue (the
+ * default), and with a slab buffer and each of the serve queues.
+ */
+
+static volatile int producersDone = 0;
+
+class Producer : public QThread
+{
+    public:
+        Producer(StreamDataBuffer* buffer, int chunks, size_t size)
+            : written(0), _buffer(buffer), _chunks(chunks), _size(size) {}
+        int written;
+
+    protected:
+        void run() {
+            for (int i = 0; i < _chunks; ++i) {
+                WritableData data = _buffer->getWritable(_size);
+                if (data.isValid()) {
+                    data.write(&i, sizeof(int), 0);
+                    ++written;
+                }
+            }
+        }
+
+    private:
+        StreamDataBuffer* _buffer;
+        int _chunks;
+        size_t _size;
+};
+
+class Consumer : public QThread
+{
+    public:
+        Consumer(StreamDataBuffer* buffer) : served(0), _buffer(buffer) {}
+        int served;
+
+    protected:
+        void run() {
+            forever {
+                bool done = producersDone;
+                LockedData data("bench");
+                _buffer->getNext(data, 10);
+                if (data.isValid()) {
+                    static_cast<LockableStreamData*>(data.object())->served() = true;
+                    ++served;
+                }
+                else if (done) {
+                    break;
+                }
+            }
+        }
+
+    private:
+        StreamDataBuffer* _buffer;
+};
+
+static void run(QCoreApplication& app, StreamDataBuffer::Allocation allocation,
+        StreamDataBuffer::ServeQueue serveQueue,
+        int producers, int consumers, int chunks, size_t chunkSize)
+{
+    Config config;
+    DataManager manager(&config);
+    StreamDataBuffer buffer("bench", 256 * chunkSize, chunkSize,
+            allocation, serveQueue);
+    buffer.setDataManager(&manager);
+
+    QList<Producer*> producerThreads;
+    QList<Consumer*> consumerThreads;
+    for (int i = 0; i < producers; ++i)
+        producerThreads.append(new Producer(&buffer, chunks, chunkSize));
+    for (int i = 0; i < consumers; ++i)
+        consumerThreads.append(new Consumer(&buffer));
+
+    producersDone = 0;
+    QTime timer;
+    timer.start();
+    foreach (Consumer* c, consumerThreads) c->start();
+    foreach (Producer* p, producerThreads) p->start();
+
+    // The mutex protected queue is fed through queued signals, which need
+    // the buffer's event loop to be running.
+    foreach (Producer* p, producerThreads) {
+        while (!p->wait(1)) app.processEvents();
+    }
+    app.processEvents();
+    producersDone = 1;
+    foreach (Consumer* c, consumerThreads) {
+        while (!c->wait(1)) app.processEvents();
+    }
+    int elapsed = timer.elapsed();
+
+    int written = 0, served = 0;
+    foreach (Producer* p, producerThreads) { written += p->written; delete p; }
+    foreach (Consumer* c, consumerThreads) { served += c->served; delete c; }
+
+    std::cout << ((allocation == StreamDataBuffer::Dynamic) ? "dynamic " : "slab    ")
+              << ((serveQueue == StreamDataBuffer::LockFree) ? "lock-free" : "locking  ")
+              << ": written " << written << ", served " << served
+              << " in " << elapsed << " ms ("
+              << (elapsed ? (qint64)served * 1000 / elapsed : 0)
+              << " chunks/s)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        QCoreApplication app(argc, argv);
+
+        if (argc != 5) {
+            std::cerr << "Usage: streamBufferBenchmark <producers> <consumers> "
+                    "<chunks per producer> <chunk size, bytes>" << std::endl;
+            return 1;
+        }
+        int producers = atoi(argv[1]);
+        int consumers = atoi(argv[2]);
+        int chunks = atoi(argv[3]);
+        size_t chunkSize = atoi(argv[4]);
+
+        run(app, StreamDataBuffer::Dynamic, StreamDataBuffer::Locking,
+                producers, consumers, chunks, chunkSize);
+        run(app, StreamDataBuffer::Slab, StreamDataBuffer::Locking,
+                producers, consumers, chunks, chunkSize);
+        run(app, StreamDataBuffer::Slab, StreamDataBuffer::LockFree,
+                producers, consumers, chunks, chunkSize);
+    }
+    catch (const QString& err) {
+        std::cerr << "Error: " << err.toStdString() << std::endl;
+        return 1;
+    }
+    return 0;
+}
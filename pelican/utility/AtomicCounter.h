@@ -0,0 +1,80 @@
+#ifndef ATOMICCOUNTER_H
+#define ATOMICCOUNTER_H
+
+#include <QtCore/QtGlobal>
+#include <time.h>
+
+/**
+ * @file AtomicCounter.h
+ */
+
+namespace pelican {
+
+/**
+ * @class AtomicCounter
+ *
+ * @brief
+ *    A 64-bit counter that can be updated and read from any thread without
+ *    a lock.
+ *
+ * @details
+ *    Used for statistics kept on the data paths of the server, e.g.
+ *
+ * @code
+ * quint64 start = AtomicCounter::now();
+ * ...
+ * _chunks.add();
+ * _waitTime.add(AtomicCounter::now() - start);
+ * _maxWaitTime.max(AtomicCounter::now() - start);
+ * @endcode
+ *
+ *    Each update is a single atomic instruction (or a compare-and-swap loop
+ *    for max()), so counters shared between threads stay exact.
+ */
+class AtomicCounter
+{
+    public:
+        /// Constructs a counter with the given value.
+        AtomicCounter(quint64 value = 0) : _value(value) {}
+
+        /// Adds to the counter, returning the new value.
+        quint64 add(quint64 n = 1) { return __sync_add_and_fetch(&_value, n); }
+
+        /// Subtracts from the counter, returning the new value.
+        quint64 sub(quint64 n = 1) { return __sync_sub_and_fetch(&_value, n); }
+
+        /// Raises the counter to the given value, if it is lower.
+        void max(quint64 v) {
+            quint64 current = value();
+            while (v > current) {
+                quint64 seen = __sync_val_compare_and_swap(&_value, current, v);
+                if (seen == current) break;
+                current = seen;
+            }
+        }
+
+        /// Sets the counter.
+        void set(quint64 v) { __sync_lock_test_and_set(&_value, v); }
+
+        /// Returns the value of the counter.
+        quint64 value() const {
+            return __sync_fetch_and_add(const_cast<volatile quint64*>(&_value), 0);
+        }
+
+        /// Returns a monotonic time in nanoseconds, for timing intervals.
+        static quint64 now() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (quint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+    private:
+        AtomicCounter(const AtomicCounter&); // Disallow copying.
+
+    private:
+        volatile quint64 _value;
+};
+
+} // namespace pelican
+
+#endif // ATOMICCOUNTER_H
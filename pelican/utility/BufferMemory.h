@@ -0,0 +1,159 @@
+#ifndef BUFFERMEMORY_H
+#define BUFFERMEMORY_H
+
+#include <QtCore/QString>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * @file BufferMemory.h
+ */
+
+namespace pelican {
+
+class ConfigNode;
+
+/**
+ * @class BufferMemory
+ *
+ * @brief
+ *    How the memory of a data buffer is allocated.
+ *
+ * @details
+ *    By default buffer memory comes from calloc(). A BufferMemory can ask
+ *    instead for:
+ *    - huge pages of 2 MiB or 1 GiB, to cut TLB misses on large buffers.
+ *      If the kernel has none reserved (see /proc/sys/vm/nr_hugepages) the
+ *      memory falls back to normal pages marked for transparent huge pages;
+ *    - the memory to be locked into RAM, so that it is never swapped out.
+ *      If RLIMIT_MEMLOCK does not allow it the memory is left unlocked;
+ *    - the memory to be bound to a NUMA node, so that it is local to the
+ *      threads that fill it.
+ *
+ *    Fallbacks are reported (once) on stderr rather than thrown, so that a
+ *    configuration tuned for one machine still runs on another.
+ *
+ *    Memory from allocate() is zero filled, and is returned with release().
+ *    Memory allocated elsewhere (e.g. a SharedMemorySegment) can be bound
+ *    and locked with place().
+ *
+ *    Read from the attributes of a configuration tag, e.g.
+ *
+ *    \verbatim
+ *    <buffer maxSize="1073741824" pages="2M" lock="true" numaNode="0"/>
+ *    \endverbatim
+ *
+ *    where \c pages is 4k (the default), 2M or 1G, and \c numaNode is -1
+ *    (the default) for no binding.
+ *
+ *    Requires Linux.
+ */
+class BufferMemory
+{
+    public:
+        /// Page sizes.
+        typedef enum { SmallPages, HugePages2M, HugePages1G } PageSize;
+
+    public:
+        /// Constructs a memory policy.
+        BufferMemory(PageSize pages = SmallPages, bool lock = false,
+                int numaNode = -1);
+
+        /// Constructs a memory policy from the attributes of a tag.
+        BufferMemory(const ConfigNode& config, const QString& tag);
+
+        /// Returns the page size asked for.
+        PageSize pages() const { return _pages; }
+
+        /// Returns true if the memory is to be locked.
+        bool lock() const { return _lock; }
+
+        /// Returns the NUMA node to bind the memory to, or -1.
+        int numaNode() const { return _numaNode; }
+
+        /// Returns true if the memory comes from calloc().
+        bool isDefault() const {
+            return _pages == SmallPages && ! _lock && _numaNode < 0;
+        }
+
+        /// Allocates zero filled memory, returning 0 if there is none.
+        void* allocate(size_t size) const;
+
+        /// Binds and locks memory allocated elsewhere.
+        void place(void* memory, size_t size) const;
+
+        /// Frees memory from allocate().
+        static void release(void* memory);
+
+        /// Returns the size of the given pages in bytes.
+        static size_t pageBytes(PageSize pages);
+
+    private:
+        PageSize _pages;
+        bool _lock;
+        int _numaNode;
+};
+
+/**
+ * @class BufferAllocator
+ *
+ * @brief
+ *    Standard library allocator taking its memory from a BufferMemory.
+ *
+ * @details
+ *    The BufferMemory is held by pointer, so that its owner can change it
+ *    between allocations. Without one the allocator uses calloc(). All
+ *    BufferAllocators compare equal, as any of them can release memory
+ *    allocated by another.
+ */
+template<typename T>
+class BufferAllocator
+{
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+        template<typename U> struct rebind { typedef BufferAllocator<U> other; };
+
+    public:
+        BufferAllocator(const BufferMemory* memory = 0) : _memory(memory) {}
+        template<typename U>
+        BufferAllocator(const BufferAllocator<U>& other) : _memory(other.memory()) {}
+
+        /// Returns the memory policy used.
+        const BufferMemory* memory() const { return _memory; }
+
+        pointer address(reference x) const { return &x; }
+        const_pointer address(const_reference x) const { return &x; }
+
+        pointer allocate(size_type n, const void* = 0) {
+            void* p = _memory ? _memory->allocate(n * sizeof(T))
+                              : calloc(n, sizeof(T));
+            if (!p && n) throw std::bad_alloc();
+            return static_cast<pointer>(p);
+        }
+        void deallocate(pointer p, size_type) { BufferMemory::release(p); }
+
+        size_type max_size() const { return size_type(-1) / sizeof(T); }
+        void construct(pointer p, const T& value) { new((void*)p) T(value); }
+        void destroy(pointer p) { p->~T(); }
+
+    private:
+        const BufferMemory* _memory;
+};
+
+template<typename T, typename U>
+inline bool operator==(const BufferAllocator<T>&, const BufferAllocator<U>&)
+{ return true; }
+
+template<typename T, typename U>
+inline bool operator!=(const BufferAllocator<T>&, const BufferAllocator<U>&)
+{ return false; }
+
+} // namespace pelican
+#endif // BUFFERMEMORY_H
@@ -0,0 +1,83 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#ifndef __linux__
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#endif
+
+/**
+ * @file EventCount.h
+ */
+
+namespace pelican {
+
+/**
+ * @class EventCount
+ *
+ * @brief
+ *    Lets threads block until an event is notified, without a lock on the
+ *    notifying side.
+ *
+ * @details
+ *    Typical use by a waiting thread, where tryGet() is any non-blocking
+ *    check (e.g. a dequeue from a LockFreeQueue):
+ *
+ * @code
+ * while( ! tryGet() ) {
+ *     EventCount::Key key = events.prepareWait();
+ *     if( tryGet() ) { events.cancelWait(); break; }
+ *     events.wait(key, timeout);
+ * }
+ * @endcode
+ *
+ *    and by the notifying thread, after making the data available:
+ *
+ * @code
+ * events.notifyAll();
+ * @endcode
+ *
+ *    notifyAll() costs a single atomic increment when nobody is waiting.
+ *    On Linux waiting threads sleep on a futex; elsewhere a
+ *    QWaitCondition is used.
+ */
+class EventCount
+{
+    public:
+        typedef int Key;
+
+    public:
+        /// EventCount constructor.
+        EventCount();
+
+        /// EventCount destructor.
+        ~EventCount();
+
+        /// announce the intention to wait, returning the key to pass to wait()
+        Key prepareWait();
+
+        /// withdraw a prepareWait() without waiting
+        void cancelWait();
+
+        /// block until notified after the given key was taken, or until the
+        //  timeout (in ms, < 0 to wait forever) expires.
+        //  Returns false on timeout.
+        bool wait(Key key, int timeout = -1);
+
+        /// wake up all the waiting threads
+        void notifyAll();
+
+    private:
+        EventCount(const EventCount&); // Disallow copying.
+
+    private:
+        volatile int _epoch;
+        volatile int _waiters;
+#ifndef __linux__
+        QMutex _mutex;
+        QWaitCondition _condition;
+#endif
+};
+
+} // namespace pelican
+#endif // EVENTCOUNT_H
@@ -0,0 +1,78 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include "pelican/utility/AtomicCounter.h"
+#include <QtCore/QMap>
+#include <QtCore/QString>
+
+/**
+ * @file LatencyHistogram.h
+ */
+
+namespace pelican {
+
+/**
+ * @class LatencyHistogram
+ *
+ * @brief
+ *    A histogram of latencies that can be updated from any thread without
+ *    a lock.
+ *
+ * @details
+ *    Bucket i counts the latencies of at most 2^i microseconds (and more
+ *    than half that), from 1 us up to about 17 s. The last bucket counts
+ *    everything longer. Quantiles are estimated from the bucket bounds, so
+ *    are accurate to a factor of two.
+ */
+class LatencyHistogram
+{
+    public:
+        /// The number of buckets.
+        enum { buckets = 26 };
+
+    public:
+        /// Constructs an empty histogram.
+        LatencyHistogram() {}
+
+        /// Adds a latency (in nanoseconds).
+        void add(quint64 latency);
+
+        /// Clears the histogram.
+        void reset();
+
+        /// Returns the number of latencies added.
+        quint64 count() const { return _count.value(); }
+
+        /// Returns the sum of the latencies added (ns).
+        quint64 sum() const { return _sum.value(); }
+
+        /// Returns the longest latency added (ns).
+        quint64 max() const { return _max.value(); }
+
+        /// Returns the number of latencies in the bucket.
+        quint64 bucketCount(int i) const { return _counts[i].value(); }
+
+        /// Returns the upper bound of the bucket in ns (0 for the last).
+        static quint64 upperBound(int i);
+
+        /// Returns an estimate of the given quantile (0 to 1) in ns.
+        quint64 quantile(double q) const;
+
+        /// Adds the histogram to a map of metrics in the Prometheus style,
+        /// in seconds, with the given labels (e.g. stream="a").
+        void metrics(QMap<QString, double>& values, const QString& name,
+                const QString& labels) const;
+
+    private:
+        LatencyHistogram(const LatencyHistogram&); // Disallow copying.
+
+    private:
+        AtomicCounter _counts[buckets];
+        AtomicCounter _count;
+        AtomicCounter _sum;
+        AtomicCounter _max;
+};
+
+} // namespace pelican
+
+#endif // LATENCYHISTOGRAM_H
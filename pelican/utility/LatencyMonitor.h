@@ -0,0 +1,89 @@
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include "pelican/utility/LatencyTrace.h"
+#include "pelican/utility/LatencyHistogram.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/**
+ * @file LatencyMonitor.h
+ */
+
+namespace pelican {
+
+/**
+ * @class LatencyMonitor
+ *
+ * @brief
+ *    Keeps a histogram of the latency of each stage of each stream.
+ *
+ * @details
+ *    The latency of a stage is the time since the chunk of data was
+ *    ingested by the server (see LatencyTrace). The server records the
+ *    serve stage and the pipelines the later stages, in the process-wide
+ *    instance():
+ *
+ * @code
+ * LatencyMonitor::instance()->record(blob->latencyTrace(), LatencyTrace::Adapt);
+ * @endcode
+ *
+ *    The histograms are published with the server metrics (see
+ *    DataManager::metrics()) and can be reported by the pipeline driver.
+ */
+class LatencyMonitor
+{
+    public:
+        /// Constructs an empty monitor.
+        LatencyMonitor() {}
+
+        /// Destroys the monitor.
+        ~LatencyMonitor();
+
+        /// Returns the process-wide monitor.
+        static LatencyMonitor* instance();
+
+        /// Records the latency (ns) of the stream at the stage.
+        void record(const QString& stream, LatencyTrace::Stage stage,
+                quint64 latency);
+
+        /// Records the latency of the trace at the stage, if it has been
+        /// ingested and has reached the stage.
+        void record(const LatencyTrace& trace, LatencyTrace::Stage stage) {
+            if (trace.isValid() && trace.time(stage) != 0)
+                record(trace.stream(), stage, trace.latency(stage));
+        }
+
+        /// Returns the histogram of the stream and stage (0 if none).
+        const LatencyHistogram* histogram(const QString& stream,
+                LatencyTrace::Stage stage) const;
+
+        /// Returns the names of the streams recorded.
+        QStringList streams() const;
+
+        /// Clears all the histograms.
+        void reset();
+
+        /// Adds the histograms to a map of metrics in the Prometheus style.
+        void metrics(QMap<QString, double>& values) const;
+
+        /// Returns a summary of each histogram, one per line.
+        QString report() const;
+
+    private:
+        LatencyMonitor(const LatencyMonitor&); // Disallow copying.
+
+    private:
+        /// Histograms of each stage, by stream (created as first needed
+        /// and kept until the monitor is destroyed).
+        QHash<QString, LatencyHistogram*> _histograms;
+        mutable QMutex _mutex;
+};
+
+} // namespace pelican
+
+#endif // LATENCYMONITOR_H
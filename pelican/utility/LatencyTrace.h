@@ -0,0 +1,96 @@
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <QtCore/QString>
+#include <time.h>
+
+/**
+ * @file LatencyTrace.h
+ */
+
+namespace pelican {
+
+/**
+ * @class LatencyTrace
+ *
+ * @brief
+ *    The times at which a chunk of stream data passed each stage on its
+ *    way from a chunker to an output stream.
+ *
+ * @details
+ *    The server stamps the ingest time when a chunker releases its
+ *    WritableData, and the serve time when the data is sent to a client.
+ *    The client stamps the receive and adapt times, and the pipeline the
+ *    start and end of its run and the output of each data blob. The trace
+ *    travels with the StreamData and then the adapted DataBlob.
+ *
+ *    Times are nanoseconds of the real time clock, so that the stages on
+ *    the server and pipeline hosts can be compared (given synchronised
+ *    clocks). A time of 0 means the stage has not been reached.
+ */
+class LatencyTrace
+{
+    public:
+        /// The stages traced.
+        typedef enum {
+            Ingest, Serve, Receive, Adapt, ExecStart, ExecEnd, Output, Stages
+        } Stage;
+
+    public:
+        /// Constructs an empty trace.
+        LatencyTrace() { clear(); }
+
+        /// Clears the stream name and the time of every stage.
+        void clear() {
+            _stream.clear();
+            for (int i = 0; i < Stages; ++i) _time[i] = 0;
+        }
+
+        /// Returns the name of the stream the data came from.
+        const QString& stream() const { return _stream; }
+
+        /// Sets the name of the stream the data came from.
+        void setStream(const QString& stream) { _stream = stream; }
+
+        /// Returns the time of the stage (0 if not reached).
+        quint64 time(Stage stage) const { return _time[stage]; }
+
+        /// Sets the time of the stage.
+        void setTime(Stage stage, quint64 time) { _time[stage] = time; }
+
+        /// Sets the time of the stage to now.
+        void stamp(Stage stage) { _time[stage] = now(); }
+
+        /// Returns true if the ingest time is known.
+        bool isValid() const { return _time[Ingest] != 0; }
+
+        /// Returns the time from ingest to the stage (0 if either is unknown).
+        quint64 latency(Stage stage) const {
+            if (_time[Ingest] == 0 || _time[stage] < _time[Ingest]) return 0;
+            return _time[stage] - _time[Ingest];
+        }
+
+        /// Returns the name of the stage.
+        static const char* stageName(Stage stage) {
+            static const char* names[Stages] = {
+                "ingest", "serve", "receive", "adapt", "exec_start",
+                "exec_end", "output"
+            };
+            return names[stage];
+        }
+
+        /// Returns the current real time in nanoseconds.
+        static quint64 now() {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return (quint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+    private:
+        QString _stream;
+        quint64 _time[Stages];
+};
+
+} // namespace pelican
+
+#endif // LATENCYTRACE_H
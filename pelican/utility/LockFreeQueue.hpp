@@ -0,0 +1,142 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+#include <QtCore/QAtomicInt>
+
+/**
+ * @file LockFreeQueue.hpp
+ */
+
+namespace pelican {
+
+/**
+ * @class LockFreeQueue
+ *
+ * @brief
+ *   A bounded, lock-free, multi-producer/multi-consumer FIFO queue.
+ *
+ * @details
+ *   Each slot in the ring carries a sequence number that tells producers
+ *   and consumers whether the slot is free to write or ready to read, so
+ *   that an enqueue or dequeue costs a single compare-and-swap on the
+ *   queue position when uncontended (D. Vyukov's bounded MPMC queue).
+ *
+ *   The capacity is rounded up to the next power of two. enqueue() returns
+ *   false if the queue is full and dequeue() returns false if it is empty;
+ *   neither ever blocks.
+ *
+ *   T must be cheap to copy (e.g. a pointer).
+ */
+
+template<typename T>
+class LockFreeQueue
+{
+    private:
+        struct Cell {
+            QAtomicInt sequence;
+            T data;
+        };
+
+    public:
+        LockFreeQueue( int capacity ) {
+            _size = 1;
+            while( _size < capacity ) _size <<= 1;
+            _mask = _size - 1;
+            _cells = new Cell[_size];
+            for( int i = 0; i < _size; ++i ) {
+                _cells[i].sequence = i;
+            }
+            _enqueuePos = 0;
+            _dequeuePos = 0;
+        }
+        ~LockFreeQueue() { delete [] _cells; }
+
+        /// add an item to the tail of the queue.
+        //  returns false if the queue is full.
+        bool enqueue( const T& item ) {
+            Cell* cell;
+            int pos = _enqueuePos;
+            for(;;) {
+                cell = &_cells[pos & _mask];
+                int diff = _sub(cell->sequence, pos);
+                if( diff == 0 ) {
+                    // The ordered CAS also orders the sequence read
+                    // before the write of the data below.
+                    if( _enqueuePos.testAndSetOrdered(pos, _add(pos, 1)) )
+                        break;
+                    pos = _enqueuePos;
+                }
+                else if( diff < 0 ) {
+                    return false;
+                }
+                else {
+                    pos = _enqueuePos;
+                }
+            }
+            cell->data = item;
+            cell->sequence.fetchAndStoreRelease(_add(pos, 1));
+            return true;
+        }
+
+        /// remove an item from the head of the queue.
+        //  returns false if the queue is empty.
+        bool dequeue( T& item ) {
+            Cell* cell;
+            int pos = _dequeuePos;
+            for(;;) {
+                cell = &_cells[pos & _mask];
+                int diff = _sub(cell->sequence, _add(pos, 1));
+                if( diff == 0 ) {
+                    if( _dequeuePos.testAndSetOrdered(pos, _add(pos, 1)) )
+                        break;
+                    pos = _dequeuePos;
+                }
+                else if( diff < 0 ) {
+                    return false;
+                }
+                else {
+                    pos = _dequeuePos;
+                }
+            }
+            item = cell->data;
+            cell->sequence.fetchAndStoreRelease(_add(pos, _size));
+            return true;
+        }
+
+        /// return the approximate number of items in the queue
+        //  (exact when there are no concurrent operations)
+        int size() const {
+            int s = _sub(_enqueuePos, _dequeuePos);
+            return s < 0 ? 0 : ( s > _size ? _size : s );
+        }
+
+        /// return true if the queue appears empty
+        bool isEmpty() const { return size() == 0; }
+
+        /// return the maximum number of items the queue can hold
+        int capacity() const { return _size; }
+
+    private:
+        LockFreeQueue( const LockFreeQueue& ); // Disallow copying.
+
+        /// add and subtract with wrap around
+        //  (the positions overflow in long runs)
+        static int _add( int a, int b ) {
+            return int( unsigned(a) + unsigned(b) );
+        }
+        static int _sub( int a, int b ) {
+            return int( unsigned(a) - unsigned(b) );
+        }
+
+    private:
+        Cell* _cells;
+        int _size;
+        int _mask;
+        char _pad0[64];
+        QAtomicInt _enqueuePos;
+        char _pad1[64];
+        QAtomicInt _dequeuePos;
+        char _pad2[64];
+};
+
+} // namespace pelican
+#endif // LOCKFREEQUEUE_H
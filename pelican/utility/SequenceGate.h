@@ -0,0 +1,60 @@
+#ifndef SEQUENCEGATE_H
+#define SEQUENCEGATE_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QWaitCondition>
+
+/**
+ * @file SequenceGate.h
+ */
+
+namespace pelican {
+
+/**
+ * @class SequenceGate
+ *
+ * @brief
+ *    Lets work numbered in sequence finish in any order, while holding
+ *    back each piece until those before it have completed.
+ *
+ * @details
+ *    Each piece of work, numbered from 0, calls complete() when it has
+ *    finished. wait() blocks until all the work numbered before the given
+ *    number has completed, e.g. to send results in order:
+ *
+ * @code
+ * // on the thread doing piece n
+ * ... process ...
+ * gate.wait(n);
+ * send(result);
+ * gate.complete(n);
+ * @endcode
+ */
+class SequenceGate
+{
+    public:
+        /// Constructs a gate, with no work completed.
+        SequenceGate() : _next(0) {}
+
+        /// Waits until all the work before the given number has completed.
+        void wait(quint64 sequence);
+
+        /// Marks the work with the given number as complete.
+        void complete(quint64 sequence);
+
+        /// Returns the number of the first work not yet completed.
+        quint64 next() const;
+
+    private:
+        SequenceGate(const SequenceGate&); // Disallow copying.
+
+    private:
+        mutable QMutex _mutex;
+        QWaitCondition _completed;
+        quint64 _next;
+        QSet<quint64> _done;
+};
+
+} // namespace pelican
+#endif // SEQUENCEGATE_H
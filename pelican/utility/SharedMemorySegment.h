@@ -0,0 +1,73 @@
+#ifndef SHAREDMEMORYSEGMENT_H
+#define SHAREDMEMORYSEGMENT_H
+
+#include <QtCore/QString>
+#include <cstddef>
+
+/**
+ * @file SharedMemorySegment.h
+ */
+
+namespace pelican {
+
+/**
+ * @class SharedMemorySegment
+ *
+ * @brief
+ *    A POSIX shared memory segment mapped into the process.
+ *
+ * @details
+ *    The process that creates a segment owns its name, which is removed
+ *    when the segment is destroyed. Other processes attach to it by name
+ *    (read-only), and keep their mapping until they destroy their own
+ *    SharedMemorySegment object.
+ *
+ *    Segments created in the process are registered so that memory handed
+ *    out from them can be traced back with find(), e.g. to describe a
+ *    chunk of stream data to a client by its offset in the segment.
+ *
+ *    Errors are thrown as QStrings.
+ */
+class SharedMemorySegment
+{
+    public:
+        /// Creates and maps a new segment of the given size.
+        SharedMemorySegment(const QString& name, size_t size);
+
+        /// Maps an existing segment (read-only).
+        explicit SharedMemorySegment(const QString& name);
+
+        /// Unmaps the segment, removing its name if it was created here.
+        ~SharedMemorySegment();
+
+        /// Returns the name of the segment.
+        const QString& name() const { return _name; }
+
+        /// Returns the start of the mapped memory.
+        char* data() const { return _data; }
+
+        /// Returns the size of the segment in bytes.
+        size_t size() const { return _size; }
+
+        /// Returns true if the given address lies within the segment.
+        bool contains(const void* ptr) const {
+            return (const char*)ptr >= _data && (const char*)ptr < _data + _size;
+        }
+
+        /// Returns the segment created by this process that holds the
+        /// given address, or 0.
+        static SharedMemorySegment* find(const void* ptr);
+
+    private:
+        SharedMemorySegment(const SharedMemorySegment&); // Disallow copying.
+        void _map(int fd, bool writable);
+
+    private:
+        QString _name;
+        char* _data;
+        size_t _size;
+        bool _owner;
+};
+
+} // namespace pelican
+#endif // SHAREDMEMORYSEGMENT_H
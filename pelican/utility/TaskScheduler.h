@@ -0,0 +1,266 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include "pelican/utility/AtomicCounter.h"
+#include "pelican/utility/EventCount.h"
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <vector>
+
+/**
+ * @file TaskScheduler.h
+ */
+
+namespace pelican {
+
+/**
+ * @class TaskScheduler
+ *
+ * @brief
+ *    Runs small tasks on a pool of worker threads, balancing the load by
+ *    work stealing.
+ *
+ * @details
+ *    Each worker thread has its own queue of tasks. A task submitted by a
+ *    worker (e.g. from a task it is running) goes on that worker's queue,
+ *    which the worker takes from newest first, while idle workers steal
+ *    the oldest tasks from the other queues. Tasks submitted by other
+ *    threads are spread over the queues in turn.
+ *
+ *    Tasks are submitted as part of a Group, and wait() returns when all
+ *    the tasks of the group have finished. The waiting thread runs queued
+ *    tasks meanwhile, so tasks may themselves submit and wait for more
+ *    tasks without tying up the workers. For example:
+ *
+ * @code
+ * TaskScheduler::Group group;
+ * MyTask a, b;
+ * scheduler.submit(&a, group);
+ * scheduler.submit(&b, group);
+ * scheduler.wait(group); // a and b have run
+ * @endcode
+ *
+ *    The scheduler does not take ownership of the tasks. If a task throws
+ *    a QString, wait() throws the first one thrown in the group.
+ *
+ *    Loops over a range of indices are split into tasks by parallelFor()
+ *    and parallelReduce(), e.g. to sum an array:
+ *
+ * @code
+ * struct Sum {
+ *     const float* data;
+ *     double operator()(int begin, int end) const {
+ *         double sum = 0.0;
+ *         for (int i = begin; i < end; ++i) sum += data[i];
+ *         return sum;
+ *     }
+ * };
+ * struct Add {
+ *     double operator()(double a, double b) const { return a + b; }
+ * };
+ * Sum sum = { data };
+ * double total = scheduler.parallelReduce(0, n, 0.0, sum, Add());
+ * @endcode
+ *
+ *    The range is split into pieces of the given grain size (by default
+ *    about four per worker thread), and the partial results are joined in
+ *    the order of the range, so that the result does not depend on which
+ *    threads ran the pieces.
+ *
+ *    The worker threads can be bound to a set of CPUs (on Linux), each
+ *    worker to the next CPU of the list in turn.
+ */
+class TaskScheduler
+{
+    public:
+        class Group;
+
+        /// A unit of work run by the scheduler.
+        class Task
+        {
+            public:
+                Task() : _group(0) {}
+                virtual ~Task() {}
+
+                /// Does the work of the task.
+                virtual void run() = 0;
+
+            private:
+                friend class TaskScheduler;
+                Group* _group;
+        };
+
+        /// A set of tasks that can be waited for.
+        class Group
+        {
+            public:
+                Group() {}
+
+                /// Returns the number of tasks submitted but not finished.
+                int pending() const { return (int)_pending.value(); }
+
+            private:
+                Group(const Group&); // Disallow copying.
+
+            private:
+                friend class TaskScheduler;
+                AtomicCounter _pending;
+                QMutex _mutex;
+                QString _error;
+        };
+
+    public:
+        /// Starts the given number of worker threads (0 for one per core),
+        /// bound in turn to the given CPUs.
+        TaskScheduler(int threads = 0, const QList<int>& cpus = QList<int>());
+
+        /// Stops the worker threads.
+        ~TaskScheduler();
+
+        /// Returns the number of worker threads.
+        int threads() const { return _workers.size(); }
+
+        /// Queues a task to be run as part of the group.
+        void submit(Task* task, Group& group);
+
+        /// Runs tasks until all those in the group have finished.
+        void wait(Group& group);
+
+        /// Returns the index of the calling worker thread (-1 for others).
+        int currentWorker() const;
+
+        /// Returns the CPUs the worker threads are bound to.
+        const QList<int>& cpus() const { return _cpus; }
+
+        /// Calls body(begin, end) on pieces of the range [begin, end),
+        /// returning when all have finished.
+        template <class Body>
+        void parallelFor(int begin, int end, const Body& body, int grain = 0);
+
+        /// Calls body(begin, end) on pieces of the range [begin, end) and
+        /// joins the results, in order, with join(a, b).
+        template <class T, class Body, class Join>
+        T parallelReduce(int begin, int end, const T& identity,
+                const Body& body, const Join& join, int grain = 0);
+
+        /// Returns the list of CPUs given as e.g. "0-3,8,10-11".
+        static QList<int> parseCpus(const QString& list);
+
+    private:
+        template <class Body> class ForTask;
+        template <class T, class Body> class ReduceTask;
+        class Worker;
+        friend class Worker;
+        struct Queue;
+
+        /// Takes a task from the worker's own queue, or steals one.
+        Task* _take(int worker);
+
+        /// Runs a task and records its completion in its group.
+        void _run(Task* task);
+
+        /// The loop of each worker thread.
+        void _work(int worker);
+
+        /// Returns the size of the pieces to split n indices into.
+        int _grain(int n, int grain) const;
+
+    private:
+        TaskScheduler(const TaskScheduler&); // Disallow copying.
+
+    private:
+        QList<Worker*> _workers;
+        QList<Queue*> _queues;
+        QList<int> _cpus;
+        AtomicCounter _next;
+        EventCount _events;
+        volatile bool _stopping;
+};
+
+
+//------------------------------------------------------------------------------
+// Template definitions.
+
+/**
+ * @details
+ * Runs a loop body on a piece of a range.
+ */
+template <class Body>
+class TaskScheduler::ForTask : public Task
+{
+    public:
+        ForTask(const Body* body, int begin, int end)
+            : _body(body), _begin(begin), _end(end) {}
+        void run() { (*_body)(_begin, _end); }
+
+    private:
+        const Body* _body;
+        int _begin, _end;
+};
+
+/**
+ * @details
+ * Runs a reduction body on a piece of a range, keeping its result.
+ */
+template <class T, class Body>
+class TaskScheduler::ReduceTask : public Task
+{
+    public:
+        ReduceTask(const Body* body, int begin, int end)
+            : _body(body), _begin(begin), _end(end) {}
+        void run() { result = (*_body)(_begin, _end); }
+        T result;
+
+    private:
+        const Body* _body;
+        int _begin, _end;
+};
+
+template <class Body>
+void TaskScheduler::parallelFor(int begin, int end, const Body& body,
+        int grain)
+{
+    int n = end - begin;
+    if( n <= 0 ) return;
+    grain = _grain(n, grain);
+    if( grain >= n ) {
+        body(begin, end);
+        return;
+    }
+    std::vector<ForTask<Body> > tasks;
+    tasks.reserve((n + grain - 1) / grain);
+    for( int i = begin; i < end; i += grain )
+        tasks.push_back(ForTask<Body>(&body, i, qMin(i + grain, end)));
+    Group group;
+    for( unsigned i = 0; i < tasks.size(); ++i )
+        submit(&tasks[i], group);
+    wait(group);
+}
+
+template <class T, class Body, class Join>
+T TaskScheduler::parallelReduce(int begin, int end, const T& identity,
+        const Body& body, const Join& join, int grain)
+{
+    int n = end - begin;
+    if( n <= 0 ) return identity;
+    grain = _grain(n, grain);
+    if( grain >= n )
+        return join(identity, body(begin, end));
+    std::vector<ReduceTask<T, Body> > tasks;
+    tasks.reserve((n + grain - 1) / grain);
+    for( int i = begin; i < end; i += grain )
+        tasks.push_back(ReduceTask<T, Body>(&body, i, qMin(i + grain, end)));
+    Group group;
+    for( unsigned i = 0; i < tasks.size(); ++i )
+        submit(&tasks[i], group);
+    wait(group);
+    T result = identity;
+    for( unsigned i = 0; i < tasks.size(); ++i )
+        result = join(result, tasks[i].result);
+    return result;
+}
+
+} // namespace pelican
+#endif // TASKSCHEDULER_H
@@ -0,0 +1,108 @@
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+/**
+ * @file ThreadPlacement.h
+ */
+
+namespace pelican {
+
+class ConfigNode;
+
+/**
+ * @class ThreadPlacement
+ *
+ * @brief
+ *    The CPUs and scheduling policy of a thread.
+ *
+ * @details
+ *    The long-running threads of Pelican (the DataReceiver of each
+ *    chunker, Session, PelicanServer, ThreadedBlobServer and
+ *    EmulatorDriver) call place() when they start, which applies the
+ *    placement configured for their class, and reports where the first
+ *    thread of each class (and name) runs. Placements are read with configure() from a \c threads section,
+ *    one tag per thread class:
+ *
+ *    \verbatim
+ *    <threads>
+ *        <DataReceiver cpus="2-3" policy="fifo" priority="80"/>
+ *        <DataReceiver name="MyChunker" cpus="4"/>
+ *        <Session cpus="8-15"/>
+ *    </threads>
+ *    \endverbatim
+ *
+ *    where \c cpus lists the CPUs the thread may run on (all by default),
+ *    \c policy is "other" (the default), "fifo" (SCHED_FIFO) or "rr"
+ *    (SCHED_RR), and \c priority (1-99) is the real-time priority. A tag
+ *    with a \c name applies only to the thread of that name, in preference
+ *    to the tag for the whole class: the DataReceiver of a chunker is named
+ *    after the chunker's configuration name, or its type if it has none
+ *    (the receivers of a chunker with several threads share the name).
+ *
+ *    Real-time policies need CAP_SYS_NICE (or an RLIMIT_RTPRIO); a
+ *    placement that can not be applied is reported (again only for the
+ *    first thread of the class), and the thread runs
+ *    where the system puts it. Invalid placements are thrown as QStrings
+ *    by configure().
+ *
+ *    Requires Linux.
+ */
+class ThreadPlacement
+{
+    public:
+        /// Scheduling policies.
+        typedef enum { Other, Fifo, RoundRobin } Policy;
+
+    public:
+        /// Constructs a placement that leaves the thread as it is.
+        ThreadPlacement() : _policy(Other), _priority(0) {}
+
+        /// Constructs a placement from the attributes of a tag.
+        ThreadPlacement(const ConfigNode& config);
+
+        /// Returns true if the placement changes anything.
+        bool isSet() const { return ! _cpus.isEmpty() || _policy != Other; }
+
+        /// Returns the CPUs the thread may run on (empty for any).
+        const QList<int>& cpus() const { return _cpus; }
+
+        /// Returns the scheduling policy.
+        Policy policy() const { return _policy; }
+
+        /// Returns the real-time priority.
+        int priority() const { return _priority; }
+
+        /// Applies the placement to the calling thread, returning false
+        /// (with the reason) if it failed.
+        bool apply(QString* error = 0) const;
+
+    public:
+        /// Adds the placements in the threads section of the given node.
+        static void configure(const ConfigNode& config);
+
+        /// Returns the placement configured for a thread.
+        static ThreadPlacement find(const QString& threadClass,
+                const QString& name = QString());
+
+        /// Applies the configured placement to the calling thread and
+        /// reports it, if it is the first of its class and name.
+        static void place(const QString& threadClass,
+                const QString& name = QString());
+
+        /// Returns the CPUs and scheduling policy of the calling thread.
+        static QString describe();
+
+        /// Returns the list of CPUs as e.g. "0-3,8".
+        static QString formatCpus(const QList<int>& cpus);
+
+    private:
+        QList<int> _cpus;
+        Policy _policy;
+        int _priority;
+};
+
+} // namespace pelican
+#endif // THREADPLACEMENT_H
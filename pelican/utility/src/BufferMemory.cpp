@@ -0,0 +1,190 @@
+#include "BufferMemory.h"
+#include "ConfigNode.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace pelican {
+
+// Mapped lengths of the memory allocated with mmap(), by address.
+static QMutex registryMutex;
+static QHash<void*, size_t> registry;
+
+// Fallbacks already reported.
+static bool warnedPages = false;
+static bool warnedLock = false;
+static bool warnedNuma = false;
+
+/**
+ * @details
+ * Reports a fallback on stderr, the first time it happens.
+ */
+static void warnOnce(bool& warned, const QString& message)
+{
+    QMutexLocker locker(&registryMutex);
+    if (warned) return;
+    warned = true;
+    std::cerr << "BufferMemory: " << message.toStdString() << std::endl;
+}
+
+/**
+ * @details
+ * Rounds the size up to a whole number of pages.
+ */
+static size_t roundUp(size_t size, size_t page)
+{
+    return (size + page - 1) / page * page;
+}
+
+
+/**
+ * @details
+ * Constructs a memory policy with the given page size, locking and NUMA
+ * node (-1 for none).
+ */
+BufferMemory::BufferMemory(PageSize pages, bool lock, int numaNode)
+    : _pages(pages), _lock(lock), _numaNode(numaNode)
+{
+}
+
+/**
+ * @details
+ * Constructs a memory policy from the \c pages, \c lock and \c numaNode
+ * attributes of the given tag. Throws if they are not understood.
+ */
+BufferMemory::BufferMemory(const ConfigNode& config, const QString& tag)
+{
+    QString pages = config.getOption(tag, "pages", "4k").toLower();
+    if (pages == "4k")
+        _pages = SmallPages;
+    else if (pages == "2m")
+        _pages = HugePages2M;
+    else if (pages == "1g")
+        _pages = HugePages1G;
+    else
+        throw QString("BufferMemory: Unknown page size \"%1\" (4k, 2M or 1G).")
+                .arg(pages);
+    _lock = config.getOption(tag, "lock", "false").toLower() == "true";
+    bool ok = false;
+    _numaNode = config.getOption(tag, "numaNode", "-1").toInt(&ok);
+    if (!ok || _numaNode >= 1024)
+        throw QString("BufferMemory: Invalid NUMA node \"%1\".")
+                .arg(config.getOption(tag, "numaNode"));
+}
+
+/**
+ * @details
+ * Allocates zero filled memory of at least the given size. Huge pages are
+ * mapped (rounding the size up to whole pages) if asked for and available,
+ * and normal pages otherwise. The memory is bound to its NUMA node before
+ * it is touched, and then locked, which faults it in.
+ *
+ * With the default policy the memory comes from calloc().
+ */
+void* BufferMemory::allocate(size_t size) const
+{
+    if (isDefault())
+        return calloc(size, sizeof(char));
+
+    size_t length = 0;
+    void* memory = MAP_FAILED;
+    if (_pages != SmallPages) {
+        length = roundUp(size, pageBytes(_pages));
+        int shift = (_pages == HugePages1G) ? 30 : 21;
+        memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE |
+                MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+        if (memory == MAP_FAILED)
+            warnOnce(warnedPages, QString("No %1 huge pages available (%2), "
+                    "using normal pages (see /proc/sys/vm/nr_hugepages).")
+                    .arg(_pages == HugePages1G ? "1G" : "2M")
+                    .arg(strerror(errno)));
+    }
+    if (memory == MAP_FAILED) {
+        length = roundUp(size, pageBytes(SmallPages));
+        memory = mmap(0, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return 0;
+    }
+
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.insert(memory, length);
+    }
+    place(memory, length);
+    return memory;
+}
+
+/**
+ * @details
+ * Binds the given memory to the policy's NUMA node and locks it. Pages
+ * that are already present are moved to the node. Memory on normal pages
+ * is also marked for transparent huge pages if huge pages were asked for.
+ */
+void BufferMemory::place(void* memory, size_t size) const
+{
+    if (_pages != SmallPages)
+        madvise(memory, size, MADV_HUGEPAGE); // Fails harmlessly on huge pages.
+
+    if (_numaNode >= 0) {
+        unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[_numaNode / (8 * sizeof(unsigned long))] =
+                1UL << (_numaNode % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_mbind, memory, size, MPOL_BIND, mask,
+                8 * sizeof(mask), MPOL_MF_MOVE) != 0)
+            warnOnce(warnedNuma, QString("Unable to bind memory to NUMA "
+                    "node %1: %2").arg(_numaNode).arg(strerror(errno)));
+    }
+
+    if (_lock && mlock(memory, size) != 0)
+        warnOnce(warnedLock, QString("Unable to lock memory: %1 "
+                "(see ulimit -l).").arg(strerror(errno)));
+}
+
+/**
+ * @details
+ * Frees memory from allocate(), unmapping it if it was mapped. (Unmapping
+ * also unlocks it.)
+ */
+void BufferMemory::release(void* memory)
+{
+    if (!memory) return;
+    size_t length = 0;
+    {
+        QMutexLocker locker(&registryMutex);
+        length = registry.take(memory);
+    }
+    if (length)
+        munmap(memory, length);
+    else
+        free(memory);
+}
+
+/**
+ * @details
+ * Returns the size of the given pages in bytes.
+ */
+size_t BufferMemory::pageBytes(PageSize pages)
+{
+    switch (pages) {
+        case HugePages2M: return size_t(2) << 20;
+        case HugePages1G: return size_t(1) << 30;
+        default: return sysconf(_SC_PAGESIZE);
+    }
+}
+
+} // namespace pelican
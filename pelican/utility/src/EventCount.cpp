@@ -0,0 +1,91 @@
+#include "EventCount.h"
+
+#include <climits>
+#ifdef __linux__
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <QtCore/QMutexLocker>
+#endif
+
+namespace pelican {
+
+/**
+ * @details Constructs an EventCount object.
+ */
+EventCount::EventCount()
+    : _epoch(0), _waiters(0)
+{
+}
+
+/**
+ * @details Destroys the EventCount object.
+ */
+EventCount::~EventCount()
+{
+}
+
+/**
+ * @details
+ * Registers the calling thread as a waiter. The condition being waited
+ * for must be checked again after this call and before wait(), as it
+ * may have become true in between.
+ */
+EventCount::Key EventCount::prepareWait()
+{
+    __sync_fetch_and_add(&_waiters, 1);
+    return __sync_fetch_and_add(&_epoch, 0);
+}
+
+void EventCount::cancelWait()
+{
+    __sync_fetch_and_sub(&_waiters, 1);
+}
+
+/**
+ * @details
+ * Returns immediately if notifyAll() has been called since the key was
+ * obtained from prepareWait().
+ */
+bool EventCount::wait(Key key, int timeout)
+{
+#ifdef __linux__
+    struct timespec ts;
+    struct timespec* tsp = 0;
+    if( timeout >= 0 ) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    // The futex only sleeps while the epoch still equals the key, so a
+    // notification between prepareWait() and here is never lost.
+    // Spurious wake ups simply return to the caller to check again.
+    if( _epoch == key )
+        syscall(SYS_futex, &_epoch, FUTEX_WAIT_PRIVATE, key, tsp, 0, 0);
+#else
+    {
+        QMutexLocker lock(&_mutex);
+        if( _epoch == key )
+            _condition.wait(&_mutex, timeout < 0 ? ULONG_MAX : timeout);
+    }
+#endif
+    __sync_fetch_and_sub(&_waiters, 1);
+    return _epoch != key;
+}
+
+void EventCount::notifyAll()
+{
+    __sync_fetch_and_add(&_epoch, 1);
+    if( _waiters ) {
+#ifdef __linux__
+        syscall(SYS_futex, &_epoch, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#else
+        QMutexLocker lock(&_mutex);
+        _condition.wakeAll();
+#endif
+    }
+}
+
+} // namespace pelican
@@ -0,0 +1,93 @@
+#include "pelican/utility/LatencyHistogram.h"
+
+namespace pelican {
+
+
+/**
+ * @details
+ * Adds the latency to its bucket, and to the count, sum and maximum.
+ */
+void LatencyHistogram::add(quint64 latency)
+{
+    // The smallest i with 2^i us >= latency.
+    quint64 us = (latency + 999) / 1000;
+    int i = 0;
+    while (i < buckets - 1 && (Q_UINT64_C(1) << i) < us) ++i;
+    _counts[i].add();
+    _count.add();
+    _sum.add(latency);
+    _max.max(latency);
+}
+
+
+/**
+ * @details
+ * Clears the histogram. Latencies added at the same time may be lost.
+ */
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < buckets; ++i) _counts[i].set(0);
+    _count.set(0);
+    _sum.set(0);
+    _max.set(0);
+}
+
+
+/**
+ * @details
+ * Returns the upper bound of bucket i in nanoseconds, or 0 for the last
+ * bucket, which has no bound.
+ */
+quint64 LatencyHistogram::upperBound(int i)
+{
+    if (i >= buckets - 1) return 0;
+    return Q_UINT64_C(1000) << i;
+}
+
+
+/**
+ * @details
+ * Returns the upper bound of the bucket holding the given quantile, or the
+ * longest latency if that is less (or the quantile is in the last bucket).
+ * Returns 0 if the histogram is empty.
+ */
+quint64 LatencyHistogram::quantile(double q) const
+{
+    quint64 total = count();
+    if (total == 0) return 0;
+    quint64 rank = (quint64)(q * total + 0.5);
+    if (rank < 1) rank = 1;
+    quint64 cumulative = 0;
+    for (int i = 0; i < buckets - 1; ++i) {
+        cumulative += bucketCount(i);
+        if (cumulative >= rank)
+            return qMin(upperBound(i), max());
+    }
+    return max();
+}
+
+
+/**
+ * @details
+ * Adds the cumulative bucket counts as \c name_bucket, with an \c le label
+ * giving the bound in seconds, and the sum (in seconds) and count as
+ * \c name_sum and \c name_count.
+ */
+void LatencyHistogram::metrics(QMap<QString, double>& values,
+        const QString& name, const QString& labels) const
+{
+    QString prefix = labels.isEmpty() ? QString() : labels + ",";
+    quint64 cumulative = 0;
+    for (int i = 0; i < buckets; ++i) {
+        cumulative += bucketCount(i);
+        QString le = i < buckets - 1 ?
+                QString::number(upperBound(i) * 1e-9, 'g', 6) : QString("+Inf");
+        values.insert(QString("%1_bucket{%2le=\"%3\"}").arg(name)
+                .arg(prefix).arg(le), cumulative);
+    }
+    QString suffix = labels.isEmpty() ? QString() : "{" + labels + "}";
+    values.insert(name + "_sum" + suffix, sum() * 1e-9);
+    values.insert(name + "_count" + suffix, count());
+}
+
+} // namespace pelican
@@ -0,0 +1,139 @@
+#include "pelican/utility/LatencyMonitor.h"
+
+#include <QtCore/QMutexLocker>
+
+namespace pelican {
+
+
+/**
+ * @details
+ * Destroys the monitor and its histograms.
+ */
+LatencyMonitor::~LatencyMonitor()
+{
+    foreach (LatencyHistogram* h, _histograms)
+        delete [] h;
+}
+
+
+/**
+ * @details
+ * Returns the monitor shared by the whole process.
+ */
+LatencyMonitor* LatencyMonitor::instance()
+{
+    static LatencyMonitor monitor;
+    return &monitor;
+}
+
+
+/**
+ * @details
+ * Adds the latency to the histogram of the stream and stage. Only finding
+ * the histograms of a stream takes a lock.
+ */
+void LatencyMonitor::record(const QString& stream, LatencyTrace::Stage stage,
+        quint64 latency)
+{
+    LatencyHistogram* h;
+    {
+        QMutexLocker locker(&_mutex);
+        h = _histograms.value(stream);
+        if (!h) {
+            h = new LatencyHistogram[LatencyTrace::Stages];
+            _histograms.insert(stream, h);
+        }
+    }
+    h[stage].add(latency);
+}
+
+
+/**
+ * @details
+ * Returns the histogram of the stream and stage, or 0 if nothing has been
+ * recorded for the stream.
+ */
+const LatencyHistogram* LatencyMonitor::histogram(const QString& stream,
+        LatencyTrace::Stage stage) const
+{
+    QMutexLocker locker(&_mutex);
+    LatencyHistogram* h = _histograms.value(stream);
+    return h ? &h[stage] : 0;
+}
+
+
+/**
+ * @details
+ * Returns the names of the streams that have latencies recorded.
+ */
+QStringList LatencyMonitor::streams() const
+{
+    QMutexLocker locker(&_mutex);
+    QStringList streams = _histograms.keys();
+    streams.sort();
+    return streams;
+}
+
+
+/**
+ * @details
+ * Clears the histograms (the streams stay known).
+ */
+void LatencyMonitor::reset()
+{
+    QMutexLocker locker(&_mutex);
+    foreach (LatencyHistogram* h, _histograms) {
+        for (int i = 0; i < LatencyTrace::Stages; ++i)
+            h[i].reset();
+    }
+}
+
+
+/**
+ * @details
+ * Adds a \c pelican_latency_seconds histogram, labelled with the stream
+ * and stage, for each stage with latencies recorded.
+ */
+void LatencyMonitor::metrics(QMap<QString, double>& values) const
+{
+    foreach (const QString& stream, streams()) {
+        QString s = stream;
+        s.replace('\\', "\\\\").replace('"', "\\\"");
+        for (int i = 0; i < LatencyTrace::Stages; ++i) {
+            LatencyTrace::Stage stage = (LatencyTrace::Stage)i;
+            const LatencyHistogram* h = histogram(stream, stage);
+            if (h->count() == 0) continue;
+            h->metrics(values, "pelican_latency_seconds",
+                    QString("stream=\"%1\",stage=\"%2\"").arg(s)
+                    .arg(LatencyTrace::stageName(stage)));
+        }
+    }
+}
+
+
+/**
+ * @details
+ * Returns a line for each stage of each stream with latencies recorded,
+ * giving the count and the median, 99th percentile and longest latency
+ * in milliseconds.
+ */
+QString LatencyMonitor::report() const
+{
+    QString text;
+    foreach (const QString& stream, streams()) {
+        for (int i = 0; i < LatencyTrace::Stages; ++i) {
+            LatencyTrace::Stage stage = (LatencyTrace::Stage)i;
+            const LatencyHistogram* h = histogram(stream, stage);
+            if (h->count() == 0) continue;
+            text += QString("%1 %2: count %3, p50 %4 ms, p99 %5 ms, max %6 ms\n")
+                    .arg(stream).arg(LatencyTrace::stageName(stage))
+                    .arg(h->count())
+                    .arg(h->quantile(0.5) * 1e-6)
+                    .arg(h->quantile(0.99) * 1e-6)
+                    .arg(h->max() * 1e-6);
+        }
+    }
+    return text;
+}
+
+} // namespace pelican
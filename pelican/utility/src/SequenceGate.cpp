@@ -0,0 +1,48 @@
+#include "pelican/utility/SequenceGate.h"
+
+#include <QtCore/QMutexLocker>
+
+namespace pelican {
+
+/**
+ * @details
+ * Blocks until complete() has been called for every number below
+ * \p sequence.
+ */
+void SequenceGate::wait(quint64 sequence)
+{
+    QMutexLocker locker(&_mutex);
+    while( _next < sequence )
+        _completed.wait(&_mutex);
+}
+
+/**
+ * @details
+ * Marks the work complete. Work completed ahead of its turn is kept until
+ * the work before it has completed.
+ */
+void SequenceGate::complete(quint64 sequence)
+{
+    QMutexLocker locker(&_mutex);
+    if( sequence < _next ) return;
+    _done.insert(sequence);
+    bool advanced = false;
+    while( _done.remove(_next) ) {
+        ++_next;
+        advanced = true;
+    }
+    if( advanced )
+        _completed.wakeAll();
+}
+
+/**
+ * @details
+ * Returns the lowest number not yet completed.
+ */
+quint64 SequenceGate::next() const
+{
+    QMutexLocker locker(&_mutex);
+    return _next;
+}
+
+} // namespace pelican
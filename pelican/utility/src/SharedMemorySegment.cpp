@@ -0,0 +1,124 @@
+#include "SharedMemorySegment.h"
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace pelican {
+
+// Segments created by this process.
+static QMutex registryMutex;
+static QList<SharedMemorySegment*> registry;
+
+/**
+ * @details
+ * Creates a new shared memory segment with the given name (which should
+ * start with a '/') and size, replacing any stale segment of the same
+ * name, and maps it read-write. The memory is zero filled.
+ */
+SharedMemorySegment::SharedMemorySegment(const QString& name, size_t size)
+    : _name(name), _data(0), _size(size), _owner(true)
+{
+    QByteArray n = _name.toLocal8Bit();
+    shm_unlink(n.constData());
+    int fd = shm_open(n.constData(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        throw QString("SharedMemorySegment: Unable to create \"%1\": %2")
+                .arg(_name).arg(strerror(errno));
+    if (ftruncate(fd, _size) != 0) {
+        int e = errno;
+        ::close(fd);
+        shm_unlink(n.constData());
+        throw QString("SharedMemorySegment: Unable to size \"%1\": %2")
+                .arg(_name).arg(strerror(e));
+    }
+    try {
+        _map(fd, true);
+    }
+    catch (...) {
+        shm_unlink(n.constData());
+        throw;
+    }
+    QMutexLocker locker(&registryMutex);
+    registry.append(this);
+}
+
+
+/**
+ * @details
+ * Maps the existing segment with the given name read-only.
+ */
+SharedMemorySegment::SharedMemorySegment(const QString& name)
+    : _name(name), _data(0), _size(0), _owner(false)
+{
+    int fd = shm_open(_name.toLocal8Bit().constData(), O_RDONLY, 0);
+    if (fd < 0)
+        throw QString("SharedMemorySegment: Unable to open \"%1\": %2")
+                .arg(_name).arg(strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int e = errno;
+        ::close(fd);
+        throw QString("SharedMemorySegment: Unable to stat \"%1\": %2")
+                .arg(_name).arg(strerror(e));
+    }
+    _size = st.st_size;
+    _map(fd, false);
+}
+
+
+/**
+ * @details
+ * Unmaps the segment. The creator also removes the name, so that the
+ * memory is freed once every other process has unmapped it.
+ */
+SharedMemorySegment::~SharedMemorySegment()
+{
+    if (_owner) {
+        QMutexLocker locker(&registryMutex);
+        registry.removeAll(this);
+        shm_unlink(_name.toLocal8Bit().constData());
+    }
+    if (_data) munmap(_data, _size);
+}
+
+
+/**
+ * @details
+ * Returns the segment created in this process that contains the address.
+ */
+SharedMemorySegment* SharedMemorySegment::find(const void* ptr)
+{
+    QMutexLocker locker(&registryMutex);
+    foreach (SharedMemorySegment* segment, registry) {
+        if (segment->contains(ptr))
+            return segment;
+    }
+    return 0;
+}
+
+
+/**
+ * @details
+ * Maps the whole of the open segment and closes the descriptor.
+ */
+void SharedMemorySegment::_map(int fd, bool writable)
+{
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* p = mmap(0, _size, prot, MAP_SHARED, fd, 0);
+    int e = errno;
+    ::close(fd);
+    if (p == MAP_FAILED)
+        throw QString("SharedMemorySegment: Unable to map \"%1\": %2")
+                .arg(_name).arg(strerror(e));
+    _data = static_cast<char*>(p);
+}
+
+} // namespace pelican
@@ -0,0 +1,274 @@
+#include "pelican/utility/TaskScheduler.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <iostream>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace pelican {
+
+/**
+ * @details
+ * The queue of tasks of a worker thread.
+ */
+struct TaskScheduler::Queue
+{
+    QMutex mutex;
+    QList<Task*> tasks;
+};
+
+/**
+ * @details
+ * A worker thread of the scheduler.
+ */
+class TaskScheduler::Worker : public QThread
+{
+    public:
+        Worker(TaskScheduler* scheduler, int index, int cpu)
+            : _scheduler(scheduler), _index(index), _cpu(cpu) {}
+
+    protected:
+        void run() {
+            _bind();
+            _scheduler->_work(_index);
+        }
+
+    private:
+        /// Binds the thread to its CPU, if it has one.
+        void _bind() {
+            if( _cpu < 0 ) return;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(_cpu, &set);
+            if( sched_setaffinity(0, sizeof(set), &set) != 0 )
+                std::cerr << "TaskScheduler: unable to bind worker "
+                          << _index << " to CPU " << _cpu << std::endl;
+#endif
+        }
+
+    private:
+        TaskScheduler* _scheduler;
+        int _index;
+        int _cpu;
+};
+
+
+/**
+ * @details
+ * Constructs the scheduler and starts its worker threads. If CPUs are
+ * given, worker i is bound to cpus[i % cpus.size()], and the number of
+ * threads defaults to the number of CPUs.
+ */
+TaskScheduler::TaskScheduler(int threads, const QList<int>& cpus)
+    : _cpus(cpus), _stopping(false)
+{
+    if( threads <= 0 )
+        threads = cpus.isEmpty() ? QThread::idealThreadCount() : cpus.size();
+    if( threads <= 0 )
+        threads = 1;
+    for( int i = 0; i < threads; ++i ) {
+        int cpu = cpus.isEmpty() ? -1 : cpus[i % cpus.size()];
+        _queues.append(new Queue);
+        _workers.append(new Worker(this, i, cpu));
+    }
+    foreach( Worker* worker, _workers ) {
+        worker->start();
+    }
+}
+
+/**
+ * @details
+ * Stops the worker threads once they have finished their current tasks.
+ * Tasks still queued are not run.
+ */
+TaskScheduler::~TaskScheduler()
+{
+    _stopping = true;
+    _events.notifyAll();
+    foreach( Worker* worker, _workers ) {
+        worker->wait();
+        delete worker;
+    }
+    foreach( Queue* queue, _queues ) {
+        delete queue;
+    }
+}
+
+/**
+ * @details
+ * Queues the task on the queue of the calling worker or, from any other
+ * thread, on the next queue in turn, and wakes the idle workers.
+ */
+void TaskScheduler::submit(Task* task, Group& group)
+{
+    task->_group = &group;
+    group._pending.add();
+    int index = currentWorker();
+    if( index < 0 )
+        index = (int)(_next.add() % _queues.size());
+    Queue* queue = _queues[index];
+    queue->mutex.lock();
+    queue->tasks.append(task);
+    queue->mutex.unlock();
+    _events.notifyAll();
+}
+
+/**
+ * @details
+ * Runs queued tasks (of any group) until all the tasks of the group have
+ * finished, then throws the first error thrown by any of them.
+ */
+void TaskScheduler::wait(Group& group)
+{
+    int index = currentWorker();
+    while( group._pending.value() > 0 ) {
+        Task* task = _take(index);
+        if( ! task ) {
+            EventCount::Key key = _events.prepareWait();
+            if( group._pending.value() == 0 || (task = _take(index)) ) {
+                _events.cancelWait();
+            }
+            else {
+                _events.wait(key);
+                continue;
+            }
+        }
+        if( task ) _run(task);
+    }
+
+    QMutexLocker locker(&group._mutex);
+    if( ! group._error.isEmpty() ) {
+        QString error = group._error;
+        group._error.clear();
+        throw error;
+    }
+}
+
+/**
+ * @details
+ * Returns the index of the worker thread calling, or -1 if it is not one
+ * of the workers of this scheduler.
+ */
+int TaskScheduler::currentWorker() const
+{
+    QThread* thread = QThread::currentThread();
+    for( int i = 0; i < _workers.size(); ++i ) {
+        if( _workers[i] == thread ) return i;
+    }
+    return -1;
+}
+
+/**
+ * @details
+ * Returns the CPU numbers in a comma separated list of numbers and ranges,
+ * e.g. "0-3,8" gives 0, 1, 2, 3 and 8. An empty list gives no CPUs.
+ */
+QList<int> TaskScheduler::parseCpus(const QString& list)
+{
+    QList<int> cpus;
+    foreach( const QString& item, list.split(',', QString::SkipEmptyParts) ) {
+        QStringList range = item.trimmed().split('-');
+        bool ok1 = true, ok2 = true;
+        int first = range[0].toInt(&ok1);
+        int last = range.size() == 2 ? range[1].toInt(&ok2) : first;
+        if( ! ok1 || ! ok2 || range.size() > 2 || first < 0 || last < first )
+            throw QString("TaskScheduler: invalid CPU list \"%1\"").arg(list);
+        for( int cpu = first; cpu <= last; ++cpu )
+            cpus.append(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * @details
+ * Returns the given grain size or, if it is not positive, one that splits
+ * the n indices into about four pieces per worker thread.
+ */
+int TaskScheduler::_grain(int n, int grain) const
+{
+    if( grain > 0 ) return grain;
+    int pieces = 4 * threads();
+    return qMax(1, (n + pieces - 1) / pieces);
+}
+
+/**
+ * @details
+ * Takes the newest task from the worker's own queue or, failing that, the
+ * oldest task from one of the other queues. Returns 0 if there are none.
+ */
+TaskScheduler::Task* TaskScheduler::_take(int worker)
+{
+    Task* task = 0;
+    if( worker >= 0 ) {
+        Queue* queue = _queues[worker];
+        QMutexLocker locker(&queue->mutex);
+        if( ! queue->tasks.isEmpty() )
+            return queue->tasks.takeLast();
+    }
+    int n = _queues.size();
+    int start = worker >= 0 ? worker + 1 : (int)(_next.value() % n);
+    for( int i = 0; i < n && ! task; ++i ) {
+        Queue* queue = _queues[(start + i) % n];
+        QMutexLocker locker(&queue->mutex);
+        if( ! queue->tasks.isEmpty() )
+            task = queue->tasks.takeFirst();
+    }
+    return task;
+}
+
+/**
+ * @details
+ * Runs the task, recording any error in its group, and wakes the threads
+ * waiting for the group when it is the last of its group to finish.
+ */
+void TaskScheduler::_run(Task* task)
+{
+    Group* group = task->_group;
+    QString error;
+    try {
+        task->run();
+    }
+    catch( const QString& e ) {
+        error = e;
+    }
+    catch( ... ) {
+        error = "TaskScheduler: unknown exception thrown by a task";
+    }
+    if( ! error.isEmpty() ) {
+        QMutexLocker locker(&group->_mutex);
+        if( group->_error.isEmpty() )
+            group->_error = error;
+    }
+    // The task may be deleted as soon as its group has finished.
+    if( group->_pending.sub() == 0 )
+        _events.notifyAll();
+}
+
+/**
+ * @details
+ * Runs tasks until the scheduler is destroyed, sleeping while there are
+ * none to run.
+ */
+void TaskScheduler::_work(int worker)
+{
+    while( ! _stopping ) {
+        Task* task = _take(worker);
+        if( ! task ) {
+            EventCount::Key key = _events.prepareWait();
+            if( _stopping || (task = _take(worker)) ) {
+                _events.cancelWait();
+            }
+            else {
+                _events.wait(key);
+                continue;
+            }
+        }
+        if( task ) _run(task);
+    }
+}
+
+} // namespace pelican
@@ -0,0 +1,215 @@
+#include "ThreadPlacement.h"
+#include "ConfigNode.h"
+#include "TaskScheduler.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtXml/QDomElement>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+
+namespace pelican {
+
+// Configured placements, by thread class or class/name.
+static QMutex registryMutex;
+static QHash<QString, ThreadPlacement> registry;
+// Threads already reported by place(), by class or class (name).
+static QSet<QString> reported;
+
+
+/**
+ * @details
+ * Constructs a placement from the \c cpus, \c policy and \c priority
+ * attributes of the node. Throws if they are not understood.
+ */
+ThreadPlacement::ThreadPlacement(const ConfigNode& config)
+{
+    _cpus = TaskScheduler::parseCpus(config.getAttribute("cpus"));
+    foreach (int cpu, _cpus) {
+        if (cpu >= CPU_SETSIZE)
+            throw QString("ThreadPlacement: CPU %1 for %2 is out of range.")
+                    .arg(cpu).arg(config.type());
+    }
+    QString policy = config.getAttribute("policy").toLower();
+    if (policy.isEmpty() || policy == "other")
+        _policy = Other;
+    else if (policy == "fifo")
+        _policy = Fifo;
+    else if (policy == "rr")
+        _policy = RoundRobin;
+    else
+        throw QString("ThreadPlacement: Unknown policy \"%1\" for %2 "
+                "(other, fifo or rr).").arg(policy).arg(config.type());
+
+    _priority = 0;
+    if (_policy != Other) {
+        bool ok = false;
+        _priority = config.getAttribute("priority").toInt(&ok);
+        if (!ok || _priority < 1 || _priority > 99)
+            throw QString("ThreadPlacement: %1 needs a real-time priority "
+                    "from 1 to 99.").arg(config.type());
+    }
+}
+
+/**
+ * @details
+ * Binds the calling thread to the placement's CPUs and sets its scheduling
+ * policy. Returns false, setting the error if given, if either failed.
+ */
+bool ThreadPlacement::apply(QString* error) const
+{
+    QStringList errors;
+    if (!_cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        foreach (int cpu, _cpus)
+            CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            errors << QString("unable to bind to CPUs %1: %2")
+                    .arg(formatCpus(_cpus)).arg(strerror(errno));
+    }
+    if (_policy != Other) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = _priority;
+        int policy = (_policy == Fifo) ? SCHED_FIFO : SCHED_RR;
+        if (sched_setscheduler(0, policy, &param) != 0)
+            errors << QString("unable to set %1 priority %2: %3")
+                    .arg(policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR")
+                    .arg(_priority).arg(strerror(errno));
+    }
+    if (error) *error = errors.join("; ");
+    return errors.isEmpty();
+}
+
+/**
+ * @details
+ * Adds the placements listed in the \c threads tag of the given node, one
+ * child tag per thread class, replacing any already configured for the
+ * same threads.
+ */
+void ThreadPlacement::configure(const ConfigNode& config)
+{
+    QDomElement threads = config.getDomElement().firstChildElement("threads");
+    QHash<QString, ThreadPlacement> placements;
+    for (QDomElement e = threads.firstChildElement(); !e.isNull();
+            e = e.nextSiblingElement()) {
+        ConfigNode node(e, 0);
+        QString key = e.tagName();
+        if (!node.name().isEmpty())
+            key += "/" + node.name();
+        placements.insert(key, ThreadPlacement(node));
+    }
+    QMutexLocker locker(&registryMutex);
+    QHash<QString, ThreadPlacement>::const_iterator i;
+    for (i = placements.constBegin(); i != placements.constEnd(); ++i)
+        registry.insert(i.key(), i.value());
+}
+
+/**
+ * @details
+ * Returns the placement configured for the named thread of the class, or
+ * else for the class.
+ */
+ThreadPlacement ThreadPlacement::find(const QString& threadClass,
+        const QString& name)
+{
+    QMutexLocker locker(&registryMutex);
+    if (!name.isEmpty() && registry.contains(threadClass + "/" + name))
+        return registry.value(threadClass + "/" + name);
+    return registry.value(threadClass);
+}
+
+/**
+ * @details
+ * Applies the placement configured for the calling thread, and reports
+ * where it runs on stdout. Nothing is reported if no placements are
+ * configured at all, and only the first thread of each class and name is
+ * reported, as threads such as sessions are started for each connection.
+ */
+void ThreadPlacement::place(const QString& threadClass, const QString& name)
+{
+    QString thread = threadClass;
+    if (!name.isEmpty())
+        thread += QString(" (%1)").arg(name);
+    bool report;
+    {
+        QMutexLocker locker(&registryMutex);
+        if (registry.isEmpty()) return;
+        report = !reported.contains(thread);
+        reported.insert(thread);
+    }
+
+    QString error;
+    bool applied = find(threadClass, name).apply(&error);
+    if (!report) return;
+    if (!applied)
+        std::cerr << "ThreadPlacement: " << thread.toStdString() << ": "
+                  << error.toStdString() << std::endl;
+    std::cout << "ThreadPlacement: " << thread.toStdString() << " "
+              << describe().toStdString() << std::endl;
+}
+
+/**
+ * @details
+ * Returns the thread id, CPUs and scheduling policy of the calling thread,
+ * e.g. "thread 1234 on CPUs 2-3, SCHED_FIFO priority 80".
+ */
+QString ThreadPlacement::describe()
+{
+    QList<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set)) cpus.append(cpu);
+    }
+
+    QString policy;
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    sched_getparam(0, &param);
+    switch (sched_getscheduler(0)) {
+        case SCHED_FIFO:
+            policy = QString("SCHED_FIFO priority %1").arg(param.sched_priority);
+            break;
+        case SCHED_RR:
+            policy = QString("SCHED_RR priority %1").arg(param.sched_priority);
+            break;
+        default:
+            policy = "SCHED_OTHER";
+    }
+    return QString("thread %1 on CPUs %2, %3").arg(syscall(SYS_gettid))
+            .arg(formatCpus(cpus)).arg(policy);
+}
+
+/**
+ * @details
+ * Returns the list of CPUs with consecutive CPUs given as ranges, the
+ * inverse of TaskScheduler::parseCpus().
+ */
+QString ThreadPlacement::formatCpus(const QList<int>& cpus)
+{
+    QStringList ranges;
+    for (int i = 0; i < cpus.size(); ) {
+        int j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+        if (j == i)
+            ranges << QString::number(cpus[i]);
+        else
+            ranges << QString("%1-%2").arg(cpus[i]).arg(cpus[j]);
+        i = j + 1;
+    }
+    return ranges.join(",");
+}
+
+} // namespace pelican
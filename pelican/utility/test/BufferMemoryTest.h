@@ -0,0 +1,45 @@
+#ifndef BUFFERMEMORYTEST_H
+#define BUFFERMEMORYTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file BufferMemoryTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class BufferMemoryTest
+ *
+ * @brief
+ *   Unit test for the BufferMemory and BufferAllocator classes.
+ * @details
+ *
+ */
+
+class BufferMemoryTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( BufferMemoryTest );
+        CPPUNIT_TEST( test_config );
+        CPPUNIT_TEST( test_allocate );
+        CPPUNIT_TEST( test_allocator );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_config();
+        void test_allocate();
+        void test_allocator();
+
+    public:
+        BufferMemoryTest();
+        ~BufferMemoryTest();
+};
+
+} // namespace pelican
+#endif // BUFFERMEMORYTEST_H
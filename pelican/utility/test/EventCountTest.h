@@ -0,0 +1,45 @@
+#ifndef EVENTCOUNTTEST_H
+#define EVENTCOUNTTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file EventCountTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class EventCountTest
+ *
+ * @brief
+ *   unit test for the EventCount class
+ * @details
+ *
+ */
+
+class EventCountTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( EventCountTest );
+        CPPUNIT_TEST( test_timeout );
+        CPPUNIT_TEST( test_notify );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_timeout();
+        void test_notify();
+
+    public:
+        EventCountTest(  );
+        ~EventCountTest();
+
+    private:
+};
+
+} // namespace pelican
+#endif // EVENTCOUNTTEST_H
@@ -0,0 +1,43 @@
+#ifndef LATENCYHISTOGRAMTEST_H
+#define LATENCYHISTOGRAMTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file LatencyHistogramTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class LatencyHistogramTest
+ *
+ * @brief
+ *   Unit test for the LatencyHistogram and LatencyMonitor classes.
+ * @details
+ *
+ */
+
+class LatencyHistogramTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( LatencyHistogramTest );
+        CPPUNIT_TEST( test_histogram );
+        CPPUNIT_TEST( test_monitor );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_histogram();
+        void test_monitor();
+
+    public:
+        LatencyHistogramTest();
+        ~LatencyHistogramTest();
+};
+
+} // namespace pelican
+#endif // LATENCYHISTOGRAMTEST_H
@@ -0,0 +1,45 @@
+#ifndef LOCKFREEQUEUETEST_H
+#define LOCKFREEQUEUETEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file LockFreeQueueTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class LockFreeQueueTest
+ *
+ * @brief
+ *   unit test for the LockFreeQueue template
+ * @details
+ *
+ */
+
+class LockFreeQueueTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( LockFreeQueueTest );
+        CPPUNIT_TEST( test_fifo );
+        CPPUNIT_TEST( test_concurrent );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_fifo();
+        void test_concurrent();
+
+    public:
+        LockFreeQueueTest(  );
+        ~LockFreeQueueTest();
+
+    private:
+};
+
+} // namespace pelican
+#endif // LOCKFREEQUEUETEST_H
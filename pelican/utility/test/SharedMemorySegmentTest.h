@@ -0,0 +1,45 @@
+#ifndef SHAREDMEMORYSEGMENTTEST_H
+#define SHAREDMEMORYSEGMENTTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file SharedMemorySegmentTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class SharedMemorySegmentTest
+ *
+ * @brief
+ *   Unit test for the SharedMemorySegment class.
+ * @details
+ *
+ */
+
+class SharedMemorySegmentTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( SharedMemorySegmentTest );
+        CPPUNIT_TEST( test_create );
+        CPPUNIT_TEST( test_attach );
+        CPPUNIT_TEST( test_find );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_create();
+        void test_attach();
+        void test_find();
+
+    public:
+        SharedMemorySegmentTest();
+        ~SharedMemorySegmentTest();
+};
+
+} // namespace pelican
+#endif // SHAREDMEMORYSEGMENTTEST_H
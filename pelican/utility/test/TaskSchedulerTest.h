@@ -0,0 +1,53 @@
+#ifndef TASKSCHEDULERTEST_H
+#define TASKSCHEDULERTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file TaskSchedulerTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class TaskSchedulerTest
+ *
+ * @brief
+ *   unit test for the TaskScheduler class
+ * @details
+ *
+ */
+
+class TaskSchedulerTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( TaskSchedulerTest );
+        CPPUNIT_TEST( test_run );
+        CPPUNIT_TEST( test_nested );
+        CPPUNIT_TEST( test_error );
+        CPPUNIT_TEST( test_parallelFor );
+        CPPUNIT_TEST( test_parallelReduce );
+        CPPUNIT_TEST( test_parseCpus );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_run();
+        void test_nested();
+        void test_error();
+        void test_parallelFor();
+        void test_parallelReduce();
+        void test_parseCpus();
+
+    public:
+        TaskSchedulerTest(  );
+        ~TaskSchedulerTest();
+
+    private:
+};
+
+} // namespace pelican
+#endif // TASKSCHEDULERTEST_H
@@ -0,0 +1,45 @@
+#ifndef THREADPLACEMENTTEST_H
+#define THREADPLACEMENTTEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/**
+ * @file ThreadPlacementTest.h
+ */
+
+namespace pelican {
+
+/**
+ * @class ThreadPlacementTest
+ *
+ * @brief
+ *   Unit test for the ThreadPlacement class.
+ * @details
+ *
+ */
+
+class ThreadPlacementTest : public CppUnit::TestFixture
+{
+    public:
+        CPPUNIT_TEST_SUITE( ThreadPlacementTest );
+        CPPUNIT_TEST( test_config );
+        CPPUNIT_TEST( test_find );
+        CPPUNIT_TEST( test_apply );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+        void setUp();
+        void tearDown();
+
+        // Test Methods
+        void test_config();
+        void test_find();
+        void test_apply();
+
+    public:
+        ThreadPlacementTest();
+        ~ThreadPlacementTest();
+};
+
+} // namespace pelican
+#endif // THREADPLACEMENTTEST_H
@@ -0,0 +1,97 @@
+#include "BufferMemoryTest.h"
+#include "BufferMemory.h"
+#include "ConfigNode.h"
+
+#include <vector>
+
+namespace pelican {
+CPPUNIT_TEST_SUITE_REGISTRATION( BufferMemoryTest );
+
+BufferMemoryTest::BufferMemoryTest()
+    : CppUnit::TestFixture()
+{
+}
+
+BufferMemoryTest::~BufferMemoryTest()
+{
+}
+
+void BufferMemoryTest::setUp()
+{
+}
+
+void BufferMemoryTest::tearDown()
+{
+}
+
+void BufferMemoryTest::test_config()
+{
+    {
+        // Use Case:
+        // No memory options
+        // Expect the default policy
+        BufferMemory memory(ConfigNode("<Stream><buffer maxSize=\"1024\"/></Stream>"),
+                "buffer");
+        CPPUNIT_ASSERT( memory.isDefault() );
+        CPPUNIT_ASSERT_EQUAL( -1, memory.numaNode() );
+    }
+    {
+        // Use Case:
+        // Huge pages, locking and a NUMA node
+        // Expect them all to be set
+        BufferMemory memory(ConfigNode("<Stream><buffer pages=\"1G\" "
+                "lock=\"true\" numaNode=\"1\"/></Stream>"), "buffer");
+        CPPUNIT_ASSERT( ! memory.isDefault() );
+        CPPUNIT_ASSERT( memory.pages() == BufferMemory::HugePages1G );
+        CPPUNIT_ASSERT( memory.lock() );
+        CPPUNIT_ASSERT_EQUAL( 1, memory.numaNode() );
+    }
+    {
+        // Use Case:
+        // An unknown page size
+        // Expect to throw
+        CPPUNIT_ASSERT_THROW( BufferMemory(ConfigNode("<Stream><buffer "
+                "pages=\"3M\"/></Stream>"), "buffer"), QString );
+    }
+}
+
+void BufferMemoryTest::test_allocate()
+{
+    // Use Case:
+    // Memory asked for on 2M pages, locked and on node 0, whether or not
+    // the machine has huge pages, permission to lock or NUMA nodes
+    // Expect zero filled memory that can be written and released
+    BufferMemory policies[] = {
+        BufferMemory(),
+        BufferMemory(BufferMemory::HugePages2M),
+        BufferMemory(BufferMemory::SmallPages, true, 0)
+    };
+    for (unsigned i = 0; i < sizeof(policies) / sizeof(BufferMemory); ++i) {
+        size_t size = 3 * 1024 * 1024 + 1;
+        char* memory = (char*) policies[i].allocate(size);
+        CPPUNIT_ASSERT( memory != 0 );
+        CPPUNIT_ASSERT_EQUAL( (char)0, memory[0] );
+        CPPUNIT_ASSERT_EQUAL( (char)0, memory[size - 1] );
+        memory[size - 1] = 1;
+        BufferMemory::release(memory);
+    }
+    CPPUNIT_ASSERT_EQUAL( (size_t)(2 << 20),
+            BufferMemory::pageBytes(BufferMemory::HugePages2M) );
+}
+
+void BufferMemoryTest::test_allocator()
+{
+    // Use Case:
+    // A vector allocated from a policy that is changed part way through
+    // Expect the data to be kept
+    BufferMemory memory;
+    std::vector<double, BufferAllocator<double> > data(
+            BufferAllocator<double>(&memory));
+    data.resize(10, 1.0);
+    memory = BufferMemory(BufferMemory::HugePages2M);
+    data.resize(100000, 2.0);
+    CPPUNIT_ASSERT_EQUAL( 1.0, data[9] );
+    CPPUNIT_ASSERT_EQUAL( 2.0, data[99999] );
+}
+
+} // namespace pelican
@@ -0,0 +1,104 @@
+#include "EventCountTest.h"
+#include "EventCount.h"
+
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( EventCountTest );
+
+/**
+ * @details
+ * Waits on an EventCount until the flag is set.
+ */
+class EventCountTestWaiter : public QThread
+{
+    public:
+        EventCountTestWaiter(EventCount* events, volatile int* flag)
+            : woken(false), _events(events), _flag(flag) {}
+        bool woken;
+
+    protected:
+        void run() {
+            while( ! *_flag ) {
+                EventCount::Key key = _events->prepareWait();
+                if( *_flag ) { _events->cancelWait(); break; }
+                _events->wait(key, 5000);
+            }
+            woken = true;
+        }
+
+    private:
+        EventCount* _events;
+        volatile int* _flag;
+};
+
+/**
+ *@details EventCountTest
+ */
+EventCountTest::EventCountTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+EventCountTest::~EventCountTest()
+{
+}
+
+void EventCountTest::setUp()
+{
+}
+
+void EventCountTest::tearDown()
+{
+}
+
+void EventCountTest::test_timeout()
+{
+    // Use Case:
+    // wait() with nothing notified
+    // Expect: to return false after the timeout
+    EventCount events;
+    QTime timer; timer.start();
+    EventCount::Key key = events.prepareWait();
+    CPPUNIT_ASSERT( ! events.wait(key, 50) );
+    CPPUNIT_ASSERT( timer.elapsed() >= 40 );
+
+    // Use Case:
+    // notified between prepareWait() and wait()
+    // Expect: to return true immediately
+    key = events.prepareWait();
+    events.notifyAll();
+    timer.restart();
+    CPPUNIT_ASSERT( events.wait(key, 5000) );
+    CPPUNIT_ASSERT( timer.elapsed() < 1000 );
+}
+
+void EventCountTest::test_notify()
+{
+    // Use Case:
+    // Several threads blocked on the event count
+    // Expect: all to be woken by a single notifyAll()
+    EventCount events;
+    volatile int flag = 0;
+    QList<EventCountTestWaiter*> waiters;
+    for( int i = 0; i < 3; ++i ) {
+        waiters.append(new EventCountTestWaiter(&events, &flag));
+        waiters.last()->start();
+    }
+    QThread::yieldCurrentThread();
+    flag = 1;
+    events.notifyAll();
+    foreach( EventCountTestWaiter* w, waiters ) {
+        CPPUNIT_ASSERT( w->wait(2000) );
+        CPPUNIT_ASSERT( w->woken );
+        delete w;
+    }
+}
+
+} // namespace pelican
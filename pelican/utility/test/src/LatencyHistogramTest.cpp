@@ -0,0 +1,95 @@
+#include "LatencyHistogramTest.h"
+#include "LatencyHistogram.h"
+#include "LatencyMonitor.h"
+
+
+namespace pelican {
+CPPUNIT_TEST_SUITE_REGISTRATION( LatencyHistogramTest );
+
+LatencyHistogramTest::LatencyHistogramTest()
+    : CppUnit::TestFixture()
+{
+}
+
+LatencyHistogramTest::~LatencyHistogramTest()
+{
+}
+
+void LatencyHistogramTest::setUp()
+{
+}
+
+void LatencyHistogramTest::tearDown()
+{
+}
+
+void LatencyHistogramTest::test_histogram()
+{
+    // Use Case:
+    // Latencies of 1 us, 3 us (x98) and 1 s
+    // Expect them in the buckets bounded by 1 us, 4 us and 1.05 s,
+    // and the quantiles to be the bucket bounds
+    LatencyHistogram h;
+    CPPUNIT_ASSERT_EQUAL( (quint64)0, h.quantile(0.5) );
+    h.add(1000);
+    for (int i = 0; i < 98; ++i) h.add(3000);
+    h.add(1000000000);
+    CPPUNIT_ASSERT_EQUAL( (quint64)100, h.count() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1000000000, h.max() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)(1000 + 98 * 3000 + 1000000000), h.sum() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1, h.bucketCount(0) );
+    CPPUNIT_ASSERT_EQUAL( (quint64)98, h.bucketCount(2) );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1, h.bucketCount(20) );
+    CPPUNIT_ASSERT_EQUAL( (quint64)4000, h.quantile(0.5) );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1000000000, h.quantile(1.0) );
+
+    // Expect cumulative buckets in seconds.
+    QMap<QString, double> values;
+    h.metrics(values, "latency", "stream=\"a\"");
+    CPPUNIT_ASSERT_EQUAL( 99.0, values.value("latency_bucket{stream=\"a\",le=\"4e-06\"}") );
+    CPPUNIT_ASSERT_EQUAL( 100.0, values.value("latency_bucket{stream=\"a\",le=\"+Inf\"}") );
+    CPPUNIT_ASSERT_EQUAL( 100.0, values.value("latency_count{stream=\"a\"}") );
+
+    h.reset();
+    CPPUNIT_ASSERT_EQUAL( (quint64)0, h.count() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)0, h.bucketCount(2) );
+}
+
+void LatencyHistogramTest::test_monitor()
+{
+    // Use Case:
+    // A trace ingested, adapted 2 ms later and not yet run
+    // Expect only the adapt latency to be recorded
+    LatencyMonitor monitor;
+    LatencyTrace trace;
+    trace.setStream("stream1");
+    trace.setTime(LatencyTrace::Ingest, 1000000);
+    trace.setTime(LatencyTrace::Adapt, 3000000);
+    monitor.record(trace, LatencyTrace::Adapt);
+    monitor.record(trace, LatencyTrace::ExecStart);
+    CPPUNIT_ASSERT( monitor.streams() == QStringList("stream1") );
+    const LatencyHistogram* h = monitor.histogram("stream1", LatencyTrace::Adapt);
+    CPPUNIT_ASSERT( h != 0 );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1, h->count() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)2000000, h->max() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)0,
+            monitor.histogram("stream1", LatencyTrace::ExecStart)->count() );
+    CPPUNIT_ASSERT( monitor.histogram("stream2", LatencyTrace::Adapt) == 0 );
+
+    // Expect a histogram labelled with the stream and stage.
+    QMap<QString, double> values;
+    monitor.metrics(values);
+    CPPUNIT_ASSERT_EQUAL( 1.0, values.value(
+            "pelican_latency_seconds_count{stream=\"stream1\",stage=\"adapt\"}") );
+
+    // Use Case:
+    // A trace with no ingest time
+    // Expect nothing to be recorded
+    LatencyTrace empty;
+    empty.setStream("stream2");
+    empty.stamp(LatencyTrace::Adapt);
+    monitor.record(empty, LatencyTrace::Adapt);
+    CPPUNIT_ASSERT_EQUAL( 1, monitor.streams().size() );
+}
+
+} // namespace pelican
@@ -0,0 +1,116 @@
+#include "LockFreeQueueTest.h"
+#include "LockFreeQueue.hpp"
+
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LockFreeQueueTest );
+
+/**
+ * @details
+ * Pushes a range of values through a queue shared with other threads,
+ * recording everything it takes off the queue.
+ */
+class LockFreeQueueTestWorker : public QThread
+{
+    public:
+        LockFreeQueueTestWorker(LockFreeQueue<int>* queue, int start, int count)
+            : _queue(queue), _start(start), _count(count) {}
+        QVector<int> received;
+
+    protected:
+        void run() {
+            int value;
+            for( int i = _start; i < _start + _count; ++i ) {
+                while( ! _queue->enqueue(i) ) {
+                    if( _queue->dequeue(value) ) received.append(value);
+                }
+                if( _queue->dequeue(value) ) received.append(value);
+            }
+        }
+
+    private:
+        LockFreeQueue<int>* _queue;
+        int _start;
+        int _count;
+};
+
+/**
+ *@details LockFreeQueueTest
+ */
+LockFreeQueueTest::LockFreeQueueTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+LockFreeQueueTest::~LockFreeQueueTest()
+{
+}
+
+void LockFreeQueueTest::setUp()
+{
+}
+
+void LockFreeQueueTest::tearDown()
+{
+}
+
+void LockFreeQueueTest::test_fifo()
+{
+    // Use Case:
+    // Fill and empty a queue several times round the ring
+    // Expect: capacity rounded up to a power of 2, items returned in
+    // order, and enqueue/dequeue to fail when full/empty
+    LockFreeQueue<int> queue(3);
+    CPPUNIT_ASSERT_EQUAL( 4, queue.capacity() );
+    CPPUNIT_ASSERT( queue.isEmpty() );
+    int value = -1;
+    CPPUNIT_ASSERT( ! queue.dequeue(value) );
+    for( int cycle = 0; cycle < 3; ++cycle ) {
+        for( int i = 0; i < 4; ++i ) {
+            CPPUNIT_ASSERT( queue.enqueue(cycle * 10 + i) );
+        }
+        CPPUNIT_ASSERT( ! queue.enqueue(99) );
+        CPPUNIT_ASSERT_EQUAL( 4, queue.size() );
+        for( int i = 0; i < 4; ++i ) {
+            CPPUNIT_ASSERT( queue.dequeue(value) );
+            CPPUNIT_ASSERT_EQUAL( cycle * 10 + i, value );
+        }
+        CPPUNIT_ASSERT( ! queue.dequeue(value) );
+    }
+}
+
+void LockFreeQueueTest::test_concurrent()
+{
+    // Use Case:
+    // Several threads enqueue and dequeue from the same small queue
+    // Expect: every value to be received exactly once
+    const int threads = 4;
+    const int count = 100000;
+    LockFreeQueue<int> queue(16);
+    QList<LockFreeQueueTestWorker*> workers;
+    for( int i = 0; i < threads; ++i ) {
+        workers.append(new LockFreeQueueTestWorker(&queue, i * count, count));
+    }
+    foreach( LockFreeQueueTestWorker* w, workers ) w->start();
+    foreach( LockFreeQueueTestWorker* w, workers ) w->wait();
+
+    QVector<int> seen(threads * count, 0);
+    foreach( LockFreeQueueTestWorker* w, workers ) {
+        foreach( int v, w->received ) ++seen[v];
+        delete w;
+    }
+    int value;
+    while( queue.dequeue(value) ) ++seen[value];
+    for( int i = 0; i < seen.size(); ++i ) {
+        CPPUNIT_ASSERT_EQUAL( 1, seen[i] );
+    }
+}
+
+} // namespace pelican
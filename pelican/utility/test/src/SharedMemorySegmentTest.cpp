@@ -0,0 +1,100 @@
+#include "SharedMemorySegmentTest.h"
+#include "SharedMemorySegment.h"
+
+#include <cstring>
+#include <unistd.h>
+
+namespace pelican {
+CPPUNIT_TEST_SUITE_REGISTRATION( SharedMemorySegmentTest );
+
+SharedMemorySegmentTest::SharedMemorySegmentTest()
+    : CppUnit::TestFixture()
+{
+}
+
+SharedMemorySegmentTest::~SharedMemorySegmentTest()
+{
+}
+
+void SharedMemorySegmentTest::setUp()
+{
+}
+
+void SharedMemorySegmentTest::tearDown()
+{
+}
+
+static QString segmentName(const QString& suffix)
+{
+    return QString("/pelican.SharedMemorySegmentTest.%1.%2")
+            .arg(getpid()).arg(suffix);
+}
+
+void SharedMemorySegmentTest::test_create()
+{
+    // Use Case:
+    // A new segment
+    // Expect it to be mapped, writable and zero filled, and to hold
+    // exactly the addresses inside it
+    QString name = segmentName("create");
+    SharedMemorySegment segment(name, 4096);
+    CPPUNIT_ASSERT_EQUAL( name.toStdString(), segment.name().toStdString() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)4096, segment.size() );
+    CPPUNIT_ASSERT( segment.data() != 0 );
+    for (size_t i = 0; i < segment.size(); ++i)
+        CPPUNIT_ASSERT_EQUAL( 0, (int)segment.data()[i] );
+    memset(segment.data(), 'x', segment.size());
+    CPPUNIT_ASSERT( segment.contains(segment.data()) );
+    CPPUNIT_ASSERT( segment.contains(segment.data() + 4095) );
+    CPPUNIT_ASSERT( ! segment.contains(segment.data() + 4096) );
+    CPPUNIT_ASSERT( ! segment.contains(segment.data() - 1) );
+}
+
+void SharedMemorySegmentTest::test_attach()
+{
+    QString name = segmentName("attach");
+    {
+        // Use Case:
+        // A segment attached to by name
+        // Expect the size and the contents written by the creator
+        SharedMemorySegment segment(name, 8192);
+        strcpy(segment.data() + 100, "shared");
+        SharedMemorySegment attached(name);
+        CPPUNIT_ASSERT_EQUAL( (size_t)8192, attached.size() );
+        CPPUNIT_ASSERT( attached.data() != segment.data() );
+        CPPUNIT_ASSERT_EQUAL( std::string("shared"),
+                std::string(attached.data() + 100) );
+
+        // Use Case:
+        // A segment created again with the same name
+        // Expect the stale segment to be replaced
+        SharedMemorySegment again(name, 1024);
+        CPPUNIT_ASSERT_EQUAL( (size_t)1024, SharedMemorySegment(name).size() );
+    }
+
+    // Use Case:
+    // Attaching after the creator has gone
+    // Expect to throw
+    CPPUNIT_ASSERT_THROW( SharedMemorySegment s(name), QString );
+}
+
+void SharedMemorySegmentTest::test_find()
+{
+    // Use Case:
+    // Addresses in, and outside, the segments created by the process
+    // Expect the segment holding the address, or 0
+    SharedMemorySegment a(segmentName("a"), 4096);
+    SharedMemorySegment b(segmentName("b"), 4096);
+    CPPUNIT_ASSERT( SharedMemorySegment::find(a.data() + 10) == &a );
+    CPPUNIT_ASSERT( SharedMemorySegment::find(b.data() + 4095) == &b );
+    int local = 0;
+    CPPUNIT_ASSERT( SharedMemorySegment::find(&local) == 0 );
+
+    // Use Case:
+    // A segment attached to, rather than created
+    // Expect it not to be found
+    SharedMemorySegment attached(a.name());
+    CPPUNIT_ASSERT( SharedMemorySegment::find(attached.data()) == 0 );
+}
+
+} // namespace pelican
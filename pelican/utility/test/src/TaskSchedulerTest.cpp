@@ -0,0 +1,259 @@
+#include "TaskSchedulerTest.h"
+#include "TaskScheduler.h"
+
+#include <QtCore/QVector>
+
+
+namespace pelican {
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TaskSchedulerTest );
+
+/**
+ * @details
+ * Counts its runs, and optionally submits and waits for child tasks.
+ */
+class TaskSchedulerTestTask : public TaskScheduler::Task
+{
+    public:
+        TaskSchedulerTestTask(AtomicCounter* count, TaskScheduler* scheduler = 0,
+                int children = 0)
+            : _count(count), _scheduler(scheduler), _children(children) {}
+
+        void run() {
+            if( _children > 0 ) {
+                QVector<TaskSchedulerTestTask*> tasks;
+                TaskScheduler::Group group;
+                for( int i = 0; i < _children; ++i ) {
+                    tasks.append(new TaskSchedulerTestTask(_count));
+                    _scheduler->submit(tasks.last(), group);
+                }
+                _scheduler->wait(group);
+                qDeleteAll(tasks);
+            }
+            _count->add();
+        }
+
+    private:
+        AtomicCounter* _count;
+        TaskScheduler* _scheduler;
+        int _children;
+};
+
+/**
+ * @details
+ * Throws an error when run.
+ */
+class TaskSchedulerTestError : public TaskScheduler::Task
+{
+    public:
+        void run() { throw QString("task failed"); }
+};
+
+/**
+ * @details
+ * Doubles the values of a piece of an array, counting the pieces.
+ */
+struct TaskSchedulerTestDouble
+{
+    int* values;
+    AtomicCounter* pieces;
+    void operator()(int begin, int end) const {
+        for( int i = begin; i < end; ++i ) values[i] *= 2;
+        pieces->add();
+    }
+};
+
+/**
+ * @details
+ * Sums a piece of an array.
+ */
+struct TaskSchedulerTestSum
+{
+    const int* values;
+    qint64 operator()(int begin, int end) const {
+        qint64 sum = 0;
+        for( int i = begin; i < end; ++i ) sum += values[i];
+        return sum;
+    }
+};
+
+/**
+ * @details
+ * Joins the partial sums.
+ */
+struct TaskSchedulerTestAdd
+{
+    qint64 operator()(qint64 a, qint64 b) const { return a + b; }
+};
+
+/**
+ *@details TaskSchedulerTest
+ */
+TaskSchedulerTest::TaskSchedulerTest()
+    : CppUnit::TestFixture()
+{
+}
+
+/**
+ *@details
+ */
+TaskSchedulerTest::~TaskSchedulerTest()
+{
+}
+
+void TaskSchedulerTest::setUp()
+{
+}
+
+void TaskSchedulerTest::tearDown()
+{
+}
+
+void TaskSchedulerTest::test_run()
+{
+    // Use Case:
+    // Many tasks submitted to a group
+    // Expect: all to have run when wait() returns
+    TaskScheduler scheduler(4);
+    CPPUNIT_ASSERT_EQUAL( 4, scheduler.threads() );
+    CPPUNIT_ASSERT_EQUAL( -1, scheduler.currentWorker() );
+    AtomicCounter count;
+    QVector<TaskSchedulerTestTask*> tasks;
+    TaskScheduler::Group group;
+    for( int i = 0; i < 1000; ++i ) {
+        tasks.append(new TaskSchedulerTestTask(&count));
+        scheduler.submit(tasks.last(), group);
+    }
+    scheduler.wait(group);
+    CPPUNIT_ASSERT_EQUAL( 0, group.pending() );
+    CPPUNIT_ASSERT_EQUAL( (quint64)1000, count.value() );
+    qDeleteAll(tasks);
+
+    // Use Case:
+    // Waiting for an empty group
+    // Expect: to return immediately
+    TaskScheduler::Group empty;
+    scheduler.wait(empty);
+}
+
+void TaskSchedulerTest::test_nested()
+{
+    // Use Case:
+    // More tasks than workers, each waiting for tasks of its own
+    // Expect: no deadlock, as waiting threads run the queued tasks
+    TaskScheduler scheduler(2);
+    AtomicCounter count;
+    QVector<TaskSchedulerTestTask*> tasks;
+    TaskScheduler::Group group;
+    for( int i = 0; i < 8; ++i ) {
+        tasks.append(new TaskSchedulerTestTask(&count, &scheduler, 10));
+        scheduler.submit(tasks.last(), group);
+    }
+    scheduler.wait(group);
+    CPPUNIT_ASSERT_EQUAL( (quint64)(8 * 11), count.value() );
+    qDeleteAll(tasks);
+}
+
+void TaskSchedulerTest::test_error()
+{
+    // Use Case:
+    // A task throws an error
+    // Expect: the other tasks to run, and wait() to throw the error
+    TaskScheduler scheduler(2);
+    AtomicCounter count;
+    TaskSchedulerTestTask task1(&count), task2(&count);
+    TaskSchedulerTestError error;
+    TaskScheduler::Group group;
+    scheduler.submit(&task1, group);
+    scheduler.submit(&error, group);
+    scheduler.submit(&task2, group);
+    try {
+        scheduler.wait(group);
+        CPPUNIT_FAIL("expecting an exception");
+    }
+    catch( const QString& e ) {
+        CPPUNIT_ASSERT_EQUAL( std::string("task failed"), e.toStdString() );
+    }
+    CPPUNIT_ASSERT_EQUAL( (quint64)2, count.value() );
+
+    // the error is only thrown once
+    TaskScheduler::Group next;
+    scheduler.submit(&task1, next);
+    scheduler.wait(next);
+}
+
+void TaskSchedulerTest::test_parallelFor()
+{
+    TaskScheduler scheduler(4);
+    QVector<int> values(1000, 1);
+    AtomicCounter pieces;
+    TaskSchedulerTestDouble body = { values.data(), &pieces };
+    {
+        // Use Case:
+        // Loop with a grain size
+        // Expect: every index to be visited once, in pieces of the grain
+        scheduler.parallelFor(0, values.size(), body, 100);
+        CPPUNIT_ASSERT_EQUAL( (quint64)10, pieces.value() );
+        CPPUNIT_ASSERT_EQUAL( 1000, values.count(2) );
+    }
+    {
+        // Use Case:
+        // Loop with the default grain size
+        // Expect: about four pieces per thread
+        pieces.set(0);
+        scheduler.parallelFor(0, values.size(), body);
+        CPPUNIT_ASSERT_EQUAL( (quint64)16, pieces.value() );
+        CPPUNIT_ASSERT_EQUAL( 1000, values.count(4) );
+    }
+    {
+        // Use Case:
+        // Range smaller than the grain, and an empty range
+        // Expect: the body to be called once, then not at all
+        pieces.set(0);
+        scheduler.parallelFor(10, 20, body, 100);
+        scheduler.parallelFor(20, 20, body);
+        CPPUNIT_ASSERT_EQUAL( (quint64)1, pieces.value() );
+        CPPUNIT_ASSERT_EQUAL( 8, values[10] );
+    }
+}
+
+void TaskSchedulerTest::test_parallelReduce()
+{
+    // Use Case:
+    // Sum of an array, with several grain sizes
+    // Expect: the same result as a serial sum
+    TaskScheduler scheduler(3);
+    QVector<int> values(10001);
+    for( int i = 0; i < values.size(); ++i ) values[i] = i;
+    TaskSchedulerTestSum sum = { values.data() };
+    TaskSchedulerTestAdd add;
+    qint64 expected = (qint64)10000 * 10001 / 2;
+    CPPUNIT_ASSERT_EQUAL( expected,
+            scheduler.parallelReduce(0, values.size(), (qint64)0, sum, add) );
+    CPPUNIT_ASSERT_EQUAL( expected,
+            scheduler.parallelReduce(0, values.size(), (qint64)0, sum, add, 7) );
+    CPPUNIT_ASSERT_EQUAL( expected + 5, scheduler.parallelReduce(0,
+                values.size(), (qint64)5, sum, add, 100000) );
+    CPPUNIT_ASSERT_EQUAL( (qint64)5,
+            scheduler.parallelReduce(3, 3, (qint64)5, sum, add) );
+}
+
+void TaskSchedulerTest::test_parseCpus()
+{
+    QList<int> cpus = TaskScheduler::parseCpus("0-2, 5,7-8");
+    CPPUNIT_ASSERT_EQUAL( 6, cpus.size() );
+    CPPUNIT_ASSERT_EQUAL( 2, cpus[2] );
+    CPPUNIT_ASSERT_EQUAL( 5, cpus[3] );
+    CPPUNIT_ASSERT_EQUAL( 8, cpus[5] );
+    CPPUNIT_ASSERT( TaskScheduler::parseCpus("").isEmpty() );
+    CPPUNIT_ASSERT_THROW( TaskScheduler::parseCpus("3-1"), QString );
+    CPPUNIT_ASSERT_THROW( TaskScheduler::parseCpus("a"), QString );
+
+    // Use Case:
+    // Scheduler bound to CPUs, with the default number of threads
+    // Expect: one thread per CPU
+    TaskScheduler scheduler(0, QList<int>() << 0 << 0);
+    CPPUNIT_ASSERT_EQUAL( 2, scheduler.threads() );
+}
+
+} // namespace pelican
@@ -0,0 +1,115 @@
+#include "ThreadPlacementTest.h"
+#include "ThreadPlacement.h"
+#include "ConfigNode.h"
+
+#include <QtCore/QThread>
+#include <sched.h>
+
+namespace pelican {
+CPPUNIT_TEST_SUITE_REGISTRATION( ThreadPlacementTest );
+
+/**
+ * @details
+ * Applies a placement on its own thread and records where it ran.
+ */
+class ThreadPlacementTestThread : public QThread
+{
+    public:
+        ThreadPlacementTestThread(const ThreadPlacement& placement)
+            : _placement(placement), _applied(false) {}
+        void run() {
+            _applied = _placement.apply();
+            _description = ThreadPlacement::describe();
+        }
+        ThreadPlacement _placement;
+        bool _applied;
+        QString _description;
+};
+
+ThreadPlacementTest::ThreadPlacementTest()
+    : CppUnit::TestFixture()
+{
+}
+
+ThreadPlacementTest::~ThreadPlacementTest()
+{
+}
+
+void ThreadPlacementTest::setUp()
+{
+}
+
+void ThreadPlacementTest::tearDown()
+{
+}
+
+void ThreadPlacementTest::test_config()
+{
+    {
+        // Use Case:
+        // CPUs and a real-time policy
+        // Expect them to be read
+        ThreadPlacement p(ConfigNode("<DataReceiver cpus=\"0-2,5\" "
+                "policy=\"fifo\" priority=\"80\"/>"));
+        CPPUNIT_ASSERT( p.isSet() );
+        CPPUNIT_ASSERT_EQUAL( 4, p.cpus().size() );
+        CPPUNIT_ASSERT( p.policy() == ThreadPlacement::Fifo );
+        CPPUNIT_ASSERT_EQUAL( 80, p.priority() );
+        CPPUNIT_ASSERT_EQUAL( std::string("0-2,5"),
+                ThreadPlacement::formatCpus(p.cpus()).toStdString() );
+    }
+    {
+        // Use Case:
+        // No attributes
+        // Expect a placement that changes nothing
+        ThreadPlacement p(ConfigNode("<Session/>"));
+        CPPUNIT_ASSERT( ! p.isSet() );
+    }
+    {
+        // Use Case:
+        // A real-time policy without a priority, or an unknown policy
+        // Expect to throw
+        CPPUNIT_ASSERT_THROW( ThreadPlacement(ConfigNode("<Session "
+                "policy=\"rr\"/>")), QString );
+        CPPUNIT_ASSERT_THROW( ThreadPlacement(ConfigNode("<Session "
+                "policy=\"idle\"/>")), QString );
+    }
+}
+
+void ThreadPlacementTest::test_find()
+{
+    // Use Case:
+    // A threads section with a class placement and one for a named thread
+    // Expect the named thread to get its own placement, and others of the
+    // class the class placement
+    ThreadPlacement::configure(ConfigNode("<server><threads>"
+            "<TestReceiver cpus=\"1\"/>"
+            "<TestReceiver name=\"special\" cpus=\"2-3\"/>"
+            "</threads></server>"));
+    CPPUNIT_ASSERT_EQUAL( std::string("1"), ThreadPlacement::formatCpus(
+            ThreadPlacement::find("TestReceiver", "other").cpus()).toStdString() );
+    CPPUNIT_ASSERT_EQUAL( std::string("2-3"), ThreadPlacement::formatCpus(
+            ThreadPlacement::find("TestReceiver", "special").cpus()).toStdString() );
+    CPPUNIT_ASSERT( ! ThreadPlacement::find("TestSession").isSet() );
+}
+
+void ThreadPlacementTest::test_apply()
+{
+    // Use Case:
+    // A thread bound to the first CPU it is allowed to run on
+    // Expect it to run there only
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPPUNIT_ASSERT( sched_getaffinity(0, sizeof(set), &set) == 0 );
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &set)) ++cpu;
+    ThreadPlacement placement(ConfigNode(QString("<Test cpus=\"%1\"/>").arg(cpu)));
+    ThreadPlacementTestThread thread(placement);
+    thread.start();
+    thread.wait();
+    CPPUNIT_ASSERT( thread._applied );
+    CPPUNIT_ASSERT( thread._description.contains(
+            QString("on CPUs %1, SCHED_OTHER").arg(cpu)) );
+}
+
+} // namespace pelican